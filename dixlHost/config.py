@@ -7,6 +7,10 @@
 """
 # Communication parameter
 NodeCommPort: int 	                    = 256
+NodeCommCompact: bool                   = True      # send messages with the compact header (nodes accept both)
+NodeConfigBulk: bool                    = True      # send the routes configuration many routes per message
+RouteStarTopology: bool                 = False     # routes reserved by their first node coordinating all the others (star), not node to node (chain)
 RouteRequestResponseTimeout: int        = 10        # seconds
+RouteTrace: bool                        = False     # route requests traced by the nodes: per-hop timestamps back with TRAINOK/TRAINNOK, printed as a waterfall
 LogRequestResponseTimeout: int          = 10        # seconds
 NodeMalfunctionSimulationMaxDelay: int  = 2000      # ms
\ No newline at end of file
@@ -28,6 +28,7 @@ class   Main():
         - view.node.log
         - view.node.malfunction
         - view.route.request
+        - view.route.requestbatch
         - node.update.state
         - node.update.log
     """         
@@ -51,6 +52,7 @@ class   Main():
         pub.subscribe(self.viewNodeClearLog, 'view.node.clearlog')
         pub.subscribe(self.viewNodeMalfunction, 'view.node.malfunction')
         pub.subscribe(self.viewRouteRequest, 'view.route.request')
+        pub.subscribe(self.viewRouteRequestBatch, 'view.route.requestbatch')
         pub.subscribe(self.nodeUpdateState, 'node.update.state')
         pub.subscribe(self.nodeUpdateIP, 'node.update.IP')
         pub.subscribe(self.nodeUpdateLog, 'node.update.log')
@@ -177,3 +179,14 @@ class   Main():
 
         # Call the function
         return route.request(self.hostIP)
+
+    def viewRouteRequestBatch(self, routeIds: list[int]) -> bool:
+        # Check route IDs
+        if not routeIds: return False
+
+        # Find route instances
+        routes: list[Route] = [self.model.routes.get(routeId, None) for routeId in routeIds]
+        if None in routes: return False
+
+        # Call the function
+        return Route.requestBatch(routes, self.hostIP)
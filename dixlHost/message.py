@@ -11,6 +11,7 @@ from collections.abc import Iterable
 from enum import Enum
 
 import random
+import select
 import socket
 from pubsub import pub
 import time
@@ -31,17 +32,26 @@ class MsgType(Enum):
 	# Service messages - Init task
 	NODERESET 					= 10	# Reset in the Init state
 	NODECONFIG 					= 11	# Routes configuration sent by the host
+	NODECONFIGBULK				= 12	# Routes configuration sent by the host, many routes per message
+	NODESTATSREQ				= 13	# Request the tasks queues statistics
+	NODESTATS					= 14	# Response a task queue statistics (one message per queue)
+	NODECONFIGMEMBERS			= 15	# Members of a route coordinated by the node (star mode)
 
 	# Route messages - Ctrl task
 	ROUTEREQ 					= 30	# Route request
+	ROUTEACK 					= 31	# 2PhaseCommit Ack (first node of a batch route: all its nodes agree)
+	ROUTECOMMIT 				= 33	# 2PhaseCommit Commit (sent by the host to the batch routes once all ACKed)
+	ROUTEDISAGREE 				= 35	# 2PhaseCommit Disagree (sent by the host to release a reserved route)
 	ROUTETRAINOK 				= 36	# 2PhaseCommit Train OK
 	ROUTETTRAINOK 				= 37	# 2PhaseCommit Train NOK
+	ROUTEREQBATCH				= 38	# Route request of a set of routes (all or none)
 
 	# Log messages - Log task
 	LOGREQ						= 81	# Request current log messages
 	LOGSEND						= 82	# Response current log messages
 	LOGDEL						= 83	# Ack messages were received and ask to delete
 	LOGDELACK					= 84	# Ack messages were deleted
+	LOGSENDBULK					= 85	# Response current log messages (many lines per message)
 
 	# Point requests - Point task
 	POINTMALFUNC   				= 95   	# Point set malfunction state (error simulation request)
@@ -52,9 +62,17 @@ Header = namedtuple("Header", [ "length", "type" , "source", "destination"])
 Route = namedtuple("Route", ["ID", "prev", "next", "position", "requestedPosition"])
 MsgInitCONFIGTYPE = namedtuple("MsgHeaderCONFIG", ["header", "sequence", "totalSegments", "nodeType"])
 MsgInitCONFIG = namedtuple("MsgHeaderCONFIG", ["header", "sequence", "totalSegments", "route"])
+MsgInitCONFIGBULK = namedtuple("MsgHeaderCONFIGBULK", ["header", "sequence", "totalSegments", "numRoutes", "routes"])
+MsgInitCONFIGMEMBERS = namedtuple("MsgInitCONFIGMEMBERS", ["header", "routeId", "numMembers", "members"])
 MsgRouteREQ = namedtuple("MsgRouteREQ", ["header", "requestRouteId"])
+MsgRouteREQBATCH = namedtuple("MsgRouteREQBATCH", ["header", "numRoutes", "routeIds"])
+MsgRouteCOMMIT = namedtuple("MsgRouteCOMMIT", ["header", "requestRouteId"])
+MsgRouteDISAGREE = namedtuple("MsgRouteDISAGREE", ["header", "requestRouteId"])
 MsgRouteTRAINOK = namedtuple("MsgRouteTRAINOK", ["header", "requestRouteId"])
 MsgRouteTRAINNOK = namedtuple("MsgRouteTRAINNOK", ["header", "requestRouteId"])
+MsgRouteREQTRACED = namedtuple("MsgRouteREQTRACED", ["header", "requestRouteId", "trace"])
+MsgTrace = namedtuple("MsgTrace", ["traceId", "numHops", "droppedHops", "origin", "hops"])
+MsgTraceHop = namedtuple("MsgTraceHop", ["node", "type", "flags", "rxAt", "fsmAt", "txAt"])
 MsgInitRESET = namedtuple("MsgInitRESET", ["header"])
 MsgPointMALFUNCTION = namedtuple("MsgPointMALFUNCTION", ["header"])
 MsgLogREQ = namedtuple("MsgLogREQ", ["header"])
@@ -63,18 +81,40 @@ MsgLogCurrentTotal = namedtuple("MsgLogCurrentTotal", ["currentLine", "totalLine
 MsgLogSEND = namedtuple("MsgLogSEND", ["header", "currentTotal", "logline"])
 MsgLogDEL = namedtuple("MsgLogDEL", ["header"])
 MsgLogDELACK = namedtuple("MsgLogDELACK", ["header"])
+MsgNodeSTATSREQ = namedtuple("MsgNodeSTATSREQ", ["header"])
+MsgQStats = namedtuple("MsgQStats", ["queue", "totalQueues", "depth", "maxMsgs", "highWater", "enqueued", "dequeued", "dropped", "poolDropped", "residency"])
 
 # Packed messages formats
 MsgHeaderFormat = "BBxx4s4sxxxx"
+MsgHeaderLength: int = 16
+MsgCompactVersion: int = 2				# Compact header version (legacy header first byte is its length, >= 16)
+MsgCompactHeaderFormat = "!BBH4s4s"		# version, type, length (network order), source, destination
+MsgCompactHeaderLength: int = 12
 MsgRouteFormat = "I4s4sbbxx"
 MsgSequenceTotalFormat = "II"
 MsgNodeTypeFormat = "Bxxx"
 MsgInitCONFIGTYPEFormat = MsgHeaderFormat + MsgSequenceTotalFormat + MsgNodeTypeFormat
 MsgInitCONFIGFormat = MsgHeaderFormat + MsgSequenceTotalFormat + MsgRouteFormat
+MsgInitCONFIGBULKFormat = MsgHeaderFormat + MsgSequenceTotalFormat + "I"		# followed by numRoutes MsgRouteFormat
+MsgConfigBulkMaxRoutes: int = 14		# Max routes in a NODECONFIGBULK (message within 255 bytes)
+MsgInitCONFIGMEMBERSFormat = MsgHeaderFormat + "II"		# followed by numMembers IPs (4s)
+MsgConfigMaxMembers: int = 32			# Max members of a coordinated route (node CONFIGMAXMEMBERS)
 MsgRouteRequestFormat = "I"
 MsgRouteREQFormat = MsgHeaderFormat + MsgRouteRequestFormat
+MsgRouteREQBATCHFormat = MsgHeaderFormat + "I"		# followed by numRoutes MsgRouteRequestFormat
+MsgRouteBatchMaxRoutes: int = 32		# Max routes in a ROUTEREQBATCH (node MSG_ROUTEBATCHMAXROUTES)
+MsgRouteCOMMITFormat = MsgHeaderFormat + MsgRouteRequestFormat
+MsgRouteDISAGREEFormat = MsgHeaderFormat + MsgRouteRequestFormat
 MsgRouteTRAINOKFormat = MsgHeaderFormat + MsgRouteRequestFormat
 MsgRouteTRAINNOKFormat = MsgHeaderFormat + MsgRouteRequestFormat
+MsgTraceFormat = "IBBxxq"				# traceId, numHops, droppedHops, origin (us, first node realtime clock), followed by numHops hops
+MsgTraceHopFormat = "4sBBxxiii"			# node, message type, flags, received / FSM / sent timestamps (us since the origin)
+MsgTraceMaxHops: int = 10				# Max hops in a route trace (node MSG_TRACEMAXHOPS)
+MsgTraceHopRX: int = 0x01				# Hop received by the node (rxAt set, type is the message received)
+MsgTraceHopFSM: int = 0x02				# Hop processed by the Ctrl FSM (fsmAt set)
+MsgTraceHopTX: int = 0x04				# Next message sent (txAt set, type is the message sent if not received)
+MsgTraceTypes = {30: "REQ", 31: "ACK", 32: "NACK", 33: "COMMIT", 34: "AGREE", 35: "DISAGREE", 36: "TRAINOK", 37: "TRAINNOK"}
+MsgRouteREQTRACEDFormat = MsgRouteREQFormat + "xxxx" + MsgTraceFormat		# trace without hops (started by the first node)
 MsgInitRESETFormat = MsgHeaderFormat
 MsgPointMALFUNCTIONFormat = MsgHeaderFormat
 MsgLogREQFormat = MsgHeaderFormat
@@ -82,8 +122,13 @@ MsgLogCurrentTotalFormat = "II"
 MsgTimestampFormat = "qq"				# Python pack (signed) long long format (8 bytes)
 MsgLogLineFormat = MsgTimestampFormat + "BxxxI4sxxxx"
 MsgLogSENDFormat = MsgHeaderFormat + MsgLogCurrentTotalFormat + MsgLogLineFormat
+MsgLogBulkFormat = "IIIxxxx"			# firstLine, totalLines, numLines (followed by numLines log lines)
 MsgLogDELFormat = MsgHeaderFormat
 MsgLogDELACKFormat = MsgHeaderFormat
+MsgNodeSTATSREQFormat = MsgHeaderFormat
+MsgQStatsFormat = "BBHHHIIII6I"			# queue, totalQueues, depth, maxMsgs, highWater, enqueued, dequeued, dropped, poolDropped, residency histogram
+MsgQStatsQueues = ["Init", "Ctrl", "CommTx", "Log", "Diag", "Point", "Sensor"]
+MsgQStatsBuckets = ["<1ms", "<10ms", "<100ms", "<1s", "<10s", ">=10s"]
 
 
 def getLocaIP() -> str:
@@ -124,8 +169,83 @@ def getMessageToSend(data: namedtuple, format: str):
     """
 	dataToSend = bytearray(struct.pack(format, *flatten(data)))
 	dataToSend[0]=len(dataToSend)
+
+	# Compact header: same payload, without the header padding
+	if NodeCommCompact:
+		header = Header._make(struct.unpack(MsgHeaderFormat, dataToSend[0:MsgHeaderLength]))
+		payload = dataToSend[MsgHeaderLength:]
+		dataToSend = bytearray(struct.pack(MsgCompactHeaderFormat, MsgCompactVersion, header.type, MsgCompactHeaderLength + len(payload), header.source, header.destination)) + payload
+
 	return dataToSend
 
+def parseHeader(data: bytes):
+	"""
+	Parse the header of the message at the start of data, legacy or compact.
+	Parameters:
+		data - received bytes
+
+	Return:
+		(Header, header length) with Header.length the whole message length, None if data is too short
+	"""
+	if len(data) >= MsgCompactHeaderLength and data[0] == MsgCompactVersion:
+		version, type, length, source, destination = struct.unpack(MsgCompactHeaderFormat, data[0:MsgCompactHeaderLength])
+		return Header(length, type, source, destination), MsgCompactHeaderLength
+	if len(data) >= MsgHeaderLength and data[0] != MsgCompactVersion:
+		return Header._make(struct.unpack(MsgHeaderFormat, data[0:MsgHeaderLength])), MsgHeaderLength
+	return None
+
+def parseTrace(frame: bytes, headerLength: int):
+	"""
+	Parse the trace of a route message (it follows the route id if the request was traced).
+	Parameters:
+		frame - received message
+		headerLength - length of its header
+
+	Return:
+		MsgTrace, None if the message isn't traced
+	"""
+	offset: int = headerLength + struct.calcsize(MsgRouteRequestFormat + "xxxx")
+	traceLength: int = struct.calcsize(MsgTraceFormat)
+	hopLength: int = struct.calcsize(MsgTraceHopFormat)
+	if len(frame) < offset + traceLength:
+		return None
+
+	traceId, numHops, droppedHops, origin = struct.unpack(MsgTraceFormat, frame[offset:offset + traceLength])
+	numHops = min(numHops, MsgTraceMaxHops, (len(frame) - offset - traceLength) // hopLength)
+	hops = [MsgTraceHop._make(struct.unpack_from(MsgTraceHopFormat, frame, offset + traceLength + i * hopLength)) for i in range(numHops)]
+	return MsgTrace(traceId, numHops, droppedHops, origin, hops)
+
+def printTrace(routeId: int, trace: MsgTrace, hostElapsed: float, width: int = 50):
+	"""
+	Print the per-hop waterfall of a traced route request: for each hop the time waiting
+	for the Ctrl FSM (.) and from the FSM to the next message sent (#). The gaps between hops are
+	the network (and the skew of the nodes clocks).
+	Parameters:
+		routeId - route requested
+		trace - trace received with TRAINOK/TRAINNOK
+		hostElapsed - seconds from the request sent to the reply received (host clock)
+		width - columns of the waterfall
+	"""
+	# Hop bounds: received (or sent only), FSM, sent (missing timestamps collapse on the previous one)
+	bounds: list[tuple[int, int, int]] = []
+	for hop in trace.hops:
+		start: int = hop.rxAt if hop.flags & MsgTraceHopRX else hop.txAt
+		fsm: int = hop.fsmAt if hop.flags & MsgTraceHopFSM else start
+		stop: int = hop.txAt if hop.flags & MsgTraceHopTX else fsm
+		bounds.append((start, fsm, stop))
+	begin: int = min([0] + [start for start, fsm, stop in bounds])
+	end: int = max([0] + [stop for start, fsm, stop in bounds])
+	column = lambda t: round((t - begin) * width / (end - begin)) if end > begin else 0
+
+	dropped: str = f', {trace.droppedHops} hops not recorded' if trace.droppedHops else ''
+	print(f'Route {routeId} trace {trace.traceId:08x}: {(end - begin) / 1000:.3f} ms on the nodes, {hostElapsed * 1000:.3f} ms on the host{dropped}')
+	for i, (hop, (start, fsm, stop)) in enumerate(zip(trace.hops, bounds)):
+		direction: str = 'rx' if hop.flags & MsgTraceHopRX else 'tx'
+		bar: str = ' ' * column(start) + '.' * (column(fsm) - column(start)) + '#' * (column(stop) - column(fsm))
+		if column(stop) == column(start):
+			bar += '|'
+		print(f'  {i + 1:2} {IP2str(hop.node):15} {direction} {MsgTraceTypes.get(hop.type, str(hop.type)):8} {start / 1000:9.3f} {fsm / 1000:9.3f} {stop / 1000:9.3f} ms |{bar:<{width + 1}}|')
+
 def sendReset(hostIP: bytes, node: 'Node'):
 	"""
 	Create a client socket to node to send the RESET message
@@ -173,12 +293,18 @@ def sendConfig(hostIP: bytes, node: 'Node'):
 		# Send to node
 		client_socket.send(messageToSend)
 
-		# Cycle over config
-		counter: int = 0
+		# Members of the routes coordinated by the node (star mode), before the routes
+		messagesToSend: bytearray = bytearray()
 		for configItem in node.Config:
-			# Count
-			counter += 1
+			if configItem.members:
+				if len(configItem.members) > MsgConfigMaxMembers:
+					raise ValueError(f'route {configItem.routeId} has more than {MsgConfigMaxMembers} members')
+				members = [member.IP for member in configItem.members]
+				messagesToSend += getMessageToSend( MsgInitCONFIGMEMBERS( Header( 0, MsgType.NODECONFIGMEMBERS, hostIP, node.IP), configItem.routeId, len(members), members ), MsgInitCONFIGMEMBERSFormat + "4s" * len(members))
 
+		# Cycle over config
+		routes: list[Route] = []
+		for configItem in node.Config:
 			# Get prev and next
 			if configItem.prev is None:
 				prev = hostIP
@@ -188,10 +314,18 @@ def sendConfig(hostIP: bytes, node: 'Node'):
 				next = bytes([0, 0, 0, 0])
 			else:
 				next = configItem.next.IP				
-			# Prepare the message of the current config item
-			messageToSend = getMessageToSend( MsgInitCONFIG( Header( 0, MsgType.NODECONFIG, hostIP, node.IP), counter, len(node.Config), Route( configItem.routeId, prev, next, configItem.position, configItem.requestedPos ) ), MsgInitCONFIGFormat)
-			# Send to node
-			client_socket.send(messageToSend)
+			routes.append(Route( configItem.routeId, prev, next, configItem.position, configItem.requestedPos ))
+
+		# Prepare the messages of the config items (many per message if bulk) and send them with a single write
+		if NodeConfigBulk:
+			for first in range(0, len(routes), MsgConfigBulkMaxRoutes):
+				chunk = routes[first:first + MsgConfigBulkMaxRoutes]
+				messagesToSend += getMessageToSend( MsgInitCONFIGBULK( Header( 0, MsgType.NODECONFIGBULK, hostIP, node.IP), first + 1, len(routes), len(chunk), chunk ), MsgInitCONFIGBULKFormat + MsgRouteFormat * len(chunk))
+		else:
+			for counter, configRoute in enumerate(routes, start=1):
+				messagesToSend += getMessageToSend( MsgInitCONFIG( Header( 0, MsgType.NODECONFIG, hostIP, node.IP), counter, len(routes), configRoute ), MsgInitCONFIGFormat)
+		# Send to node
+		client_socket.sendall(messagesToSend)
 
 		# Close the socket
 		client_socket.shutdown(socket.SHUT_RDWR)
@@ -296,56 +430,74 @@ def requestLog(hostIP: bytes, node: 'Node', IDDict: dict[bytes, str]):
 				client_socket, client_address = server_socket.accept()
 				print(f"Connected with {client_address}...")
 
-				while True:
+				# Nodes keep their outbound connections open (pooled): stop reading when the sequence
+				# is complete and close our side so the node drops the stale connection
+				while sequenceExcepted > 0:
 					chunk: bytes = client_socket.recv(1024)
 
 					if chunk: 
 						data += chunk
 
 						# process messages
-						while sequenceExcepted > 0 and len(data) >= 56:
+						while sequenceExcepted > 0:
+							# Wait for a complete message (legacy or compact header)
+							parsed = parseHeader(data)
+							if parsed is None or len(data) < parsed[0].length: break
+
 							# Message unpacking
-							header = struct.unpack(MsgHeaderFormat,  data[0:16])
-							header = Header._make(header)
-							logCurrentTotal = struct.unpack(MsgLogCurrentTotalFormat,  data[16:24])
-							logCurrentTotal = MsgLogCurrentTotal._make(logCurrentTotal)
-							logLine = struct.unpack(MsgLogLineFormat,  data[24:56])
-							logLine = MsgLogLine._make(logLine)
+							header, headerLength = parsed
+							frame: bytearray = data[:header.length]
 
 							# Remove used data
-							data = data[56:]
+							data = data[header.length:]
 
 							# Check message type
-							if header.type != MsgType.LOGSEND.value:
+							if header.type == MsgType.LOGSENDBULK.value:
+								# Many lines per message
+								payloadStart: int = headerLength + struct.calcsize(MsgLogBulkFormat)
+								firstLine, totalLines, numLines = struct.unpack(MsgLogBulkFormat, frame[headerLength:payloadStart])
+								logLines = [ MsgLogLine._make(line) for line in struct.iter_unpack(MsgLogLineFormat, frame[payloadStart:payloadStart + numLines * struct.calcsize(MsgLogLineFormat)]) ]
+								if len(logLines) != numLines: sequenceError = True
+							elif header.type == MsgType.LOGSEND.value:
+								# One line per message
+								payloadStart: int = headerLength + struct.calcsize(MsgLogCurrentTotalFormat)
+								logCurrentTotal = struct.unpack(MsgLogCurrentTotalFormat,  frame[headerLength:payloadStart])
+								logCurrentTotal = MsgLogCurrentTotal._make(logCurrentTotal)
+								# currentLine && totalLines == 00 => Log empty
+								if logCurrentTotal.currentLine == 0 and logCurrentTotal.totalLines == 0:
+									# reset request with OK and without log update notify
+									node.resetRequest(NodeState.OK)
+									return True
+								firstLine, totalLines, numLines = logCurrentTotal.currentLine, logCurrentTotal.totalLines, 1
+								logLines = [ MsgLogLine._make(struct.unpack(MsgLogLineFormat,  frame[payloadStart:payloadStart + struct.calcsize(MsgLogLineFormat)])) ]
+							else:
 								node.resetRequest(NodeState.FAIL)
 								return False							
-							# currentLine && totalLines == 00 => Log empty
-							if logCurrentTotal.currentLine == 0 and logCurrentTotal.totalLines == 0:
-								# reset request with OK and without log update notify
-								node.resetRequest(NodeState.OK)
-								return True
 							
 							# Check sequence (but continue receiving). Is the excepted one?
-							if logCurrentTotal.currentLine != sequenceExcepted: sequenceError = True
-							if logCurrentTotal.currentLine > logCurrentTotal.totalLines: sequenceError = True
+							lastLine: int = firstLine + numLines - 1
+							if firstLine != sequenceExcepted: sequenceError = True
+							if lastLine > totalLines: sequenceError = True
 
 							# Completed ?
-							if logCurrentTotal.currentLine == logCurrentTotal.totalLines:
+							if lastLine >= totalLines:
 								sequenceExcepted = 0
 							else:
-								sequenceExcepted += 1
+								sequenceExcepted = lastLine + 1
 
-							# Log line appended
-							if  logLine.nodeIP != NodeNull:
-								ID: str = IDDict.get(logLine.nodeIP, None)
-							else:
-								ID = None
-								
-							lines.append(LogLine(logLine.timestamp_s, logLine.timestamp_ns, LogType(logLine.type), logLine.routeId, ID, logLine.nodeIP))
+							# Log lines appended
+							for logLine in logLines:
+								if  logLine.nodeIP != NodeNull:
+									ID: str = IDDict.get(logLine.nodeIP, None)
+								else:
+									ID = None
+									
+								lines.append(LogLine(logLine.timestamp_s, logLine.timestamp_ns, LogType(logLine.type), logLine.routeId, ID, logLine.nodeIP))
 
 					else:
 						# No more data
 						break
+				client_socket.close()
 			
 				# Sequence error detected while receiving?
 				if sequenceError:
@@ -413,12 +565,12 @@ def requestLog(hostIP: bytes, node: 'Node', IDDict: dict[bytes, str]):
 			client_socket, client_address = server_socket.accept()
 			print(f"Connected with {client_address}...")
 
-			# Receive data
+			# Receive data (and close: the node reconnects on its next send)
 			data = client_socket.recv(1024)
+			client_socket.close()
 
 			# Message unpacking
-			header = struct.unpack(MsgHeaderFormat,  data[0:16])
-			header = Header._make(header)
+			header, headerLength = parseHeader(data)
 
 			# If data received
 			if header.type != MsgType.LOGDELACK.value:
@@ -453,6 +605,72 @@ def requestLog(hostIP: bytes, node: 'Node', IDDict: dict[bytes, str]):
 
 		return False
 
+def requestStats(hostIP: bytes, node: 'Node'):
+	"""
+	Request the tasks queues statistics to the node and wait for them (one message per queue)
+	Parameters:
+		- hostIP: IP of the sending host (bytes)
+		- node: node object to request
+
+	Return:
+		dict queue name => MsgQStats (residency as a dict bucket => messages), None on error
+	"""
+	nodeIP: str = IP2str(node.IP)
+	hostIPStr = IP2str(hostIP)
+	stats: dict[str, MsgQStats] = {}
+
+	try:
+		# Listen before the request: the node replies at once
+		server_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+
+		try:
+			server_socket.settimeout(LogRequestResponseTimeout)
+			server_socket.bind((hostIPStr, NodeCommPort))
+			server_socket.listen()
+
+			# Send the request
+			messageToSend = getMessageToSend( MsgNodeSTATSREQ( Header( 0, MsgType.NODESTATSREQ, hostIP, node.IP) ), MsgNodeSTATSREQFormat)
+			request_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+			request_socket.connect((nodeIP, NodeCommPort))
+			request_socket.sendall(messageToSend)
+			request_socket.shutdown(socket.SHUT_RDWR)
+
+			# Receive until every queue is received
+			client_socket, client_address = server_socket.accept()
+			client_socket.settimeout(LogRequestResponseTimeout)
+			data: bytearray = bytearray()
+			totalQueues: int = len(MsgQStatsQueues)
+			while len(stats) < totalQueues:
+				chunk: bytes = client_socket.recv(1024)
+				if not chunk: break
+				data += chunk
+
+				while True:
+					parsed = parseHeader(data)
+					if parsed is None or len(data) < parsed[0].length: break
+					header, headerLength = parsed
+					frame: bytearray = data[:header.length]
+					data = data[header.length:]
+					if header.type != MsgType.NODESTATS.value: continue
+
+					values = struct.unpack(MsgQStatsFormat, frame[headerLength:headerLength + struct.calcsize(MsgQStatsFormat)])
+					queueStats = MsgQStats._make(values[:9] + (dict(zip(MsgQStatsBuckets, values[9:])),))
+					totalQueues = queueStats.totalQueues
+					name = MsgQStatsQueues[queueStats.queue] if queueStats.queue < len(MsgQStatsQueues) else str(queueStats.queue)
+					stats[name] = queueStats
+			client_socket.close()
+
+		finally:
+			server_socket.close()
+
+	except Exception as ex:
+		print(f'Error requesting queues statistics to node {nodeIP}: {ex}')
+		return None
+
+	for name, queueStats in stats.items():
+		print(f'{nodeIP} {name}: {queueStats.depth}/{queueStats.maxMsgs} queued, {queueStats.highWater} max, {queueStats.enqueued} sent, {queueStats.dequeued} received, {queueStats.dropped} dropped, {queueStats.poolDropped} lost (pool exhausted), residency {queueStats.residency}')
+	return stats
+
 def sendRequest(hostIP: bytes, route: Route):
 	"""
 	Create a client socket to first node to send the ROUTEREQ message and wait for a reply (or timeout)
@@ -471,7 +689,11 @@ def sendRequest(hostIP: bytes, route: Route):
 
 		# Prepare the message
 		nodeIP: str = IP2str(nodeFirst.IP)
-		messageToSend = getMessageToSend( MsgRouteREQ( Header( 0, MsgType.ROUTEREQ, hostIP, nodeFirst.IP), routeId ), MsgRouteREQFormat)
+		traceId: int = random.randint(1, 0xFFFFFFFF) if RouteTrace else 0
+		if RouteTrace:
+			messageToSend = getMessageToSend( MsgRouteREQTRACED( Header( 0, MsgType.ROUTEREQ, hostIP, nodeFirst.IP), routeId, MsgTrace(traceId, 0, 0, 0, []) ), MsgRouteREQTRACEDFormat)
+		else:
+			messageToSend = getMessageToSend( MsgRouteREQ( Header( 0, MsgType.ROUTEREQ, hostIP, nodeFirst.IP), routeId ), MsgRouteREQFormat)
 
 		# Before sending request, spawn thread for malfunction simulation if present
 		for nodeRef in route:
@@ -483,6 +705,7 @@ def sendRequest(hostIP: bytes, route: Route):
 		client_socket.connect((nodeIP, NodeCommPort))
 
 		# Route request
+		requestTime: float = time.time()
 		ret = client_socket.send(messageToSend)
 			
 		# Close the socket
@@ -508,18 +731,23 @@ def sendRequest(hostIP: bytes, route: Route):
 			client_socket, client_address = server_socket.accept()
 			print(f"Connected with {client_address}...")
 
-			# Receive data
+			# Receive data (and close: the node reconnects on its next send)
 			data = client_socket.recv(1024)
+			client_socket.close()
 
 			# Message unpacking
-			header = struct.unpack(MsgHeaderFormat,  data[0:16])
-			header = Header._make(header)
+			header, headerLength = parseHeader(data)
+			payload = struct.unpack(MsgRouteRequestFormat, data[headerLength:headerLength + struct.calcsize(MsgRouteRequestFormat)])
+
+			# Traced request: per-hop waterfall
+			trace = parseTrace(data[:header.length], headerLength) if RouteTrace else None
+			if trace and trace.traceId == traceId:
+				printTrace(routeId, trace, time.time() - requestTime)
 
 			# If data received
 			match header.type:
 				case MsgType.ROUTETRAINOK.value:
-					payload = struct.unpack(MsgRouteTRAINOKFormat, data )
-					message = MsgRouteTRAINOK._make([header, payload[4]])
+					message = MsgRouteTRAINOK._make([header, payload[0]])
 
 					# Check the response refere to excepted route id
 					if message.requestRouteId != routeId:
@@ -527,8 +755,7 @@ def sendRequest(hostIP: bytes, route: Route):
 						return False
 				
 				case MsgType.ROUTETTRAINOK.value:
-					payload = struct.unpack(MsgRouteTRAINOKFormat, data )
-					message = MsgRouteTRAINOK._make([header, payload[4]])
+					message = MsgRouteTRAINOK._make([header, payload[0]])
 
 					# Check the response refere to excepted route id
 					if message.requestRouteId != routeId:
@@ -559,3 +786,150 @@ def sendRequest(hostIP: bytes, route: Route):
 		print(f'Error waiting response to route request {routeId} from node {nodeIP}: {ex}')
 
 		return False
+
+def sendRelease(hostIP: bytes, route: Route):
+	"""
+	Create a client socket to first node to send the ROUTEDISAGREE message releasing the reserved route
+	Parameters:
+		- hostIP: IP of the sending host (bytes)
+		- route: route object to release
+	"""
+	try:
+		# Prepare the message
+		nodeFirst: Node = route[0].node
+		nodeIP: str = IP2str(nodeFirst.IP)
+		messageToSend = getMessageToSend( MsgRouteDISAGREE( Header( 0, MsgType.ROUTEDISAGREE, hostIP, nodeFirst.IP), route.id ), MsgRouteDISAGREEFormat)
+
+		# Create the connection to the node
+		client_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+		client_socket.connect((nodeIP, NodeCommPort))
+
+		# Send to node
+		client_socket.send(messageToSend)
+
+		# Close the socket
+		client_socket.shutdown(socket.SHUT_RDWR)
+
+	except Exception as ex:
+		print(f'Error releasing route {route.id} to node {nodeIP}: {ex}')
+
+def receiveRouteReplies(server_socket, connections: dict, routeIds: list[int], replyTypes: tuple[int], replies: dict[int, int], deadline: float):
+	"""
+	Receive the replies of the nodes (a message for each route, of the types) until all received, a TRAINNOK or the deadline.
+	The nodes keep their connection open to send again: each accepted one is read until EOF, every message in it parsed
+	Parameters:
+		- server_socket: listening host socket
+		- connections: accepted connections and their bytes not parsed yet (kept open between the calls)
+		- routeIds: routes replied
+		- replyTypes: types of the messages expected (MsgType values)
+		- replies: route id => type of the message received (updated)
+		- deadline: time.time() to give up at
+	"""
+	while len(replies) < len(routeIds) and MsgType.ROUTETTRAINOK.value not in replies.values() and (timeout := deadline - time.time()) > 0:
+		readable, _, _ = select.select([server_socket] + list(connections), [], [], timeout)
+		for readySocket in readable:
+			# New connection
+			if readySocket is server_socket:
+				client_socket, client_address = server_socket.accept()
+				print(f"Connected with {client_address}...")
+				connections[client_socket] = b''
+				continue
+
+			# Data (EOF: closed by the node)
+			data = readySocket.recv(1024)
+			if not data:
+				readySocket.close()
+				del connections[readySocket]
+				continue
+
+			# Messages unpacking (many can be received together, the last one partly)
+			data = connections[readySocket] + data
+			while (parsed := parseHeader(data)) and parsed[1] <= parsed[0].length <= len(data):
+				header, headerLength = parsed
+				payload = struct.unpack(MsgRouteRequestFormat, data[headerLength:headerLength + struct.calcsize(MsgRouteRequestFormat)])
+				if header.type in replyTypes and payload[0] in routeIds and payload[0] not in replies:
+					replies[payload[0]] = header.type
+				data = data[header.length:]
+			connections[readySocket] = data
+
+def sendRequestBatch(hostIP: bytes, routes: list[Route]):
+	"""
+	Send the ROUTEREQBATCH message (all the route ids) to the first node of each route, the host coordinating the routes:
+	- prepare: each first node ACKs its routes once all their nodes agree (TRAINNOK if not), nothing moved yet
+	- commit: once all the routes are ACKed a ROUTECOMMIT to each one, a TRAINOK/TRAINNOK for each route
+	The routes are reserved all or none: if any is rejected the others are released (ROUTEDISAGREE to the first node),
+	the ones without a reply too (still queued or in progress on the nodes)
+	Parameters:
+		- hostIP: IP of the sending host (bytes)
+		- routes: route objects to request
+	"""
+	routeIds: list[int] = [route.id for route in routes]
+	acks: dict[int, int] = {}
+	replies: dict[int, int] = {}
+	connections: dict = {}
+	hostIPStr: str = IP2str(hostIP)
+
+	# Create a server socket (before sending: the replies come from many nodes)
+	server_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+	try:
+		server_socket.bind((hostIPStr, NodeCommPort))
+		server_socket.listen()
+
+		# Before sending request, spawn thread for malfunction simulation if present
+		for route in routes:
+			for nodeRef in route:
+				if nodeRef.node.malfunction:
+					nodeRef.node.simulateMalfunction(hostIP)
+
+		#
+		# ### SEND REQUEST ###
+		#
+		# One message for each first node: each one evaluates only the routes it's the first node of
+		firstNodes: dict[bytes, Node] = { route[0].node.IP: route[0].node for route in routes }
+		for nodeFirst in firstNodes.values():
+			messageToSend = getMessageToSend( MsgRouteREQBATCH( Header( 0, MsgType.ROUTEREQBATCH, hostIP, nodeFirst.IP), len(routeIds), routeIds ), MsgRouteREQBATCHFormat + MsgRouteRequestFormat * len(routeIds))
+			client_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+			client_socket.connect((IP2str(nodeFirst.IP), NodeCommPort))
+			client_socket.send(messageToSend)
+			client_socket.shutdown(socket.SHUT_RDWR)
+
+		#
+		# ### WAIT FOR THE VOTES ###
+		#
+		# An ACK for each route (TRAINNOK if rejected) within the response timeout
+		receiveRouteReplies(server_socket, connections, routeIds, (MsgType.ROUTEACK.value, MsgType.ROUTETTRAINOK.value), acks, time.time() + RouteRequestResponseTimeout)
+
+		#
+		# ### COMMIT ###
+		#
+		# All ACKed: the COMMIT of its routes to each first node, a TRAINOK/TRAINNOK for each route within the response timeout
+		if len(acks) == len(routes) and all(type == MsgType.ROUTEACK.value for type in acks.values()):
+			for nodeFirst in firstNodes.values():
+				messagesToSend: bytearray = bytearray()
+				for route in routes:
+					if route[0].node is nodeFirst:
+						messagesToSend += getMessageToSend( MsgRouteCOMMIT( Header( 0, MsgType.ROUTECOMMIT, hostIP, nodeFirst.IP), route.id ), MsgRouteCOMMITFormat)
+				client_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+				client_socket.connect((IP2str(nodeFirst.IP), NodeCommPort))
+				client_socket.sendall(messagesToSend)
+				client_socket.shutdown(socket.SHUT_RDWR)
+			receiveRouteReplies(server_socket, connections, routeIds, (MsgType.ROUTETRAINOK.value, MsgType.ROUTETTRAINOK.value), replies, time.time() + RouteRequestResponseTimeout)
+		else:
+			replies = acks
+
+	except Exception as ex:
+		print(f'Error requesting routes {routeIds}: {ex}')
+
+	finally:
+		for client_socket in connections:
+			client_socket.close()
+		server_socket.close()
+
+	# All reserved or none: release all but the rejected ones (reserved, ACKed, queued or in progress)
+	reserved: bool = len(replies) == len(routes) and all(type == MsgType.ROUTETRAINOK.value for type in replies.values())
+	for route in routes:
+		if not reserved and replies.get(route.id) != MsgType.ROUTETTRAINOK.value:
+			sendRelease(hostIP, route)
+		route.resetRequest(RouteState.OK if reserved else RouteState.FAIL)
+
+	return reserved
@@ -38,7 +38,7 @@ class NodeConfig(Sequence[NodeConfigItem]):
         self._dict.clear()
 
     # Add or Update a NodeConfigItem
-    def RouteSet(self, routeId: int, prev: 'Node', next: 'Node', position: NodePosition, requestedPos: 'PointPosition' = None) -> None:
+    def RouteSet(self, routeId: int, prev: 'Node', next: 'Node', position: NodePosition, requestedPos: 'PointPosition' = None, members: list['Node'] = None) -> None:
         from model.point import PointPosition
         try:
             # Check default
@@ -54,11 +54,12 @@ class NodeConfig(Sequence[NodeConfigItem]):
             item.next = next
             item.position = position
             item.requestedPos = requestedPosValue
+            item.members = members
 
         except:
             # Not present: create, add to list and add index to dict
             self._dict[routeId] = len(self._list)
-            self._list.append(NodeConfigItem(routeId, prev, next, position, requestedPosValue))
+            self._list.append(NodeConfigItem(routeId, prev, next, position, requestedPosValue, members))
 
 
     def RouteDel(self, routeId: int) -> None:
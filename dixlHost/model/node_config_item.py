@@ -19,12 +19,13 @@ class NodePosition(Enum):
                 
 class NodeConfigItem(object):
     # Constructor    
-    def __init__(self, routeId: int,  prev: 'Node', next: 'Node' , position: NodePosition, requestedPos: 'PointPosition' = None) -> None:
+    def __init__(self, routeId: int,  prev: 'Node', next: 'Node' , position: NodePosition, requestedPos: 'PointPosition' = None, members: list['Node'] = None) -> None:
         self._routeId: int = routeId
         self._position: NodePosition = position
         self._prev: 'Node' = prev
         self._next: Node = next
         self._requestedPos = requestedPos
+        self._members: list['Node'] = members
 
     # Properties
     @property
@@ -47,6 +48,10 @@ class NodeConfigItem(object):
     def requestedPos(self) -> 'PointPosition':
         return self._requestedPos
 
+    @property
+    def members(self) -> list['Node']:
+        return self._members
+
     # Methods
     def to_json(self)->dict:
         # TODO
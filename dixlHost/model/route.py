@@ -12,6 +12,7 @@ from model.node_config_item import NodePosition
 from model.node import Node
 from model.node_ref import NodeRef
 from model.point_ref import PointRef
+from config import RouteStarTopology
 
 import threading
 from pubsub import pub
@@ -66,7 +67,14 @@ class Route(MutableSequence[NodeRef]):
         if not isinstance(v, NodeRef):
             raise TypeError(v)
 
-    def __getNodeConfigAttributes(self, index: int) -> tuple[Node, Node, NodePosition]:
+    def __getNodeConfigAttributes(self, index: int) -> tuple[Node, Node, NodePosition, list[Node]]:
+        # Star: the first node coordinates all the others (LAST, replying to it)
+        if RouteStarTopology and len(self.__nodes) > 1:
+            if index == 0:
+                members: list[Node] = [nodeRef.node for nodeRef in self.__nodes[1:]]
+                return None, self.__nodes[1].node, NodePosition.FIRST, members
+            return self.__nodes[0].node, None, NodePosition.LAST, None
+
         # Position
         position: NodePosition = NodePosition.MIDDLE
 
@@ -84,16 +92,16 @@ class Route(MutableSequence[NodeRef]):
         else:
             next: Node = self.__nodes[index + 1].node
 
-        return prev, next, position
+        return prev, next, position, None
         
     def __setNodeConfig(self, index: int, nodeRef: NodeRef) -> None:
-        prev, next, position = self.__getNodeConfigAttributes(index)
+        prev, next, position, members = self.__getNodeConfigAttributes(index)
 
         # Is a reference to Point?
         if isinstance(nodeRef, PointRef):
-            nodeRef.node.Config.RouteSet(self.id, prev, next, position, nodeRef.requestedPos )
+            nodeRef.node.Config.RouteSet(self.id, prev, next, position, nodeRef.requestedPos, members )
         else:
-            nodeRef.node.Config.RouteSet(self.id, prev, next, position )                
+            nodeRef.node.Config.RouteSet(self.id, prev, next, position, None, members )                
 
 
     def __generateNodesConfig(self) -> None:
@@ -236,3 +244,37 @@ class Route(MutableSequence[NodeRef]):
 
             # Rethrow the exception    
             raise ex    
+
+    @staticmethod
+    def requestBatch(routes: list['Route'], hostIP: bytes) -> bool:
+        """
+        Send the batch request of the routes to their First nodes and wait for the replies: all reserved or none
+        """
+        import message
+        if not routes or len(routes) > message.MsgRouteBatchMaxRoutes: return False
+
+        # Other operations pending on any of the routes ?
+        started: list[tuple[Route, RouteState]] = []
+        for route in routes:
+            state: RouteState = route.state
+            if not route.__setRequest():
+                # Restore the routes already set
+                for startedRoute, startedState in started:
+                    startedRoute.resetRequest(startedState)
+                return False
+            started.append((route, state))
+
+        # Start the request in a new thread
+        try:
+            t = threading.Thread(target=message.sendRequestBatch, kwargs={'hostIP':hostIP,'routes': routes}) 
+            t.start()
+
+        except Exception as ex:
+            # Reset current operation if FAIL to create the thread
+            for route in routes:
+                route.resetRequest(RouteState.FAIL)
+
+            # Rethrow the exception    
+            raise ex    
+
+        return True
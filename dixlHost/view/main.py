@@ -30,6 +30,7 @@ class Main(sg.Window):
         
         ROUTE OPERATIONS:
         - view.route.request
+        - view.route.requestbatch
 
         NODE OPERATIONS:
         - view.node.refreship
@@ -97,7 +98,8 @@ class Main(sg.Window):
                 # header
                 [[
                     sg.Text("ID", key=f"ROUTE.LBL.IP", font=sg.DEFAULT_FONT +('bold',), size=(5,1), pad=((36,0),(7,7)), text_color='black', background_color='#C9E4E7'),
-                    sg.Text("DESCRIPTION", font=sg.DEFAULT_FONT +('bold',), key=f"NODE.LBL.DESC", size=(30,1), pad=((1,7),(7,7)),text_color='black', background_color='#C9E4E7')                            
+                    sg.Text("DESCRIPTION", font=sg.DEFAULT_FONT +('bold',), key=f"NODE.LBL.DESC", size=(30,1), pad=((1,7),(7,7)),text_color='black', background_color='#C9E4E7'),
+                    sg.Button("REQUEST BATCH", key="ROUTE.BTN.BATCH")
                 ]]                                     
         )]]    
 
@@ -147,6 +149,11 @@ class Main(sg.Window):
                 case 'ROUTE.UPDATE.STATE':
                     self.setRouteStatus(values[event])
 
+                # ROUTE Batch request (checked routes)
+                case 'ROUTE.BTN.BATCH':
+                    routeIds = [routeId for routeId in self.__routeId if values.get(f"ROUTE.CHK.BATCH.{routeId}")]
+                    if routeIds: pub.sendMessage('view.route.requestbatch', routeIds=routeIds)
+
                 case 'NODE.UPDATE.LOG':
                     self.setNodeLog(values[event])
 
@@ -199,7 +206,8 @@ class Main(sg.Window):
                         sg.Image(filename=Main.absolutePath('../images/status_led_inactive.png'), size=(20,20), subsample=2, key=f"ROUTE.IMG.{route_id}"),
                         sg.Text(route_id, key=f"ROUTE.TXT.ID.{route_id}", size=(5,1), pad=((6,0),(3,1)), text_color='black', background_color='#EEF292'),
                         sg.Text(route.description, key=f"ROUTE.TXT.DESC.{route_id}", size=(30,1), pad=((1,7),(3,1)), text_color='black', background_color='#EEF292'),
-                        sg.Button("REQUEST", key=f"ROUTE.BTN.REQUEST.{route_id}")
+                        sg.Button("REQUEST", key=f"ROUTE.BTN.REQUEST.{route_id}"),
+                        sg.Checkbox("", key=f"ROUTE.CHK.BATCH.{route_id}")
                     ]
         self.extend_layout(self['FRAME.ROUTES'], [ route_row ])
 
@@ -17,9 +17,14 @@
 #include <syslog.h>
 
 #include "FSMCtrlPOINT.h"
+#include "FSMEngine.h"
+#include "FSMCtrlPending.h"
+#include "FSMCtrlRtt.h"
 #include "../config.h"
 #include "../datatypes/messages.h"
 #include "../globals.h"
+#include "../includes/timerWheel.h"
+#include "../includes/trace.h"
 #include "../includes/utils.h"
 
 
@@ -38,53 +43,50 @@ typedef enum eStates {
 	StateFailSafe
 } eStates;
 
-typedef struct eventData {
-	struct message *pMessage;
-    struct timespec *deadline;   	// Next timeout or 0 = no timeout	
-} eventData;
-
-
-typedef void (*StateFunc)(eventData *pEventData);
-typedef void (*EntryFunc)(eventData *pEventData);
-typedef void (*ExitFunc)(eventData *pEventData);
-
-typedef struct StateMapItem {
-	StateFunc pStateFunc;
-	EntryFunc pEntryFunc;
-	ExitFunc pExitFunc;
-} StateMapItem;
-
-/* Machine Instance */
-typedef struct {
-	eStates newState;				// New state to pass to
-	eStates currentState;			// Current state
-    StateMapItem *stateMap;			// Map to function for each state
-	bool eventGenerated;			// An event occured and hasn't been served
-	eventData *pEventData;			// Point to current event Data
-} FiniteStateMachine;
+/* Route context: a route in progress with its own FSM */
+typedef struct routeContext {
+	bool used;						// Context in use
+	FiniteStateMachine FSM;			// Route FSM
+	route *pRoute;					// Requested route
+	timerItem timer;				// Timeout timer (owner: context index)
+	routeMembers *pMembers;			// Members of the route coordinated by the node (star mode) or NULL
+	bool batch;						// Route of a host batch (first node): ACKed to the host, its COMMIT once all the routes are ACKed
+	uint32_t votes;					// Members replied (star mode, a bit per member)
+	eRttExchange rttExchange;		// Exchange waiting the reply
+	struct timespec rttSentAt;		// Message sent (monotonic clock)
+	uint32_t pointsToMove;			// Points still to move downstream (from the ACKs, star mode: the slowest member)
+	bool pointSpeculative;			// Point moving before the COMMIT (speculative positioning)
+	ePointPosition pointPrevPosition;	// Point position before the speculative positioning
+	struct timespec specStartAt;	// Speculative positioning requested (monotonic clock, 0 if not speculative)
+	struct timespec specDoneAt;		// Speculative positioning notified before the COMMIT (monotonic clock, 0 if not)
+	struct timespec specCommitAt;	// Positioning state reached (monotonic clock)
+	struct timespec lastPointNonce;	// Nonce of the last Point position request (the excepted one)
+	struct timespec lastSensorNonce;// Nonce of the last Sensor request (the excepted one)
+	uint32_t reservedOrder;			// Order the route was reserved in (0 if not yet): the oldest one owns the Sensor
+	msgTrace trace;					// Trace of the last traced message received (host opt-in), sent on with the next messages
+} routeContext;
 
 /**
  *  variables 
  */
 // Node State
 static NodeState *pCurrentNodeState = NULL;
-static struct timespec lastPointNonce; 	// Nonce of the last Point position request (the excepted one) 
-static struct timespec lastSensorNonce; // Nonce of the last Sensor request (the excepted one) 
+static routeContext contexts[CTRLROUTECONTEXTSMAX];	// Routes in progress
+static routeContext *pContext = NULL;				// Context of the event being served
+static bool nodeFailSafe = FALSE;					// Node in fail-safe: all requests rejected
+static bool pointRequestPending = FALSE;			// Point position request waiting the notify (Point keeps only the last one)
+static ePointPosition pointPosition = POINTPOS_STRAIGHT;	// Last position notified by Point
+static bool sensorRequestPending = FALSE;			// Sensor state request waiting the notify (Sensor keeps only the last one)
+static uint32_t reservedCount = 0;					// Routes reserved so far (order of the contexts)
 
 /**
  *  Functions implementation 
  */
 static bool setRoute(nodeId source, routeId requestedRouteId) {
-	// Search for the requested route
-	pCurrentNodeState->pCurrentRoute = NULL;
-	
-	for (uint32_t i=0; i < pCurrentNodeState->numRoutes ; i++ ) {
-		 // If found set it and return TRUE
-		if (pCurrentNodeState->pRouteList[i].id == requestedRouteId) {
-			pCurrentNodeState->pCurrentRoute = &(pCurrentNodeState->pRouteList[i]);
-			return TRUE;
-		}
-	}
+	// Search for the requested route (index built with the configuration)
+	pCurrentNodeState->pCurrentRoute = routeIndexFind(&pCurrentNodeState->routeIndex, requestedRouteId);
+	if (pCurrentNodeState->pCurrentRoute)
+		return TRUE;
 		
 	// Not found, return FALSE
 	syslog(LOG_ERR, "Requested route id (%i) not found", requestedRouteId);
@@ -95,14 +97,11 @@ static bool setRoute(nodeId source, routeId requestedRouteId) {
 
 static eNodePosition findPosition(routeId requestedRouteId) {
 	// Search for the requested route
-	route *pCurrentRoute = pCurrentNodeState->pRouteList;
+	route *pRoute = routeIndexFind(&pCurrentNodeState->routeIndex, requestedRouteId);
 	
-	for (uint32_t i=0; i < pCurrentNodeState->numRoutes ; i++ ) {
-		 // If found return position
-		if (pCurrentRoute[i].id == requestedRouteId) {
-			return pCurrentRoute[i].position;
-		}
-	}
+	// If found return position
+	if (pRoute)
+		return pRoute->position;
 		
 	// Not found, return NODEPOS_UNDEFINED
 	syslog(LOG_ERR, "Requested route id (%i) not found", requestedRouteId);
@@ -110,10 +109,250 @@ static eNodePosition findPosition(routeId requestedRouteId) {
 }
 
 /**
- *  Forward functions definitions 
+ * Route contexts
  */
-static void FSMEvent_Internal(eStates newState, eventData *pEventData);
-static void StateEngine();
+// Context of a route in progress (or NULL)
+static routeContext *context_find(routeId requestedRouteId) {
+	for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+		if (contexts[i].used && contexts[i].pRoute && contexts[i].pRoute->id == requestedRouteId)
+			return &contexts[i];
+	return NULL;
+}
+
+// Serve the next event in the context: its route is the current one
+static void context_select(routeContext *pRouteContext) {
+	pContext = pRouteContext;
+	pCurrentNodeState->pCurrentRoute = pRouteContext->pRoute;
+}
+
+// Check the route against the routes in progress (CTRLROUTECONFLICT rule)
+static bool context_conflict(const route *pRoute) {
+	for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++) {
+		if (!contexts[i].used || CTRLROUTECONFLICT == CTRLCONFLICTNONE)
+			continue;
+		if (CTRLROUTECONFLICT == CTRLCONFLICTALL || !contexts[i].pRoute || contexts[i].pRoute->requestedPosition != pRoute->requestedPosition)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+// A new context can serve the route now: not already in progress, no conflicts, a free context
+static bool context_admissible(const route *pRoute) {
+	bool free = FALSE;
+	for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+		free = free || !contexts[i].used;
+	return free && !context_find(pRoute->id) && !context_conflict(pRoute);
+}
+
+// Wait a reply from the neighbour (star mode: from all the members): timeout from the round-trip times
+static void context_wait(eventData *pEventData, nodeId neighbour, eRttExchange exchange) {
+	int msTimeout = ctrlRtt_Timeout(neighbour, exchange);
+	for (uint32_t i = 0; pContext->pMembers && i < pContext->pMembers->numMembers; i++) {
+		int msMember = ctrlRtt_Timeout(pContext->pMembers->members[i], exchange);
+		msTimeout = (msMember > msTimeout) ? msMember : msTimeout;
+	}
+	// The AGREE comes back after the downstream points are moved: not less than their travel time
+	if (exchange == RTTEXCHANGE_COMMITAGREE) {
+		int msTravel = CTRLRTTMINTIMEOUT + TASKPOINTTRANSTIME * pContext->pointsToMove;
+		msTimeout = (msTravel > msTimeout) ? msTravel : msTimeout;
+	}
+	pContext->rttExchange = exchange;
+	clock_gettime(CLOCK_MONOTONIC, &pContext->rttSentAt);
+	timer_Arm(pEventData->pTimer, msTimeout);
+}
+
+// Route trace (if traced) attached to a route message to send
+static void context_trace(message *pMessage) {
+	trace_Attach(pMessage, &pContext->trace);
+}
+
+// Star mode: send REQ, COMMIT or DISAGREE to all the members at once (the internal ROUTE messages share the layout)
+static void context_broadcast(eMsgType type) {
+	message message;
+	message.iHeader.type = type;
+	message.routeIReq.requestRouteId = pCurrentNodeState->pCurrentRoute->id;
+	for (uint32_t i = 0; i < pContext->pMembers->numMembers; i++) {
+		message.routeIReq.destination = pContext->pMembers->members[i];
+		context_trace(&message);
+		msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteREQ));
+	}
+}
+
+// DISAGREE from the previous node (or the host, giving up a batch): the route is released upstream
+static bool context_releasedUpstream(message *pInMessage) {
+	return pInMessage->header.type == MSGTYPE_ROUTEDISAGREE && !nodecmp(pInMessage->header.source, pCurrentNodeState->pCurrentRoute->prev);
+}
+
+// Released upstream: DISAGREE forwarded to the next node (star mode: already sent to all the members)
+static void context_forwardDisagree() {
+	if (pContext->pMembers || pCurrentNodeState->pCurrentRoute->position == NODEPOS_LAST)
+		return;
+
+	message message;
+	message.iHeader.type = IMSGTYPE_ROUTEDISAGREE;
+	message.routeIDisagree.destination = pCurrentNodeState->pCurrentRoute->next;
+	message.routeIDisagree.requestRouteId = pCurrentNodeState->pCurrentRoute->id;
+
+	// Log
+	nodeId *destNode = &(pCurrentNodeState->pCurrentRoute->next);
+	syslog(LOG_INFO, "Route (%i) released upstream forwarding DISAGREE to next node (%d.%d.%d.%d)", pCurrentNodeState->pCurrentRoute->id, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);
+	logger_log(LOGTYPE_DISAGREE, pCurrentNodeState->pCurrentRoute->id, NodeNULL );
+
+	//Send to dixlCommTx task queue
+	context_trace(&message);
+	msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteDISAGREE));
+}
+
+/**
+ * Point and Sensor requests
+ */
+// Request the route position to Point task
+static void pointRequest() {
+	message message;
+	size_t size = sizeof(msgIHeader);
+	message.iHeader.type = IMSGTYPE_POINTPOS;
+	message.pointIPosition.requestedPosition = pCurrentNodeState->pCurrentRoute->requestedPosition;
+	clock_gettime(CLOCK_REALTIME, &pContext->lastPointNonce);
+	message.pointIPosition.requestTimestamp = pContext->lastPointNonce;
+	size += sizeof(msgIPointPOS);
+	
+	// Log
+	syslog(LOG_INFO, "Route request (%i) requesting %s positioning to Point with nonce %i ", pCurrentNodeState->pCurrentRoute->id, pointPosStr(pCurrentNodeState->pCurrentRoute->requestedPosition), pContext->lastPointNonce);				
+
+	//Send to dixlPoint task queue
+	msgQ_Send(msgQPointId, (char *) &message, size);	
+	pointRequestPending = TRUE;
+}
+
+// Speculative positioning: Point moved on the route request, unless a route in progress needs the other position
+static void pointSpeculate() {
+	for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+		if (contexts[i].used && &contexts[i] != pContext && contexts[i].pRoute && contexts[i].pRoute->requestedPosition != pCurrentNodeState->pCurrentRoute->requestedPosition)
+			return;
+	
+	pContext->pointSpeculative = TRUE;
+	pContext->pointPrevPosition = pointPosition;
+	clock_gettime(CLOCK_MONOTONIC, &pContext->specStartAt);
+	pointRequest();
+}
+
+// Route aborted before the COMMIT: Point back to the position it had (if no other route is in progress)
+static void pointSpeculateAbort() {
+	pContext->pointSpeculative = FALSE;
+	for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+		if (contexts[i].used && &contexts[i] != pContext)
+			return;
+	if (pContext->pointPrevPosition == pCurrentNodeState->pCurrentRoute->requestedPosition)
+		return;
+	
+	// No route waits the notify: nonce not kept
+	message message;
+	message.iHeader.type = IMSGTYPE_POINTPOS;
+	message.pointIPosition.requestedPosition = pContext->pointPrevPosition;
+	clock_gettime(CLOCK_REALTIME, &message.pointIPosition.requestTimestamp);
+	
+	// Log
+	syslog(LOG_INFO, "Route request (%i) aborted: Point back to %s position", pCurrentNodeState->pCurrentRoute->id, pointPosStr(pContext->pointPrevPosition));
+	
+	//Send to dixlPoint task queue
+	msgQ_Send(msgQPointId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIPointPOS));
+	pointRequestPending = TRUE;
+}
+
+// Request to be notified when Sensor reaches the state
+static void sensorRequest(eSensorState requestedState) {
+	message message;
+	memset(&message, 0,sizeof(message));
+	size_t size = sizeof(msgIHeader);
+	message.iHeader.type = IMSGTYPE_SENSORSTATE;
+	message.sensorIPOS.requestedState = requestedState;
+	clock_gettime(CLOCK_REALTIME, &pContext->lastSensorNonce);
+	message.sensorIPOS.requestTimestamp = pContext->lastSensorNonce;	
+	size += sizeof(msgISensorSTATE);
+	
+	// Log
+	syslog(LOG_INFO, "Route request (%i) waiting for SENSOR %s with nonce %i", pCurrentNodeState->pCurrentRoute->id, sensorStateStr(requestedState), pContext->lastSensorNonce);				
+
+	//Send to dixlSensor task queue
+	msgQ_Send(msgQSensorId, (char *) &message, size);	
+	sensorRequestPending = TRUE;
+}
+
+// Reserved route the Sensor events are for: the oldest one (the train of the others comes after its train), NULL if none
+static routeContext *sensorOwner() {
+	routeContext *pOwner = NULL;
+	for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+		if (contexts[i].used && contexts[i].reservedOrder && (!pOwner || contexts[i].reservedOrder < pOwner->reservedOrder))
+			pOwner = &contexts[i];
+	return pOwner;
+}
+
+// Point and Sensor keep only the last request: once it's notified, request again for a route still waiting
+static void requestsResend() {
+	routeContext *pOwner = sensorOwner();
+
+	for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++) {
+		if (!contexts[i].used)
+			continue;
+		if (!pointRequestPending && contexts[i].FSM.currentState == StatePositioning) {
+			context_select(&contexts[i]);
+			pointRequest();
+		}
+		if (!sensorRequestPending && &contexts[i] == pOwner && (contexts[i].FSM.currentState == StateReserved || contexts[i].FSM.currentState == StateTrainInTransition)) {
+			context_select(&contexts[i]);
+			sensorRequest(contexts[i].FSM.currentState == StateReserved ? SENSORSTATE_ON : SENSORSTATE_OFF);
+		}
+	}
+}
+
+/**
+ * Sectional release: the train cleared the route up to a track circuit, the elements behind it are told
+ * (the previous node in the chain, the members before the source in star mode)
+ * @param pSource: node the release comes from (NULL if cleared by this node)
+ */
+static void routeRelease(const nodeId *pSource) {
+	message message;
+	message.iHeader.type = IMSGTYPE_ROUTERELEASE;
+	message.routeIRelease.requestRouteId = pCurrentNodeState->pCurrentRoute->id;
+	
+	// Star mode: the members up to the source
+	if (pContext->pMembers) {
+		for (uint32_t i = 0; pSource && i < pContext->pMembers->numMembers && nodecmp(pContext->pMembers->members[i], *pSource); i++) {
+			message.routeIRelease.destination = pContext->pMembers->members[i];
+			msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteRELEASE));
+		}
+		return;
+	}
+	
+	// First node: nothing behind
+	if (pCurrentNodeState->pCurrentRoute->position == NODEPOS_FIRST)
+		return;
+	
+	message.routeIRelease.destination = pCurrentNodeState->pCurrentRoute->prev;
+	
+	// Log
+	nodeId *destNode = &(pCurrentNodeState->pCurrentRoute->prev);
+	syslog(LOG_INFO, "Route request (%i) released sending RELEASE to previous node (%d.%d.%d.%d)", pCurrentNodeState->pCurrentRoute->id, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);
+	
+	//Send to dixlCommTx task queue
+	msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteRELEASE));
+}
+
+// Released by a track circuit ahead still waiting for the train: the Sensor missed it, the node would stay locked
+static void routeReleased(message *pInMessage) {
+	syslog(LOG_WARNING, "Route request (%i) RELEASE received: the train went through unseen by the SENSOR, released", pCurrentNodeState->pCurrentRoute->id);
+	logger_log(LOGTYPE_FREED, pCurrentNodeState->pCurrentRoute->id, pInMessage->header.source);
+	
+	routeRelease(&pInMessage->header.source);
+}
+
+// Cleared by the train: time the node stayed locked after it (from the Sensor change, same node clock)
+static void routeCleared(message *pInMessage) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int msLocked = (int) (time_timespecdiff(&now, &pInMessage->sensorINOTIFY.changedAt) * 1000);
+	syslog(LOG_INFO, "Route request (%i) SENSOR OFF received: locked %i ms after the train cleared it", pCurrentNodeState->pCurrentRoute->id, msLocked);
+}
 
 /**
  * Common functions
@@ -128,6 +367,7 @@ static void rejectRouteRequest(message *pInMessage) {
 	message message;
 	size_t size = sizeof(msgIHeader);
 	routeId requestedRouteId = pInMessage->routeReq.requestRouteId;
+	msgTrace trace = { 0 };
 
 	// Reply DISAGREE only to route request
 	switch (pInMessage->header.type) {
@@ -160,6 +400,10 @@ static void rejectRouteRequest(message *pInMessage) {
 				syslog(LOG_INFO, "Sending NACK for route (%i) to node (%d.%d.%d.%d)", pInMessage->routeReq.requestRouteId, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);			
 			}		
 			
+			// Traced request: the reply carries the trace back
+			trace_Processed(pInMessage, &trace);
+			trace_Attach(&message, &trace);
+			
 			//Send to dixlCommTx task queue
 			msgQ_Send(msgQCommTxId, (char *) &message, size);
 			break;
@@ -174,6 +418,10 @@ static void rejectRouteRequest(message *pInMessage) {
  * STATENOTRESERVED
  */
 static void NotReservedEntry(eventData *pEventData) {
+	// Speculative positioning of an aborted route
+	if (pContext && pContext->pointSpeculative)
+		pointSpeculateAbort();
+	
 	// Clean current request
 	pCurrentNodeState->pCurrentRoute = NULL;
 	
@@ -181,10 +429,9 @@ static void NotReservedEntry(eventData *pEventData) {
 	syslog(LOG_INFO, "Request cleaned");	
 	logger_log(LOGTYPE_NOTRESERVED, 0, NodeNULL);	
 	
-	// Reset timeout
+	// Cancel timeout
 	if (pEventData) {
-		pEventData->deadline->tv_sec = 0;	
-		pEventData->deadline->tv_nsec = 0;		
+		timer_Cancel(pEventData->pTimer);
 	}
 }
 static void NotReservedState(eventData *pEventData) {
@@ -215,6 +462,15 @@ static void NotReservedExit(eventData *pEventData) {
  * STATEWAITACK
  */
 static void WaitAckEntry(eventData *pEventData) {
+	// Star mode: REQ to all the members, their votes collected in this state
+	if (pContext->pMembers) {
+		pContext->votes = 0;
+		context_broadcast(IMSGTYPE_ROUTEREQ);
+		syslog(LOG_INFO, "Route request (%i) coordinated: REQ sent to %i members", pCurrentNodeState->pCurrentRoute->id, pContext->pMembers->numMembers);
+		context_wait(pEventData, pContext->pMembers->members[0], RTTEXCHANGE_REQACK);
+		return;
+	}
+	
 	// Prepare IROUTEREQ message for dixlCommTx
 	message message;
 	message.iHeader.type = IMSGTYPE_ROUTEREQ;
@@ -224,11 +480,11 @@ static void WaitAckEntry(eventData *pEventData) {
 	message.routeIReq.requestRouteId = pCurrentNodeState->pCurrentRoute->id;
 		
 	//Send to dixlCommTx task queue
+	context_trace(&message);
 	msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteREQ));
 
-	// Set timeout
-	clock_gettime(CLOCK_REALTIME, pEventData->deadline);	
-	time_timespectimeout(pEventData->deadline, COMMMSGTIMEOUT);	
+	// Set timeout (adaptive)
+	context_wait(pEventData, pCurrentNodeState->pCurrentRoute->next, RTTEXCHANGE_REQACK);
 }
 static void WaitAckState(eventData *pEventData) {
 
@@ -240,6 +496,14 @@ static void WaitAckExit(eventData *pEventData) {
 	// If DIAGERR* do nothing
 	if (pInMessage->header.type == IMSGTYPE_DIAGERRCOMM || pInMessage->header.type == IMSGTYPE_DIAGERRTASK)
 		return;	
+
+	// Star mode: not all the members ACKed (NACK or timeout), the others are released
+	if (pContext->pMembers && pInMessage->header.type != MSGTYPE_ROUTEACK)
+		context_broadcast(IMSGTYPE_ROUTEDISAGREE);
+	
+	// Released upstream before the ACK (e.g. a batch the host gave up): the next nodes too
+	if (context_releasedUpstream(pInMessage))
+		context_forwardDisagree();
 	
 	// If exit due to NACK, send back to prev node
 	if (pInMessage->header.type == MSGTYPE_ROUTENACK) {
@@ -271,6 +535,7 @@ static void WaitAckExit(eventData *pEventData) {
 		}
 		
 		//Send to dixlCommTx task queue
+		context_trace(&message);
 		msgQ_Send(msgQCommTxId, (char *) &message, size);
 	}
 }
@@ -286,17 +551,18 @@ static void WaitCommitEntry(eventData *pEventData) {
 	// Send ACK to prev node
 	message.routeIAck.destination = pCurrentNodeState->pCurrentRoute->prev;
 	message.routeIAck.requestRouteId = pCurrentNodeState->pCurrentRoute->id;
+	message.routeIAck.points = pContext->pointsToMove + ((pointRequestPending || pointPosition != pCurrentNodeState->pCurrentRoute->requestedPosition) ? 1 : 0);
 
 	// Log
 	nodeId *destNode = &(pCurrentNodeState->pCurrentRoute->prev);
 	syslog(LOG_INFO, "Route request (%i) ACKed sending back ACK to previous node (%d.%d.%d.%d)", pCurrentNodeState->pCurrentRoute->id, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);
 	
 	//Send to dixlCommTx task queue
+	context_trace(&message);
 	msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteACK));
 	
-	// Set timeout
-	clock_gettime(CLOCK_REALTIME, pEventData->deadline);	
-	time_timespectimeout(pEventData->deadline, COMMMSGTIMEOUT);	
+	// Set timeout (adaptive)
+	context_wait(pEventData, pCurrentNodeState->pCurrentRoute->prev, RTTEXCHANGE_ACKCOMMIT);
 }
 static void WaitCommitState(eventData *pEventData) {
 }
@@ -307,6 +573,17 @@ static void WaitCommitExit(eventData *pEventData) {
 	// If DIAGERR* do nothing
 	if (pInMessage->header.type == IMSGTYPE_DIAGERRCOMM || pInMessage->header.type == IMSGTYPE_DIAGERRTASK)
 		return;
+
+	// Batch route (first node): no COMMIT from the host (DISAGREE or timeout), the next nodes are released
+	if (pCurrentNodeState->pCurrentRoute->position == NODEPOS_FIRST) {
+		if (pInMessage->header.type != MSGTYPE_ROUTECOMMIT) {
+			if (pContext->pMembers)
+				context_broadcast(IMSGTYPE_ROUTEDISAGREE);
+			context_forwardDisagree();
+		}
+		return;
+	}
+
 	// If exit due to DISAGREE, forward to next node (if present)
 	if (pInMessage->header.type == MSGTYPE_ROUTEDISAGREE) {
 		
@@ -325,6 +602,7 @@ static void WaitCommitExit(eventData *pEventData) {
 			syslog(LOG_INFO, "Received DISAGREE for route (%i) forwarding DISAGREE to next node (%d.%d.%d.%d)", pCurrentNodeState->pCurrentRoute->id, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);
 		
 			//Send to dixlCommTx task queue
+			context_trace(&message);
 			msgQ_Send(msgQCommTxId, (char *) &message, size);
 		} else 
 			// Log
@@ -340,6 +618,15 @@ static void WaitCommitExit(eventData *pEventData) {
  * STATEWAITAGREE
  */
 static void WaitAgreeEntry(eventData *pEventData) {
+	// Star mode: COMMIT to all the members, their votes collected in this state
+	if (pContext->pMembers) {
+		pContext->votes = 0;
+		context_broadcast(IMSGTYPE_ROUTECOMMIT);
+		syslog(LOG_INFO, "Route request (%i) coordinated: COMMIT sent to %i members", pCurrentNodeState->pCurrentRoute->id, pContext->pMembers->numMembers);
+		context_wait(pEventData, pContext->pMembers->members[0], RTTEXCHANGE_COMMITAGREE);
+		return;
+	}
+	
 	// Prepare IROUTECOMMIT message for dixlCommTx
 	message message;
 	message.iHeader.type = IMSGTYPE_ROUTECOMMIT;
@@ -353,11 +640,11 @@ static void WaitAgreeEntry(eventData *pEventData) {
 	syslog(LOG_INFO, "Route request (%i) COMMITed forwarding COMMIT to next node (%d.%d.%d.%d)", pCurrentNodeState->pCurrentRoute->id, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);				
 	
 	//Send to dixlCommTx task queue
+	context_trace(&message);
 	msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteCOMMIT));
 	
-	// Set timeout
-	clock_gettime(CLOCK_REALTIME, pEventData->deadline);	
-	time_timespectimeout(pEventData->deadline, COMMMSGTIMEOUT);	
+	// Set timeout (adaptive)
+	context_wait(pEventData, pCurrentNodeState->pCurrentRoute->next, RTTEXCHANGE_COMMITAGREE);
 }
 static void WaitAgreeState(eventData *pEventData) {
 }
@@ -369,6 +656,16 @@ static void WaitAgreeExit(eventData *pEventData) {
 	if (pInMessage->header.type == IMSGTYPE_DIAGERRCOMM || pInMessage->header.type == IMSGTYPE_DIAGERRTASK)
 		return;
 
+	// Star mode: not all the members AGREEed (DISAGREE or timeout), the others are released
+	if (pContext->pMembers && pInMessage->header.type != MSGTYPE_ROUTEAGREE)
+		context_broadcast(IMSGTYPE_ROUTEDISAGREE);
+	
+	// Released upstream before the AGREE (e.g. a batch the host gave up): the next nodes too, nothing sent back
+	if (context_releasedUpstream(pInMessage)) {
+		context_forwardDisagree();
+		return;
+	}
+
 	// If exit due to DISAGREE, send back to prev node (if present)
 	if (pInMessage->header.type == MSGTYPE_ROUTEDISAGREE) {
 		// Prepare  message for prev node
@@ -400,6 +697,7 @@ static void WaitAgreeExit(eventData *pEventData) {
 		logger_log(LOGTYPE_DISAGREE, pCurrentNodeState->pCurrentRoute->id, NodeNULL );
 		
 		//Send to dixlCommTx task queue
+		context_trace(&message);
 		msgQ_Send(msgQCommTxId, (char *) &message, size);
 	}
 }
@@ -409,24 +707,14 @@ static void WaitAgreeExit(eventData *pEventData) {
  * STATEPOSITIONING
  */
 static void PositioningEntry(eventData *pEventData) {			
-	// Prepare  message to request position to Point task	
-	message message;
-	size_t size = sizeof(msgIHeader);
-	message.iHeader.type = IMSGTYPE_POINTPOS;
-	message.pointIPosition.requestedPosition = pCurrentNodeState->pCurrentRoute->requestedPosition;
-	clock_gettime(CLOCK_REALTIME, &lastPointNonce);
-	message.pointIPosition.requestTimestamp = lastPointNonce;
-	size += sizeof(msgIPointPOS);
-	
-	// Log
-	syslog(LOG_INFO, "Route request (%i) AGREEed requesting %s positioning to Point with nonce %i ", pCurrentNodeState->pCurrentRoute->id, pointPosStr(pCurrentNodeState->pCurrentRoute->requestedPosition), lastPointNonce);				
-
-	//Send to dixlPoint task queue
-	msgQ_Send(msgQPointId, (char *) &message, size);	
-
-	// Reset timeout
-	pEventData->deadline->tv_sec = 0;	
-	pEventData->deadline->tv_nsec = 0;	
+	// Request position to Point task (already moving, or done, if speculative)
+	syslog(LOG_INFO, "Route request (%i) AGREEed", pCurrentNodeState->pCurrentRoute->id);
+	pContext->pointSpeculative = FALSE;
+	clock_gettime(CLOCK_MONOTONIC, &pContext->specCommitAt);
+	pointRequest();
+
+	// Cancel timeout
+	timer_Cancel(pEventData->pTimer);
 }
 static void PositioningState(eventData *pEventData) {	
 }
@@ -441,8 +729,11 @@ static void PositioningExit(eventData *pEventData) {
 	// If exit due to DISAGREE, forward to next node (if present)
 	if (pInMessage->header.type == MSGTYPE_ROUTEDISAGREE) {
 		
+		// Star mode: the coordinator releases all the members
+		if (pContext->pMembers)
+			context_broadcast(IMSGTYPE_ROUTEDISAGREE);
 		// Not last node? Send to next node
-		if (pCurrentNodeState->pCurrentRoute->position != NODEPOS_LAST) {
+		else if (pCurrentNodeState->pCurrentRoute->position != NODEPOS_LAST) {
 			// Prepare  message for next node
 			message message;
 			size_t size = sizeof(msgIHeader);
@@ -456,6 +747,7 @@ static void PositioningExit(eventData *pEventData) {
 			syslog(LOG_INFO, "Received DISAGREE for route (%i) forwarding DISAGREE to next node (%d.%d.%d.%d)", pCurrentNodeState->pCurrentRoute->id, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);			
 		
 			//Send to dixlCommTx task queue
+			context_trace(&message);
 			msgQ_Send(msgQCommTxId, (char *) &message, size);
 		} else 
 			// Log
@@ -509,6 +801,7 @@ static void MalfunctionStateEntry(eventData *pEventData) {
 	logger_log(LOGTYPE_DISAGREE, pCurrentNodeState->pCurrentRoute->id, NodeNULL );			
 	
 	//Send to dixlCommTx task queue
+	context_trace(&messagePrev);
 	msgQ_Send(msgQCommTxId, (char *) &messagePrev, size);
 
 	// DISAGREE to next node to abort the reservation
@@ -528,18 +821,18 @@ static void MalfunctionStateEntry(eventData *pEventData) {
 		syslog(LOG_INFO, "Route request (%i) MALFUNCTION reached sending DISAGREE to next node (%d.%d.%d.%d)", pCurrentNodeState->pCurrentRoute->id, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);					
 
 		//Send to dixlCommTx task queue
+		context_trace(&messageNext);
 		msgQ_Send(msgQCommTxId, (char *) &messageNext, size);
 	} else 
 		// Log
 		syslog(LOG_INFO, "Route request (%i) MALFUNCTION reached not propagating (last)", pCurrentNodeState->pCurrentRoute->id);
 	
-	// Reset timeout
-	pEventData->deadline->tv_sec = 0;	
-	pEventData->deadline->tv_nsec = 0;		
+	// Cancel timeout
+	timer_Cancel(pEventData->pTimer);
 }
 static void MalfunctionState(eventData *pEventData) {
 	// Simply go to FailSafeState
-	FSMEvent_Internal(StateFailSafe, pEventData);
+	FSM_Internal(&pContext->FSM, StateFailSafe, pEventData);
 }
 
 
@@ -583,27 +876,29 @@ static void ReservedStateEntry(eventData *pEventData) {
 	// Log
 	logger_log(LOGTYPE_RESERVED, pCurrentNodeState->pCurrentRoute->id, NodeNULL );			
 
+	// Speculative positioning: move time overlapped with the 2PC (up to the COMMIT/AGREE) and left after it
+	if (pContext->specStartAt.tv_sec || pContext->specStartAt.tv_nsec) {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		bool doneBefore = pContext->specDoneAt.tv_sec || pContext->specDoneAt.tv_nsec;
+		int msOverlap = (int) (time_timespecdiff(doneBefore ? &pContext->specDoneAt : &pContext->specCommitAt, &pContext->specStartAt) * 1000);
+		int msAfter = doneBefore ? 0 : (int) (time_timespecdiff(&now, &pContext->specCommitAt) * 1000);
+		syslog(LOG_INFO, "Route request (%i) speculative positioning: %i ms overlapped with the 2PC, %i ms after it", pCurrentNodeState->pCurrentRoute->id, msOverlap, msAfter);
+	}
+
 	//Send to dixlCommTx task queue
+	context_trace(&message);
 	msgQ_Send(msgQCommTxId, (char *) &message, size);
 	
-	// Prepare  message to request state to Sensor task	
-	memset(&message, 0,sizeof(message));
-	size = sizeof(msgIHeader);
-	message.iHeader.type = IMSGTYPE_SENSORSTATE;
-	message.sensorIPOS.requestedState = SENSORSTATE_ON;
-	clock_gettime(CLOCK_REALTIME, &lastSensorNonce);
-	message.pointIPosition.requestTimestamp = lastSensorNonce;	
-	size += sizeof(msgISensorSTATE);
-	
-	// Log
-	syslog(LOG_INFO, "Route request (%i) waiting for SENSOR ON with nonce %i", pCurrentNodeState->pCurrentRoute->id, lastSensorNonce);				
-
-	//Send to dixlSensor task queue
-	msgQ_Send(msgQSensorId, (char *) &message, size);	
-
-	// Reset timeout
-	pEventData->deadline->tv_sec = 0;	
-	pEventData->deadline->tv_nsec = 0;	
+	// Request state to Sensor task (the routes reserved before go first: their trains come before)
+	pContext->reservedOrder = ++reservedCount;
+	if (sensorOwner() == pContext)
+		sensorRequest(SENSORSTATE_ON);
+	else
+		syslog(LOG_INFO, "Route request (%i) waiting for SENSOR after the routes reserved before", pCurrentNodeState->pCurrentRoute->id);
+
+	// Cancel timeout
+	timer_Cancel(pEventData->pTimer);
 }
 static void ReservedState(eventData *pEventData) {	
 }
@@ -615,14 +910,23 @@ static void ReservedStateExit(eventData *pEventData) {
 	if (pInMessage->header.type == IMSGTYPE_DIAGERRCOMM || pInMessage->header.type == IMSGTYPE_DIAGERRTASK)
 		return;
 
+	// Released by a track circuit ahead
+	if (pInMessage->header.type == MSGTYPE_ROUTERELEASE) {
+		routeReleased(pInMessage);
+		return;
+	}
+
 	// If exit due to DISAGREE, forward to next node (if present)
 	if (pInMessage->header.type == MSGTYPE_ROUTEDISAGREE) {
 		// Prepare  message for prev node
 		message message;
 		size_t size = sizeof(msgIHeader);
 		
+		// Star mode: the coordinator releases all the members
+		if (pContext->pMembers)
+			context_broadcast(IMSGTYPE_ROUTEDISAGREE);
 		// Not last node? Send to next node
-		if (pCurrentNodeState->pCurrentRoute->position != NODEPOS_LAST) {
+		else if (pCurrentNodeState->pCurrentRoute->position != NODEPOS_LAST) {
 			message.iHeader.type = IMSGTYPE_ROUTEDISAGREE;
 			message.routeIDisagree.destination = pCurrentNodeState->pCurrentRoute->next;
 			message.routeIDisagree.requestRouteId = pCurrentNodeState->pCurrentRoute->id;
@@ -633,6 +937,7 @@ static void ReservedStateExit(eventData *pEventData) {
 			syslog(LOG_INFO, "Received DISAGREE for route (%i) forwarding DISAGREE to next node (%d.%d.%d.%d)", pCurrentNodeState->pCurrentRoute->id, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);			
 
 			//Send to dixlCommTx task queue
+			context_trace(&message);
 			msgQ_Send(msgQCommTxId, (char *) &message, size);
 		} else 
 			// Log
@@ -650,24 +955,11 @@ static void TrainInTransitionEntry(eventData *pEventData) {
 	// Log
 	syslog(LOG_INFO, "Route request (%i) TRAIN IS GOING THROUGH", pCurrentNodeState->pCurrentRoute->id);
 	
-	// Prepare  message to request state to Sensor task	
-	message message;
-	size_t size = sizeof(msgIHeader);
-	message.iHeader.type = IMSGTYPE_SENSORSTATE;
-	message.sensorIPOS.requestedState = SENSORSTATE_OFF;
-	clock_gettime(CLOCK_REALTIME, &lastSensorNonce);
-	message.pointIPosition.requestTimestamp = lastSensorNonce;	
-	size += sizeof(msgISensorSTATE);
-	
-	// Log
-	syslog(LOG_INFO, "Route request (%i) waiting for SENSOR OFF with nonce %i", pCurrentNodeState->pCurrentRoute->id, lastSensorNonce);					
+	// Request state to Sensor task	
+	sensorRequest(SENSORSTATE_OFF);
 
-	//Send to dixlSensor task queue
-	msgQ_Send(msgQSensorId, (char *) &message, size);			
-
-	// Reset timeout
-	pEventData->deadline->tv_sec = 0;	
-	pEventData->deadline->tv_nsec = 0;	
+	// Cancel timeout
+	timer_Cancel(pEventData->pTimer);
 }
 static void TrainInTransitionState(eventData *pEventData) {
 }
@@ -678,9 +970,9 @@ static void TrainInTransitionExit(eventData *pEventData) {
 	// If DIAGERR* do nothing
 	if (pInMessage->header.type == IMSGTYPE_DIAGERRCOMM || pInMessage->header.type == IMSGTYPE_DIAGERRTASK)
 		return;	
-	
+
 	// Log
-	syslog(LOG_INFO, "Route request (%i) SENSOR OFF received", pCurrentNodeState->pCurrentRoute->id);
+	routeCleared(pInMessage);
 }
 
 /**
@@ -689,10 +981,10 @@ static void TrainInTransitionExit(eventData *pEventData) {
 static void FailSafeEntry(eventData *pEventData) {
 	// Log
 	syslog(LOG_ERR, "Node is going in fail-safe mode all subsequent requests will be rejected");
+	nodeFailSafe = TRUE;
 
-	// Reset timeout
-	pEventData->deadline->tv_sec = 0;	
-	pEventData->deadline->tv_nsec = 0;	
+	// Cancel timeout
+	timer_Cancel(pEventData->pTimer);
 }
 static void FailSafeState(eventData *pEventData) {
 	// Reject All reuqests
@@ -707,7 +999,7 @@ static void FailSafeState(eventData *pEventData) {
 	}
 }
 
-static StateMapItem StateMap[] = {
+static const StateMapItem StateMap[] = {
 		// StateDummy
 		{ NULL,						NULL, 					NULL},
 		// StateNotReserved
@@ -730,390 +1022,402 @@ static StateMapItem StateMap[] = {
 		{ FailSafeState,			FailSafeEntry,			NULL },
 };
 
-/* FiniteStateMachine istance object */
-static FiniteStateMachine FSM =  {
-	StateDummy,
-	StateDummy,
-	StateMap,
-	FALSE,
-	NULL
-};
-
 /**
- * STATEDUMMY
+ * Guards
  */
-void FSMCtrlPOINT(NodeState *pState) {	
-	// Get pointer to NodeState
-	pCurrentNodeState = pState;
-	
-	// Force first (Init) State
-	FSM.currentState = StateDummy;	
-	FSMEvent_Internal(StateNotReserved, NULL);
-	
-	// and process it
-	StateEngine();
+// Requested route set (route id found) and the node isn't the last one
+static bool guard_routeSetNotLast(eventData *pEventData) {
+	message *pMessage = pEventData->pMessage;
+	return setRoute(pMessage->header.source, pMessage->routeReq.requestRouteId) && pCurrentNodeState->pCurrentRoute->position != NODEPOS_LAST;
+}
 
-	// Log
-	syslog(LOG_INFO, "FSM initialized");
+// Requested route set (by the previous guard) and the node is the last one
+static bool guard_routeSetLast(eventData *pEventData) {
+	return pCurrentNodeState->pCurrentRoute && pCurrentNodeState->pCurrentRoute->position == NODEPOS_LAST;
 }
 
-/**
- * The state engine execute until events are generated
- */
-static void StateEngine() {
-    // Temporary pointer to current event data
-	eventData *pDataTemp = NULL;
+// Message for the current requested route
+static bool guard_route(eventData *pEventData) {
+	return pEventData->pMessage->routeAck.requestRouteId == pCurrentNodeState->pCurrentRoute->id;
+}
 
-    // While events are being generated keep executing states
-    while (FSM.eventGenerated) {
+// Message for the current requested route, node in the position
+static bool guard_routeFirst(eventData *pEventData) {
+	return guard_route(pEventData) && pCurrentNodeState->pCurrentRoute->position == NODEPOS_FIRST;
+}
+static bool guard_routeMiddle(eventData *pEventData) {
+	return guard_route(pEventData) && pCurrentNodeState->pCurrentRoute->position == NODEPOS_MIDDLE;
+}
+static bool guard_routeLast(eventData *pEventData) {
+	return guard_route(pEventData) && pCurrentNodeState->pCurrentRoute->position == NODEPOS_LAST;
+}
 
-        // Get the pointers to function
-        StateFunc state = FSM.stateMap[FSM.newState].pStateFunc;
-        EntryFunc entry = FSM.stateMap[FSM.newState].pEntryFunc;
-        ExitFunc exit = FSM.stateMap[FSM.currentState].pExitFunc;
+// Batch route (first node): all the nodes ACKed, the COMMIT is the host one
+static bool guard_routeBatch(eventData *pEventData) {
+	return pContext->batch && guard_routeFirst(pEventData);
+}
 
-        // Copy of event data pointer
-        pDataTemp = FSM.pEventData;
+// Star mode: vote of the member recorded, other members still to reply
+static bool guard_routeVotePending(eventData *pEventData) {
+	if (!pContext->pMembers || !guard_routeFirst(pEventData))
+		return FALSE;
+	for (uint32_t i = 0; i < pContext->pMembers->numMembers; i++)
+		if (!nodecmp(pContext->pMembers->members[i], pEventData->pMessage->header.source))
+			pContext->votes |= (uint32_t) 1 << i;
+	return pContext->votes != (uint32_t) (((uint64_t) 1 << pContext->pMembers->numMembers) - 1);
+}
 
-        // Event data used and resetted
-        FSM.pEventData = NULL;
+// Sensor notify of the last request (nonce match) in the state
+static bool guard_sensor(eventData *pEventData, eSensorState sensorState) {
+	msgISensorNOTIFY *pNotify = &pEventData->pMessage->sensorINOTIFY;
+	return pNotify->currentState == sensorState && pNotify->requestTimestamp.tv_sec == pContext->lastSensorNonce.tv_sec && pNotify->requestTimestamp.tv_nsec == pContext->lastSensorNonce.tv_nsec;
+}
+static bool guard_sensorOn(eventData *pEventData) {
+	return guard_sensor(pEventData, SENSORSTATE_ON);
+}
+static bool guard_sensorOff(eventData *pEventData) {
+	return guard_sensor(pEventData, SENSORSTATE_OFF);
+}
 
-        // Event served and resetted
-        FSM.eventGenerated = FALSE;
+// Point notify: undefined position or position different from the requested one (of the last request)
+static bool guard_pointMalfunction(eventData *pEventData) {
+	msgIPointNOTIFY *pNotify = &pEventData->pMessage->pointINotify;
+	if (pNotify->currentPosition == POINTPOS_UNDEFINED)
+		return TRUE;
+	return pNotify->requestTimestamp.tv_sec == pContext->lastPointNonce.tv_sec && pNotify->requestTimestamp.tv_nsec == pContext->lastPointNonce.tv_nsec && pNotify->currentPosition != pCurrentNodeState->pCurrentRoute->requestedPosition;
+}
 
-		// Transitioning to a new state?
-		if (FSM.newState != FSM.currentState)
-		{
-			// Execute the state exit action on current state before switching to new state
-			if (exit != NULL)
-				exit(pDataTemp);
+// Point notify: requested position reached (of the last request)
+static bool guard_pointPositioned(eventData *pEventData) {
+	msgIPointNOTIFY *pNotify = &pEventData->pMessage->pointINotify;
+	return pNotify->requestTimestamp.tv_sec == pContext->lastPointNonce.tv_sec && pNotify->requestTimestamp.tv_nsec == pContext->lastPointNonce.tv_nsec && pNotify->currentPosition == pCurrentNodeState->pCurrentRoute->requestedPosition;
+}
 
-			// Execute the state entry action on the new state
-			if (entry != NULL)
-				entry(pDataTemp);
+/**
+ * Actions
+ */
+// New route in progress in the context
+static void action_routeStart(eventData *pEventData) {
+	pContext->pRoute = pCurrentNodeState->pCurrentRoute;
+	
+	// Point moved while the 2PC goes on
+	if (CTRLPOINTSPECULATIVE)
+		pointSpeculate();
+	
+	// Star mode if the node coordinates the route
+	if (pContext->pRoute->position == NODEPOS_FIRST)
+		pContext->pMembers = routeMembersFind(pCurrentNodeState->pMembersList, pCurrentNodeState->numMembersList, pContext->pRoute->id);
+	
+	// Route of a host batch (the flag is set by the node itself, see context_requestBatch)
+	message *pMessage = pEventData->pMessage;
+	pContext->batch = pContext->pRoute->position == NODEPOS_FIRST && pMessage->header.lentgh >= sizeof(msgHeader) + offsetof(msgRouteREQ, trace) && pMessage->routeReq.batch;
+}
 
-			// Ensure exit/entry actions didn't call FSMEvent_Internal by accident 
-			assert(FSM.eventGenerated == FALSE);
-		}
+// Reply of the neighbour (or member) received: round-trip time sample
+static void action_rttSample(eventData *pEventData) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ctrlRtt_Sample(pEventData->pMessage->header.source, pContext->rttExchange, (int) (time_timespecdiff(&now, &pContext->rttSentAt) * 1000));
+}
 
-		// Switch to the new current state
-		FSM.currentState = FSM.newState;
+// ACK received: round-trip time sample and the points still to move downstream
+static void action_routeAck(eventData *pEventData) {
+	action_rttSample(pEventData);
+	if (pEventData->pMessage->routeAck.points > pContext->pointsToMove)
+		pContext->pointsToMove = pEventData->pMessage->routeAck.points;
+}
 
-		// Execute the state action passing in event data
-		assert(state != NULL);
-		state(pDataTemp);
-    }
+// RELEASE received while the Sensor is still ON (it releases the node): told to the elements behind
+static void action_routeRelease(eventData *pEventData) {
+	syslog(LOG_INFO, "Route request (%i) RELEASE received, SENSOR still ON: forwarding it", pCurrentNodeState->pCurrentRoute->id);
+	routeRelease(&pEventData->pMessage->header.source);
 }
 
+/* Transitions: DIAGERR* in every state send to StateFailSafe, REQ messages get here only in NOT_RESERVED state (a new context) */
+static const TransitionItem Transitions[] = {
+		// state					message type				guard						action				next state
+		{ FSMANYSTATE,				IMSGTYPE_DIAGERRCOMM,		NULL,						NULL,				StateFailSafe },
+		{ FSMANYSTATE,				IMSGTYPE_DIAGERRTASK,		NULL,						NULL,				StateFailSafe },
+		{ StateNotReserved,			MSGTYPE_ROUTEREQ,			guard_routeSetNotLast,		action_routeStart,	StateWaitAck },
+		{ StateNotReserved,			MSGTYPE_ROUTEREQ,			guard_routeSetLast,			action_routeStart,	StateWaitCommit },
+		{ StateWaitAck,				MSGTYPE_ROUTEACK,			guard_routeVotePending,		action_routeAck,	StateWaitAck },
+		{ StateWaitAck,				MSGTYPE_ROUTEACK,			guard_routeBatch,			action_routeAck,	StateWaitCommit },
+		{ StateWaitAck,				MSGTYPE_ROUTEACK,			guard_routeFirst,			action_routeAck,	StateWaitAgree },
+		{ StateWaitAck,				MSGTYPE_ROUTEACK,			guard_routeMiddle,			action_routeAck,	StateWaitAck },
+		{ StateWaitAck,				MSGTYPE_ROUTENACK,			guard_route,				NULL,				StateNotReserved },
+		{ StateWaitAck,				MSGTYPE_ROUTEDISAGREE,		guard_route,				NULL,				StateNotReserved },
+		{ StateWaitAck,				IMSGTYPE_TIMEOUTNOTIFY,		NULL,						NULL,				StateNotReserved },
+		{ StateWaitCommit,			MSGTYPE_ROUTECOMMIT,		guard_routeFirst,			NULL,				StateWaitAgree },
+		{ StateWaitCommit,			MSGTYPE_ROUTECOMMIT,		guard_routeMiddle,			action_rttSample,	StateWaitAgree },
+		{ StateWaitCommit,			MSGTYPE_ROUTECOMMIT,		guard_routeLast,			action_rttSample,	StatePositioning },
+		{ StateWaitCommit,			MSGTYPE_ROUTEDISAGREE,		guard_route,				NULL,				StateNotReserved },
+		{ StateWaitCommit,			IMSGTYPE_TIMEOUTNOTIFY,		NULL,						NULL,				StateNotReserved },
+		{ StateWaitAgree,			MSGTYPE_ROUTEAGREE,			guard_routeVotePending,		action_rttSample,	StateWaitAgree },
+		{ StateWaitAgree,			MSGTYPE_ROUTEAGREE,			guard_route,				action_rttSample,	StatePositioning },
+		{ StateWaitAgree,			MSGTYPE_ROUTEDISAGREE,		guard_route,				NULL,				StateNotReserved },
+		{ StateWaitAgree,			IMSGTYPE_TIMEOUTNOTIFY,		NULL,						NULL,				StateNotReserved },
+		{ StatePositioning,			IMSGTYPE_POINTNOTIFY,		guard_pointMalfunction,		NULL,				StateMalfunction },
+		{ StatePositioning,			IMSGTYPE_POINTNOTIFY,		guard_pointPositioned,		NULL,				StateReserved },
+		{ StatePositioning,			MSGTYPE_ROUTEDISAGREE,		guard_route,				NULL,				StateNotReserved },
+		{ StatePositioning,			IMSGTYPE_TIMEOUTNOTIFY,		NULL,						NULL,				StateNotReserved },
+		{ StateMalfunction,			FSMANYTYPE,					NULL,						NULL,				StateMalfunction },
+		{ StateReserved,			IMSGTYPE_SENSORNOTIFY,		guard_sensorOn,				NULL,				StateTrainInTransition },
+		{ StateReserved,			MSGTYPE_ROUTEDISAGREE,		guard_route,				NULL,				StateNotReserved },
+		{ StateReserved,			MSGTYPE_ROUTERELEASE,		guard_route,				NULL,				StateNotReserved },
+		{ StateTrainInTransition,	IMSGTYPE_SENSORNOTIFY,		guard_sensorOff,			NULL,				StateNotReserved },
+		{ StateTrainInTransition,	MSGTYPE_ROUTERELEASE,		guard_route,				action_routeRelease,StateTrainInTransition },
+		{ StateFailSafe,			FSMANYTYPE,					NULL,						NULL,				StateFailSafe },
+};
+
+/* Lookup table (built by the initialization) */
+static uint8_t Lookup[sizeof(StateMap) / sizeof(StateMap[0])][FSMMSGTYPES];
+
+/* FSM definition (shared by the route contexts) */
+static FSMTable Table = {
+	StateMap,
+	sizeof(StateMap) / sizeof(StateMap[0]),
+	Transitions,
+	sizeof(Transitions) / sizeof(Transitions[0]),
+	Lookup
+};
 
 /**
- * Generates an internal event
- * @param newState: the new state to pass to
- * @param pEventData: pointer to the event data
- */ 
-static void FSMEvent_Internal(eStates newState, eventData *pEventData) {
-    FSM.pEventData = pEventData;
-    FSM.eventGenerated = TRUE;
-    FSM.newState = newState;
+ * STATEDUMMY
+ */
+void FSMCtrlPOINT(NodeState *pState) {	
+	// Get pointer to NodeState
+	pCurrentNodeState = pState;
+	
+	// No routes in progress (each one starts in NotReserved state)
+	for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+		timer_Cancel(&contexts[i].timer);
+	memset(contexts, 0, sizeof(contexts));
+	pContext = NULL;
+	nodeFailSafe = FALSE;
+	pointRequestPending = FALSE;
+	sensorRequestPending = FALSE;
+	reservedCount = 0;
+	pointPosition = POINTPOS_STRAIGHT;
+	ctrlPending_Reset(CTRLROUTECONTEXTSMAX);
+	ctrlRtt_Reset();
+	FSM_TableBuild(&Table);
+	NotReservedEntry(NULL);
+
+	// Log
+	syslog(LOG_INFO, "FSM initialized");
 }
 
 /**
  * Event Functions
- * Only conditions to go to next state are tested and newstate decided then the StateEngine is executed, that is:
+ * The transition is looked up by current state and message type, then the StateEngine is executed, that is:
  * - currentStateExit
  * - newStateEntry
  * - newState
+ * @param pRouteContext: route context the message is for
  * @param message: message received
- * @param deadline: next deadline or 0
  */
-void FSMCtrlPOINTEvent_NewMessage(message *pMessage, struct timespec *deadline) {	
+static void context_event(routeContext *pRouteContext, message *pMessage) {	
 	
-	// Result of the precondition evaluation to pass to new state
-	bool condition = FALSE;
-	// Event data
+	// Event data (the timer is the route one)
+	context_select(pRouteContext);
 	eventData eventData;
 	eventData.pMessage = pMessage;
-	eventData.deadline = deadline;
+	eventData.pTimer = &pContext->timer;
+	
+	// Should not happen
+	if (pContext->FSM.currentState == StateDummy) {
+		syslog(LOG_ERR, "Wrong state Dummy: message received");
+		taskExit(rcFSM_WRONGSTATE);
+	}
 	
-	// New state
-	eStates newState=NULL;
+	// Traced route message: FSM timestamp, the route sends the trace on
+	trace_Processed(pMessage, &pContext->trace);
 	
-	// 1) in every state DIAGERR* messagessend to StateFailSafe
-	// 2) in every state except NOT_RESERVED REQ messages are discarded
-	if (pMessage->header.type == IMSGTYPE_DIAGERRCOMM || pMessage->header.type == IMSGTYPE_DIAGERRTASK) {
-		newState = StateFailSafe;
-		condition = TRUE;				
-	} else if (pMessage->header.type == MSGTYPE_ROUTEREQ && FSM.currentState != StateNotReserved) {
+	// Transition (if any, else the message is discarded)
+	FSM_Event(&pContext->FSM, pMessage->header.type, &eventData);
+	
+	// Route done (or not started): context free again
+	if (pContext->FSM.currentState == StateNotReserved) {
+		pContext->used = FALSE;
+		pCurrentNodeState->pCurrentRoute = NULL;
+	}
+}
+
+/**
+ * Free context for a new request (NotReserved state)
+ * @return the context or NULL if all in use
+ */
+static routeContext *context_alloc() {
+	for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+		if (!contexts[i].used) {
+			timer_Cancel(&contexts[i].timer);
+			memset(&contexts[i], 0, sizeof(routeContext));
+			timer_Init(&contexts[i].timer, msgQCtrlId, i);
+			contexts[i].used = TRUE;
+			FSM_Reset(&contexts[i].FSM, &Table, StateNotReserved);
+			return &contexts[i];
+		}
+	return NULL;
+}
+
+/**
+ * New route request: a new context if the node isn't in fail-safe, the route isn't already in progress
+ * and it doesn't conflict with the routes in progress. When busy (or older requests are waiting)
+ * it's queued, rejected if the queue is full
+ * @param message: ROUTEREQ message received
+ */
+static void context_request(message *pMessage) {
+	routeId requestedRouteId = pMessage->routeReq.requestRouteId;
+	route *pRoute = routeIndexFind(&pCurrentNodeState->routeIndex, requestedRouteId);
+	routeContext *pRouteContext = NULL;
+	
+	if (nodeFailSafe || (pRoute && context_find(requestedRouteId))) {
 		// SImply reject request
 		rejectRouteRequest(pMessage);
-		condition = FALSE;
-	} else {	
-		switch (FSM.currentState) {
-			case StateDummy:
-				// Should not happen
-				syslog(LOG_ERR, "Wrong state Dummy: message received");
-				taskExit(rcFSM_WRONGSTATE);
-				break;
-				
-			case StateNotReserved:
-				// Accept only ROUTEREQ messages, discard others			
-				if (pMessage->header.type == MSGTYPE_ROUTEREQ) {
-					// Set information of the requested route or fail
-					if (!setRoute(pMessage->header.source, pMessage->routeReq.requestRouteId))
-						condition = FALSE;
-					else {
-						// Go to next state depending on node position (in the current requested route)
-						switch (pCurrentNodeState->pCurrentRoute->position) {
-							case NODEPOS_FIRST:
-							case NODEPOS_MIDDLE:
-								newState = StateWaitAck;
-								break;
-								
-							case NODEPOS_LAST:
-								newState = StateWaitCommit;
-								break;
-						}
-						condition = TRUE;
-					}
-				} else {
-					// Discard other messages
-					condition = FALSE;
-				}
-				break;
-				
-			case StateWaitAck:
-				// Accept only current requested route id
-				// Accept only ACK or NACK or TIMOUT messages, discard others
-				switch (pMessage->header.type) {
-					case MSGTYPE_ROUTEACK:
-						if (pMessage->routeAck.requestRouteId == pCurrentNodeState->pCurrentRoute->id) {
-							// Go to next state depending on node position FIRST or MIDDLE (in the current requested route)
-							switch (pCurrentNodeState->pCurrentRoute->position) {
-								case NODEPOS_FIRST:
-									newState = StateWaitAgree;
-									break;
-									
-								case NODEPOS_MIDDLE:
-									newState = StateWaitAck;
-									break;
-							}
-							condition = TRUE;
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-					
-					case MSGTYPE_ROUTENACK:
-					case IMSGTYPE_TIMEOUTNOTIFY:
-						if (pMessage->routeNAck.requestRouteId == pCurrentNodeState->pCurrentRoute->id || pMessage->header.type == IMSGTYPE_TIMEOUTNOTIFY) {
-							// Not necessary to test NodePosition
-							// Exit send NACK to prev or TRAINNOK to host
-							newState = StateNotReserved;
-							condition = TRUE;
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-						
-					default:
-						condition = FALSE;
-						break;
-				}						
-				break;
-				
-			case StateWaitCommit:
-				// Accept only current requested route id
-				// Accept only COMMIT or DISAGREE or TIMEOUT messages, discard others
-				switch (pMessage->header.type) {
-					case MSGTYPE_ROUTECOMMIT:
-						if (pMessage->routeCommit.requestRouteId == pCurrentNodeState->pCurrentRoute->id) {
-							// Go to next state depending on node position LAST or MIDDLE (in the current requested route)
-							switch (pCurrentNodeState->pCurrentRoute->position) {
-								case NODEPOS_MIDDLE:
-									newState = StateWaitAgree;
-									break;
-									
-								case NODEPOS_LAST:
-									newState = StatePositioning;
-									break;
-							}
-							condition = TRUE;
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-					
-					case MSGTYPE_ROUTEDISAGREE:
-					case IMSGTYPE_TIMEOUTNOTIFY:
-						if (pMessage->routeDisagree.requestRouteId == pCurrentNodeState->pCurrentRoute->id  || pMessage->header.type == IMSGTYPE_TIMEOUTNOTIFY) {
-							// Not necessary to test NodePosition
-							// Exit send DISAGREE to next node if is not last
-							newState = StateNotReserved;
-							condition = TRUE;
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-	
-					default:
-						condition = FALSE;
-						break;
-				}						
-				break;
-				
-			case StateWaitAgree:
-				// Accept only current requested route id
-				// Accept only AGREE or DISAGREE or TIMEOUT messages, discard others
-				switch (pMessage->header.type) {
-					case MSGTYPE_ROUTEAGREE:
-						if (pMessage->routeCommit.requestRouteId == pCurrentNodeState->pCurrentRoute->id) {
-							// Go to positionig state to send a message to tPoint task and receive a feedback (message)
-							newState = StatePositioning;						
-							condition = TRUE;
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-					
-					case MSGTYPE_ROUTEDISAGREE:
-					case IMSGTYPE_TIMEOUTNOTIFY:
-						if (pMessage->routeDisagree.requestRouteId == pCurrentNodeState->pCurrentRoute->id  || pMessage->header.type == IMSGTYPE_TIMEOUTNOTIFY) {
-							// Not necessary to test NodePosition
-							// Exit send DISAGREE to prev node or TRAINNOK to host
-							newState = StateNotReserved;
-							condition = TRUE;
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-	
-					default:
-						condition = FALSE;
-						break;
-				}						
-				break;
-				
-			case StatePositioning:
-				// Accept only POINTNOTIFY and DISAGREE or TIMEOUT, discard others
-				switch (pMessage->header.type) {
-					case IMSGTYPE_POINTNOTIFY:
-						// Malfunction? 
-						if (pMessage->pointINotify.currentPosition == POINTPOS_UNDEFINED) {
-							newState = StateMalfunction;
-							condition = TRUE;
-						// Check request timestamp request match (if different, discard the message)
-						} else if (pMessage->pointINotify.requestTimestamp.tv_sec == lastPointNonce.tv_sec && pMessage->pointINotify.requestTimestamp.tv_nsec == lastPointNonce.tv_nsec ) {
-							// If the timestamp math but the position doesn't is considered a Malfunction
-							if (pMessage->pointINotify.currentPosition != pCurrentNodeState->pCurrentRoute->requestedPosition) {
-								// Go to Malfunction state
-								newState = StateMalfunction;
-								condition = TRUE;
-							} else {
-								// Go to reserved state to send a message to tPoint task and receive a feedback (message)
-								newState = StateReserved;						
-								condition = TRUE;
-							}
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-					
-					case MSGTYPE_ROUTEDISAGREE:
-					case IMSGTYPE_TIMEOUTNOTIFY:
-						if (pMessage->routeDisagree.requestRouteId == pCurrentNodeState->pCurrentRoute->id || pMessage->header.type == IMSGTYPE_TIMEOUTNOTIFY) {
-							// Not necessary to test NodePosition
-							// Exit send DISAGREE to prev node or TRAINNOK to host
-							newState = StateNotReserved;
-							condition = TRUE;
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-	
-					default:
-						condition = FALSE;
-						break;
-				}						
-				break;
-				
-			case StateMalfunction:
-				// Keep this state (until general dixlCtrlReset)
-				newState = StateMalfunction;
-				condition= TRUE;
-				break;
-				
-			case StateReserved:
-				// Accept only current requested route id (for DISAGREE)
-				// Accept only SENSORON or DISAGREE messages, discard others
-				switch (pMessage->header.type) {
-					// If SENSOR ON received go to state TrainInTransition
-					case IMSGTYPE_SENSORNOTIFY:		
-						if (pMessage->sensorINOTIFY.currentState == SENSORSTATE_ON && pMessage->sensorINOTIFY.requestTimestamp.tv_sec == lastSensorNonce.tv_sec && pMessage->sensorINOTIFY.requestTimestamp.tv_nsec == lastSensorNonce.tv_nsec ) {
-							newState = StateTrainInTransition;
-							condition = TRUE;
-						} else 
-							condition = FALSE;
-						break;
-					
-					case MSGTYPE_ROUTEDISAGREE:
-						if (pMessage->routeDisagree.requestRouteId == pCurrentNodeState->pCurrentRoute->id) {
-							// Not necessary to test NodePosition
-							// Exit send DISAGREE to next node
-							newState = StateNotReserved;
-							condition = TRUE;
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-	
-					default:
-						condition = FALSE;
-						break;
-				}						
-				break;
-				break;
-				
-			case StateTrainInTransition:
-				// Accept only SENSOROFF
-				if (pMessage->iHeader.type == IMSGTYPE_SENSORNOTIFY && pMessage->sensorINOTIFY.currentState == SENSORSTATE_OFF && pMessage->sensorINOTIFY.requestTimestamp.tv_sec == lastSensorNonce.tv_sec && pMessage->sensorINOTIFY.requestTimestamp.tv_nsec == lastSensorNonce.tv_nsec ) {
-					newState = StateNotReserved;
-					condition = TRUE;
-	
-				} else {
-					// Discard other messages
-					condition = FALSE;
-				}
-				break;
-			
-			case StateFailSafe:
-				// Keep the state
-				newState = StateFailSafe;
-				condition = TRUE;
-				break;
-				
-		}
+		return;
+	}
+	
+	if (pRoute && (ctrlPending_Head() || !context_admissible(pRoute))) {
+		// Wait for the node
+		if (!ctrlPending_Enqueue(pMessage))
+			rejectRouteRequest(pMessage);
+		return;
+	}
+	
+	// Unknown route: rejected by the new context (if any)
+	if (!(pRouteContext = context_alloc())) {
+		rejectRouteRequest(pMessage);
+		return;
+	}
+	
+	context_event(pRouteContext, pMessage);
+}
+
+/**
+ * Batch route request (host): a route request for each route of the set the node is the first of,
+ * the others are evaluated by their first nodes. Once all its nodes ACKed, a route is ACKed to the host
+ * and waits for the host COMMIT, sent when all the routes of the set are ACKed: nothing is moved
+ * before all the nodes voted. If any is rejected the host releases the others (DISAGREE from upstream
+ * in any state, removed if still queued)
+ * @param message: ROUTEREQBATCH message received
+ */
+static void context_requestBatch(message *pMessage) {
+	uint32_t numRoutes = pMessage->routeReqBatch.numRoutes;
+	const routeId *pRouteIds = (const routeId *) (&pMessage->routeReqBatch + 1);
+	
+	if (numRoutes == 0 || numRoutes > MSG_ROUTEBATCHMAXROUTES || sizeof(msgHeader) + sizeof(msgRouteREQBATCH) + numRoutes * sizeof(routeId) > pMessage->header.lentgh) {
+		syslog(LOG_ERR, "Wrong batch route request (%i routes): discarded", numRoutes);
+		return;
 	}
 	
-	// If the condition is passed, the new state is served
-	if (condition) {
-		// Generate the internal event
-		// New state, event data and event flag set only if used
-		FSMEvent_Internal(newState, &eventData);
+	for (uint32_t i = 0; i < numRoutes; i++) {
+		route *pRoute = routeIndexFind(&pCurrentNodeState->routeIndex, pRouteIds[i]);
+		if (!pRoute || pRoute->position != NODEPOS_FIRST)
+			continue;
 		
-		// Process the state change
-		StateEngine();
-	}	
+		// Served as a single route request
+		message request;
+		request.header = pMessage->header;
+		request.header.type = MSGTYPE_ROUTEREQ;
+		request.header.lentgh = sizeof(msgHeader) + offsetof(msgRouteREQ, trace);
+		request.routeReq.requestRouteId = pRouteIds[i];
+		request.routeReq.batch = TRUE;
+		syslog(LOG_INFO, "Batch route request: route (%i) of %i", pRouteIds[i], numRoutes);
+		context_request(&request);
+	}
 }
 
-// Manage the timeout creating a dummy message
-void FSMCtrlPOINTEvent_TimerExpired(struct timespec *deadline) {
-	// Dummy message
-	message message;
+/**
+ * Queued route requests: admitted in arrival order as soon as the node can serve them,
+ * rejected when expired or the node is in fail-safe
+ */
+static void context_admit() {
+	message *pPending;
+	
+	if (nodeFailSafe) {
+		ctrlPending_RejectAll(rejectRouteRequest);
+		return;
+	}
+	
+	ctrlPending_Expire(rejectRouteRequest);
+	while ((pPending = ctrlPending_Head()) && context_admissible(routeIndexFind(&pCurrentNodeState->routeIndex, pPending->routeReq.requestRouteId))) {
+		message message = *pPending;
+		ctrlPending_Admitted();
+		context_event(context_alloc(), &message);
+	}
+}
+
+/**
+ * Dispatch the message to the route contexts it's for
+ * @param message: message received
+ */
+void FSMCtrlPOINTEvent_NewMessage(message *pMessage) {	
+	bool delivered = FALSE;
+	
+	switch (pMessage->header.type) {
+		// Whole node in fail-safe: every route in progress (or a new context if none)
+		case IMSGTYPE_DIAGERRCOMM:
+		case IMSGTYPE_DIAGERRTASK:
+			for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+				if (contexts[i].used) {
+					context_event(&contexts[i], pMessage);
+					delivered = TRUE;
+				}
+			if (!delivered)
+				context_event(context_alloc(), pMessage);
+			break;
+			
+		// New route
+		case MSGTYPE_ROUTEREQ:
+			context_request(pMessage);
+			break;
+		case MSGTYPE_ROUTEREQBATCH:
+			context_requestBatch(pMessage);
+			break;
+			
+		// Notifies: each route checks its own nonce
+		case IMSGTYPE_POINTNOTIFY:
+		case IMSGTYPE_SENSORNOTIFY:
+			if (pMessage->iHeader.type == IMSGTYPE_POINTNOTIFY) {
+				pointRequestPending = FALSE;
+				pointPosition = pMessage->pointINotify.currentPosition;
+			} else
+				sensorRequestPending = FALSE;
+			for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++) {
+				if (!contexts[i].used)
+					continue;
+				
+				// Speculative positioning done before the COMMIT (the notify is discarded by the wait states)
+				if (pMessage->iHeader.type == IMSGTYPE_POINTNOTIFY && contexts[i].pointSpeculative && pMessage->pointINotify.requestTimestamp.tv_sec == contexts[i].lastPointNonce.tv_sec && pMessage->pointINotify.requestTimestamp.tv_nsec == contexts[i].lastPointNonce.tv_nsec)
+					clock_gettime(CLOCK_MONOTONIC, &contexts[i].specDoneAt);
+				context_event(&contexts[i], pMessage);
+			}
+			break;
+			
+		// Timeout: the route owning the timer (if not re-armed or cancelled meanwhile), the queue (owner CTRLROUTECONTEXTSMAX) is checked below
+		case IMSGTYPE_TIMEOUTNOTIFY:
+			if (pMessage->timeoutNotify.owner < CTRLROUTECONTEXTSMAX && contexts[pMessage->timeoutNotify.owner].used && timer_IsCurrent(&contexts[pMessage->timeoutNotify.owner].timer, pMessage))
+				context_event(&contexts[pMessage->timeoutNotify.owner], pMessage);
+			break;
+			
+		// Route messages: the route in progress with the same id (others discarded)
+		default: {
+			routeContext *pRouteContext = context_find(pMessage->routeReq.requestRouteId);
+			if (pRouteContext)
+				context_event(pRouteContext, pMessage);
+			
+			// Released (by the host) while still queued: never admitted
+			else if (pMessage->header.type == MSGTYPE_ROUTEDISAGREE)
+				ctrlPending_Remove(pMessage->routeDisagree.requestRouteId);
+			break;
+		}
+	}
 	
-	// Prepare the message
-	message.iHeader.type = IMSGTYPE_TIMEOUTNOTIFY;
+	// Queued route requests admitted (or expired), requests superseded by other routes sent again
+	context_admit();
+	requestsResend();
 	
-	// Call the message handler
-	FSMCtrlPOINTEvent_NewMessage(&message, deadline);	
+	// Timer for the oldest queued request
+	ctrlPending_Timer();
 }
 
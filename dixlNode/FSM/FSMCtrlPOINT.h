@@ -25,16 +25,8 @@ void FSMCtrlPOINT();
  */
 /**
  * Notify a new message Event
- * @param message: pointer to the message received
- * @param deadline: next deadline or 0
+ * @param message: pointer to the message received (timeouts are IMSGTYPE_TIMEOUTNOTIFY messages)
  */
-void FSMCtrlPOINTEvent_NewMessage(message *message, struct timespec *deadline);
-
-/**
- * Notify the timer is expired
- * @param message: pointer to the message received
- * @param deadline: next deadline or 0
- */
-void FSMCtrlPOINTEvent_TimerExpired(struct timespec *deadline);
+void FSMCtrlPOINTEvent_NewMessage(message *message);
 
 #endif /* FSMCTRLPOINT_H_ */
@@ -0,0 +1,184 @@
+/**
+ * FSMCtrlPending.c
+ * 
+ * Route requests waiting for the node (shared by the Ctrl FSMs): a bounded FIFO
+ * instead of an immediate rejection when the node is busy
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+/* includes */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <syslog.h>
+
+#include "FSMCtrlPending.h"
+#include "../config.h"
+#include "../globals.h"
+#include "../includes/timerWheel.h"
+#include "../includes/utils.h"
+
+/* defines */
+#define PENDINGSLOTS	(CTRLPENDINGMAX > 0 ? CTRLPENDINGMAX : 1)
+
+/* types */
+typedef struct pendingRequest {
+	message message;						// ROUTEREQ message
+	struct timespec queuedAt;				// Time it was queued (monotonic clock)
+} pendingRequest;
+
+/* variables */
+static pendingRequest pending[PENDINGSLOTS];
+static int head = 0;						// Oldest request index
+static int numPending = 0;					// Requests waiting
+static timerItem timer;						// Expiry of the oldest request
+
+// Statistics
+static uint32_t enqueued = 0;				// Requests queued
+static uint32_t overflowed = 0;				// Requests rejected because the queue was full
+static uint32_t admitted = 0;				// Requests admitted
+static uint32_t expired = 0;				// Requests rejected after CTRLPENDINGTIMEOUT
+static uint32_t rejected = 0;				// Requests rejected by the fail-safe
+static uint32_t removed = 0;				// Requests released by the host while waiting
+static int highWater = 0;					// Max requests waiting at the same time
+static double waitTotal = 0;				// Total wait of the admitted requests (sec)
+static double waitMax = 0;					// Max wait of an admitted request (sec)
+
+/* Implementation functions */
+/* Expiry time of a request */
+static void pending_expiry(const pendingRequest *pRequest, struct timespec *expiry) {
+	*expiry = pRequest->queuedAt;
+	expiry->tv_sec += CTRLPENDINGTIMEOUT / 1000;
+	expiry->tv_nsec += (CTRLPENDINGTIMEOUT % 1000) * 1000000L;
+	if (expiry->tv_nsec >= 1000000000L) {
+		expiry->tv_sec += 1;
+		expiry->tv_nsec -= 1000000000L;
+	}
+}
+
+/* Remove the oldest request */
+static void pending_dequeue() {
+	head = (head + 1) % PENDINGSLOTS;
+	numPending -= 1;
+}
+
+/* FUNCTIONS helpers */
+void ctrlPending_Reset(uint32_t timerOwner) {
+	head = 0;
+	numPending = 0;
+	timer_Cancel(&timer);
+	timer_Init(&timer, msgQCtrlId, timerOwner);
+}
+
+bool ctrlPending_Enqueue(message *pMessage) {
+	if (CTRLPENDINGMAX == 0)
+		return FALSE;
+	if (numPending == CTRLPENDINGMAX) {
+		overflowed++;
+		return FALSE;
+	}
+	
+	pendingRequest *pRequest = &pending[(head + numPending) % PENDINGSLOTS];
+	memcpy(&pRequest->message, pMessage, sizeof(message));
+	clock_gettime(CLOCK_MONOTONIC, &pRequest->queuedAt);
+	numPending += 1;
+	enqueued++;
+	if (numPending > highWater)
+		highWater = numPending;
+
+	// Log
+	syslog(LOG_INFO, "Route request (%i) queued: %d waiting", pMessage->routeReq.requestRouteId, numPending);
+	return TRUE;
+}
+
+message *ctrlPending_Head() {
+	return numPending ? &pending[head].message : NULL;
+}
+
+void ctrlPending_Admitted() {
+	if (!numPending)
+		return;
+	
+	// Wait time
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double wait = time_timespecdiff(&now, &pending[head].queuedAt);
+	waitTotal += wait;
+	if (wait > waitMax)
+		waitMax = wait;
+	admitted++;
+	
+	// Log
+	syslog(LOG_INFO, "Route request (%i) admitted after %d ms", pending[head].message.routeReq.requestRouteId, (int) (wait * 1000));
+	pending_dequeue();
+}
+
+bool ctrlPending_Remove(routeId requestedRouteId) {
+	for (int i = 0; i < numPending; i++) {
+		if (pending[(head + i) % PENDINGSLOTS].message.routeReq.requestRouteId != requestedRouteId)
+			continue;
+		
+		// The newer ones move a slot up (arrival order kept)
+		for (int j = i; j < numPending - 1; j++)
+			pending[(head + j) % PENDINGSLOTS] = pending[(head + j + 1) % PENDINGSLOTS];
+		numPending -= 1;
+		removed++;
+		
+		// Log
+		syslog(LOG_INFO, "Route request (%i) released while queued: removed", requestedRouteId);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+void ctrlPending_Expire(ctrlPendingRejectFunc reject) {
+	struct timespec now, expiry;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	
+	// Same max wait for all: the oldest expire first
+	while (numPending) {
+		pending_expiry(&pending[head], &expiry);
+		if (time_timespecdiff(&expiry, &now) > 0)
+			break;
+		
+		// Log
+		syslog(LOG_INFO, "Route request (%i) expired in queue", pending[head].message.routeReq.requestRouteId);
+		expired++;
+		
+		// Remove before rejecting (the message is a local copy)
+		message message = pending[head].message;
+		pending_dequeue();
+		reject(&message);
+	}
+}
+
+void ctrlPending_RejectAll(ctrlPendingRejectFunc reject) {
+	while (numPending) {
+		rejected++;
+		message message = pending[head].message;
+		pending_dequeue();
+		reject(&message);
+	}
+}
+
+void ctrlPending_Timer() {
+	if (!numPending) {
+		timer_Cancel(&timer);
+		return;
+	}
+	
+	struct timespec now, expiry;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pending_expiry(&pending[head], &expiry);
+	double remaining = time_timespecdiff(&expiry, &now);
+	timer_Arm(&timer, remaining > 0 ? (int) (remaining * 1000) + 1 : 0);
+}
+
+void ctrlPendingShow() {
+	syslog(LOG_INFO, "Route requests queue: %d waiting of %d (high-water %d)", numPending, CTRLPENDINGMAX, highWater);
+	syslog(LOG_INFO, "Route requests queue: %u queued, %u admitted, %u expired, %u rejected (fail-safe), %u rejected (full), %u released", enqueued, admitted, expired, rejected, overflowed, removed);
+	syslog(LOG_INFO, "Route requests queue: wait avg %d ms, max %d ms", admitted ? (int) (waitTotal * 1000 / admitted) : 0, (int) (waitMax * 1000));
+}
@@ -0,0 +1,78 @@
+/**
+ * FSMCtrlPending.h
+ * 
+ * Route requests waiting for the node (shared by the Ctrl FSMs): a bounded FIFO
+ * instead of an immediate rejection when the node is busy
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#ifndef FSMCTRLPENDING_H_
+#define FSMCTRLPENDING_H_
+/* includes */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../datatypes/messages.h"
+
+/* types */
+typedef void (*ctrlPendingRejectFunc)(message *pMessage);
+
+/*
+ * Public functions
+ */
+/**
+ * Empty the queue (FSM initialization): requests dropped without reply
+ * @param timerOwner: owner value of the queue timer notifies (sent to dixlCtrl)
+ */
+void ctrlPending_Reset(uint32_t timerOwner);
+
+/**
+ * Queue a route request the node can't serve now
+ * @param pMessage: ROUTEREQ message (copied)
+ * @return FALSE if the queue is disabled (CTRLPENDINGMAX 0) or full: the caller rejects it
+ */
+bool ctrlPending_Enqueue(message *pMessage);
+
+/**
+ * Oldest request still waiting (expired ones have to be removed before)
+ * @return the request or NULL if the queue is empty
+ */
+message *ctrlPending_Head();
+
+/**
+ * Remove the oldest request once admitted
+ */
+void ctrlPending_Admitted();
+
+/**
+ * Remove a request still waiting (released by the host before admitted)
+ * @param requestedRouteId: route of the request
+ * @return TRUE if it was waiting
+ */
+bool ctrlPending_Remove(routeId requestedRouteId);
+
+/**
+ * Reject the requests waiting for more than CTRLPENDINGTIMEOUT
+ * @param reject: function sending the rejection
+ */
+void ctrlPending_Expire(ctrlPendingRejectFunc reject);
+
+/**
+ * Reject all the requests waiting (node in fail-safe)
+ * @param reject: function sending the rejection
+ */
+void ctrlPending_RejectAll(ctrlPendingRejectFunc reject);
+
+/**
+ * Arm the queue timer for the expiry of the oldest request (cancel it if the queue is empty)
+ */
+void ctrlPending_Timer();
+
+/**
+ * Print the queue statistics (requests queued, admitted, expired and wait times)
+ */
+void ctrlPendingShow();
+
+#endif /* FSMCTRLPENDING_H_ */
@@ -0,0 +1,108 @@
+/**
+ * FSMCtrlRtt.c
+ * 
+ * Round-trip times measured by the Ctrl FSMs for each neighbour (and exchange of the 2PC),
+ * used to derive the timeout waiting for the reply (srtt + K * rttvar, within floor and ceiling)
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+/* includes */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <syslog.h>
+
+#include "FSMCtrlRtt.h"
+#include "../config.h"
+
+/* types */
+// Estimator of an exchange (RFC 6298 smoothing, integer ms)
+typedef struct rttEstimator {
+	int srtt;								// Smoothed round-trip time (ms)
+	int rttvar;								// Round-trip time variation (ms)
+	int last;								// Last sample (ms)
+	uint32_t samples;						// Samples measured (0 = no estimate)
+} rttEstimator;
+
+typedef struct rttNeighbour {
+	nodeId node;							// Neighbour (NodeNULL = free)
+	rttEstimator exchange[RTTEXCHANGE_NUM];
+} rttNeighbour;
+
+/* variables */
+static rttNeighbour neighbours[CTRLRTTNEIGHBOURSMAX];
+static int numNeighbours = 0;
+static uint32_t untracked = 0;				// Samples not stored (table full)
+
+/* Implementation functions */
+static rttNeighbour *neighbour_find(nodeId node, bool add) {
+	for (int i = 0; i < numNeighbours; i++)
+		if (!nodecmp(neighbours[i].node, node))
+			return &neighbours[i];
+	if (!add || numNeighbours == CTRLRTTNEIGHBOURSMAX)
+		return NULL;
+	
+	memset(&neighbours[numNeighbours], 0, sizeof(rttNeighbour));
+	neighbours[numNeighbours].node = node;
+	return &neighbours[numNeighbours++];
+}
+
+static int estimator_timeout(const rttEstimator *pEstimator) {
+	if (!pEstimator->samples)
+		return CTRLRTTMAXTIMEOUT;
+	
+	int timeout = pEstimator->srtt + CTRLRTTK * pEstimator->rttvar;
+	if (timeout < CTRLRTTMINTIMEOUT)
+		return CTRLRTTMINTIMEOUT;
+	if (timeout > CTRLRTTMAXTIMEOUT)
+		return CTRLRTTMAXTIMEOUT;
+	return timeout;
+}
+
+/* FUNCTIONS helpers */
+void ctrlRtt_Reset() {
+	numNeighbours = 0;
+}
+
+int ctrlRtt_Timeout(nodeId neighbour, eRttExchange exchange) {
+	rttNeighbour *pNeighbour = neighbour_find(neighbour, FALSE);
+	return pNeighbour ? estimator_timeout(&pNeighbour->exchange[exchange]) : CTRLRTTMAXTIMEOUT;
+}
+
+void ctrlRtt_Sample(nodeId neighbour, eRttExchange exchange, int ms) {
+	rttNeighbour *pNeighbour = neighbour_find(neighbour, TRUE);
+	if (!pNeighbour) {
+		untracked++;
+		return;
+	}
+	
+	rttEstimator *pEstimator = &pNeighbour->exchange[exchange];
+	if (!pEstimator->samples) {
+		// First sample
+		pEstimator->srtt = ms;
+		pEstimator->rttvar = ms / 2;
+	} else {
+		// rttvar = 3/4 rttvar + 1/4 |srtt - R|, srtt = 7/8 srtt + 1/8 R
+		pEstimator->rttvar += (abs(pEstimator->srtt - ms) - pEstimator->rttvar) / 4;
+		pEstimator->srtt += (ms - pEstimator->srtt) / 8;
+	}
+	pEstimator->last = ms;
+	pEstimator->samples++;
+}
+
+void ctrlRttShow() {
+	static const char *exchanges[RTTEXCHANGE_NUM] = { "REQ/ACK", "ACK/COMMIT", "COMMIT/AGREE" };
+	
+	syslog(LOG_INFO, "Round-trip times: %d neighbours of %d, %u samples not stored", numNeighbours, CTRLRTTNEIGHBOURSMAX, untracked);
+	for (int i = 0; i < numNeighbours; i++)
+		for (int j = 0; j < RTTEXCHANGE_NUM; j++) {
+			rttEstimator *pEstimator = &neighbours[i].exchange[j];
+			if (!pEstimator->samples)
+				continue;
+			syslog(LOG_INFO, "Neighbour (%d.%d.%d.%d) %-12s srtt %d ms, rttvar %d ms, last %d ms, timeout %d ms (%u samples)", neighbours[i].node.bytes[0], neighbours[i].node.bytes[1], neighbours[i].node.bytes[2], neighbours[i].node.bytes[3], exchanges[j], pEstimator->srtt, pEstimator->rttvar, pEstimator->last, estimator_timeout(pEstimator), pEstimator->samples);
+		}
+}
@@ -0,0 +1,54 @@
+/**
+ * FSMCtrlRtt.h
+ * 
+ * Round-trip times measured by the Ctrl FSMs for each neighbour (and exchange of the 2PC),
+ * used to derive the timeout waiting for the reply (srtt + K * rttvar, within floor and ceiling)
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#ifndef FSMCTRLRTT_H_
+#define FSMCTRLRTT_H_
+/* includes */
+#include "../datatypes/dataTypes.h"
+
+/* Enums */
+/* Exchange: message sent and reply waited */
+typedef enum {
+	RTTEXCHANGE_REQACK			= 0,	// REQ sent to next, ACK (or NACK) waited
+	RTTEXCHANGE_ACKCOMMIT		= 1,	// ACK sent to prev, COMMIT (or DISAGREE) waited
+	RTTEXCHANGE_COMMITAGREE		= 2,	// COMMIT sent to next, AGREE (or DISAGREE) waited
+	RTTEXCHANGE_NUM				= 3,
+} eRttExchange;
+
+/*
+ * Public functions
+ */
+/**
+ * Forget the measured times (new configuration)
+ */
+void ctrlRtt_Reset();
+
+/**
+ * Timeout waiting the reply of a neighbour
+ * @param neighbour: node the message has been sent to
+ * @param exchange: exchange
+ * @return timeout (ms): CTRLRTTMAXTIMEOUT until measured
+ */
+int ctrlRtt_Timeout(nodeId neighbour, eRttExchange exchange);
+
+/**
+ * New round-trip time measured
+ * @param neighbour: node the message has been sent to
+ * @param exchange: exchange
+ * @param ms: time from the message sent to the reply received (ms)
+ */
+void ctrlRtt_Sample(nodeId neighbour, eRttExchange exchange, int ms);
+
+/**
+ * Print the round-trip times table (srtt, rttvar, timeout and samples by neighbour and exchange)
+ */
+void ctrlRttShow();
+
+#endif /* FSMCTRLRTT_H_ */
@@ -16,10 +16,15 @@
 #include <syslog.h>
 
 #include "FSMCtrlTRACKCIRCUIT.h"
+#include "FSMEngine.h"
+#include "FSMCtrlPending.h"
+#include "FSMCtrlRtt.h"
 #include "../config.h"
 #include "../datatypes/messages.h"
 #include "../tasks/dixlLog.h"
 #include "../globals.h"
+#include "../includes/timerWheel.h"
+#include "../includes/trace.h"
 #include "../includes/utils.h"
 
 
@@ -36,31 +41,21 @@ typedef enum eStates {
 	StateFailSafe,
 } eStates;
 
-typedef struct eventData {
-	struct message *pMessage;
-    struct timespec *deadline;   	// Next timeout or 0 = no timeout	
-} eventData;
-
-
-typedef void (*StateFunc)(eventData *pEventData);
-typedef void (*EntryFunc)(eventData *pEventData);
-typedef void (*ExitFunc)(eventData *pEventData);
-
-typedef struct StateMapItem {
-	StateFunc pStateFunc;
-	EntryFunc pEntryFunc;
-	ExitFunc pExitFunc;
-} StateMapItem;
-
-/* Machine Instance */
-typedef struct {
-	eStates newState;				// New state to pass to
-	eStates currentState;			// Current state
-    StateMapItem *stateMap;			// Map to function for each state
-	bool eventGenerated;			// An event occured and hasn't been served
-	eventData *pEventData;			// Point to current event Data
-} FiniteStateMachine;
-
+/* Route context: a route in progress with its own FSM */
+typedef struct routeContext {
+	bool used;						// Context in use
+	FiniteStateMachine FSM;			// Route FSM
+	route *pRoute;					// Requested route
+	timerItem timer;				// Timeout timer (owner: context index)
+	routeMembers *pMembers;			// Members of the route coordinated by the node (star mode) or NULL
+	bool batch;						// Route of a host batch (first node): ACKed to the host, its COMMIT once all the routes are ACKed
+	uint32_t votes;					// Members replied (star mode, a bit per member)
+	eRttExchange rttExchange;		// Exchange waiting the reply
+	struct timespec rttSentAt;		// Message sent (monotonic clock)
+	uint32_t pointsToMove;			// Points still to move downstream (from the ACKs, star mode: the slowest member)
+	struct timespec lastSensorNonce;// Nonce of the last Sensor request (the excepted one)
+	msgTrace trace;					// Trace of the last traced message received (host opt-in), sent on with the next messages
+} routeContext;
 
 
 /**
@@ -68,7 +63,10 @@ typedef struct {
  */
 // Node State
 static NodeState *pCurrentNodeState = NULL;
-static struct timespec lastSensorNonce; // Nonce of the last Sensor request (the excepted one) 
+static routeContext contexts[CTRLROUTECONTEXTSMAX];	// Routes in progress
+static routeContext *pContext = NULL;				// Context of the event being served
+static bool nodeFailSafe = FALSE;					// Node in fail-safe: all requests rejected
+static bool sensorRequestPending = FALSE;			// Sensor state request waiting the notify (Sensor keeps only the last one)
 
 
 /**
@@ -76,16 +74,10 @@ static struct timespec lastSensorNonce; // Nonce of the last Sensor request (the
  */
 
 static bool setRoute(nodeId source,routeId requestedRouteId) {
-	// Search for the requested route
-	pCurrentNodeState->pCurrentRoute = NULL;
-	
-	for (uint32_t i=0; i < pCurrentNodeState->numRoutes ; i++ ) {
-		 // If found set it and return TRUE
-		if (pCurrentNodeState->pRouteList[i].id == requestedRouteId) {
-			pCurrentNodeState->pCurrentRoute = &(pCurrentNodeState->pRouteList[i]);
-			return TRUE;
-		}
-	}
+	// Search for the requested route (index built with the configuration)
+	pCurrentNodeState->pCurrentRoute = routeIndexFind(&pCurrentNodeState->routeIndex, requestedRouteId);
+	if (pCurrentNodeState->pCurrentRoute)
+		return TRUE;
 		
 	// Not found, return FALSE
 	syslog(LOG_ERR, "Requested route id (%i) not found", requestedRouteId);
@@ -96,20 +88,66 @@ static bool setRoute(nodeId source,routeId requestedRouteId) {
 
 static eNodePosition findPosition(routeId requestedRouteId) {
 	// Search for the requested route
-	route *pCurrentRoute = pCurrentNodeState->pRouteList;
+	route *pRoute = routeIndexFind(&pCurrentNodeState->routeIndex, requestedRouteId);
 	
-	for (uint32_t i=0; i < pCurrentNodeState->numRoutes ; i++ ) {
-		 // If found return position
-		if (pCurrentRoute[i].id == requestedRouteId) {
-			return pCurrentRoute[i].position;
-		}
-	}
+	// If found return position
+	if (pRoute)
+		return pRoute->position;
 		
 	// Not found, return NODEPOS_UNDEFINED
 	syslog(LOG_ERR, "Requested route id (%i) not found", requestedRouteId);
 	return NODEPOS_UNDEFINED;
 }
 
+/**
+ * Sectional release: the train cleared the route up to a track circuit, the elements behind it are told
+ * (the previous node in the chain, the members before the source in star mode)
+ * @param pSource: node the release comes from (NULL if cleared by this node)
+ */
+static void routeRelease(const nodeId *pSource) {
+	message message;
+	message.iHeader.type = IMSGTYPE_ROUTERELEASE;
+	message.routeIRelease.requestRouteId = pCurrentNodeState->pCurrentRoute->id;
+	
+	// Star mode: the members up to the source
+	if (pContext->pMembers) {
+		for (uint32_t i = 0; pSource && i < pContext->pMembers->numMembers && nodecmp(pContext->pMembers->members[i], *pSource); i++) {
+			message.routeIRelease.destination = pContext->pMembers->members[i];
+			msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteRELEASE));
+		}
+		return;
+	}
+	
+	// First node: nothing behind
+	if (pCurrentNodeState->pCurrentRoute->position == NODEPOS_FIRST)
+		return;
+	
+	message.routeIRelease.destination = pCurrentNodeState->pCurrentRoute->prev;
+	
+	// Log
+	nodeId *destNode = &(pCurrentNodeState->pCurrentRoute->prev);
+	syslog(LOG_INFO, "Route request (%i) released sending RELEASE to previous node (%d.%d.%d.%d)", pCurrentNodeState->pCurrentRoute->id, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);
+	
+	//Send to dixlCommTx task queue
+	msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteRELEASE));
+}
+
+// Released by a track circuit ahead still waiting for the train: the Sensor missed it, the node would stay locked
+static void routeReleased(message *pInMessage) {
+	syslog(LOG_WARNING, "Route request (%i) RELEASE received: the train went through unseen by the SENSOR, released", pCurrentNodeState->pCurrentRoute->id);
+	logger_log(LOGTYPE_FREED, pCurrentNodeState->pCurrentRoute->id, pInMessage->header.source);
+	
+	routeRelease(&pInMessage->header.source);
+}
+
+// Cleared by the train: time the node stayed locked after it (from the Sensor change, same node clock)
+static void routeCleared(message *pInMessage) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int msLocked = (int) (time_timespecdiff(&now, &pInMessage->sensorINOTIFY.changedAt) * 1000);
+	syslog(LOG_INFO, "Route request (%i) SENSOR OFF received: locked %i ms after the train cleared it", pCurrentNodeState->pCurrentRoute->id, msLocked);
+}
+
 /**
  * Common functions
  * 
@@ -123,6 +161,7 @@ static void rejectRouteRequest(message *pInMessage) {
 	message message;
 	size_t size = sizeof(msgIHeader);
 	routeId requestedRouteId = pInMessage->routeReq.requestRouteId;
+	msgTrace trace = { 0 };
 
 	// Reply DISAGREE only to route request
 	switch (pInMessage->header.type) {
@@ -155,6 +194,10 @@ static void rejectRouteRequest(message *pInMessage) {
 				syslog(LOG_INFO, "Sending NACK for route (%i) to node (%d.%d.%d.%d)", pInMessage->routeReq.requestRouteId, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);			
 			}		
 						
+			// Traced request: the reply carries the trace back
+			trace_Processed(pInMessage, &trace);
+			trace_Attach(&message, &trace);
+			
 			//Send to dixlCommTx task queue
 			msgQ_Send(msgQCommTxId, (char *) &message, size);
 			break;
@@ -166,10 +209,127 @@ static void rejectRouteRequest(message *pInMessage) {
 }
 
 /**
- *  Forward functions definitions 
+ * Route contexts
+ */
+// Context of a route in progress (or NULL)
+static routeContext *context_find(routeId requestedRouteId) {
+	for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+		if (contexts[i].used && contexts[i].pRoute && contexts[i].pRoute->id == requestedRouteId)
+			return &contexts[i];
+	return NULL;
+}
+
+// Serve the next event in the context: its route is the current one
+static void context_select(routeContext *pRouteContext) {
+	pContext = pRouteContext;
+	pCurrentNodeState->pCurrentRoute = pRouteContext->pRoute;
+}
+
+// Check the route against the routes in progress (CTRLROUTECONFLICT rule: a track circuit holds one train)
+static bool context_conflict(const route *pRoute) {
+	for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+		if (contexts[i].used && CTRLROUTECONFLICT != CTRLCONFLICTNONE)
+			return TRUE;
+	return FALSE;
+}
+
+// A new context can serve the route now: not already in progress, no conflicts, a free context
+static bool context_admissible(const route *pRoute) {
+	bool free = FALSE;
+	for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+		free = free || !contexts[i].used;
+	return free && !context_find(pRoute->id) && !context_conflict(pRoute);
+}
+
+// Wait a reply from the neighbour (star mode: from all the members): timeout from the round-trip times
+static void context_wait(eventData *pEventData, nodeId neighbour, eRttExchange exchange) {
+	int msTimeout = ctrlRtt_Timeout(neighbour, exchange);
+	for (uint32_t i = 0; pContext->pMembers && i < pContext->pMembers->numMembers; i++) {
+		int msMember = ctrlRtt_Timeout(pContext->pMembers->members[i], exchange);
+		msTimeout = (msMember > msTimeout) ? msMember : msTimeout;
+	}
+	// The AGREE comes back after the downstream points are moved: not less than their travel time
+	if (exchange == RTTEXCHANGE_COMMITAGREE) {
+		int msTravel = CTRLRTTMINTIMEOUT + TASKPOINTTRANSTIME * pContext->pointsToMove;
+		msTimeout = (msTravel > msTimeout) ? msTravel : msTimeout;
+	}
+	pContext->rttExchange = exchange;
+	clock_gettime(CLOCK_MONOTONIC, &pContext->rttSentAt);
+	timer_Arm(pEventData->pTimer, msTimeout);
+}
+
+// Route trace (if traced) attached to a route message to send
+static void context_trace(message *pMessage) {
+	trace_Attach(pMessage, &pContext->trace);
+}
+
+// Star mode: send REQ, COMMIT or DISAGREE to all the members at once (the internal ROUTE messages share the layout)
+static void context_broadcast(eMsgType type) {
+	message message;
+	message.iHeader.type = type;
+	message.routeIReq.requestRouteId = pCurrentNodeState->pCurrentRoute->id;
+	for (uint32_t i = 0; i < pContext->pMembers->numMembers; i++) {
+		message.routeIReq.destination = pContext->pMembers->members[i];
+		context_trace(&message);
+		msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteREQ));
+	}
+}
+
+// DISAGREE from the previous node (or the host, giving up a batch): the route is released upstream
+static bool context_releasedUpstream(message *pInMessage) {
+	return pInMessage->header.type == MSGTYPE_ROUTEDISAGREE && !nodecmp(pInMessage->header.source, pCurrentNodeState->pCurrentRoute->prev);
+}
+
+// Released upstream: DISAGREE forwarded to the next node (star mode: already sent to all the members)
+static void context_forwardDisagree() {
+	if (pContext->pMembers || pCurrentNodeState->pCurrentRoute->position == NODEPOS_LAST)
+		return;
+
+	message message;
+	message.iHeader.type = IMSGTYPE_ROUTEDISAGREE;
+	message.routeIDisagree.destination = pCurrentNodeState->pCurrentRoute->next;
+	message.routeIDisagree.requestRouteId = pCurrentNodeState->pCurrentRoute->id;
+
+	// Log
+	nodeId *destNode = &(pCurrentNodeState->pCurrentRoute->next);
+	syslog(LOG_INFO, "Route (%i) released upstream forwarding DISAGREE to next node (%d.%d.%d.%d)", pCurrentNodeState->pCurrentRoute->id, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);
+	logger_log(LOGTYPE_DISAGREE, pCurrentNodeState->pCurrentRoute->id, NodeNULL );
+
+	//Send to dixlCommTx task queue
+	context_trace(&message);
+	msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteDISAGREE));
+}
+
+/**
+ * Sensor requests
  */
-static void FSMEvent_Internal(eStates newState, eventData *pEventData);
-static void StateEngine();
+// Request to be notified when Sensor reaches the state
+static void sensorRequest(eSensorState requestedState) {
+	message message;
+	memset(&message, 0,sizeof(message));
+	size_t size = sizeof(msgIHeader);
+	message.iHeader.type = IMSGTYPE_SENSORSTATE;
+	message.sensorIPOS.requestedState = requestedState;
+	clock_gettime(CLOCK_REALTIME, &pContext->lastSensorNonce);
+	message.sensorIPOS.requestTimestamp = pContext->lastSensorNonce;	
+	size += sizeof(msgISensorSTATE);
+	
+	// Log
+	syslog(LOG_INFO, "Route request (%i) waiting for SENSOR %s with nonce %i", pCurrentNodeState->pCurrentRoute->id, sensorStateStr(requestedState), pContext->lastSensorNonce);			
+
+	//Send to dixlSensor task queue
+	msgQ_Send(msgQSensorId, (char *) &message, size);	
+	sensorRequestPending = TRUE;
+}
+
+// Sensor keeps only the last request: once it's notified, request again for a route still waiting
+static void requestsResend() {
+	for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+		if (contexts[i].used && !sensorRequestPending && (contexts[i].FSM.currentState == StateReserved || contexts[i].FSM.currentState == StateTrainInTransition)) {
+			context_select(&contexts[i]);
+			sensorRequest(contexts[i].FSM.currentState == StateReserved ? SENSORSTATE_ON : SENSORSTATE_OFF);
+		}
+}
 
 /**
  * STATENOTRESERVED
@@ -182,10 +342,9 @@ static void NotReservedEntry(eventData *pEventData) {
 	syslog(LOG_INFO, "Request cleaned");
 	logger_log(LOGTYPE_NOTRESERVED, 0, NodeNULL);
 	
-	// Reset timeout
+	// Cancel timeout
 	if (pEventData) {
-		pEventData->deadline->tv_sec = 0;	
-		pEventData->deadline->tv_nsec = 0;		
+		timer_Cancel(pEventData->pTimer);
 	}
 }
 static void NotReservedState(eventData *pEventData) {
@@ -215,6 +374,15 @@ static void NotReservedExit(eventData *pEventData) {
  * STATEWAITACK
  */
 static void WaitAckEntry(eventData *pEventData) {
+	// Star mode: REQ to all the members, their votes collected in this state
+	if (pContext->pMembers) {
+		pContext->votes = 0;
+		context_broadcast(IMSGTYPE_ROUTEREQ);
+		syslog(LOG_INFO, "Route request (%i) coordinated: REQ sent to %i members", pCurrentNodeState->pCurrentRoute->id, pContext->pMembers->numMembers);
+		context_wait(pEventData, pContext->pMembers->members[0], RTTEXCHANGE_REQACK);
+		return;
+	}
+	
 	// Prepare IROUTEREQ message for dixlCommTx
 	message message;
 	message.iHeader.type = IMSGTYPE_ROUTEREQ;
@@ -224,11 +392,11 @@ static void WaitAckEntry(eventData *pEventData) {
 	message.routeIReq.requestRouteId = pCurrentNodeState->pCurrentRoute->id;
 		
 	//Send to dixlCommTx task queue
+	context_trace(&message);
 	msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteREQ));
 	
-	// Set timeout
-	clock_gettime(CLOCK_REALTIME, pEventData->deadline);	
-	time_timespectimeout(pEventData->deadline, COMMMSGTIMEOUT);	
+	// Set timeout (adaptive)
+	context_wait(pEventData, pCurrentNodeState->pCurrentRoute->next, RTTEXCHANGE_REQACK);
 }
 static void WaitAckState(eventData *pEventData) {
 }
@@ -240,6 +408,14 @@ static void WaitAckExit(eventData *pEventData) {
 	if (pInMessage->header.type == IMSGTYPE_DIAGERRCOMM || pInMessage->header.type == IMSGTYPE_DIAGERRTASK)
 		return;	
 
+	// Star mode: not all the members ACKed (NACK or timeout), the others are released
+	if (pContext->pMembers && pInMessage->header.type != MSGTYPE_ROUTEACK)
+		context_broadcast(IMSGTYPE_ROUTEDISAGREE);
+	
+	// Released upstream before the ACK (e.g. a batch the host gave up): the next nodes too
+	if (context_releasedUpstream(pInMessage))
+		context_forwardDisagree();
+
 	// If exit due to NACK, send back to prev node
 	if (pInMessage->header.type == MSGTYPE_ROUTENACK) {
 		// Prepare  message for prev node
@@ -270,6 +446,7 @@ static void WaitAckExit(eventData *pEventData) {
 		}
 		
 		//Send to dixlCommTx task queue
+		context_trace(&message);
 		msgQ_Send(msgQCommTxId, (char *) &message, size);
 	}
 }
@@ -287,17 +464,18 @@ static void WaitCommitEntry(eventData *pEventData) {
 	// Send ACK to prev node
 	message.routeIAck.destination = pCurrentNodeState->pCurrentRoute->prev;
 	message.routeIAck.requestRouteId = pCurrentNodeState->pCurrentRoute->id;
+	message.routeIAck.points = pContext->pointsToMove;
 
 	// Log
 	nodeId *destNode = &(pCurrentNodeState->pCurrentRoute->prev);
 	syslog(LOG_INFO, "Route request (%i) ACKed sending back ACK to previous node", pCurrentNodeState->pCurrentRoute->id, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);
 	
 	//Send to dixlCommTx task queue	
+	context_trace(&message);
 	msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteACK));
 	
-	// Set timeout
-	clock_gettime(CLOCK_REALTIME, pEventData->deadline);	
-	time_timespectimeout(pEventData->deadline, COMMMSGTIMEOUT);	
+	// Set timeout (adaptive)
+	context_wait(pEventData, pCurrentNodeState->pCurrentRoute->prev, RTTEXCHANGE_ACKCOMMIT);
 }
 static void WaitCommitExit(eventData *pEventData) {
 	// Get original message
@@ -307,6 +485,16 @@ static void WaitCommitExit(eventData *pEventData) {
 	if (pInMessage->header.type == IMSGTYPE_DIAGERRCOMM || pInMessage->header.type == IMSGTYPE_DIAGERRTASK)
 		return;	
 
+	// Batch route (first node): no COMMIT from the host (DISAGREE or timeout), the next nodes are released
+	if (pCurrentNodeState->pCurrentRoute->position == NODEPOS_FIRST) {
+		if (pInMessage->header.type != MSGTYPE_ROUTECOMMIT) {
+			if (pContext->pMembers)
+				context_broadcast(IMSGTYPE_ROUTEDISAGREE);
+			context_forwardDisagree();
+		}
+		return;
+	}
+
 	// If exit due to DISAGREE, forward to next node (if present)
 	if (pInMessage->header.type == MSGTYPE_ROUTEDISAGREE) {
 		
@@ -325,6 +513,7 @@ static void WaitCommitExit(eventData *pEventData) {
 			syslog(LOG_INFO, "Received DISAGREE for route (%i) forwarding DISAGREE to next node (%d.%d.%d.%d)", pCurrentNodeState->pCurrentRoute->id, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);
 		
 			//Send to dixlCommTx task queue
+			context_trace(&message);
 			msgQ_Send(msgQCommTxId, (char *) &message, size);
 		} else 
 			// Log
@@ -339,6 +528,15 @@ static void WaitCommitExit(eventData *pEventData) {
  * STATEWAITAGREE
  */
 static void WaitAgreeEntry(eventData *pEventData) {
+	// Star mode: COMMIT to all the members, their votes collected in this state
+	if (pContext->pMembers) {
+		pContext->votes = 0;
+		context_broadcast(IMSGTYPE_ROUTECOMMIT);
+		syslog(LOG_INFO, "Route request (%i) coordinated: COMMIT sent to %i members", pCurrentNodeState->pCurrentRoute->id, pContext->pMembers->numMembers);
+		context_wait(pEventData, pContext->pMembers->members[0], RTTEXCHANGE_COMMITAGREE);
+		return;
+	}
+	
 	// Prepare IROUTECOMMIT message for dixlCommTx
 	message message;
 	message.iHeader.type = IMSGTYPE_ROUTECOMMIT;
@@ -352,11 +550,11 @@ static void WaitAgreeEntry(eventData *pEventData) {
 	syslog(LOG_INFO, "Route request (%i) COMMITed forwarding COMMIT to next node (%d.%d.%d.%d)", pCurrentNodeState->pCurrentRoute->id, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);
 	
 	//Send to dixlCommTx task queue
+	context_trace(&message);
 	msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteCOMMIT));
 	
-	// Set timeout
-	clock_gettime(CLOCK_REALTIME, pEventData->deadline);	
-	time_timespectimeout(pEventData->deadline, COMMMSGTIMEOUT);	
+	// Set timeout (adaptive)
+	context_wait(pEventData, pCurrentNodeState->pCurrentRoute->next, RTTEXCHANGE_COMMITAGREE);
 }
 static void WaitAgreeState(eventData *pEventData) {
 }
@@ -368,6 +566,16 @@ static void WaitAgreeExit(eventData *pEventData) {
 	if (pInMessage->header.type == IMSGTYPE_DIAGERRCOMM || pInMessage->header.type == IMSGTYPE_DIAGERRTASK)
 		return;	
 
+	// Star mode: not all the members AGREEed (DISAGREE or timeout), the others are released
+	if (pContext->pMembers && pInMessage->header.type != MSGTYPE_ROUTEAGREE)
+		context_broadcast(IMSGTYPE_ROUTEDISAGREE);
+	
+	// Released upstream before the AGREE (e.g. a batch the host gave up): the next nodes too, nothing sent back
+	if (context_releasedUpstream(pInMessage)) {
+		context_forwardDisagree();
+		return;
+	}
+
 	// If exit due to DISAGREE, send back to prev node (if present)
 	if (pInMessage->header.type == MSGTYPE_ROUTEDISAGREE) {
 		// Prepare  message for prev node
@@ -399,6 +607,7 @@ static void WaitAgreeExit(eventData *pEventData) {
 		logger_log(LOGTYPE_DISAGREE, pCurrentNodeState->pCurrentRoute->id, NodeNULL );
 		
 		//Send to dixlCommTx task queue
+		context_trace(&message);
 		msgQ_Send(msgQCommTxId, (char *) &message, size);
 	}
 }
@@ -444,26 +653,14 @@ static void ReservedEntry(eventData *pEventData) {
 	logger_log(LOGTYPE_RESERVED, pCurrentNodeState->pCurrentRoute->id, NodeNULL );			
 
 	//Send to dixlCommTx task queue
+	context_trace(&message);
 	msgQ_Send(msgQCommTxId, (char *) &message, size);	
 	
-	// Prepare  message to request state to Sensor task	
-	memset(&message, 0,sizeof(message));
-	size = sizeof(msgIHeader);
-	message.iHeader.type = IMSGTYPE_SENSORSTATE;
-	message.sensorIPOS.requestedState = SENSORSTATE_ON;
-	clock_gettime(CLOCK_REALTIME, &lastSensorNonce);
-	message.pointIPosition.requestTimestamp = lastSensorNonce;	
-	size += sizeof(msgISensorSTATE);
+	// Request state to Sensor task	
+	sensorRequest(SENSORSTATE_ON);
 	
-	// Log
-	syslog(LOG_INFO, "Route request (%i) waiting for SENSOR ON with nonce %i", pCurrentNodeState->pCurrentRoute->id, lastSensorNonce);			
-
-	//Send to dixlSensor task queue
-	msgQ_Send(msgQSensorId, (char *) &message, size);	
-	
-	// Reset timeout
-	pEventData->deadline->tv_sec = 0;	
-	pEventData->deadline->tv_nsec = 0;		
+	// Cancel timeout
+	timer_Cancel(pEventData->pTimer);
 }
 static void ReservedState(eventData *pEventData) {
 }
@@ -475,14 +672,23 @@ static void ReservedExit(eventData *pEventData) {
 	if (pInMessage->header.type == IMSGTYPE_DIAGERRCOMM || pInMessage->header.type == IMSGTYPE_DIAGERRTASK)
 		return;	
 
+	// Released by a track circuit ahead
+	if (pInMessage->header.type == MSGTYPE_ROUTERELEASE) {
+		routeReleased(pInMessage);
+		return;
+	}
+
 	// If exit due to DISAGREE, forward to next node (if present)
 	if (pInMessage->header.type == MSGTYPE_ROUTEDISAGREE) {
 		// Prepare  message for prev node
 		message message;
 		size_t size = sizeof(msgIHeader);
 		
+		// Star mode: the coordinator releases all the members
+		if (pContext->pMembers)
+			context_broadcast(IMSGTYPE_ROUTEDISAGREE);
 		// Not last node? Send to next node
-		if (pCurrentNodeState->pCurrentRoute->position != NODEPOS_LAST) {
+		else if (pCurrentNodeState->pCurrentRoute->position != NODEPOS_LAST) {
 			message.iHeader.type = IMSGTYPE_ROUTEDISAGREE;
 			message.routeIDisagree.destination = pCurrentNodeState->pCurrentRoute->next;
 			message.routeIDisagree.requestRouteId = pCurrentNodeState->pCurrentRoute->id;
@@ -493,6 +699,7 @@ static void ReservedExit(eventData *pEventData) {
 			syslog(LOG_INFO, "Received DISAGREE for route (%i) forwarding DISAGREE to next node (%d.%d.%d.%d)", pCurrentNodeState->pCurrentRoute->id, destNode->bytes[0], destNode->bytes[1], destNode->bytes[2], destNode->bytes[3]);
 
 			//Send to dixlCommTx task queue
+			context_trace(&message);
 			msgQ_Send(msgQCommTxId, (char *) &message, size);
 		} else 
 			// Log
@@ -510,24 +717,11 @@ static void TrainInTransitionEntry(eventData *pEventData) {
 	// Log
 	syslog(LOG_INFO, "Route request (%i) TRAIN IS GOING THROUGH", pCurrentNodeState->pCurrentRoute->id);
 	
-	// Prepare  message to request state to Sensor task	
-	message message;
-	size_t size = sizeof(msgIHeader);
-	message.iHeader.type = IMSGTYPE_SENSORSTATE;
-	message.sensorIPOS.requestedState = SENSORSTATE_OFF;
-	clock_gettime(CLOCK_REALTIME, &lastSensorNonce);
-	message.pointIPosition.requestTimestamp = lastSensorNonce;	
-	size += sizeof(msgISensorSTATE);
-	
-	// Log
-	syslog(LOG_INFO, "Route request (%i) waiting for SENSOR OFF with nonce %i", pCurrentNodeState->pCurrentRoute->id, lastSensorNonce);					
+	// Request state to Sensor task	
+	sensorRequest(SENSORSTATE_OFF);
 
-	//Send to dixlSensor task queue
-	msgQ_Send(msgQSensorId, (char *) &message, size);		
-
-	// Reset timeout
-	pEventData->deadline->tv_sec = 0;	
-	pEventData->deadline->tv_nsec = 0;	
+	// Cancel timeout
+	timer_Cancel(pEventData->pTimer);
 }
 static void TrainInTransitionState(eventData *pEventData) {
 }
@@ -539,8 +733,9 @@ static void TrainInTransitionExit(eventData *pEventData) {
 	if (pInMessage->header.type == IMSGTYPE_DIAGERRCOMM || pInMessage->header.type == IMSGTYPE_DIAGERRTASK)
 		return;	
 
-	// Log
-	syslog(LOG_INFO, "Route request (%i) SENSOR OFF received", pCurrentNodeState->pCurrentRoute->id);
+	// Track circuit cleared: elements behind the train told
+	routeCleared(pInMessage);
+	routeRelease(NULL);
 }
 
 
@@ -550,10 +745,10 @@ static void TrainInTransitionExit(eventData *pEventData) {
 static void FailSafeEntry(eventData *pEventData) {
 	// Log
 	syslog(LOG_ERR, "Node is going in fail-safe mode all subsequent requests will be rejected");
+	nodeFailSafe = TRUE;
 
-	// Reset timeout
-	pEventData->deadline->tv_sec = 0;	
-	pEventData->deadline->tv_nsec = 0;	
+	// Cancel timeout
+	timer_Cancel(pEventData->pTimer);
 }
 static void FailSafeState(eventData *pEventData) {
 	// Reject All reuqests
@@ -568,7 +763,7 @@ static void FailSafeState(eventData *pEventData) {
 	}
 }
 
-static StateMapItem StateMap[] = {
+static const StateMapItem StateMap[] = {
 		// StateDummy
 		{ NULL,						NULL, 					NULL},
 		// StateNotReserved
@@ -587,339 +782,365 @@ static StateMapItem StateMap[] = {
 		{ FailSafeState,			FailSafeEntry,			NULL },		
 };
 
-/* FiniteStateMachine istance object */
-static FiniteStateMachine FSM =  {
-	StateDummy,
-	StateDummy,
-	StateMap,
-	FALSE,
-	NULL
-};
-
 /**
- * STATEDUMMY
+ * Guards
  */
-void FSMCtrlTRACKCIRCUIT(NodeState *pState) {
-	// Get pointer to NodeState
-	pCurrentNodeState = pState;
-	
-	// Force first (Init) State
-	FSM.currentState = StateDummy;	
-	FSMEvent_Internal(StateNotReserved, NULL);
+// Requested route set (route id found) and the node isn't the last one
+static bool guard_routeSetNotLast(eventData *pEventData) {
+	message *pMessage = pEventData->pMessage;
+	return setRoute(pMessage->header.source, pMessage->routeReq.requestRouteId) && pCurrentNodeState->pCurrentRoute->position != NODEPOS_LAST;
+}
 
-	
-	// and process it
-	StateEngine();
-	
-	// Log
-	syslog(LOG_INFO, "FSM initialized");	
+// Requested route set (by the previous guard) and the node is the last one
+static bool guard_routeSetLast(eventData *pEventData) {
+	return pCurrentNodeState->pCurrentRoute && pCurrentNodeState->pCurrentRoute->position == NODEPOS_LAST;
 }
 
-/**
- * The state engine execute until events are generated
- */
-static void StateEngine() {
-    // Temporary pointer to current event data
-	eventData *pDataTemp = NULL;
+// Message for the current requested route
+static bool guard_route(eventData *pEventData) {
+	return pEventData->pMessage->routeAck.requestRouteId == pCurrentNodeState->pCurrentRoute->id;
+}
 
-    // While events are being generated keep executing states
-    while (FSM.eventGenerated) {
+// Message for the current requested route, node in the position
+static bool guard_routeFirst(eventData *pEventData) {
+	return guard_route(pEventData) && pCurrentNodeState->pCurrentRoute->position == NODEPOS_FIRST;
+}
+static bool guard_routeMiddle(eventData *pEventData) {
+	return guard_route(pEventData) && pCurrentNodeState->pCurrentRoute->position == NODEPOS_MIDDLE;
+}
+static bool guard_routeLast(eventData *pEventData) {
+	return guard_route(pEventData) && pCurrentNodeState->pCurrentRoute->position == NODEPOS_LAST;
+}
 
-        // Get the pointers to function
-        StateFunc state = FSM.stateMap[FSM.newState].pStateFunc;
-        EntryFunc entry = FSM.stateMap[FSM.newState].pEntryFunc;
-        ExitFunc exit = FSM.stateMap[FSM.currentState].pExitFunc;
+// Batch route (first node): all the nodes ACKed, the COMMIT is the host one
+static bool guard_routeBatch(eventData *pEventData) {
+	return pContext->batch && guard_routeFirst(pEventData);
+}
 
-        // Copy of event data pointer
-        pDataTemp = FSM.pEventData;
+// Star mode: vote of the member recorded, other members still to reply
+static bool guard_routeVotePending(eventData *pEventData) {
+	if (!pContext->pMembers || !guard_routeFirst(pEventData))
+		return FALSE;
+	for (uint32_t i = 0; i < pContext->pMembers->numMembers; i++)
+		if (!nodecmp(pContext->pMembers->members[i], pEventData->pMessage->header.source))
+			pContext->votes |= (uint32_t) 1 << i;
+	return pContext->votes != (uint32_t) (((uint64_t) 1 << pContext->pMembers->numMembers) - 1);
+}
 
-        // Event data used and resetted
-        FSM.pEventData = NULL;
+// Sensor notify of the last request (nonce match) in the state
+static bool guard_sensor(eventData *pEventData, eSensorState sensorState) {
+	msgISensorNOTIFY *pNotify = &pEventData->pMessage->sensorINOTIFY;
+	return pNotify->currentState == sensorState && pNotify->requestTimestamp.tv_sec == pContext->lastSensorNonce.tv_sec && pNotify->requestTimestamp.tv_nsec == pContext->lastSensorNonce.tv_nsec;
+}
+static bool guard_sensorOn(eventData *pEventData) {
+	return guard_sensor(pEventData, SENSORSTATE_ON);
+}
+static bool guard_sensorOff(eventData *pEventData) {
+	return guard_sensor(pEventData, SENSORSTATE_OFF);
+}
 
-        // Event served and resetted
-        FSM.eventGenerated = FALSE;
+/**
+ * Actions
+ */
+// New route in progress in the context
+static void action_routeStart(eventData *pEventData) {
+	pContext->pRoute = pCurrentNodeState->pCurrentRoute;
+	
+	// Star mode if the node coordinates the route
+	if (pContext->pRoute->position == NODEPOS_FIRST)
+		pContext->pMembers = routeMembersFind(pCurrentNodeState->pMembersList, pCurrentNodeState->numMembersList, pContext->pRoute->id);
+	
+	// Route of a host batch (the flag is set by the node itself, see context_requestBatch)
+	message *pMessage = pEventData->pMessage;
+	pContext->batch = pContext->pRoute->position == NODEPOS_FIRST && pMessage->header.lentgh >= sizeof(msgHeader) + offsetof(msgRouteREQ, trace) && pMessage->routeReq.batch;
+}
 
-		// Transitioning to a new state?
-		if (FSM.newState != FSM.currentState)
-		{
-			// Execute the state exit action on current state before switching to new state
-			if (exit != NULL)
-				exit(pDataTemp);
+// Reply of the neighbour (or member) received: round-trip time sample
+static void action_rttSample(eventData *pEventData) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ctrlRtt_Sample(pEventData->pMessage->header.source, pContext->rttExchange, (int) (time_timespecdiff(&now, &pContext->rttSentAt) * 1000));
+}
 
-			// Execute the state entry action on the new state
-			if (entry != NULL)
-				entry(pDataTemp);
+// ACK received: round-trip time sample and the points still to move downstream
+static void action_routeAck(eventData *pEventData) {
+	action_rttSample(pEventData);
+	if (pEventData->pMessage->routeAck.points > pContext->pointsToMove)
+		pContext->pointsToMove = pEventData->pMessage->routeAck.points;
+}
 
-			// Ensure exit/entry actions didn't call FSMEvent_Internal by accident 
-			assert(FSM.eventGenerated == FALSE);
-		}
+// RELEASE received while the Sensor is still ON (it releases the node): told to the elements behind
+static void action_routeRelease(eventData *pEventData) {
+	syslog(LOG_INFO, "Route request (%i) RELEASE received, SENSOR still ON: forwarding it", pCurrentNodeState->pCurrentRoute->id);
+	routeRelease(&pEventData->pMessage->header.source);
+}
 
-		// Switch to the new current state
-		FSM.currentState = FSM.newState;
+/* Transitions: DIAGERR* in every state send to StateFailSafe, REQ messages get here only in NOT_RESERVED state (a new context) */
+static const TransitionItem Transitions[] = {
+		// state					message type				guard						action				next state
+		{ FSMANYSTATE,				IMSGTYPE_DIAGERRCOMM,		NULL,						NULL,				StateFailSafe },
+		{ FSMANYSTATE,				IMSGTYPE_DIAGERRTASK,		NULL,						NULL,				StateFailSafe },
+		{ StateNotReserved,			MSGTYPE_ROUTEREQ,			guard_routeSetNotLast,		action_routeStart,	StateWaitAck },
+		{ StateNotReserved,			MSGTYPE_ROUTEREQ,			guard_routeSetLast,			action_routeStart,	StateWaitCommit },
+		{ StateWaitAck,				MSGTYPE_ROUTEACK,			guard_routeVotePending,		action_routeAck,	StateWaitAck },
+		{ StateWaitAck,				MSGTYPE_ROUTEACK,			guard_routeBatch,			action_routeAck,	StateWaitCommit },
+		{ StateWaitAck,				MSGTYPE_ROUTEACK,			guard_routeFirst,			action_routeAck,	StateWaitAgree },
+		{ StateWaitAck,				MSGTYPE_ROUTEACK,			guard_routeMiddle,			action_routeAck,	StateWaitCommit },
+		{ StateWaitAck,				MSGTYPE_ROUTENACK,			guard_route,				NULL,				StateNotReserved },
+		{ StateWaitAck,				MSGTYPE_ROUTEDISAGREE,		guard_route,				NULL,				StateNotReserved },
+		{ StateWaitAck,				IMSGTYPE_TIMEOUTNOTIFY,		NULL,						NULL,				StateNotReserved },
+		{ StateWaitCommit,			MSGTYPE_ROUTECOMMIT,		guard_routeFirst,			NULL,				StateWaitAgree },
+		{ StateWaitCommit,			MSGTYPE_ROUTECOMMIT,		guard_routeMiddle,			action_rttSample,	StateWaitAgree },
+		{ StateWaitCommit,			MSGTYPE_ROUTECOMMIT,		guard_routeLast,			action_rttSample,	StateReserved },
+		{ StateWaitCommit,			MSGTYPE_ROUTEDISAGREE,		guard_route,				NULL,				StateNotReserved },
+		{ StateWaitCommit,			IMSGTYPE_TIMEOUTNOTIFY,		NULL,						NULL,				StateNotReserved },
+		{ StateWaitAgree,			MSGTYPE_ROUTEAGREE,			guard_routeVotePending,		action_rttSample,	StateWaitAgree },
+		{ StateWaitAgree,			MSGTYPE_ROUTEAGREE,			guard_route,				action_rttSample,	StateReserved },
+		{ StateWaitAgree,			MSGTYPE_ROUTEDISAGREE,		guard_route,				NULL,				StateNotReserved },
+		{ StateWaitAgree,			IMSGTYPE_TIMEOUTNOTIFY,		NULL,						NULL,				StateNotReserved },
+		{ StateReserved,			IMSGTYPE_SENSORNOTIFY,		guard_sensorOn,				NULL,				StateTrainInTransition },
+		{ StateReserved,			MSGTYPE_ROUTEDISAGREE,		guard_route,				NULL,				StateNotReserved },
+		{ StateReserved,			MSGTYPE_ROUTERELEASE,		guard_route,				NULL,				StateNotReserved },
+		{ StateTrainInTransition,	IMSGTYPE_SENSORNOTIFY,		guard_sensorOff,			NULL,				StateNotReserved },
+		{ StateTrainInTransition,	MSGTYPE_ROUTERELEASE,		guard_route,				action_routeRelease,StateTrainInTransition },
+		{ StateFailSafe,			FSMANYTYPE,					NULL,						NULL,				StateFailSafe },
+};
 
-		// Execute the state action passing in event data
-		assert(state != NULL);
-		state(pDataTemp);
-    }
-}
+/* Lookup table (built by the initialization) */
+static uint8_t Lookup[sizeof(StateMap) / sizeof(StateMap[0])][FSMMSGTYPES];
 
+/* FSM definition (shared by the route contexts) */
+static FSMTable Table = {
+	StateMap,
+	sizeof(StateMap) / sizeof(StateMap[0]),
+	Transitions,
+	sizeof(Transitions) / sizeof(Transitions[0]),
+	Lookup
+};
 
 /**
- * Generates an internal event
- * @param newState: the new state to pass to
- * @param pEventData: pointer to the event data
- */ 
-static void FSMEvent_Internal(eStates newState, eventData *pEventData) {
-    FSM.pEventData = pEventData;
-    FSM.eventGenerated = TRUE;
-    FSM.newState = newState;
+ * STATEDUMMY
+ */
+void FSMCtrlTRACKCIRCUIT(NodeState *pState) {
+	// Get pointer to NodeState
+	pCurrentNodeState = pState;
+	
+	// No routes in progress (each one starts in NotReserved state)
+	for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+		timer_Cancel(&contexts[i].timer);
+	memset(contexts, 0, sizeof(contexts));
+	pContext = NULL;
+	nodeFailSafe = FALSE;
+	sensorRequestPending = FALSE;
+	ctrlPending_Reset(CTRLROUTECONTEXTSMAX);
+	ctrlRtt_Reset();
+	FSM_TableBuild(&Table);
+	NotReservedEntry(NULL);
+	
+	// Log
+	syslog(LOG_INFO, "FSM initialized");	
 }
 
 /**
  * Event Functions
- * Only conditions to go to next state are tested and newstate decided then the StateEngine is executed, that is:
+ * The transition is looked up by current state and message type, then the StateEngine is executed, that is:
  * - currentStateExit
  * - newStateEntry
  * - newState
+ * @param pRouteContext: route context the message is for
  * @param message: message received
- * @param deadline: next deadline or 0
  */
-void FSMCtrlTRACKCIRCUITEvent_NewMessage(message *pMessage, struct timespec *deadline) {	
+static void context_event(routeContext *pRouteContext, message *pMessage) {	
 	
-	// Result of the precondition evaluation to pass to new state
-	bool condition = FALSE;
-	// Event data
+	// Event data (the timer is the route one)
+	context_select(pRouteContext);
 	eventData eventData;
 	eventData.pMessage = pMessage;
-	eventData.deadline = deadline;
-	// New state
-	eStates newState=NULL;
-	
-	// 1) in every state DIAGERR* messagessend to StateFailSafe
-	// 2) in every state except NOT_RESERVED REQ messages are discarded
-	if (pMessage->header.type == IMSGTYPE_DIAGERRCOMM || pMessage->header.type == IMSGTYPE_DIAGERRTASK) {
-		newState = StateFailSafe;
-		condition = TRUE;				
-	} else if (pMessage->header.type == MSGTYPE_ROUTEREQ && FSM.currentState != StateNotReserved) {
+	eventData.pTimer = &pContext->timer;
+	
+	// Should not happen
+	if (pContext->FSM.currentState == StateDummy) {
+		syslog(LOG_ERR, "Wrong state Dummy: message received");
+		taskExit(rcFSM_WRONGSTATE);
+	}
+	
+	// Traced route message: FSM timestamp, the route sends the trace on
+	trace_Processed(pMessage, &pContext->trace);
+	
+	// Transition (if any, else the message is discarded)
+	FSM_Event(&pContext->FSM, pMessage->header.type, &eventData);
+	
+	// Route done (or not started): context free again
+	if (pContext->FSM.currentState == StateNotReserved) {
+		pContext->used = FALSE;
+		pCurrentNodeState->pCurrentRoute = NULL;
+	}
+}
+
+/**
+ * Free context for a new request (NotReserved state)
+ * @return the context or NULL if all in use
+ */
+static routeContext *context_alloc() {
+	for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+		if (!contexts[i].used) {
+			timer_Cancel(&contexts[i].timer);
+			memset(&contexts[i], 0, sizeof(routeContext));
+			timer_Init(&contexts[i].timer, msgQCtrlId, i);
+			contexts[i].used = TRUE;
+			FSM_Reset(&contexts[i].FSM, &Table, StateNotReserved);
+			return &contexts[i];
+		}
+	return NULL;
+}
+
+/**
+ * New route request: a new context if the node isn't in fail-safe, the route isn't already in progress
+ * and it doesn't conflict with the routes in progress. When busy (or older requests are waiting)
+ * it's queued, rejected if the queue is full
+ * @param message: ROUTEREQ message received
+ */
+static void context_request(message *pMessage) {
+	routeId requestedRouteId = pMessage->routeReq.requestRouteId;
+	route *pRoute = routeIndexFind(&pCurrentNodeState->routeIndex, requestedRouteId);
+	routeContext *pRouteContext = NULL;
+	
+	if (nodeFailSafe || (pRoute && context_find(requestedRouteId))) {
 		// SImply reject request
 		rejectRouteRequest(pMessage);
-		condition = FALSE;
-	} else {
-		switch (FSM.currentState) {
-			case StateDummy:
-				// Should not happen
-				syslog(LOG_ERR, "Wrong state Dummy: message received");
-				taskExit(rcFSM_WRONGSTATE);
-				break;
-				
-			case StateNotReserved:
-				// Accept only ROUTEREQ messages, discard others			
-				if (pMessage->header.type == MSGTYPE_ROUTEREQ) {
-					// Set information of the requested route or fail
-					if (!setRoute(pMessage->header.source,pMessage->routeReq.requestRouteId))
-						condition = FALSE;
-					else {
-						// Go to next state depending on node position (in the current requested route)
-						switch (pCurrentNodeState->pCurrentRoute->position) {
-							case NODEPOS_FIRST:
-							case NODEPOS_MIDDLE:
-								newState = StateWaitAck;
-								break;
-								
-							case NODEPOS_LAST:
-								newState = StateWaitCommit;
-								break;
-						}
-						condition = TRUE;
-					}
-				} else {
-					// Discard other messages
-					condition = FALSE;
-				}
-				break;
-				
-			case StateWaitAck:
-				// Accept only current requested route id
-				// Accept only ACK or NACK or TIMEOUT messages, discard others
-				switch (pMessage->header.type) {
-					case MSGTYPE_ROUTEACK:
-						if (pMessage->routeAck.requestRouteId == pCurrentNodeState->pCurrentRoute->id) {
-							// Go to next state depending on node position FIRST or MIDDLE (in the current requested route)
-							switch (pCurrentNodeState->pCurrentRoute->position) {
-								case NODEPOS_FIRST:
-									newState = StateWaitAgree;
-									break;
-									
-								case NODEPOS_MIDDLE:
-									newState = StateWaitCommit;
-									break;
-							}
-							condition = TRUE;
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-					
-					case MSGTYPE_ROUTENACK:
-					case IMSGTYPE_TIMEOUTNOTIFY:
-						if (pMessage->routeNAck.requestRouteId == pCurrentNodeState->pCurrentRoute->id || pMessage->header.type == IMSGTYPE_TIMEOUTNOTIFY) {
-							// Not necessary to test NodePosition
-							// Exit send NACK to prev or TRAINNOK to host
-							newState = StateNotReserved;
-							condition = TRUE;
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-						
-					default:
-						condition = FALSE;
-						break;
-				}						
-				break;
-				
-			case StateWaitCommit:
-				// Accept only current requested route id
-				// Accept only COMMIT or DISAGREE or TIMEOUT messages, discard others
-				switch (pMessage->header.type) {
-					case MSGTYPE_ROUTECOMMIT:
-						if (pMessage->routeCommit.requestRouteId == pCurrentNodeState->pCurrentRoute->id) {
-							// Go to next state depending on node position LAST or MIDDLE (in the current requested route)
-							switch (pCurrentNodeState->pCurrentRoute->position) {
-								case NODEPOS_MIDDLE:
-									newState = StateWaitAgree;
-									break;
-									
-								case NODEPOS_LAST:
-									newState = StateReserved;
-									break;
-							}
-							condition = TRUE;
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-					
-					case MSGTYPE_ROUTEDISAGREE:
-					case IMSGTYPE_TIMEOUTNOTIFY:
-						if (pMessage->routeDisagree.requestRouteId == pCurrentNodeState->pCurrentRoute->id  || pMessage->header.type == IMSGTYPE_TIMEOUTNOTIFY) {
-							// Not necessary to test NodePosition
-							// Exit send DISAGREE to next node if is not last
-							newState = StateNotReserved;
-							condition = TRUE;
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-		
-					default:
-						condition = FALSE;
-						break;
-				}						
-				break;
-				
-			case StateWaitAgree:
-				// Accept only current requested route id
-				// Accept only AGREE or DISAGREE or TIMEOUT messages, discard others
-				switch (pMessage->header.type) {
-					case MSGTYPE_ROUTEAGREE:
-						if (pMessage->routeCommit.requestRouteId == pCurrentNodeState->pCurrentRoute->id) {
-							// Go to Reserved state
-							newState = StateReserved;
-							condition = TRUE;
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-					
-					case MSGTYPE_ROUTEDISAGREE:
-					case IMSGTYPE_TIMEOUTNOTIFY:
-						if (pMessage->routeDisagree.requestRouteId == pCurrentNodeState->pCurrentRoute->id || pMessage->header.type == IMSGTYPE_TIMEOUTNOTIFY) {
-							// Not necessary to test NodePosition
-							// Exit send DISAGREE to prev node or TRAINNOK to host
-							newState = StateNotReserved;
-							condition = TRUE;
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-		
-					default:
-						condition = FALSE;
-						break;
-				}						
-				break;
-				
-			case StateReserved:
-				// Accept only current requested route id (for DISAGREE)
-				// Accept only SENSORON or DISAGREE messages, discard others
-				switch (pMessage->header.type) {
-					// If SENSOR ON received go to state TrainInTransition
-					case IMSGTYPE_SENSORNOTIFY:						
-						if (pMessage->sensorINOTIFY.currentState == SENSORSTATE_ON && pMessage->sensorINOTIFY.requestTimestamp.tv_sec == lastSensorNonce.tv_sec && pMessage->sensorINOTIFY.requestTimestamp.tv_nsec == lastSensorNonce.tv_nsec ) {
-							newState = StateTrainInTransition;
-							condition = TRUE;
-						} else 
-							condition = FALSE;
-						break;
-					
-					case MSGTYPE_ROUTEDISAGREE:
-						if (pMessage->routeDisagree.requestRouteId == pCurrentNodeState->pCurrentRoute->id) {
-							// Not necessary to test NodePosition
-							// Exit send DISAGREE to next node
-							newState = StateNotReserved;
-							condition = TRUE;
-						} else
-							// Discard
-							condition = FALSE;
-						break;
-		
-					default:
-						condition = FALSE;
-						break;
-				}						
-				break;
-				
-			case StateTrainInTransition:
-				// Accept only SENSOROFF
-				if (pMessage->iHeader.type == IMSGTYPE_SENSORNOTIFY && pMessage->sensorINOTIFY.currentState == SENSORSTATE_OFF && pMessage->sensorINOTIFY.requestTimestamp.tv_sec == lastSensorNonce.tv_sec && pMessage->sensorINOTIFY.requestTimestamp.tv_nsec == lastSensorNonce.tv_nsec ) {
-					newState = StateNotReserved;
-					condition = TRUE;
-				} else {
-					// Discard other messages
-					condition = FALSE;
-				}
-				break;
-		
-			case StateFailSafe:
-				// Keep the state
-				newState = StateFailSafe;
-				condition = TRUE;
-				break;
-							
-		}
+		return;
+	}
+	
+	if (pRoute && (ctrlPending_Head() || !context_admissible(pRoute))) {
+		// Wait for the node
+		if (!ctrlPending_Enqueue(pMessage))
+			rejectRouteRequest(pMessage);
+		return;
 	}
+	
+	// Unknown route: rejected by the new context (if any)
+	if (!(pRouteContext = context_alloc())) {
+		rejectRouteRequest(pMessage);
+		return;
+	}
+	
+	context_event(pRouteContext, pMessage);
+}
 
-	// If the condition is passed, the new state is served
-	if (condition) {
-		// Generate the internal event
-		// New state, event data and event flag set only if used
-		FSMEvent_Internal(newState, &eventData);
+/**
+ * Batch route request (host): a route request for each route of the set the node is the first of,
+ * the others are evaluated by their first nodes. Once all its nodes ACKed, a route is ACKed to the host
+ * and waits for the host COMMIT, sent when all the routes of the set are ACKed: nothing is moved
+ * before all the nodes voted. If any is rejected the host releases the others (DISAGREE from upstream
+ * in any state, removed if still queued)
+ * @param message: ROUTEREQBATCH message received
+ */
+static void context_requestBatch(message *pMessage) {
+	uint32_t numRoutes = pMessage->routeReqBatch.numRoutes;
+	const routeId *pRouteIds = (const routeId *) (&pMessage->routeReqBatch + 1);
+	
+	if (numRoutes == 0 || numRoutes > MSG_ROUTEBATCHMAXROUTES || sizeof(msgHeader) + sizeof(msgRouteREQBATCH) + numRoutes * sizeof(routeId) > pMessage->header.lentgh) {
+		syslog(LOG_ERR, "Wrong batch route request (%i routes): discarded", numRoutes);
+		return;
+	}
+	
+	for (uint32_t i = 0; i < numRoutes; i++) {
+		route *pRoute = routeIndexFind(&pCurrentNodeState->routeIndex, pRouteIds[i]);
+		if (!pRoute || pRoute->position != NODEPOS_FIRST)
+			continue;
 		
-		// Process the state change
-		StateEngine();
+		// Served as a single route request
+		message request;
+		request.header = pMessage->header;
+		request.header.type = MSGTYPE_ROUTEREQ;
+		request.header.lentgh = sizeof(msgHeader) + offsetof(msgRouteREQ, trace);
+		request.routeReq.requestRouteId = pRouteIds[i];
+		request.routeReq.batch = TRUE;
+		syslog(LOG_INFO, "Batch route request: route (%i) of %i", pRouteIds[i], numRoutes);
+		context_request(&request);
 	}
 }
 
-// Manage the timeout creating a dummy message
-void FSMCtrlTRACKCIRCUITEvent_TimerExpired(struct timespec *deadline) {
-	// Dummy message
-	message message;
+/**
+ * Queued route requests: admitted in arrival order as soon as the node can serve them,
+ * rejected when expired or the node is in fail-safe
+ */
+static void context_admit() {
+	message *pPending;
+	
+	if (nodeFailSafe) {
+		ctrlPending_RejectAll(rejectRouteRequest);
+		return;
+	}
+	
+	ctrlPending_Expire(rejectRouteRequest);
+	while ((pPending = ctrlPending_Head()) && context_admissible(routeIndexFind(&pCurrentNodeState->routeIndex, pPending->routeReq.requestRouteId))) {
+		message message = *pPending;
+		ctrlPending_Admitted();
+		context_event(context_alloc(), &message);
+	}
+}
+
+/**
+ * Dispatch the message to the route contexts it's for
+ * @param message: message received
+ */
+void FSMCtrlTRACKCIRCUITEvent_NewMessage(message *pMessage) {	
+	bool delivered = FALSE;
+	
+	switch (pMessage->header.type) {
+		// Whole node in fail-safe: every route in progress (or a new context if none)
+		case IMSGTYPE_DIAGERRCOMM:
+		case IMSGTYPE_DIAGERRTASK:
+			for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+				if (contexts[i].used) {
+					context_event(&contexts[i], pMessage);
+					delivered = TRUE;
+				}
+			if (!delivered)
+				context_event(context_alloc(), pMessage);
+			break;
+			
+		// New route
+		case MSGTYPE_ROUTEREQ:
+			context_request(pMessage);
+			break;
+		case MSGTYPE_ROUTEREQBATCH:
+			context_requestBatch(pMessage);
+			break;
+			
+		// Notify: each route checks its own nonce
+		case IMSGTYPE_SENSORNOTIFY:
+			sensorRequestPending = FALSE;
+			for (int i = 0; i < CTRLROUTECONTEXTSMAX; i++)
+				if (contexts[i].used)
+					context_event(&contexts[i], pMessage);
+			break;
+			
+		// Timeout: the route owning the timer (if not re-armed or cancelled meanwhile), the queue (owner CTRLROUTECONTEXTSMAX) is checked below
+		case IMSGTYPE_TIMEOUTNOTIFY:
+			if (pMessage->timeoutNotify.owner < CTRLROUTECONTEXTSMAX && contexts[pMessage->timeoutNotify.owner].used && timer_IsCurrent(&contexts[pMessage->timeoutNotify.owner].timer, pMessage))
+				context_event(&contexts[pMessage->timeoutNotify.owner], pMessage);
+			break;
+			
+		// Route messages: the route in progress with the same id (others discarded)
+		default: {
+			routeContext *pRouteContext = context_find(pMessage->routeReq.requestRouteId);
+			if (pRouteContext)
+				context_event(pRouteContext, pMessage);
+			
+			// Released (by the host) while still queued: never admitted
+			else if (pMessage->header.type == MSGTYPE_ROUTEDISAGREE)
+				ctrlPending_Remove(pMessage->routeDisagree.requestRouteId);
+			break;
+		}
+	}
 	
-	// Prepare the message
-	message.iHeader.type = IMSGTYPE_TIMEOUTNOTIFY;
+	// Queued route requests admitted (or expired), requests superseded by other routes sent again
+	context_admit();
+	requestsResend();
 	
-	// Call the message handler
-	FSMCtrlTRACKCIRCUITEvent_NewMessage(&message, deadline);	
+	// Timer for the oldest queued request
+	ctrlPending_Timer();
 }
 
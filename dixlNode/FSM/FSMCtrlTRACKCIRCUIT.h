@@ -25,16 +25,8 @@ void FSMCtrlTRACKCIRCUIT();
  */
 /**
  * Notify a new message Event
- * @param message: pointer to the message received
- * @param deadline: next deadline or 0
+ * @param message: pointer to the message received (timeouts are IMSGTYPE_TIMEOUTNOTIFY messages)
  */
-void FSMCtrlTRACKCIRCUITEvent_NewMessage(message *message, struct timespec *deadline);
-
-/**
- * Notify the timer is expired
- * @param message: pointer to the message received
- * @param deadline: next deadline or 0
- */
-void FSMCtrlTRACKCIRCUITEvent_TimerExpired(struct timespec *deadline);
+void FSMCtrlTRACKCIRCUITEvent_NewMessage(message *message);
 
 #endif /* FSMCTRLTC_H_ */
@@ -0,0 +1,117 @@
+/**
+ * FSMEngine.c
+ * 
+ * Finite State Machine engine shared by the FSMs
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+/* includes */
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "FSMEngine.h"
+
+/* FUNCTIONS helpers */
+void FSM_TableBuild(FSMTable *pTable) {
+	memset(pTable->lookup, 0, pTable->numStates * sizeof(*pTable->lookup));
+	
+	// First matching row wins (rows in table order)
+	for (int i = 0; i < pTable->numTransitions; i++) {
+		const TransitionItem *pItem = &pTable->transitions[i];
+		assert(pItem->nextState < pTable->numStates);
+		for (int state = 0; state < pTable->numStates; state++) {
+			if (pItem->state != FSMANYSTATE && pItem->state != state)
+				continue;
+			for (int type = 0; type < FSMMSGTYPES; type++)
+				if ((pItem->msgType == FSMANYTYPE || pItem->msgType == type) && !pTable->lookup[state][type])
+					pTable->lookup[state][type] = i + 1;
+		}
+	}
+}
+
+void FSM_Reset(FiniteStateMachine *pFSM, const FSMTable *pTable, uint8_t state) {
+	pFSM->newState = state;
+	pFSM->currentState = state;
+	pFSM->pTable = pTable;
+	pFSM->eventGenerated = false;
+	pFSM->pEventData = NULL;
+}
+
+void FSM_Internal(FiniteStateMachine *pFSM, uint8_t newState, eventData *pEventData) {
+    pFSM->pEventData = pEventData;
+    pFSM->eventGenerated = true;
+    pFSM->newState = newState;
+}
+
+void FSM_Engine(FiniteStateMachine *pFSM) {
+    // Temporary pointer to current event data
+	eventData *pDataTemp = NULL;
+	const StateMapItem *stateMap = pFSM->pTable->stateMap;
+
+    // While events are being generated keep executing states
+    while (pFSM->eventGenerated) {
+
+        // Get the pointers to function
+        StateFunc state = stateMap[pFSM->newState].pStateFunc;
+        EntryFunc entry = stateMap[pFSM->newState].pEntryFunc;
+        ExitFunc exit = stateMap[pFSM->currentState].pExitFunc;
+
+        // Copy of event data pointer
+        pDataTemp = pFSM->pEventData;
+
+        // Event data used and resetted
+        pFSM->pEventData = NULL;
+
+        // Event served and resetted
+        pFSM->eventGenerated = false;
+
+		// Transitioning to a new state?
+		if (pFSM->newState != pFSM->currentState)
+		{
+			// Execute the state exit action on current state before switching to new state
+			if (exit != NULL)
+				exit(pDataTemp);
+
+			// Execute the state entry action on the new state
+			if (entry != NULL)
+				entry(pDataTemp);
+
+			// Ensure exit/entry actions didn't call FSM_Internal by accident 
+			assert(pFSM->eventGenerated == false);
+		}
+
+		// Switch to the new current state
+		pFSM->currentState = pFSM->newState;
+
+		// Execute the state action passing in event data
+		assert(state != NULL);
+		state(pDataTemp);
+    }
+}
+
+bool FSM_Event(FiniteStateMachine *pFSM, uint8_t msgType, eventData *pEventData) {
+	const FSMTable *pTable = pFSM->pTable;
+	int first = pTable->lookup[pFSM->currentState][msgType];
+	
+	// No transition: discard
+	if (!first)
+		return false;
+	
+	// Try the rows with the same state and message type until a guard passes
+	const TransitionItem *pFirst = &pTable->transitions[first - 1];
+	for (const TransitionItem *pItem = pFirst; pItem < pTable->transitions + pTable->numTransitions && pItem->state == pFirst->state && pItem->msgType == pFirst->msgType; pItem++) {
+		if (pItem->pGuardFunc && !pItem->pGuardFunc(pEventData))
+			continue;
+		
+		// Action, then the new state is served
+		if (pItem->pActionFunc)
+			pItem->pActionFunc(pEventData);
+		FSM_Internal(pFSM, pItem->nextState, pEventData);
+		FSM_Engine(pFSM);
+		return true;
+	}
+	return false;
+}
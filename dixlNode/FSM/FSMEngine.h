@@ -0,0 +1,117 @@
+/**
+ * FSMEngine.h
+ * 
+ * Finite State Machine engine shared by the FSMs: states (entry, state and exit functions)
+ * and a const transition table (state, message type) -> (guard, action, next state)
+ * looked up directly by current state and message type
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#ifndef FSMENGINE_H_
+#define FSMENGINE_H_
+/* includes (no VxWorks ones: the engine builds on any host) */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Defines */
+#define FSMSTATEDUMMY		0			// State 0 of every FSM: before the initialization
+#define FSMANYSTATE			0xFF		// Transition valid in every state
+#define FSMANYTYPE			0xFF		// Transition valid for every message type
+#define FSMMSGTYPES			256			// Message types (lookup table columns)
+
+/* Types */
+struct message;
+struct timerItem;
+
+typedef struct eventData {
+	struct message *pMessage;
+	struct timerItem *pTimer;		// Timeout timer (armed by the states waiting a message)
+} eventData;
+
+typedef void (*StateFunc)(eventData *pEventData);
+typedef void (*EntryFunc)(eventData *pEventData);
+typedef void (*ExitFunc)(eventData *pEventData);
+typedef bool (*GuardFunc)(eventData *pEventData);
+typedef void (*ActionFunc)(eventData *pEventData);
+
+typedef struct StateMapItem {
+	StateFunc pStateFunc;
+	EntryFunc pEntryFunc;
+	ExitFunc pExitFunc;
+} StateMapItem;
+
+/**
+ * Transition: in state, on message type, if the guard passes (NULL = always)
+ * the action is executed (NULL = none) and the FSM goes to the next state.
+ * The first row matching the state and the message type is the one looked up (wildcard rows too):
+ * if its guard fails the following rows with the same state and message type are tried
+ */
+typedef struct TransitionItem {
+	uint8_t state;					// State (or FSMANYSTATE)
+	uint8_t msgType;				// Message type (or FSMANYTYPE)
+	GuardFunc pGuardFunc;			// Condition to pass to next state
+	ActionFunc pActionFunc;			// Executed before leaving the state
+	uint8_t nextState;				// State to pass to
+} TransitionItem;
+
+/* FSM definition (one for all the machines of the same kind) */
+typedef struct FSMTable {
+	const StateMapItem *stateMap;				// Map to function for each state
+	uint8_t numStates;							// Number of states (StateMap items)
+	const TransitionItem *transitions;			// Transitions
+	uint8_t numTransitions;						// Number of transitions
+	uint8_t (*lookup)[FSMMSGTYPES];				// First transition + 1 (0 = none) by state and message type
+} FSMTable;
+
+/* Machine Instance */
+typedef struct FiniteStateMachine {
+	uint8_t newState;				// New state to pass to
+	uint8_t currentState;			// Current state
+	const FSMTable *pTable;			// States and transitions
+	bool eventGenerated;			// An event occured and hasn't been served
+	eventData *pEventData;			// Point to current event Data
+} FiniteStateMachine;
+
+/*
+ * Public functions
+ */
+/**
+ * Build the lookup table from the transitions (once, before any event)
+ * @param pTable: FSM definition (lookup sized numStates x FSMMSGTYPES)
+ */
+void FSM_TableBuild(FSMTable *pTable);
+
+/**
+ * Set the machine in a state without executing any function
+ * @param pFSM: machine
+ * @param pTable: FSM definition
+ * @param state: current state
+ */
+void FSM_Reset(FiniteStateMachine *pFSM, const FSMTable *pTable, uint8_t state);
+
+/**
+ * Generates an internal event
+ * @param pFSM: machine
+ * @param newState: the new state to pass to
+ * @param pEventData: pointer to the event data
+ */
+void FSM_Internal(FiniteStateMachine *pFSM, uint8_t newState, eventData *pEventData);
+
+/**
+ * The state engine execute until events are generated
+ * @param pFSM: machine
+ */
+void FSM_Engine(FiniteStateMachine *pFSM);
+
+/**
+ * External event: the transition is looked up by current state and message type
+ * @param pFSM: machine
+ * @param msgType: type of the message received
+ * @param pEventData: pointer to the event data
+ * @return true if a transition has been executed, false if the message has been discarded
+ */
+bool FSM_Event(FiniteStateMachine *pFSM, uint8_t msgType, eventData *pEventData);
+
+#endif /* FSMENGINE_H_ */
@@ -16,6 +16,7 @@
 #include <syslog.h>
 
 #include "FSMInit.h"
+#include "FSMEngine.h"
 #include "../config.h"
 #include "../datatypes/messages.h"
 #include "../globals.h"
@@ -37,31 +38,6 @@ typedef enum eStates {
 	StateConfigured,
 } eStates;
 
-typedef struct eventData {
-	struct message *pMessage;
-    struct timespec *deadline;   	// Next timeout or 0 = no timeout		
-} eventData;
-
-
-typedef void (*StateFunc)(eventData *pEventData);
-typedef void (*EntryFunc)(eventData *pEventData);
-typedef void (*ExitFunc)(eventData *pEventData);
-
-typedef struct StateMapItem {
-	StateFunc pStateFunc;
-	EntryFunc pEntryFunc;
-	ExitFunc pExitFunc;
-} StateMapItem;
-
-/* Machine Instance */
-typedef struct {
-	eStates newState;				// New state to pass to
-	eStates currentState;			// Current state
-    StateMapItem *stateMap;			// Map to function for each state
-	bool eventGenerated;			// An event occured and hasn't been served
-	eventData *pEventData;			// Point to current event Data
-} FiniteStateMachine;
-
 /**
  *  variables 
  */
@@ -72,6 +48,8 @@ static int configPreviousSegment = -1;
 static int configTotalSegments = -1;
 static eNodeType configNodeType;
 static route configuration[CONFIGMAXROUTES];
+static uint32_t configNumMembers = 0;
+static routeMembers configMembers[CONFIGMAXCOORDINATED];
 
 /**
  *  Functions implementation 
@@ -109,11 +87,8 @@ static void spawnCoreTasks() {
 	taskCommTxId = taskSpawn(TASKCOMMTXNAME, TASKCOMMTXPRIO, 0, TASKCOMMTXSTACKSIZE, (FUNCPTR) dixlCommTx, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
 }
 
-/**
- *  Forward functions definitions 
- */
-static void FSMEvent_Internal(eStates newState, eventData *pEventData);
-static void StateEngine();
+/* FiniteStateMachine istance object */
+static FiniteStateMachine FSM;
 
 /**
  * STATEINIT
@@ -123,7 +98,7 @@ static void InitState(eventData *pEventData) {
 	spawnCoreTasks();
 	
 	// Pass to next (Idle) state
-	FSMEvent_Internal(StateIdle, pEventData);
+	FSM_Internal(&FSM, StateIdle, pEventData);
 }
 
 /**
@@ -133,6 +108,7 @@ static void IdleState(eventData *pEventData) {
 	// Clean CONFIG
 	configPreviousSegment = -1;
 	configTotalSegments = -1;
+	configNumMembers = 0;
 
 	// Log cleaned CONFIG
 	syslog(LOG_INFO, "CONFIG cleaned");
@@ -155,35 +131,73 @@ static void ConfiguringEntry(eventData *pEventData) {
 	destination = pMessage->header.destination;
 	configTotalSegments = pMessage->initConfigType.totalSegments;
 	configNodeType = pMessage->initConfigType.nodeType;
+	configNumMembers = 0;
 }
 static void ConfiguringState(eventData *pEventData) {
 	// Get message pointer
 	message *pMessage = pEventData->pMessage;
 	
-	// Get current sequence	
-	uint32_t configCurrentSequence = pMessage->initConfig.sequence;
+	// Members of a route coordinated by the node (star mode): out of the routes sequence
+	if (pMessage->header.type == MSGTYPE_NODECONFIGMEMBERS) {
+		uint32_t numMembers = pMessage->initConfigMembers.numMembers;
+		if (numMembers == 0 || numMembers > CONFIGMAXMEMBERS || sizeof(msgHeader) + sizeof(msgInitCONFIGMEMBERS) + numMembers * sizeof(nodeId) > pMessage->header.lentgh) {
+			syslog(LOG_INFO, "Wrong CONFIG number of members (%i) going back to idle state", numMembers);
+			FSM_Internal(&FSM, StateIdle, pEventData);
+		} else if (configNumMembers == CONFIGMAXCOORDINATED) {
+			syslog(LOG_ERR, "Wrong CONFIG number of coordinated routes (max %i): going back to Idle state", CONFIGMAXCOORDINATED);
+			FSM_Internal(&FSM, StateIdle, pEventData);
+		} else {
+			routeMembers *pMembers = &configMembers[configNumMembers++];
+			pMembers->id = pMessage->initConfigMembers.routeId;
+			pMembers->numMembers = numMembers;
+			memcpy(pMembers->members, &pMessage->initConfigMembers + 1, numMembers * sizeof(nodeId));
+			syslog(LOG_INFO, "Received CONFIG route (%i) coordinated with %i members", pMembers->id, numMembers);
+		}
+		return;
+	}
+	
+	// Get current sequence and number of routes (1 for NODECONFIG, many for NODECONFIGBULK)
+	uint32_t configCurrentSequence, configTotal, configNumRoutes;
+	const route *pRoutes;
+	if (pMessage->header.type == MSGTYPE_NODECONFIGBULK) {
+		configCurrentSequence = pMessage->initConfigBulk.sequence;
+		configTotal = pMessage->initConfigBulk.totalSegments;
+		configNumRoutes = pMessage->initConfigBulk.numRoutes;
+		pRoutes = (const route *) (&pMessage->initConfigBulk + 1);
+	} else {
+		configCurrentSequence = pMessage->initConfig.sequence;
+		configTotal = pMessage->initConfig.totalSegments;
+		configNumRoutes = (configCurrentSequence == 0) ? 0 : 1;
+		pRoutes = &pMessage->initConfig.route;
+	}
 	
-	// Check if CONFIG is correct
+	// Check if CONFIG is correct (once for the whole message)
 	// If sequence or total segment error, discard the message and the sequence and go back to StateIdle
-	if ( (configCurrentSequence - configPreviousSegment != 1 || pMessage->initConfig.totalSegments != configTotalSegments )) { 
+	if ( (configCurrentSequence - configPreviousSegment != 1 || configTotal != configTotalSegments )) { 
 		syslog(LOG_INFO, "Wrong CONFIG sequence going back to idle state");
-		FSMEvent_Internal(StateIdle, pEventData);
+		FSM_Internal(&FSM, StateIdle, pEventData);
+	} else if (configCurrentSequence == 0 && (configTotalSegments <= 0 || configTotalSegments > CONFIGMAXROUTES)) {
+		syslog(LOG_ERR, "Wrong CONFIG number of segments (%i, max %i): going back to Idle state", configTotalSegments, CONFIGMAXROUTES);
+		FSM_Internal(&FSM, StateIdle, pEventData);
+	} else if (configCurrentSequence != 0 && (configNumRoutes == 0 || configNumRoutes > MSG_CONFIGBULKMAXROUTES || configCurrentSequence + configNumRoutes - 1 > configTotalSegments)) {
+		syslog(LOG_INFO, "Wrong CONFIG number of routes (%i from %i) going back to idle state", configNumRoutes, configCurrentSequence);
+		FSM_Internal(&FSM, StateIdle, pEventData);
 	} else {
-		// Sequence OK (stpre fpr next iteration
-		configPreviousSegment = configCurrentSequence;
-
 		// Log received CONFIG
 		if (configCurrentSequence == 0)	
 			syslog(LOG_INFO, "Receiving CONFIG NodeType %s, Total routes %i", ( configNodeType == NODETYPE_TRACKCIRCUIT ) ? "TrackCircuit" : "Point", configTotalSegments);
 		else {
 			// Store current sequence excluding 0 used to send nodeType 
-			memcpy(&configuration[configCurrentSequence - 1], &(pMessage->initConfig.route),  sizeof(route));		
-			syslog(LOG_INFO, "Received CONFIG route %i of %i", configCurrentSequence, configTotalSegments);
+			memcpy(&configuration[configCurrentSequence - 1], pRoutes,  configNumRoutes * sizeof(route));		
+			syslog(LOG_INFO, "Received CONFIG routes %i-%i of %i", configCurrentSequence, configCurrentSequence + configNumRoutes - 1, configTotalSegments);
 		}
 		
+		// Sequence OK (store last route for next iteration)
+		configPreviousSegment = (configCurrentSequence == 0) ? 0 : configCurrentSequence + configNumRoutes - 1;
+
 		//If last go to next State (Configured) without need for events
-		if (configCurrentSequence == configTotalSegments)
-			FSMEvent_Internal(StateConfigured, pEventData);	
+		if (configPreviousSegment == configTotalSegments)
+			FSM_Internal(&FSM, StateConfigured, pEventData);	
 	}
 
 }
@@ -207,6 +221,8 @@ static void ConfiguredState(eventData *pEventData) {
 	messageConfig.nodeIConfigSet.pRoute = configuration;
 	messageConfig.nodeIConfigSet.numRoutes = configTotalSegments;
 	messageConfig.nodeIConfigSet.nodeType = (uint8_t) configNodeType;
+	messageConfig.nodeIConfigSet.pMembers = configMembers;
+	messageConfig.nodeIConfigSet.numMembers = configNumMembers;
 
 	// Prepare CONFIG SET message for dixlCommTx
 	messageCommTx.iHeader.type = IMSGTYPE_COMMTXCONFIGSET;
@@ -215,10 +231,10 @@ static void ConfiguredState(eventData *pEventData) {
 	// Check CONFIG
 	if (configTotalSegments <= 0) {
 		syslog(LOG_ERR, "Wrong CONFIG number of segments (%i): going back to Idle state", configTotalSegments);
-		FSMEvent_Internal(StateIdle, pEventData);
+		FSM_Internal(&FSM, StateIdle, pEventData);
 	} else if ( configNodeType != NODETYPE_TRACKCIRCUIT && configNodeType != NODETYPE_POINT) {
 		syslog(LOG_ERR, "Wrong CONFIG node type: going back to Idle state");
-		FSMEvent_Internal(StateIdle, pEventData);
+		FSM_Internal(&FSM, StateIdle, pEventData);
 	} else {		
 		// CONFIG ok, Send to dixlCtrl and dixlDiag task queue
 		msgQ_Send(msgQCtrlId, (char *) &messageConfig, sizeof(msgIHeader) + sizeof(msgINodeCONFIGSET));
@@ -246,7 +262,7 @@ static void ConfiguredExit(eventData *pEventData) {
 
 }
 
-static StateMapItem StateMap[] = {
+static const StateMapItem StateMap[] = {
 		// StateDummy
 		{ NULL,				NULL, 				NULL},
 		// StateInit
@@ -259,87 +275,50 @@ static StateMapItem StateMap[] = {
 		{ ConfiguredState,	NULL,				ConfiguredExit},
 };
 
-/* FiniteStateMachine istance object */
-static FiniteStateMachine FSM =  {
-	StateDummy,
-	StateDummy,
-	StateMap,
-	FALSE,
-	NULL
-};
-
 /**
- * The state engine execute until events are generated
+ * Guards
  */
-static void StateEngine() {
-    // Temporary pointer to current event data
-	eventData *pDataTemp = NULL;
-
-    // While events are being generated keep executing states
-    while (FSM.eventGenerated) {
-
-        // Get the pointers to function
-        StateFunc state = FSM.stateMap[FSM.newState].pStateFunc;
-        EntryFunc entry = FSM.stateMap[FSM.newState].pEntryFunc;
-        ExitFunc exit = FSM.stateMap[FSM.currentState].pExitFunc;
-
-        // Copy of event data pointer
-        pDataTemp = FSM.pEventData;
-
-        // Event data used and resetted
-        FSM.pEventData = NULL;
-
-        // Event served and resetted
-        FSM.eventGenerated = FALSE;
-
-		// Transitioning to a new state?
-		if (FSM.newState != FSM.currentState)
-		{
-			// Execute the state exit action on current state before switching to new state
-			if (exit != NULL)
-				exit(pDataTemp);
-
-			// Execute the state entry action on the new state
-			if (entry != NULL)
-				entry(pDataTemp);
-
-			// Ensure exit/entry actions didn't call FSMEvent_Internal by accident 
-			assert(FSM.eventGenerated == FALSE);
-		}
-
-		// Switch to the new current state
-		FSM.currentState = FSM.newState;
-
-		// Execute the state action passing in event data
-		assert(state != NULL);
-		state(pDataTemp);
-    }
+// First CONFIG in sequence (node type and total number of segments)
+static bool guard_configFirst(eventData *pEventData) {
+	return pEventData->pMessage->initConfig.sequence == 0;
 }
 
+/* Transitions */
+static const TransitionItem Transitions[] = {
+		// state					message type				guard						action				next state
+		{ StateIdle,				MSGTYPE_NODECONFIG,			guard_configFirst,			NULL,				StateConfiguring },
+		{ StateConfiguring,			MSGTYPE_NODECONFIG,			NULL,						NULL,				StateConfiguring },
+		{ StateConfiguring,			MSGTYPE_NODECONFIGBULK,		NULL,						NULL,				StateConfiguring },
+		{ StateConfiguring,			MSGTYPE_NODECONFIGMEMBERS,	NULL,						NULL,				StateConfiguring },
+		{ StateConfiguring,			MSGTYPE_NODERESET,			NULL,						NULL,				StateIdle },
+		{ StateConfigured,			MSGTYPE_NODERESET,			NULL,						NULL,				StateIdle },
+};
 
-/**
- * Generates an internal event
- * @param newState: the new state to pass to
- * @param pEventData: pointer to the event data
- */ 
-void FSMEvent_Internal(eStates newState, eventData *pEventData) {
-    FSM.pEventData = pEventData;
-    FSM.eventGenerated = TRUE;
-    FSM.newState = newState;
-}
+/* Lookup table (built by the initialization) */
+static uint8_t Lookup[sizeof(StateMap) / sizeof(StateMap[0])][FSMMSGTYPES];
+
+/* FSM definition */
+static FSMTable Table = {
+	StateMap,
+	sizeof(StateMap) / sizeof(StateMap[0]),
+	Transitions,
+	sizeof(Transitions) / sizeof(Transitions[0]),
+	Lookup
+};
 
 /**
  * STATEDUMMY
  */
 void FSMInit() {
 	// Current State to dummy
-	FSM.currentState = StateDummy;
+	FSM_TableBuild(&Table);
+	FSM_Reset(&FSM, &Table, StateDummy);
 	
 	// Force first (Init) State
-	FSMEvent_Internal(StateInit, NULL);
+	FSM_Internal(&FSM, StateInit, NULL);
 	
 	// and process it
-	StateEngine();
+	FSM_Engine(&FSM);
 	
 	syslog(LOG_INFO, "FSM initialized");
 }
@@ -347,7 +326,7 @@ void FSMInit() {
 
 /**
  * Event Functions
- * Only conditions to go to next state are tested and newstate decided then the StateEngine is executed, that is:
+ * The transition is looked up by current state and message type, then the StateEngine is executed, that is:
  * - currentStateExit
  * - newStateEntry
  * - newState
@@ -356,79 +335,17 @@ void FSMInit() {
  */
 void FSMInitEvent_NewMessage(message *pMessage, struct timespec *deadline) {	
 	
-	// Result of the precondition evaluation to pass to new state
-	bool condition = FALSE;
 	// Event data
 	eventData eventData;
 	eventData.pMessage = pMessage;
-	// New state
-	eStates newState=NULL;
+	eventData.pTimer = NULL;
 	
-	switch (FSM.currentState) {
-		case StateDummy:
-			// Should not happen
-			syslog(LOG_ERR, "Wrong state Dummy: message received");
-			taskExit(rcFSM_WRONGSTATE);
-			break;
-			
-		case StateInit:
-			// Should not happen
-			syslog(LOG_ERR, "Wrong state Init: message received");
-			taskExit(rcFSM_WRONGSTATE);
-			break;
-
-		case StateIdle:
-			// Accept only CFG messages discard others			
-			if (pMessage->header.type == MSGTYPE_NODECONFIG) {
-				// Get current sequence
-				int configCurrentSequence = pMessage->initConfig.sequence;
-				
-				// First in sequence? OK to next state (Configuring)			
-				if (configCurrentSequence == 0) {
-					newState = StateConfiguring;
-					condition = TRUE;
-				} else
-					condition = FALSE;			
-			} else {
-				// Discard other messages
-				condition = FALSE;
-			}
-			break;
-			
-		case StateConfiguring:		
-			// Accept CONFIG or RESET message					
-			if (pMessage->header.type == MSGTYPE_NODECONFIG) {
-				// continue checking and configuring 
-				newState = StateConfiguring;				
-				condition = TRUE;
-			} else if (pMessage->header.type == MSGTYPE_NODERESET) {
-					// Reset config going back to Idle
-					newState = StateIdle;
-					condition = TRUE;
-			} else {				
-				// Discard other message type
-				condition = FALSE;
-			}
-			break;
-			
-		case StateConfigured:
-			// Accept only RESET message
-			if (pMessage->header.type == MSGTYPE_NODERESET) {
-				// Reset config going back to Idle
-				newState = StateIdle;
-				condition = TRUE;
-			} else
-				condition = FALSE;
-			break;
+	// Should not happen
+	if (FSM.currentState == StateDummy || FSM.currentState == StateInit) {
+		syslog(LOG_ERR, "Wrong state %s: message received", FSM.currentState == StateDummy ? "Dummy" : "Init");
+		taskExit(rcFSM_WRONGSTATE);
 	}
 	
-	// If the condition is passed, the new state is served
-	if (condition) {
-		// Generate the internal event
-		// New state, event data and event flag set only if used
-		FSMEvent_Internal(newState, &eventData);
-		
-		// Process the state change
-		StateEngine();
-	}
+	// Transition (if any, else the message is discarded)
+	FSM_Event(&FSM, pMessage->header.type, &eventData);
 }
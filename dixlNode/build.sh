@@ -1,2 +1,2 @@
 source SDK/sdkenv.sh
-$CC -dkm dkm.c includes/ntp.c includes/network.c includes/utils.c includes/hw.c datatypes/dataHelper.c FSM/FSMCtrlPOINT.c FSM/FSMCtrlTRACKCIRCUIT.c FSM/FSMInit.c tasks/dixlCommRx.c tasks/dixlCommTx.c tasks/dixlCtrl.c tasks/dixlDiag.c tasks/dixlInit.c tasks/dixlLog.c tasks/dixlPoint.c tasks/dixlSensor.c -o dkm.o  -v
+$CC -dkm dkm.c includes/ntp.c includes/network.c includes/utils.c includes/msgPool.c includes/msgQRing.c includes/timerWheel.c includes/trace.c includes/hw.c datatypes/dataHelper.c FSM/FSMCtrlPOINT.c FSM/FSMCtrlTRACKCIRCUIT.c FSM/FSMCtrlPending.c FSM/FSMCtrlRtt.c FSM/FSMEngine.c FSM/FSMInit.c tasks/dixlCommRx.c tasks/dixlCommTx.c tasks/dixlCtrl.c tasks/dixlDiag.c tasks/dixlInit.c tasks/dixlLog.c tasks/dixlPoint.c tasks/dixlSensor.c -o dkm.o  -v
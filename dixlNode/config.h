@@ -50,6 +50,7 @@
 #define	TASKLOGPRIO 			95					/* Task Logger prio */
 #define	TASKLOGSTACKSIZE 		20480				/* Task Logger stack Size */
 #define TASKLOGMAXLINES			1024				/* Task Logger: maximum lines that can be stored */
+#define TASKLOGEXPORTTIMEOUT	(COMMPEERMSGTIMEOUT + 1000)	/* Task Logger: max wait (ms) for the previous log export to be sent (or dropped after COMMPEERMSGTIMEOUT) */
 
 /* Task dixlCtrl */
 #define TASKCTRLNAME  			"tDixlCtrl"			/* Task Ctrl name */
@@ -88,43 +89,68 @@
 #define	TASKSENSORPRIO 			86					/* Task Sensor prio */
 #define	TASKSENSORSTACKSIZE		20480				/* Task Sensor stack Size */
 #define TASKSENSORCHECKPERIOD   1000                /* Task Sensor check period (ms) */
+#define TASKSENSORSIMMISSED		FALSE				/* VxSim: the emulated sensor never sees the trains (sensor fault, test only) */
 
 #define TASKSENSORWKRNAME 		"tDixlSensorWkr"			/* Task Sensor worker name */
 #define TASKSENSORWKRDESC  		"Sensor Checker Worker"		/* Task Sensor worker description */
 #define	TASKSENSORWKRPRIO 		85							/* Task Sensor worker prio */
 #define	TASKSENSORWKRSTACKSIZE	20480						/* Task Sensor worker stack Size */
 
+/* Task dixlTimer */
+#define TASKTIMERNAME 			"tDixlTimer"		/* Task Timer name */
+#define TASKTIMERDESC  			"Timer Wheel"		/* Task Timer description */
+#define	TASKTIMERPRIO 			75					/* Task Timer prio (before the timers owners) */
+#define	TASKTIMERSTACKSIZE		20480				/* Task Timer stack Size */
+#define TIMERWHEELSLOTS			256					/* Timer wheel slots (power of 2): one tick each, timers beyond wait more rounds */
+
 /**
  *  Messages queues specifications
  *
  */
+/* Messages pool (queues carry references to pool messages) */
+#define MSGPOOLSIZE					1024					/* Number of messages in the pool */
+#define MSGPOOLALLOCTIMEOUT			1000					/* Max wait (ms) for a free message if the pool is exhausted */
+#define MSGPOOLRESERVED				256						/* Free messages left to the route messages (logging can't take them) */
+#define MSGQRINGMAX					4						/* Max number of queues replaced by a lock-free ring */
+#define MSGQMAX						8						/* Max number of queues (policy and statistics) */
+#define MSGQCOALESCEMAX				8						/* Max queued messages tracked for merging (coalesce policy) */
+
 /* dxilInit task IN Queue */
 #define MSGQINITMESSAGESMAX  		1024			/* Max number of the messages accepted */
-#define MSGQINITMESSAGESLENGTH 		MSG_MAXLENGTH	/* Max length of the messages */
+#define MSGQINITMESSAGESLENGTH 		MSGPOOL_REFLENGTH		/* Length of the messages (pool reference) */
 
 /* dxilCommTx task IN Queue */
 #define MSGQCOMMTXMESSAGESMAX  		1024					/* Max number of the messages accepted */
-#define MSGQCOMMTXMESSAGESLENGTH 	MSG_MAXLENGTH			/* Max length of the messages */
+#define MSGQCOMMTXMESSAGESLENGTH 	MSGPOOL_REFLENGTH		/* Length of the messages (pool reference) */
+#define MSGQCOMMTXOPTIONS			MSG_Q_FIFO | MSGQ_OPT_RING	/* Options: lock-free ring (many producers, hot path) */
+#define MSGQCOMMTXPOLICY			MSGQPOLICY_BLOCK		/* Policy when full */
+#define MSGQCOMMTXSENDTIMEOUT		WAIT_FOREVER			/* Wait for room when full: route messages are never dropped */
+#define MSGQCOMMTXLOGLIMIT			256						/* Log export waits while more messages are queued (room for route messages) */
 
 /* dxilCtrl task IN Queue */
 #define MSGQCTRLMESSAGESMAX  		1024					/* Max number of the messages accepted */
-#define MSGQCTRLMESSAGESLENGTH 		MSG_MAXLENGTH			/* Max length of the messages */
+#define MSGQCTRLMESSAGESLENGTH 		MSGPOOL_REFLENGTH		/* Length of the messages (pool reference) */
+#define MSGQCTRLOPTIONS				MSG_Q_FIFO | MSGQ_OPT_RING	/* Options: lock-free ring (many producers, hot path) */
+#define MSGQCTRLPOLICY				MSGQPOLICY_BLOCK		/* Policy when full */
+#define MSGQCTRLSENDTIMEOUT			WAIT_FOREVER			/* Wait for room when full: route messages are never dropped */
 
 /* dxilLog task IN Queue */
-#define MSGQLOGMESSAGESMAX  		1024					/* Max number of the messages accepted */
-#define MSGQLOGMESSAGESLENGTH 		MSG_MAXLENGTH			/* Max length of the messages */
+#define MSGQLOGMESSAGESMAX  		128						/* Max number of the messages accepted (well below MSGPOOLSIZE: a log flood holds few pool messages) */
+#define MSGQLOGMESSAGESLENGTH 		MSGPOOL_REFLENGTH		/* Length of the messages (pool reference) */
+#define MSGQLOGPOLICY				MSGQPOLICY_DROPOLDEST	/* Policy when full: logging never blocks the caller */
 		
 /* dxilDiag task IN Queue */
 #define MSGQDIAGMESSAGESMAX  		1024					/* Max number of the messages accepted */
-#define MSGQDIAGMESSAGESLENGTH 		MSG_MAXLENGTH			/* Max length of the messages */
+#define MSGQDIAGMESSAGESLENGTH 		MSGPOOL_REFLENGTH		/* Length of the messages (pool reference) */
 		
 /* dxilPoint task IN Queue */
 #define MSGQPOINTMESSAGESMAX  		1024					/* Max number of the messages accepted */
-#define MSGQPOINTMESSAGESLENGTH 	MSG_MAXLENGTH			/* Max length of the messages */
+#define MSGQPOINTMESSAGESLENGTH 	MSGPOOL_REFLENGTH		/* Length of the messages (pool reference) */
 		
 /* dxilSensor task IN Queue */
 #define MSGQSENSORMESSAGESMAX  		1024					/* Max number of the messages accepted */
-#define MSGQSENSORMESSAGESLENGTH 	MSG_MAXLENGTH			/* Max length of the messages */
+#define MSGQSENSORMESSAGESLENGTH 	MSGPOOL_REFLENGTH		/* Length of the messages (pool reference) */
+#define MSGQSENSORPOLICY			MSGQPOLICY_COALESCE		/* Policy: a new state request replaces the queued one (full or not) */
 		
 /**
  * GPIO PINs
@@ -139,12 +165,54 @@
 #define COMMSOCKTYPE 				SOCK_STREAM				/* Connection-based (use SOCK-DGRAM for datagram) */
 #define COMMSOCKPROTOCOL    		IPPROTO_TCP				/* TCP  /use IPPROTO_UDP for UDP */
 #define COMMSOCKPORT        		256		        		/* port, IANA unassigned */
-#define COMMBUFFERSIZE		        2 * MSG_MAXLENGTH		/* Comm buffer size to receive messages */
+#define COMMBUFFERSIZE		        2 * MSG_BULKMAXLENGTH	/* Comm buffer size to receive messages */
 #define COMMMSGTIMEOUT				30						/* timeout on msg receive (sec) */
+#define COMMPOOLMAXCONNECTIONS		(CONFIGMAXMEMBERS + 16)	/* Max number of outbound destinations (one connection and queue each): all the members of a coordinated route at once */
+#define COMMPEERQUEUEMAX			32						/* Max number of messages queued per destination */
+#define COMMPEERMSGTIMEOUT			5000					/* Queued message dropped if not sent within this time (ms) */
+#define COMMCONNECTTIMEOUT			1000					/* Outbound connect timeout (ms) */
+#define COMMCONNECTRETRY			2000					/* Wait before connecting again after a failure (ms) */
+#define COMMPEERPOLLPERIOD			10						/* Period of the pending connects and sends check (ms) */
+#define COMMPOOLIDLETIMEOUT			10						/* Pooled connection closed after this idle time (sec) */
+#define COMMPOOLCHECKPERIOD			1000					/* Period of the idle connections check (ms) */
+#define COMMLISTENBACKLOG			COMMRXMAXCONNECTIONS	/* Pending inbound connections queued by the listening socket */
+#define COMMRXMAXCONNECTIONS		(CONFIGMAXMEMBERS + 16)	/* Max number of inbound connections served at the same time (the members' votes to a coordinator) */
+#define COMMRXIDLETIMEOUT			30						/* Inbound connection closed after this idle time (sec) */
+#define COMMRXCHECKPERIOD			1000					/* Period of the idle inbound connections check (ms) */
+
+#define COMMTRANSPORTTCP			0						/* Transport: TCP stream */
+#define COMMTRANSPORTUDP			1						/* Transport: UDP datagram with ack and retransmission */
+#define COMMROUTETRANSPORT			COMMTRANSPORTTCP		/* Transport of route messages between nodes (host always on TCP) */
+#define COMMDGRAMMAXPEERS			COMMPOOLMAXCONNECTIONS	/* Max number of peers tracked by the datagram transport (as many as the destinations) */
+#define COMMDGRAMMAXPENDING			64						/* Max number of datagrams waiting for the ack */
+#define COMMDGRAMRETRANSMIT			200						/* Datagram retransmission timeout (ms) */
+#define COMMDGRAMMAXRETRIES			5						/* Max retransmissions of a datagram before giving up */
+#define COMMDGRAMLOSSPERCENT		0						/* Received datagrams dropped on purpose (%), to test loss recovery */
+#define COMMTXBATCHMAX				16						/* Max number of queued messages drained and sent in a single write */
+#define COMMWIRECOMPACT				TRUE					/* Send messages with the compact header (both are accepted on receive) */
+#define COMMTXBATCHLINGER			0						/* Max wait for more messages to batch (ms), 0 = only already queued */
 
 /**
  * Configurations parameters
  */
 #define CONFIGMAXROUTES      		256						/* Max number of routes in node config */
+#define CONFIGMAXMEMBERS			32						/* Max members of a route coordinated by the node (star mode) */
+#define CONFIGMAXCOORDINATED		16						/* Max routes coordinated by the node (star mode) */
+
+/**
+ * Control logic parameters
+ */
+#define CTRLCONFLICTALL				0						/* Any two routes conflict: one route at a time */
+#define CTRLCONFLICTPOSITION		1						/* Point: routes with the same position are compatible (Track Circuit: any conflict) */
+#define CTRLCONFLICTNONE			2						/* Routes never conflict (test only) */
+#define CTRLROUTECONFLICT			CTRLCONFLICTALL			/* Rule for routes reserved at the same time on a node (POSITION: a single Sensor, its events go to the oldest route) */
+#define CTRLROUTECONTEXTSMAX		4						/* Max routes in progress at the same time on a node */
+#define CTRLPENDINGMAX				4						/* Max route requests waiting for the node when busy (0 = rejected at once) */
+#define CTRLPENDINGTIMEOUT			2000					/* Max wait (ms) of a queued route request, then rejected */
+#define CTRLRTTNEIGHBOURSMAX		16						/* Neighbours with measured round-trip times */
+#define CTRLRTTK					4						/* Reply timeout = srtt + K * rttvar */
+#define CTRLRTTMINTIMEOUT			1000					/* Reply timeout floor (ms) */
+#define CTRLRTTMAXTIMEOUT			(COMMMSGTIMEOUT * 1000)	/* Reply timeout ceiling (ms), used until measured */
+#define CTRLPOINTSPECULATIVE		FALSE					/* Point: start positioning on the route request (back if the route aborts), not after the COMMIT */
 
 #endif /* CONFIG_H_ */
@@ -6,8 +6,15 @@
  * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
  * @date: Jan 10, 2023
  */
+#include <string.h>
+
 #include "dataTypes.h"
 
+/* Home slot of a route id (multiplicative hash) */
+static uint32_t routeIndexSlot(routeId id) {
+	return (uint32_t) (((uint64_t) id * 2654435761u) % ROUTEINDEXSLOTS);
+}
+
 const char *pointPosStr(ePointPosition pos) {
 	switch (pos) {
 	case POINTPOS_DIVERGING:
@@ -40,3 +47,38 @@ bool nodeIsNull(nodeId node) {
 bool nodecmp(const nodeId node1, const nodeId node2) {
 	return (!(node1.bytes[0] == node2.bytes[0] && node1.bytes[1] == node2.bytes[1] && node1.bytes[2] == node2.bytes[2] && node1.bytes[3] == node2.bytes[3]));
 }
+
+void routeIndexBuild(routeIndex *pIndex, route *pRouteList, uint32_t numRoutes) {
+	memset(pIndex->slots, 0, sizeof(pIndex->slots));
+	pIndex->pRouteList = pRouteList;
+	if (!pRouteList)
+		return;
+	
+	for (uint32_t i = 0; i < numRoutes && i < CONFIGMAXROUTES; i++) {
+		// Probe from the home slot up to a free one (or the same id, already indexed)
+		uint32_t slot = routeIndexSlot(pRouteList[i].id);
+		while (pIndex->slots[slot] && pRouteList[pIndex->slots[slot] - 1].id != pRouteList[i].id)
+			slot = (slot + 1) % ROUTEINDEXSLOTS;
+		if (!pIndex->slots[slot])
+			pIndex->slots[slot] = i + 1;
+	}
+}
+
+route *routeIndexFind(const routeIndex *pIndex, routeId id) {
+	if (!pIndex->pRouteList)
+		return NULL;
+	
+	// Probe from the home slot up to the id or a free slot
+	for (uint32_t slot = routeIndexSlot(id); pIndex->slots[slot]; slot = (slot + 1) % ROUTEINDEXSLOTS)
+		if (pIndex->pRouteList[pIndex->slots[slot] - 1].id == id)
+			return &pIndex->pRouteList[pIndex->slots[slot] - 1];
+	return NULL;
+}
+
+routeMembers *routeMembersFind(routeMembers *pMembersList, uint32_t numMembersList, routeId id) {
+	// Few coordinated routes: linear search
+	for (uint32_t i = 0; pMembersList && i < numMembersList; i++)
+		if (pMembersList[i].id == id)
+			return &pMembersList[i];
+	return NULL;
+}
@@ -15,6 +15,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "../config.h"
+
 /***************************************************
  *  Return codes
  ***************************************************/
@@ -23,6 +25,7 @@ enum returnCode {
 	rcINQUEUE_INITERR		= 101,		// IN QUEUE initialization error
 	rcINQUEUE_RECEIVEERR	= 102,		// IN QUEUE receive error
 	rcINQUEUE_SENDERR		= 103,		// IN QUEUE send error
+	rcMSGPOOL_INITERR		= 104,		// MESSAGE POOL initialization error
 	
 	rcSOCKET_INITERR		= 201,		// SOCKET initialization error
 	rcSOCKET_BINDERR		= 202,		// SOCKET binding error
@@ -30,6 +33,7 @@ enum returnCode {
 	rcSOCKET_ACCEPTERR		= 204,		// SOCKET accept error
 	rcSOCKET_RECEIVEERR		= 205,		// SOCKET receive error
 	rcSOCKET_SENDERR		= 206,		// SOCKET send error
+	rcSOCKET_SELECTERR		= 207,		// SOCKET select error
 	
 	rcNETWORK_GETIFADDRSERR = 301,		// NETWORK errore getting if addresses
 	
@@ -91,11 +95,28 @@ typedef struct route {
 	uint8_t padding[2];				// Padding to 32bit
 } route;
 
+/* Members of a route coordinated by the node (star mode): the coordinator sends REQ and COMMIT to all of them */
+typedef struct routeMembers {
+	routeId id;						// ID of the route
+	uint32_t numMembers;			// Number of members (the coordinator excluded)
+	nodeId members[CONFIGMAXMEMBERS];	// Members of the route
+} routeMembers;
+
+/* Route lookup by id: open addressing hash table, built at configuration time */
+#define ROUTEINDEXSLOTS				(2 * CONFIGMAXROUTES)	// Slots (half used at most: short probes)
+typedef struct routeIndex {
+	route *pRouteList;				// Indexed routes
+	uint32_t slots[ROUTEINDEXSLOTS];	// Route position + 1 in the list (0 = empty slot)
+} routeIndex;
+
 typedef struct NodeState {
 	uint8_t nodeType;				// Type of the node ( => behaviour)
 	uint32_t numRoutes;				// Total number (N) of segments in the configuration
 	route *pRouteList;				// Array of route in the configuration received
 	route *pCurrentRoute;			// Current requested route
+	routeIndex routeIndex;			// Routes lookup by id
+	uint32_t numMembersList;		// Number of routes coordinated by the node (star mode)
+	routeMembers *pMembersList;		// Members of the coordinated routes
 } NodeState;
 
 
@@ -128,5 +149,30 @@ bool nodeIsNull(nodeId node);
   * @return Return TRUE if node are equal
   */
 bool nodecmp(const nodeId node1, const nodeId node2);
+
+/**
+ * Build the routes index (the first of duplicated ids is kept, as a linear search)
+ * @param pIndex	: index to build
+ * @param pRouteList: routes (NULL to clean the index)
+ * @param numRoutes	: number of routes (at most CONFIGMAXROUTES)
+ */
+void routeIndexBuild(routeIndex *pIndex, route *pRouteList, uint32_t numRoutes);
+
+/**
+ * Find a route by id
+ * @param pIndex	: index
+ * @param id		: route id
+ * @return			: the route or NULL if not found
+ */
+route *routeIndexFind(const routeIndex *pIndex, routeId id);
+
+/**
+ * Find the members of a route coordinated by the node (star mode)
+ * @param pMembersList	: members of the coordinated routes
+ * @param numMembersList: number of coordinated routes
+ * @param id			: route id
+ * @return				: the members or NULL if the route isn't coordinated by the node (chain mode)
+ */
+routeMembers *routeMembersFind(routeMembers *pMembersList, uint32_t numMembersList, routeId id);
 #endif /* DATATYPES_H_ */
  
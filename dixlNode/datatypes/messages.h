@@ -15,6 +15,13 @@
  *  Defines
  */
 #define MSG_MAXLENGTH			255		// Maximum message length
+#define MSG_BULKMAXLENGTH		2048	// Maximum message length with the compact header
+#define MSG_COMPACTVERSION		2		// Compact header version (legacy header first byte is its length, >= 16)
+#define MSG_LOGBULKMAXLINES		63		// Max log lines in a MSGTYPE_LOGSENDBULK: (MSG_BULKMAXLENGTH - 12 - 16) / sizeof(logMessage)
+#define MSG_CONFIGBULKMAXROUTES	14		// Max routes in a MSGTYPE_NODECONFIGBULK: (MSG_MAXLENGTH - 16 - 12) / sizeof(route)
+#define MSG_ROUTEBATCHMAXROUTES	32		// Max routes in a MSGTYPE_ROUTEREQBATCH
+#define MSG_QSTATSBUCKETS		6		// Queue residency time histogram buckets: <1ms, <10ms, <100ms, <1s, <10s, >=10s
+#define MSG_TRACEMAXHOPS		10		// Max hops in a route trace: (MSG_MAXLENGTH - 16 - 8 - 16) / sizeof(traceHop)
 /**
  *  Enum
  */
@@ -24,6 +31,10 @@ typedef enum {
 	// Service messages - Init task
 	MSGTYPE_NODERESET 			= 10,	// Reset in the Init state
 	MSGTYPE_NODECONFIG 			= 11,	// Routes configuration sent by the host
+	MSGTYPE_NODECONFIGBULK		= 12,	// Routes configuration sent by the host, many routes per message
+	MSGTYPE_NODESTATSREQ		= 13,	// Request the tasks queues statistics
+	MSGTYPE_NODESTATS			= 14,	// Response a task queue statistics (one message per queue)
+	MSGTYPE_NODECONFIGMEMBERS	= 15,	// Members of a route coordinated by the node (star mode), sent by the host
 	MSGTYPE_NODEDISCOVERY 		= 20,	// TODO Nodes discovery from the host
 	MSGTYPE_NODEADVERTISE 		= 21,	// TODO Node advertise reply to discovery
 		
@@ -36,12 +47,15 @@ typedef enum {
 	MSGTYPE_ROUTEDISAGREE 		= 35,	// 2PhaseCommit Disagree
 	MSGTYPE_ROUTETRAINOK 		= 36,	// 2PhaseCommit Train OK
 	MSGTYPE_ROUTETRAINNOK 		= 37,	// 2PhaseCommit Train NOK
+	MSGTYPE_ROUTEREQBATCH		= 38,	// Route request of a set of routes (all or none: ACKed to the host, COMMIT by the host once all ACKed)
+	MSGTYPE_ROUTERELEASE		= 39,	// Sectional release: the train cleared the route up to the source node
 
 	// Log messages
 	MSGTYPE_LOGREQ				= 81,	// Request current log messages
 	MSGTYPE_LOGSEND				= 82,	// Response current log messages
 	MSGTYPE_LOGDEL				= 83,	// Ack messages were received and ask to delete
 	MSGTYPE_LOGDELACK			= 84,	// Ack messages were deleted
+	MSGTYPE_LOGSENDBULK			= 85,	// Response current log messages, many per message (compact header only)
 
 	// Diagnostic messages
 	MSGTYPE_DIAGERRTASK			= 90,	// Diagnostic error on task
@@ -54,10 +68,12 @@ typedef enum {
 	// Config messages - ComTx task
 	IMSGTYPE_COMMTXCONFIGSET    = 101,   // Set config in dixlCommTx task
 	IMSGTYPE_COMMTXCONFIGRESET  = 102,   // Reset config in dixlCommTx task	
+	IMSGTYPE_COMMTXDGRAMACK     = 103,   // Datagram acknowledged by the destination (UDP transport)
 
 	// Service messages - Init task
 	IMSGTYPE_NODECONFIGSET      = 111,   // Set config in dixlCtrl and dixlDiag task
 	IMSGTYPE_NODECONFIGRESET    = 112,   // Reset config in dixlCtrl and dixlDiag task	
+	IMSGTYPE_NODESTATS		    = 113,   // Send a task queue statistics to the host
 	
 	// Route messages internal request to send to
 	IMSGTYPE_ROUTEREQ 			= 130,	// Route request
@@ -68,6 +84,7 @@ typedef enum {
 	IMSGTYPE_ROUTEDISAGREE 		= 135,	// 2PhaseCommit Disagree
 	IMSGTYPE_ROUTETRAINOK 		= 136,	// 2PhaseCommit Train OK
 	IMSGTYPE_ROUTETRAINNOK 		= 137,	// 2PhaseCommit Train NOK
+	IMSGTYPE_ROUTERELEASE 		= 138,	// Sectional release
 
 	// Sensors messages
 	IMSGTYPE_SENSORSTATE		= 150,   // Track Circuit Sensor value request
@@ -77,6 +94,7 @@ typedef enum {
 	IMSGTYPE_LOG 				= 180,	// Log a message
 	IMSGTYPE_LOGSEND			= 182,	// Send current  log lines to the host
 	IMSGTYPE_LOGDELACK		    = 184,	// Ack log lines deletion to the host
+	IMSGTYPE_LOGSENDBULK		= 185,	// Send current log lines to the host, many per message
 
 	// Diagnostic messages
 	IMSGTYPE_DIAGERRTASK		= 190,	// Diagnostic error on task
@@ -91,6 +109,18 @@ typedef enum {
 	IMSGTYPE_TIMEOUTNOTIFY		= 199    // Point position or malfunction notify
 } eMsgType;
 
+/* Task queue in the statistics (MSGTYPE_NODESTATS) */
+typedef enum {
+	MSGQSTATS_INIT				= 0,	// dixlInit IN queue
+	MSGQSTATS_CTRL				= 1,	// dixlCtrl IN queue
+	MSGQSTATS_COMMTX			= 2,	// dixlCommTx IN queue
+	MSGQSTATS_LOG				= 3,	// dixlLog IN queue
+	MSGQSTATS_DIAG				= 4,	// dixlDiag IN queue
+	MSGQSTATS_POINT				= 5,	// dixlPoint IN queue
+	MSGQSTATS_SENSOR			= 6,	// dixlSensor IN queue
+	MSGQSTATS_NUM				= 7		// Number of queues
+} eMsgQStatsQueue;
+
 /***************************************
  * MESSAGES and TYPES
  ***************************************/
@@ -105,6 +135,16 @@ typedef struct msgHeader {
 	nodeId destination;				// Destination node Id
 	uint8_t padding[4];				// Padding to 64bit	
 } msgHeader;
+/**
+ *  EXT message COMPACT HEADER (on the wire only: converted to msgHeader on receive)
+ */
+typedef struct msgCompactHeader {
+	uint8_t version;				// Header version (MSG_COMPACTVERSION)
+	uint8_t type;					// Type of message (eMsgType)
+	uint16_t length;				// Message length, header included (network byte order)
+	nodeId source;					// Source node Id
+	nodeId destination;				// Destination node Id
+} msgCompactHeader;
 /**
  *  INT message HEADER
  */
@@ -114,6 +154,21 @@ typedef struct msgIHeader {
 	uint8_t padding[14];			// Padding to 64bit	
 } msgIHeader;
 
+/**
+ *  DATAGRAM HEADER (UDP transport only: followed by the EXT message)
+ */
+typedef enum {
+	DGRAMKIND_DATA				= 1,	// Datagram carries a message
+	DGRAMKIND_ACK				= 2		// Datagram acknowledges a received message
+} eDgramKind;
+
+typedef struct msgDgramHeader {
+	uint8_t kind;					// Kind of datagram (eDgramKind)
+	uint8_t padding[3];				// Padding to allign to 32bit
+	uint32_t session;				// Sender session (a new one restarts the duplicates check)
+	uint32_t sequence;				// Sequence number (per destination)
+} msgDgramHeader;
+
 /**
  *  EXTERNAL MESSAGES 
  */
@@ -133,31 +188,112 @@ typedef struct msgInitCONFIG {
 	route route;					// Single route
 } msgInitCONFIG;
 
+typedef struct msgInitCONFIGBULK {
+	uint32_t sequence;				// Sequence number of the first route in respect to total configuration (1..N)
+	uint32_t totalSegments;			// Total number (N) of segments (routes) in the configuration
+	uint32_t numRoutes;				// Number of routes following (1..MSG_CONFIGBULKMAXROUTES)
+} msgInitCONFIGBULK;				// followed by numRoutes route
+
+typedef struct msgInitCONFIGMEMBERS {
+	routeId routeId;				// Route coordinated by the node (position FIRST)
+	uint32_t numMembers;			// Number of members following (1..CONFIGMAXMEMBERS)
+} msgInitCONFIGMEMBERS;				// followed by numMembers nodeId
+
+/** message NODE types */
+typedef struct msgQStats {
+	uint8_t queue;					// Queue (eMsgQStatsQueue)
+	uint8_t totalQueues;			// Total number of queues (MSGQSTATS_NUM)
+	uint16_t depth;					// Messages queued now
+	uint16_t maxMsgs;				// Max number of messages accepted
+	uint16_t highWater;				// Max messages queued at the same time
+	uint32_t enqueued;				// Messages sent
+	uint32_t dequeued;				// Messages received
+	uint32_t dropped;				// Messages dropped (queue full)
+	uint32_t poolDropped;			// Messages lost before the queue (pool exhausted)
+	uint32_t residency[MSG_QSTATSBUCKETS];	// Messages received by time spent queued
+} msgQStats;
+
+typedef struct msgNodeSTATSREQ {
+} msgNodeSTATSREQ;
+typedef struct msgNodeSTATS {
+	msgQStats stats;
+} msgNodeSTATS;
+
+/**  message ROUTE trace (host opt-in, carried by REQ..TRAINNOK) */
+typedef enum {
+	TRACEHOP_RX					= 0x01,	// Received by dixlCommRx (rxAt)
+	TRACEHOP_FSM				= 0x02,	// Processed by the Ctrl FSM (fsmAt)
+	TRACEHOP_TX					= 0x04,	// Next message handed to the transport by dixlCommTx (txAt)
+	TRACEHOP_ATTACHED			= 0x08	// Node internal: already attached to a message sent
+} eTraceHopFlags;
+
+typedef struct traceHop {
+	nodeId node;					// Node
+	uint8_t type;					// Message received (eMsgType), or sent if not TRACEHOP_RX
+	uint8_t flags;					// Timestamps set (eTraceHopFlags)
+	uint8_t padding[2];				// Padding to allign to 32bit
+	int32_t rxAt;					// Timestamps: us since the trace origin (node realtime clock)
+	int32_t fsmAt;
+	int32_t txAt;
+} traceHop;
+
+typedef struct msgTrace {
+	uint32_t traceId;				// Trace Id chosen by the host (0 = not traced)
+	uint8_t numHops;				// Hops following (on the wire only these ones)
+	uint8_t droppedHops;			// Hops not recorded (trace full)
+	uint8_t padding[2];				// Padding to 64bit
+	int64_t origin;					// Realtime (us) the first node received the request
+	traceHop hops[MSG_TRACEMAXHOPS];
+} msgTrace;
+
 /**  message ROUTE types  */
 typedef struct msgRouteREQ {
 	routeId requestRouteId;			// Requested route Id
+	uint32_t batch;					// Route of a host batch (set by its first node only, if the message is long enough)
+	msgTrace trace;					// Route trace (only if the message is long enough)
 } msgRouteREQ;
+typedef struct msgRouteREQBATCH {
+	uint32_t numRoutes;				// Number of routes following (1..MSG_ROUTEBATCHMAXROUTES)
+} msgRouteREQBATCH;					// followed by numRoutes routeId
 typedef struct msgRouteACK {
 	routeId requestRouteId;			// Requested route Id
+	uint32_t points;				// Points still to move from the source to the last node (the COMMIT/AGREE wait includes them)
+	msgTrace trace;					// Route trace (only if the message is long enough)
 } msgRouteACK;
 typedef struct msgRouteNACK {
 	routeId requestRouteId;			// Requested route Id
+	uint32_t padding;				// Padding to 64bit
+	msgTrace trace;					// Route trace (only if the message is long enough)
 } msgRouteNACK;
 typedef struct msgRouteCOMMIT {
 	routeId requestRouteId;			// Requested route Id
+	uint32_t padding;				// Padding to 64bit
+	msgTrace trace;					// Route trace (only if the message is long enough)
 } msgRouteCOMMIT;
 typedef struct msgRouteAGREE {
 	routeId requestRouteId;			// Requested route Id
+	uint32_t padding;				// Padding to 64bit
+	msgTrace trace;					// Route trace (only if the message is long enough)
 } msgRouteAGREE;
 typedef struct msgRouteDISAGREE {
 	routeId requestRouteId;			// Requested route Id
+	uint32_t padding;				// Padding to 64bit
+	msgTrace trace;					// Route trace (only if the message is long enough)
 } msgRouteDISAGREE;
 typedef struct msgRouteTRAINOK {
 	routeId requestRouteId;			// Requested route Id
+	uint32_t padding;				// Padding to 64bit
+	msgTrace trace;					// Route trace (only if the message is long enough)
 } msgRouteTRAINOK;
 typedef struct msgRouteTRAINNOK {
 	routeId requestRouteId;			// Requested route Id
+	uint32_t padding;				// Padding to 64bit
+	msgTrace trace;					// Route trace (only if the message is long enough)
 } msgRouteTRAINNOK;
+typedef struct msgRouteRELEASE {
+	routeId requestRouteId;			// Requested route Id
+	uint32_t padding;				// Padding to 64bit
+} msgRouteRELEASE;
 
 /**  message POINT types */
 typedef struct msgPOINTMALFUNC {
@@ -171,6 +307,15 @@ typedef struct msgLOGSEND {
 	uint32_t totalLines;			// Total number of lines
 	logMessage line;
 } msgLogSEND;
+typedef struct msgLOGSENDBULK {
+	uint32_t firstLine;				// Line number of the first line in the message
+	uint32_t totalLines;			// Total number of lines
+	uint32_t numLines;				// Number of lines in the message
+	uint32_t padding;				// Padding to 64bit
+	// Node internal only: on the wire the lines follow the fields above
+	const logMessage *pLines;		// Lines to send
+	bool last;						// Last message of the log export
+} msgLogSENDBULK;
 typedef struct msgLOGDEL {
 } msgLogDEL;
 typedef struct msgLOGDELACK {
@@ -192,6 +337,11 @@ typedef struct msgICommTxCONFIGSET {
 } msgICommTxCONFIGSET;
 typedef struct msgICommTxCONFIGRESET {
 } msgICommTxCONFIGRESET;
+typedef struct msgICommTxDGRAMACK {
+	nodeId source;					// Node acknowledging the datagram
+	uint32_t session;				// Session of the acknowledged datagram
+	uint32_t sequence;				// Sequence number of the acknowledged datagram
+} msgICommTxDGRAMACK;
 
 /** message NDDE types */ 
 typedef struct msgINodeCONFIGSET {
@@ -199,43 +349,62 @@ typedef struct msgINodeCONFIGSET {
 	uint8_t padding[3];	
 	uint32_t numRoutes;				// Total number (N) of segments in the configuration
 	route *pRoute;					// Pointer to array of routes
+	uint32_t numMembers;			// Number of routes coordinated by the node (star mode)
+	routeMembers *pMembers;			// Pointer to array of members of the coordinated routes
 } msgINodeCONFIGSET;
 typedef struct msgICtrlCONFIGRESET {
 } msgINodeCONFIGRESET;
+typedef struct msgINodeSTATS {
+	nodeId destination;				// Node destination (host)
+	msgQStats stats;
+} msgINodeSTATS;
 
 /** message ROUTE types */
 typedef struct msgIRouteREQ {
 	nodeId destination;				// Node destination
 	routeId requestRouteId;			// Requested route Id
+	msgTrace trace;					// Route trace (traceId 0 = not traced)
 } msgIRouteREQ;
 typedef struct msgIRouteACK {
 	nodeId destination;				// Node destination
 	routeId requestRouteId;			// Requested route Id
+	msgTrace trace;					// Route trace (traceId 0 = not traced)
+	uint32_t points;				// Points still to move from this node to the last one
 } msgIRouteACK;
 typedef struct msgIRouteNACK {
 	nodeId destination;				// Node destination
 	routeId requestRouteId;			// Requested route Id
+	msgTrace trace;					// Route trace (traceId 0 = not traced)
 } msgIRouteNACK;
 typedef struct msgIRouteCOMMIT {
 	nodeId destination;				// Node destination
 	routeId requestRouteId;			// Requested route Id
+	msgTrace trace;					// Route trace (traceId 0 = not traced)
 } msgIRouteCOMMIT;
 typedef struct msgIRouteAGREE {
 	nodeId destination;				// Node destination
 	routeId requestRouteId;			// Requested route Id
+	msgTrace trace;					// Route trace (traceId 0 = not traced)
 } msgIRouteAGREE;
 typedef struct msgIRouteDISAGREE {
 	nodeId destination;				// Node destination
 	routeId requestRouteId;			// Requested route Id
+	msgTrace trace;					// Route trace (traceId 0 = not traced)
 } msgIRouteDISAGREE;
 typedef struct msgIRouteTRAINOK {
 	nodeId destination;				// Node destination
 	routeId requestRouteId;			// Requested route Id
+	msgTrace trace;					// Route trace (traceId 0 = not traced)
 } msgIRouteTRAINOK;
 typedef struct msgIRouteTRAINNOK {
 	nodeId destination;				// Node destination
 	routeId requestRouteId;			// Requested route Id
+	msgTrace trace;					// Route trace (traceId 0 = not traced)
 } msgIRouteTRAINNOK;
+typedef struct msgIRouteRELEASE {
+	nodeId destination;				// Node destination
+	routeId requestRouteId;			// Requested route Id
+} msgIRouteRELEASE;
 
 /** message SENSOR types */
 typedef struct msgISENSORSTATE {
@@ -245,6 +414,7 @@ typedef struct msgISENSORSTATE {
 typedef struct msgISENSORNOTIFY {
 	struct timespec requestTimestamp;	// Timestamp of the request as nonce
 	eSensorState currentState;
+	struct timespec changedAt;			// Current state reached (monotonic clock)
 } msgISensorNOTIFY;
 
 /** message POINT types */
@@ -270,6 +440,14 @@ typedef struct msgILOGSEND {
 	uint32_t totalLines;			// Total number of lines
 	logMessage line;
 } msgILogSEND;
+typedef struct msgILOGSENDBULK {
+	nodeId destination;
+	uint32_t firstLine;				// Line number of the first line in the message
+	uint32_t totalLines;			// Total number of lines
+	uint32_t numLines;				// Number of lines in the message
+	const logMessage *pLines;		// Lines to send (log export area, released by dixlCommTx after the last one)
+	bool last;						// Last message of the log export
+} msgILogSENDBULK;
 typedef struct msgILOGDELACK {
 	nodeId destination;
 } msgILogDELACK;
@@ -283,6 +461,8 @@ typedef struct msgIDIAGERRCOMM {
 
 /** message TIMEOUT types */
 typedef struct msgITIMEOUTNOTIFY {
+	uint32_t owner;						// Owner value of the timer
+	uint32_t timerId;					// Arm sequence of the timer (stale if re-armed or cancelled)
 } msgITimeoutNotify;
 
 
@@ -298,9 +478,16 @@ typedef struct message {
 				msgInitRESET 		initReset;
 				msgInitCONFIG 		initConfig;
 				msgInitCONFIGTYPE 	initConfigType;
+				msgInitCONFIGBULK	initConfigBulk;
+				msgInitCONFIGMEMBERS initConfigMembers;
+
+				// NODE
+				msgNodeSTATSREQ		nodeStatsReq;
+				msgNodeSTATS		nodeStats;
 				
 				// ROUTE
 				msgRouteREQ         routeReq;
+				msgRouteREQBATCH	routeReqBatch;
 				msgRouteACK        	routeAck;
 				msgRouteNACK        routeNAck;
 				msgRouteCOMMIT     	routeCommit;
@@ -308,12 +495,14 @@ typedef struct message {
 				msgRouteDISAGREE    routeDisagree;
 				msgRouteTRAINOK     routeTrainOk;
 				msgRouteTRAINNOK    routeTrainNOk;	
+				msgRouteRELEASE		routeRelease;
 				
 				// POINT MALFUNCTION
 				msgPointMalfunc    	pointMalfunc;
 
 				//LOG
 				msgLogSEND 			logSend;
+				msgLogSENDBULK		logSendBulk;
 				msgLogDELACK		logDelAck;
 
 				// DIAG
@@ -327,10 +516,12 @@ typedef struct message {
 				// COMMTX
 				msgICommTxCONFIGSET   	commTxIConfigSet;
 				msgICommTxCONFIGRESET 	commTxIConfigReset;
+				msgICommTxDGRAMACK	 	commTxIDgramAck;
 
 				// NODE (CTRL + DIAG)
 				msgINodeCONFIGSET   	nodeIConfigSet;
 				msgINodeCONFIGRESET 	nodeIConfigReset;
+				msgINodeSTATS			nodeIStats;
 				
 				// ROUTE
 				msgIRouteREQ        	routeIReq;
@@ -341,6 +532,7 @@ typedef struct message {
 				msgIRouteDISAGREE   	routeIDisagree;
 				msgIRouteTRAINOK    	routeITrainOk;
 				msgIRouteTRAINNOK   	routeITrainNOk;
+				msgIRouteRELEASE		routeIRelease;
 
 				// SENSOR
 				msgISensorSTATE        	sensorIPOS;			
@@ -354,6 +546,7 @@ typedef struct message {
 				// LOG
 				msgILog 				logILog;
 				msgILogSEND 			logISend;
+				msgILogSENDBULK			logISendBulk;
 				msgILogDELACK 			logIDelAck;
 
 				// DIAG
@@ -16,7 +16,9 @@
 #include "globals.h"
 #include "config.h"
 #include "includes/hw.h"
+#include "includes/network.h"
 #include "includes/utils.h"
+#include "includes/timerWheel.h"
 #include "tasks/dixlInit.h"
 #include "version.h"
 
@@ -44,6 +46,12 @@ uint_t start(void) {
 	// Time setting
 	time_set(NTPServer, NTPTimezoneOffset);
 	
+	// Messages pool (used by all the tasks queues)
+	msgPool_Initialize();
+	
+	// Timer wheel (used by the tasks timeouts)
+	timerWheel_Initialize();
+	
 	// Spawn the Initialization task
 	syslog(LOG_INFO, "Spawning Initialization task...");
 	
@@ -68,7 +76,13 @@ uint_t stop(void) {
 	task_shutdown(&taskPointId, TASKPOINTDESC, &msgQPointId, NULL, &semPosition);
 	task_shutdown(&taskSensorId, TASKSENSORDESC, &msgQSensorId, NULL, &semSensor);
 	task_shutdown(&taskLogId, TASKLOGDESC, &msgQLogId, NULL, NULL);
+	task_shutdown(&taskTimerId, TASKTIMERDESC, NULL, NULL, &semTimer);
 	task_shutdown(&taskCommRxId, TASKCOMMRXDESC, NULL, &dixlCommRxSocket, NULL);
+	if (dixlCommRxDgramSocket)
+		if (socket_close(dixlCommRxDgramSocket) == SOCK_OK) {
+			syslog(LOG_INFO, "%s task Datagram socket closed", TASKCOMMRXDESC);
+			dixlCommRxDgramSocket = 0;
+		}
 	task_shutdown(&taskInitId, TASKINITDESC, &msgQInitId, NULL, NULL);
 	
 	// GPIO freeing
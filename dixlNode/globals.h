@@ -38,6 +38,7 @@ extern 	TASK_ID 	taskLogId;			// Log task ID
 extern 	TASK_ID 	taskDiagId;			// Diag task ID
 extern 	TASK_ID 	taskPointId;		// Point task ID
 extern 	TASK_ID 	taskSensorId;		// Sensor task ID
+extern 	TASK_ID 	taskTimerId;		// Timer task ID
 
 /***************************************************
  *  Messages queues
@@ -55,6 +56,7 @@ extern 	MSG_Q_ID 	msgQSensorId;    	// Sensor task IN Queue Id
  *  Sockets
  ***************************************************/
 extern 	int         dixlCommRxSocket;	// Comm Rx task IN Socket
+extern 	int         dixlCommRxDgramSocket;	// Comm Rx task IN Socket (datagrams)
 
 /***************************************************
  *  Semaphores
@@ -62,6 +64,7 @@ extern 	int         dixlCommRxSocket;	// Comm Rx task IN Socket
 extern SEM_ID semPosition;							// Semaphore to access position
 extern SEM_ID semSensor;							// Semaphore to access sensor
 extern SEM_ID semDiag;							    // Semaphore to access internal variables
+extern SEM_ID semTimer;								// Semaphore to access the timer wheel
 
 #endif /* GLOBALS_H_ */
  
@@ -0,0 +1,483 @@
+/**
+ * msgPool.c
+ *
+ * Preallocated messages pool: tasks queues carry only the reference of a pool message
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <msgQLib.h>
+#include <semLib.h>
+#include <sysLib.h>
+#include <syslog.h>
+#include <taskLib.h>
+#include <objLibCommon.h>
+
+#include "../config.h"
+#include "../globals.h"
+#include "msgPool.h"
+#include "msgQRing.h"
+#include "utils.h"
+
+/* types */
+// Pool message: any message received by Comm Rx fits
+typedef struct msgPoolBuffer {
+	union {
+		message message;
+		char buffer[MSG_MAXLENGTH];
+	};
+	struct timespec sentAt;					// Timestamp (monotonic) of the send, for the queue residency time
+} msgPoolBuffer;
+
+// Queue sending policy and statistics
+typedef struct msgQInfo {
+	MSG_Q_ID msgQId;						// Queue (NULL = unused)
+	msgQRing *pRing;						// Ring replacing the queue (or NULL)
+	eMsgQPolicy policy;						// Sending policy (when the queue is full, coalesce at every send)
+	int32_t msTimeout;						// Max wait (ms) with MSGQPOLICY_BLOCK
+	SEM_ID semCoalesce;						// Queue, receive and merge in mutex (MSGQPOLICY_COALESCE)
+	SEM_ID semQueued;						// Queued messages count, the receiver waits on it (MSGQPOLICY_COALESCE)
+	message *pCoalesce[MSGQCOALESCEMAX];	// Queued messages to merge in (MSGQPOLICY_COALESCE)
+	bool dropping;							// Last send dropped (logged once)
+	int maxMsgs;							// Max number of messages accepted
+	// Updated by the producers (any task): atomic
+	atomic_int highWater;					// Max messages queued at the same time
+	atomic_ulong sent;						// Messages sent
+	atomic_ulong blocked;					// Sends that waited the queue
+	atomic_ulong blockedMs;					// Total wait (ms)
+	atomic_ulong dropsNewest;				// New messages dropped (queue full)
+	atomic_ulong dropsOldest;				// Queued messages dropped for new ones
+	atomic_ulong dropsPool;					// Messages lost before the queue (pool exhausted)
+	atomic_ulong coalesced;					// Messages merged in a queued one
+	// Updated by the receiver only
+	ulong_t received;						// Messages received
+	ulong_t residency[MSG_QSTATSBUCKETS];	// Messages received by time spent queued (<1ms, <10ms ... >=10s)
+} msgQInfo;
+
+/* variables */
+static msgPoolBuffer pool[MSGPOOLSIZE];			// Messages
+static message *freeList[MSGPOOLSIZE];			// Free messages (stack)
+static int numFree = 0;							// Free messages in the stack
+static SEM_ID semFree = NULL;					// Free messages count (Alloc waits on it)
+static SEM_ID semPool = NULL;					// Free list and statistics mutex
+
+// Queues (policy and statistics)
+static msgQInfo queues[MSGQMAX];
+
+// Statistics
+static ulong_t allocs = 0;						// Messages allocated
+static ulong_t exhausted = 0;					// Allocations that found the pool empty
+static ulong_t allocFailures = 0;				// Allocations failed (still empty after MSGPOOLALLOCTIMEOUT)
+static ulong_t lowFailures = 0;					// Low priority allocations failed (only the reserved messages free)
+static int highWater = 0;						// Max messages in use at the same time
+
+/* FUNCTIONS helpers */
+void msgPool_Initialize() {
+	// Restart: messages held by the deleted tasks are free again
+	if (semPool) semDelete(semPool);
+	if (semFree) semDelete(semFree);
+	
+	for (int i = 0; i < MSGPOOLSIZE; i++)
+		freeList[i] = &pool[i].message;
+	numFree = MSGPOOLSIZE;
+
+	semPool = semMCreate(SEM_Q_FIFO);
+	semFree = semCCreate(SEM_Q_FIFO, MSGPOOLSIZE);
+	if (!semPool || !semFree) {
+		int err = errno;
+		syslog(LOG_ERR, "Message pool initialization error %d: %s", err, strerror(err));
+		taskExit(rcMSGPOOL_INITERR);
+	}
+
+	syslog(LOG_INFO, "Message pool initialized (%d messages)", MSGPOOLSIZE);
+}
+
+message *msgPool_Alloc() {
+	// Wait a free message (count the pool found empty)
+	if (semTake(semFree, NO_WAIT) != OK) {
+		semTake(semPool, WAIT_FOREVER);
+		exhausted++;
+		semGive(semPool);
+
+		if (semTake(semFree, MSGPOOLALLOCTIMEOUT * sysClkRateGet() / 1000) != OK) {
+			semTake(semPool, WAIT_FOREVER);
+			allocFailures++;
+			semGive(semPool);
+			syslog(LOG_ERR, "Message pool exhausted: message dropped");
+			return NULL;
+		}
+	}
+
+	// Pop it
+	semTake(semPool, WAIT_FOREVER);
+	message *pMessage = freeList[--numFree];
+	allocs++;
+	if (MSGPOOLSIZE - numFree > highWater)
+		highWater = MSGPOOLSIZE - numFree;
+	semGive(semPool);
+
+	memset(pMessage, 0, sizeof(message));
+	return pMessage;
+}
+
+message *msgPool_AllocLow() {
+	// Never waits: the reserved messages are left to the other allocations
+	semTake(semPool, WAIT_FOREVER);
+	if (numFree <= MSGPOOLRESERVED || semTake(semFree, NO_WAIT) != OK) {
+		lowFailures++;
+		semGive(semPool);
+		return NULL;
+	}
+	
+	// Pop it
+	message *pMessage = freeList[--numFree];
+	allocs++;
+	if (MSGPOOLSIZE - numFree > highWater)
+		highWater = MSGPOOLSIZE - numFree;
+	semGive(semPool);
+
+	memset(pMessage, 0, sizeof(message));
+	return pMessage;
+}
+
+void msgPool_Free(message *pMessage) {
+	msgPoolBuffer *pBuffer = (msgPoolBuffer *) pMessage;
+
+	// Only messages of the pool
+	if (pBuffer < pool || pBuffer >= &pool[MSGPOOLSIZE]) {
+		syslog(LOG_ERR, "Message pool free error: %p isn't a pool message", pMessage);
+		return;
+	}
+
+	// Push it
+	semTake(semPool, WAIT_FOREVER);
+	freeList[numFree++] = pMessage;
+	semGive(semPool);
+	semGive(semFree);
+}
+
+/* Queues */
+static msgQInfo *queue_get(MSG_Q_ID msgQId) {
+	if (!msgQId)
+		return NULL;
+	for (int i = 0; i < MSGQMAX; i++)
+		if (queues[i].msgQId == msgQId)
+			return &queues[i];
+	return NULL;
+}
+
+/* Put a reference in the queue (or its ring) waiting at most timeout */
+static bool queue_put(msgQInfo *pQueue, message *pMessage, _Vx_ticks_t timeout) {
+	if (pQueue->pRing)
+		return msgQRing_Send(pQueue->pRing, pMessage, timeout);
+	
+	if (msgQSend(pQueue->msgQId, (char *) &pMessage, sizeof(pMessage), timeout, MSG_PRI_NORMAL) == OK)
+		return TRUE;
+	
+	int err = errno;
+	if (err != S_objLib_OBJ_TIMEOUT && err != S_objLib_OBJ_UNAVAILABLE)
+		syslog(LOG_ERR, "Message queue send error %d: %s", err, strerror(err));
+	return FALSE;
+}
+
+/* Remove the oldest reference from the queue (not for rings: single receiver) */
+static message *queue_takeOldest(msgQInfo *pQueue) {
+	message *pOldest = NULL;
+	if (pQueue->pRing || msgQReceive(pQueue->msgQId, (char *) &pOldest, sizeof(pOldest), NO_WAIT) == ERROR)
+		return NULL;
+	return pOldest;
+}
+
+/* Message queued: count it and track the high-water mark */
+static void queue_sent(msgQInfo *pQueue) {
+	atomic_fetch_add(&pQueue->sent, 1);
+	int depth = msgQ_NumMsgs(pQueue->msgQId);
+	int highWater = atomic_load(&pQueue->highWater);
+	while (depth > highWater && !atomic_compare_exchange_weak(&pQueue->highWater, &highWater, depth))
+		;
+}
+
+/* Merge the message in a queued one of the same type, else queue it if there is room (tracked for the next ones).
+ * Under the same lock the receiver takes a message and forgets it: a message taken is never merged in */
+static bool queue_coalesce(msgQInfo *pQueue, message *pMessage) {
+	bool merged = FALSE;
+	bool queued = FALSE;
+	
+	semTake(pQueue->semCoalesce, WAIT_FOREVER);
+	for (int i = 0; i < MSGQCOALESCEMAX; i++) {
+		if (pQueue->pCoalesce[i] && pQueue->pCoalesce[i]->iHeader.type == pMessage->iHeader.type) {
+			memcpy(pQueue->pCoalesce[i], pMessage, MSG_MAXLENGTH);
+			merged = TRUE;
+			break;
+		}
+	}
+	if (!merged && queue_put(pQueue, pMessage, NO_WAIT)) {
+		queued = TRUE;
+		for (int i = 0; i < MSGQCOALESCEMAX; i++)
+			if (!pQueue->pCoalesce[i]) {
+				pQueue->pCoalesce[i] = pMessage;
+				break;
+			}
+		semGive(pQueue->semQueued);
+	}
+	semGive(pQueue->semCoalesce);
+	
+	if (merged) {
+		atomic_fetch_add(&pQueue->coalesced, 1);
+		msgPool_Free(pMessage);
+	}
+	if (queued)
+		queue_sent(pQueue);
+	return merged || queued;
+}
+
+/* Take a queued message and forget it (the receiver of a MSGQPOLICY_COALESCE queue) */
+static message *queue_coalesceTake(msgQInfo *pQueue, _Vx_ticks_t timeout) {
+	message *pMessage = NULL;
+	if (semTake(pQueue->semQueued, timeout) != OK)
+		return NULL;
+	
+	semTake(pQueue->semCoalesce, WAIT_FOREVER);
+	if (pQueue->pRing)
+		pMessage = msgQRing_Receive(pQueue->pRing, NO_WAIT);
+	else if (msgQReceive(pQueue->msgQId, (char *) &pMessage, sizeof(pMessage), NO_WAIT) == ERROR)
+		pMessage = NULL;
+	for (int i = 0; pMessage && i < MSGQCOALESCEMAX; i++)
+		if (pQueue->pCoalesce[i] == pMessage) {
+			pQueue->pCoalesce[i] = NULL;
+			break;
+		}
+	semGive(pQueue->semCoalesce);
+	return pMessage;
+}
+
+/* Message taken by the receiver: count it by time spent queued */
+static void queue_received(msgQInfo *pQueue, message *pMessage) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double ms = time_timespecdiff(&now, &((msgPoolBuffer *) pMessage)->sentAt) * 1000;
+	
+	int bucket = 0;
+	for (double limit = 1; bucket < MSG_QSTATSBUCKETS - 1 && ms >= limit; limit *= 10)
+		bucket++;
+	pQueue->residency[bucket]++;
+	pQueue->received++;
+}
+
+void msgQ_Register(MSG_Q_ID msgQId, size_t maxMsgs) {
+	semTake(semPool, WAIT_FOREVER);
+	for (int i = 0; i < MSGQMAX; i++)
+		if (!queues[i].msgQId) {
+			memset(&queues[i], 0, sizeof(msgQInfo));
+			queues[i].pRing = msgQRing_Get(msgQId);
+			queues[i].policy = MSGQPOLICY_BLOCK;
+			queues[i].msTimeout = WAIT_FOREVER;
+			queues[i].maxMsgs = (int) maxMsgs;
+			queues[i].msgQId = msgQId;
+			break;
+		}
+	semGive(semPool);
+}
+
+void msgQ_Unregister(MSG_Q_ID msgQId) {
+	msgQInfo *pQueue = queue_get(msgQId);
+	if (!pQueue)
+		return;
+	
+	if (pQueue->semCoalesce)
+		semDelete(pQueue->semCoalesce);
+	if (pQueue->semQueued)
+		semDelete(pQueue->semQueued);
+	pQueue->msgQId = NULL;
+}
+
+void msgQ_SetPolicy(MSG_Q_ID msgQId, eMsgQPolicy policy, int32_t msTimeout) {
+	msgQInfo *pQueue = queue_get(msgQId);
+	if (!pQueue)
+		return;
+	
+	// A ring has a single receiver: producers can't remove the oldest message
+	if (policy == MSGQPOLICY_DROPOLDEST && pQueue->pRing) {
+		syslog(LOG_WARNING, "Message queue drop-oldest policy not available on a ring: drop-newest used");
+		policy = MSGQPOLICY_DROPNEWEST;
+	}
+	if (policy == MSGQPOLICY_COALESCE && !pQueue->semCoalesce) {
+		pQueue->semCoalesce = semMCreate(SEM_Q_FIFO);
+		pQueue->semQueued = semCCreate(SEM_Q_FIFO, msgQ_NumMsgs(msgQId));
+	}
+	
+	pQueue->msTimeout = msTimeout;
+	pQueue->policy = policy;
+}
+
+bool msgQ_SendRef(MSG_Q_ID msgQId, message *pMessage) {
+	msgQInfo *pQueue = queue_get(msgQId);
+	if (!pQueue) {
+		syslog(LOG_ERR, "Message queue send error: queue not initialized");
+		msgPool_Free(pMessage);
+		return FALSE;
+	}
+	
+	// Timestamp for the residency time (a merged message keeps the queued one)
+	clock_gettime(CLOCK_MONOTONIC, &((msgPoolBuffer *) pMessage)->sentAt);
+	
+	// Merged in a queued message of the same type (or queued), else dropped
+	if (pQueue->policy == MSGQPOLICY_COALESCE) {
+		if (queue_coalesce(pQueue, pMessage)) {
+			pQueue->dropping = FALSE;
+			return TRUE;
+		}
+	}
+	
+	// Room in the queue: sent
+	else if (queue_put(pQueue, pMessage, NO_WAIT)) {
+		queue_sent(pQueue);
+		pQueue->dropping = FALSE;
+		return TRUE;
+	}
+	
+	// Full: apply the policy
+	bool sent = FALSE;
+	switch (pQueue->policy) {
+		case MSGQPOLICY_BLOCK:
+			if (pQueue->msTimeout != NO_WAIT) {
+				struct timespec start, end;
+				clock_gettime(CLOCK_MONOTONIC, &start);
+				sent = queue_put(pQueue, pMessage, (pQueue->msTimeout == WAIT_FOREVER) ? WAIT_FOREVER : math_ceil(pQueue->msTimeout * sysClkRateGet(), 1000));
+				clock_gettime(CLOCK_MONOTONIC, &end);
+				atomic_fetch_add(&pQueue->blocked, 1);
+				atomic_fetch_add(&pQueue->blockedMs, (ulong_t) (time_timespecdiff(&end, &start) * 1000));
+			}
+			break;
+			
+		case MSGQPOLICY_DROPOLDEST: {
+			message *pOldest = queue_takeOldest(pQueue);
+			if (pOldest) {
+				msgPool_Free(pOldest);
+				atomic_fetch_add(&pQueue->dropsOldest, 1);
+			}
+			sent = queue_put(pQueue, pMessage, NO_WAIT);
+			break;
+		}
+		
+		default:
+			break;
+	}
+	
+	// Not sent: the new one is dropped
+	if (!sent) {
+		msgPool_Free(pMessage);
+		atomic_fetch_add(&pQueue->dropsNewest, 1);
+		if (!pQueue->dropping)
+			syslog(LOG_WARNING, "Message queue 0x%jx full: dropping messages", (uintmax_t) (uintptr_t) msgQId);
+	}
+	pQueue->dropping = !sent;
+	if (sent)
+		queue_sent(pQueue);
+	
+	return sent;
+}
+
+bool msgQ_TrySendRef(MSG_Q_ID msgQId, message *pMessage) {
+	msgQInfo *pQueue = queue_get(msgQId);
+	if (!pQueue) {
+		syslog(LOG_ERR, "Message queue send error: queue not initialized");
+		return FALSE;
+	}
+	
+	// Merged in a queued message of the same type or queued (counted as sent by the merge)
+	clock_gettime(CLOCK_MONOTONIC, &((msgPoolBuffer *) pMessage)->sentAt);
+	if (pQueue->policy == MSGQPOLICY_COALESCE)
+		return queue_coalesce(pQueue, pMessage);
+	
+	if (!queue_put(pQueue, pMessage, NO_WAIT))
+		return FALSE;
+	queue_sent(pQueue);
+	return TRUE;
+}
+
+void msgQ_PoolDropped(MSG_Q_ID msgQId) {
+	msgQInfo *pQueue = queue_get(msgQId);
+	if (pQueue)
+		atomic_fetch_add(&pQueue->dropsPool, 1);
+}
+
+int msgQ_NumMsgs(MSG_Q_ID msgQId) {
+	msgQInfo *pQueue = queue_get(msgQId);
+	if (pQueue && pQueue->pRing)
+		return (int) msgQRing_NumMsgs(pQueue->pRing);
+	return msgQNumMsgs(msgQId);
+}
+
+message *msgQ_ReceiveRef(MSG_Q_ID msgQId, _Vx_ticks_t timeout) {
+	message *pMessage = NULL;
+	msgQInfo *pQueue = queue_get(msgQId);
+
+	// Merged in by the producers: taken under their lock
+	if (pQueue && pQueue->policy == MSGQPOLICY_COALESCE)
+		pMessage = queue_coalesceTake(pQueue, timeout);
+	
+	// Queue replaced by a ring
+	else if (pQueue && pQueue->pRing)
+		pMessage = msgQRing_Receive(pQueue->pRing, timeout);
+	
+	// Wait for a reference ...
+	else if (msgQReceive(msgQId, (char *) &pMessage, sizeof(pMessage), timeout) == ERROR) {
+		// Error check
+		int err = errno;
+		if ((err == S_objLib_OBJ_TIMEOUT && timeout != WAIT_FOREVER) || (err == S_objLib_OBJ_UNAVAILABLE && timeout == NO_WAIT))
+			return NULL;
+
+		syslog(LOG_ERR, "Message queue receive error %d: %s", err, strerror(err));
+		taskExit(rcINQUEUE_RECEIVEERR);
+	}
+	
+	if (pMessage && pQueue)
+		queue_received(pQueue, pMessage);
+
+	return pMessage;
+}
+
+bool msgQ_GetStats(MSG_Q_ID msgQId, msgQStats *pStats) {
+	msgQInfo *pQueue = queue_get(msgQId);
+	if (!pQueue)
+		return FALSE;
+	
+	pStats->depth = (uint16_t) msgQ_NumMsgs(msgQId);
+	pStats->maxMsgs = (uint16_t) pQueue->maxMsgs;
+	pStats->highWater = (uint16_t) atomic_load(&pQueue->highWater);
+	pStats->enqueued = (uint32_t) atomic_load(&pQueue->sent);
+	pStats->dequeued = (uint32_t) pQueue->received;
+	pStats->dropped = (uint32_t) (atomic_load(&pQueue->dropsNewest) + atomic_load(&pQueue->dropsOldest));
+	pStats->poolDropped = (uint32_t) atomic_load(&pQueue->dropsPool);
+	for (int i = 0; i < MSG_QSTATSBUCKETS; i++)
+		pStats->residency[i] = (uint32_t) pQueue->residency[i];
+	return TRUE;
+}
+
+void msgQShow() {
+	static const char *policyNames[] = { "block", "drop-newest", "drop-oldest", "coalesce" };
+	
+	for (int i = 0; i < MSGQMAX; i++) {
+		if (!queues[i].msgQId)
+			continue;
+		syslog(LOG_INFO, "Message queue 0x%jx (%s%s): %d queued of %d, %d max queued", (uintmax_t) (uintptr_t) queues[i].msgQId, policyNames[queues[i].policy], queues[i].pRing ? ", ring" : "", msgQ_NumMsgs(queues[i].msgQId), queues[i].maxMsgs, atomic_load(&queues[i].highWater));
+		syslog(LOG_INFO, "  %lu sent, %lu received, %lu blocked for %lums, dropped %lu newest %lu oldest %lu pool exhausted, %lu coalesced", atomic_load(&queues[i].sent), queues[i].received, atomic_load(&queues[i].blocked), atomic_load(&queues[i].blockedMs), atomic_load(&queues[i].dropsNewest), atomic_load(&queues[i].dropsOldest), atomic_load(&queues[i].dropsPool), atomic_load(&queues[i].coalesced));
+		syslog(LOG_INFO, "  queued for <1ms %lu, <10ms %lu, <100ms %lu, <1s %lu, <10s %lu, >=10s %lu", queues[i].residency[0], queues[i].residency[1], queues[i].residency[2], queues[i].residency[3], queues[i].residency[4], queues[i].residency[5]);
+	}
+}
+
+void msgPoolShow() {
+	semTake(semPool, WAIT_FOREVER);
+	syslog(LOG_INFO, "Message pool: %d messages, %d in use, %d max in use", MSGPOOLSIZE, MSGPOOLSIZE - numFree, highWater);
+	syslog(LOG_INFO, "Message pool: %d reserved, %lu allocated, %lu found it exhausted, %lu failed, %lu low priority failed", MSGPOOLRESERVED, allocs, exhausted, allocFailures, lowFailures);
+	semGive(semPool);
+}
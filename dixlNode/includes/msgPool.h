@@ -0,0 +1,136 @@
+/**
+ * msgPool.h
+ *
+ * Preallocated messages pool: tasks queues carry only the reference of a pool message
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#ifndef INCLUDES_MSGPOOL_H_
+#define INCLUDES_MSGPOOL_H_
+#include <stdbool.h>
+#include <msgQLib.h>
+
+#include "../datatypes/messages.h"
+
+/**
+ * Defines
+ */
+#define MSGPOOL_REFLENGTH		sizeof(message *)		// Length of a queue message (the reference)
+
+/**
+ * Enums
+ */
+/* Queue sending policy: what happens when the queue is full (coalesce: at every send) */
+typedef enum {
+	MSGQPOLICY_BLOCK			= 0,	// When full: wait for room (at most the queue timeout), then drop the new message
+	MSGQPOLICY_DROPNEWEST		= 1,	// When full: drop the new message
+	MSGQPOLICY_DROPOLDEST		= 2,	// When full: drop the oldest queued message (not for rings: drop the new one)
+	MSGQPOLICY_COALESCE			= 3,	// Always: merge in a queued message of the same type, else queue it (dropped if full)
+} eMsgQPolicy;
+
+/* FUNCTIONS helpers */
+
+/**
+ * Initialize the pool (before any task uses a queue)
+ */
+void msgPool_Initialize();
+
+/**
+ * Get a free message (the message struct is zeroed, MSG_MAXLENGTH bytes can be used)
+ * waiting at most MSGPOOLALLOCTIMEOUT if the pool is exhausted
+ * @return the message or NULL if the pool is still exhausted
+ */
+message *msgPool_Alloc();
+
+/**
+ * Get a free message for low priority traffic (logging): never waits, the last MSGPOOLRESERVED
+ * free messages are left to the route messages
+ * @return the message or NULL if only the reserved messages are free
+ */
+message *msgPool_AllocLow();
+
+/**
+ * Give back a message to the pool
+ * @param pMessage: message got by msgPool_Alloc or msgQ_ReceiveRef
+ */
+void msgPool_Free(message *pMessage);
+
+/**
+ * Register a queue (by msgQ_Initialize): policy MSGQPOLICY_BLOCK forever
+ * @param msgQId: queue
+ * @param maxMsgs: max number of messages accepted
+ */
+void msgQ_Register(MSG_Q_ID msgQId, size_t maxMsgs);
+
+/**
+ * Unregister a queue (by msgQ_Delete)
+ * @param msgQId: queue
+ */
+void msgQ_Unregister(MSG_Q_ID msgQId);
+
+/**
+ * Set the sending policy of a queue (see eMsgQPolicy)
+ * @param msgQId: queue
+ * @param policy: policy
+ * @param msTimeout: max wait (ms) with MSGQPOLICY_BLOCK (or NO_WAIT, WAIT_FOREVER)
+ */
+void msgQ_SetPolicy(MSG_Q_ID msgQId, eMsgQPolicy policy, int32_t msTimeout);
+
+/**
+ * Send the reference of a pool message to a Queue applying its policy: the receiver owns (and frees) the message
+ * @param msgQId: queue
+ * @param pMessage: message got by msgPool_Alloc (freed if dropped)
+ * @return TRUE if sent (or merged), FALSE if dropped
+ */
+bool msgQ_SendRef(MSG_Q_ID msgQId, message *pMessage);
+
+/**
+ * Send the reference of a pool message to a Queue only if there is room, whatever its policy
+ * (for a sender that must not wait on the receiver, e.g. because the receiver may wait on it)
+ * @param msgQId: queue
+ * @param pMessage: message got by msgPool_Alloc (left to the caller if not sent)
+ * @return TRUE if sent (or merged), FALSE if the queue is full
+ */
+bool msgQ_TrySendRef(MSG_Q_ID msgQId, message *pMessage);
+
+/**
+ * Count a message for a Queue lost before the send: the pool was exhausted
+ * @param msgQId: queue
+ */
+void msgQ_PoolDropped(MSG_Q_ID msgQId);
+
+/**
+ * Number of messages in a Queue (or its ring)
+ * @param msgQId: queue
+ */
+int msgQ_NumMsgs(MSG_Q_ID msgQId);
+
+/**
+ * Get the statistics of a Queue (depth, high-water mark, counters, residency time histogram)
+ * @param msgQId: queue
+ * @param pStats: statistics (queue and totalQueues fields left to the caller)
+ * @return TRUE if the queue is registered
+ */
+bool msgQ_GetStats(MSG_Q_ID msgQId, msgQStats *pStats);
+
+/**
+ * Receive the reference of a pool message from a Queue: the caller has to free it
+ * @param msgQId: queue
+ * @param timeout: timeout in ticks (or NO_WAIT, WAIT_FOREVER)
+ * @return the message or NULL on timeout
+ */
+message *msgQ_ReceiveRef(MSG_Q_ID msgQId, _Vx_ticks_t timeout);
+
+/**
+ * Print the pool statistics
+ */
+void msgPoolShow();
+
+/**
+ * Print the queues statistics
+ */
+void msgQShow();
+
+#endif /* INCLUDES_MSGPOOL_H_ */
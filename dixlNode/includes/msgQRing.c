@@ -0,0 +1,216 @@
+/**
+ * msgQRing.c
+ *
+ * Lock-free multi-producer single-consumer ring of pool messages references,
+ * used in place of a VxWorks message queue by the tasks that opt in (MSGQ_OPT_RING)
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <semLib.h>
+#include <syslog.h>
+#include <taskLib.h>
+
+#include "../config.h"
+#include "msgPool.h"
+#include "msgQRing.h"
+
+/* types */
+// Ring cell: the sequence tells who owns it (producer: == position, consumer: == position + 1)
+typedef struct msgQRingCell {
+	atomic_size_t sequence;
+	message *pMessage;
+} msgQRingCell;
+
+struct msgQRing {
+	_Atomic(MSG_Q_ID) msgQId;				// Queue handle (NULL = unused)
+	msgQRingCell *cells;					// Cells (power of 2)
+	size_t mask;							// Number of cells - 1
+	atomic_size_t enqueuePos;				// Next position to write (producers)
+	size_t dequeuePos;						// Next position to read (consumer only)
+	atomic_bool waiting;					// Consumer waiting on semWakeup
+	SEM_ID semWakeup;						// Given by the producer that finds the consumer waiting
+	atomic_ulong full;						// Sends delayed because the ring was full
+	atomic_int senders;						// Sends in progress (waited by msgQRing_Delete)
+	atomic_bool deleted;					// Deleting: new sends refused
+};
+
+/* variables */
+static msgQRing rings[MSGQRINGMAX];
+
+/* Implementation functions */
+static bool ring_push(msgQRing *pRing, message *pMessage) {
+	size_t pos = atomic_load_explicit(&pRing->enqueuePos, memory_order_relaxed);
+	msgQRingCell *pCell;
+
+	// Claim a cell
+	for (;;) {
+		pCell = &pRing->cells[pos & pRing->mask];
+		size_t sequence = atomic_load_explicit(&pCell->sequence, memory_order_acquire);
+		intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+		if (diff == 0) {
+			if (atomic_compare_exchange_weak_explicit(&pRing->enqueuePos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+				break;
+		} else if (diff < 0)
+			return FALSE;				// full
+		else
+			pos = atomic_load_explicit(&pRing->enqueuePos, memory_order_relaxed);
+	}
+
+	// Fill and publish it
+	pCell->pMessage = pMessage;
+	atomic_store_explicit(&pCell->sequence, pos + 1, memory_order_release);
+	return TRUE;
+}
+
+static message *ring_pop(msgQRing *pRing) {
+	msgQRingCell *pCell = &pRing->cells[pRing->dequeuePos & pRing->mask];
+	size_t sequence = atomic_load_explicit(&pCell->sequence, memory_order_acquire);
+
+	// Not published yet: empty
+	if ((intptr_t) sequence - (intptr_t) (pRing->dequeuePos + 1) < 0)
+		return NULL;
+
+	// Take it and give back the cell for the next round
+	message *pMessage = pCell->pMessage;
+	atomic_store_explicit(&pCell->sequence, pRing->dequeuePos + pRing->mask + 1, memory_order_release);
+	pRing->dequeuePos++;
+	return pMessage;
+}
+
+/* FUNCTIONS helpers */
+bool msgQRing_Create(MSG_Q_ID msgQId, size_t maxMsgs) {
+	// Free slot
+	msgQRing *pRing = NULL;
+	for (int i = 0; i < MSGQRINGMAX && !pRing; i++) {
+		MSG_Q_ID unused = NULL;
+		if (atomic_compare_exchange_strong(&rings[i].msgQId, &unused, msgQId))
+			pRing = &rings[i];
+	}
+	if (!pRing) {
+		syslog(LOG_ERR, "Message ring initialization error: more than %d rings", MSGQRINGMAX);
+		return FALSE;
+	}
+
+	// Cells (power of 2)
+	size_t numCells = 2;
+	while (numCells < maxMsgs)
+		numCells <<= 1;
+	pRing->cells = malloc(numCells * sizeof(msgQRingCell));
+	pRing->semWakeup = semBCreate(SEM_Q_FIFO, SEM_EMPTY);
+	if (!pRing->cells || !pRing->semWakeup) {
+		int err = errno;
+		syslog(LOG_ERR, "Message ring initialization error %d: %s", err, strerror(err));
+		free(pRing->cells);
+		atomic_store(&pRing->msgQId, NULL);
+		return FALSE;
+	}
+	for (size_t i = 0; i < numCells; i++)
+		atomic_init(&pRing->cells[i].sequence, i);
+	pRing->mask = numCells - 1;
+	atomic_init(&pRing->enqueuePos, 0);
+	pRing->dequeuePos = 0;
+	atomic_init(&pRing->waiting, FALSE);
+	atomic_init(&pRing->full, 0);
+	atomic_init(&pRing->senders, 0);
+	atomic_store(&pRing->deleted, FALSE);
+
+	syslog(LOG_INFO, "Message ring initialized (%u messages)", (unsigned) numCells);
+	return TRUE;
+}
+
+void msgQRing_Delete(MSG_Q_ID msgQId) {
+	msgQRing *pRing = msgQRing_Get(msgQId);
+	if (!pRing)
+		return;
+
+	// Refuse the new sends, wait the ones in progress (a full ring is no longer drained: they give up)
+	atomic_store(&pRing->deleted, TRUE);
+	while (atomic_load(&pRing->senders))
+		taskDelay(1);
+
+	// Give back the messages never received, then free the slot
+	message *pMessage;
+	while ((pMessage = ring_pop(pRing)))
+		msgPool_Free(pMessage);
+	semDelete(pRing->semWakeup);
+	free(pRing->cells);
+	pRing->cells = NULL;
+	atomic_store(&pRing->msgQId, NULL);
+}
+
+msgQRing *msgQRing_Get(MSG_Q_ID msgQId) {
+	if (!msgQId)
+		return NULL;
+	for (int i = 0; i < MSGQRINGMAX; i++)
+		if (atomic_load_explicit(&rings[i].msgQId, memory_order_acquire) == msgQId)
+			return &rings[i];
+	return NULL;
+}
+
+bool msgQRing_Send(msgQRing *pRing, message *pMessage, _Vx_ticks_t timeout) {
+	// Counted as in progress before checking the deletion (msgQRing_Delete sets it, then waits the count)
+	atomic_fetch_add(&pRing->senders, 1);
+	bool sent = !atomic_load(&pRing->deleted) && ring_push(pRing, pMessage);
+
+	// Full: wait the consumer a tick at a time (at most timeout, given up if the ring is deleted)
+	if (!sent && !atomic_load(&pRing->deleted)) {
+		atomic_fetch_add_explicit(&pRing->full, 1, memory_order_relaxed);
+		for (_Vx_ticks_t waited = 0; !sent && (timeout == WAIT_FOREVER || waited < timeout) && !atomic_load(&pRing->deleted); waited++) {
+			taskDelay(1);
+			sent = ring_push(pRing, pMessage);
+		}
+	}
+
+	// Wake up the consumer only if it's waiting (the fence orders the publish before the check)
+	atomic_thread_fence(memory_order_seq_cst);
+	if (sent && atomic_load_explicit(&pRing->waiting, memory_order_relaxed) && atomic_exchange(&pRing->waiting, FALSE))
+		semGive(pRing->semWakeup);
+	atomic_fetch_sub(&pRing->senders, 1);
+	return sent;
+}
+
+message *msgQRing_Receive(msgQRing *pRing, _Vx_ticks_t timeout) {
+	message *pMessage;
+
+	for (;;) {
+		if ((pMessage = ring_pop(pRing)) || timeout == NO_WAIT)
+			return pMessage;
+
+		// Tell the producers, then check again: a message published meanwhile is not missed
+		atomic_store(&pRing->waiting, TRUE);
+		atomic_thread_fence(memory_order_seq_cst);
+		if ((pMessage = ring_pop(pRing))) {
+			atomic_store(&pRing->waiting, FALSE);
+			return pMessage;
+		}
+
+		// Wait (a wake up left by a previous round just loops again)
+		if (semTake(pRing->semWakeup, timeout) != OK) {
+			atomic_store(&pRing->waiting, FALSE);
+			return ring_pop(pRing);
+		}
+	}
+}
+
+size_t msgQRing_NumMsgs(msgQRing *pRing) {
+	return atomic_load(&pRing->enqueuePos) - pRing->dequeuePos;
+}
+
+void msgQRingShow() {
+	for (int i = 0; i < MSGQRINGMAX; i++) {
+		MSG_Q_ID msgQId = atomic_load(&rings[i].msgQId);
+		if (!msgQId)
+			continue;
+		size_t queued = msgQRing_NumMsgs(&rings[i]);
+		syslog(LOG_INFO, "Message ring 0x%jx: %u queued of %u, %lu sends found it full", (uintmax_t) (uintptr_t) msgQId, (unsigned) queued, (unsigned) (rings[i].mask + 1), atomic_load(&rings[i].full));
+	}
+}
@@ -0,0 +1,81 @@
+/**
+ * msgQRing.h
+ *
+ * Lock-free multi-producer single-consumer ring of pool messages references,
+ * used in place of a VxWorks message queue by the tasks that opt in (MSGQ_OPT_RING)
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#ifndef INCLUDES_MSGQRING_H_
+#define INCLUDES_MSGQRING_H_
+#include <stdbool.h>
+#include <msgQLib.h>
+
+#include "../datatypes/messages.h"
+
+/**
+ * Defines
+ */
+#define MSGQ_OPT_RING			0x10000			// msgQ_Initialize option: lock-free ring (pool references, single receiver)
+
+/**
+ * Types
+ */
+typedef struct msgQRing msgQRing;
+
+/* FUNCTIONS helpers */
+
+/**
+ * Create the ring of a queue
+ * @param msgQId: queue the ring replaces (used as its handle)
+ * @param maxMsgs: max number of messages (rounded up to a power of 2)
+ * @return TRUE if created
+ */
+bool msgQRing_Create(MSG_Q_ID msgQId, size_t maxMsgs);
+
+/**
+ * Delete the ring of a queue (if any): the sends in progress are waited (those waiting for room give up),
+ * the later ones refused, the messages never received given back to the pool.
+ * The receiver must be stopped before (task_shutdown deletes the task first)
+ * @param msgQId: queue
+ */
+void msgQRing_Delete(MSG_Q_ID msgQId);
+
+/**
+ * Get the ring of a queue
+ * @param msgQId: queue
+ * @return the ring or NULL if the queue is a VxWorks message queue
+ */
+msgQRing *msgQRing_Get(MSG_Q_ID msgQId);
+
+/**
+ * Send a message reference (any task), waiting a tick at a time while the ring is full
+ * @param pRing: ring
+ * @param pMessage: pool message
+ * @param timeout: max wait in ticks (or NO_WAIT, WAIT_FOREVER)
+ * @return TRUE if sent, FALSE if still full
+ */
+bool msgQRing_Send(msgQRing *pRing, message *pMessage, _Vx_ticks_t timeout);
+
+/**
+ * Receive a message reference (only the owner task)
+ * @param pRing: ring
+ * @param timeout: timeout in ticks (or NO_WAIT, WAIT_FOREVER)
+ * @return the message or NULL on timeout
+ */
+message *msgQRing_Receive(msgQRing *pRing, _Vx_ticks_t timeout);
+
+/**
+ * Number of messages in the ring
+ * @param pRing: ring
+ */
+size_t msgQRing_NumMsgs(msgQRing *pRing);
+
+/**
+ * Print the rings statistics
+ */
+void msgQRingShow();
+
+#endif /* INCLUDES_MSGQRING_H_ */
@@ -13,6 +13,7 @@
 #include <netinet/in.h>
 
 #include <syslog.h>
+#include <ioLib.h>
 #include <inetLib.h>
 #include <sockLib.h>
 #include <net/if.h>
@@ -58,10 +59,10 @@ int socket_bind(int fd, char *bind_address, int port) {
     return ret;
 }
 
-int socket_listen(int fd) {
+int socket_listen(int fd, int backlog) {
     int ret;
     /* listen for incoming request on the specific socket */
-    if ((ret = listen(fd, 1)) == SOCK_ERROR) {
+    if ((ret = listen(fd, backlog)) == SOCK_ERROR) {
     	int err = errno;
     	close(fd);
         syslog(LOG_ERR, "Listen socket error %i: %s", err, strerror(err));
@@ -92,6 +93,53 @@ int socket_connect(int fd, char *bind_address, int port) {
     return ret;
 }
 
+int socket_connect_nonblocking(int fd, char *address, int port) {
+    int on = 1;
+    struct sockaddr_in server;
+
+    memset (&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = inet_addr(address); /* the server address */
+    server.sin_port = htons(port);
+    server.sin_len = sizeof(server);
+
+    /* non-blocking mode: connect returns immediately */
+    if (ioctl(fd, FIONBIO, &on) == SOCK_ERROR) {
+    	int err = errno;
+    	close(fd);
+        syslog(LOG_ERR, "Non-blocking socket error %i: %s", err, strerror(err));
+        return SOCK_ERROR;
+    }
+
+    /* start the connection */
+    if (connect(fd, (struct sockaddr*)&server, sizeof(server)) == SOCK_OK)
+    	return SOCK_OK;
+
+    int err = errno;
+    if (err == EINPROGRESS)
+    	return SOCK_INPROGRESS;
+
+    close(fd);
+    syslog(LOG_ERR, "Connect socket error %i: %s", err, strerror(err));
+    syslog(LOG_ERR, "Connect socket error address %s", address);
+    return SOCK_ERROR;
+}
+
+int socket_connect_result(int fd) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+
+    /* pending error of the connection (0 if established) */
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == SOCK_ERROR)
+    	err = errno;
+    
+    if (err) {
+        syslog(LOG_ERR, "Connect socket error %i: %s", err, strerror(err));
+        return SOCK_ERROR;
+    }
+    return SOCK_OK;
+}
+
 int socket_accept(int fd) {
     int ret;
 	struct sockaddr_in peer_addr;
@@ -147,6 +195,24 @@ size_t socket_send(int fd, void *buffer, size_t buffer_size) {
 	return ret;	
 }
 
+ssize_t socket_sendmsg(int fd, struct iovec *iov, int iovcnt) {
+    ssize_t ret;
+    struct msghdr msg;
+
+    /* gather the buffers in a single send */
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+
+	if ((ret = sendmsg(fd, &msg, 0)) == SOCK_ERROR) {
+	    // Error (a full buffer of a non-blocking socket isn't)
+		int err=errno;
+		if (err != EWOULDBLOCK && err != EAGAIN)
+			syslog(LOG_ERR, "Sendmsg socket error %i: %s", err, strerror(err));
+	}
+	return ret;	
+}
+
 size_t socket_sendto(int fd, void *buffer, size_t buffer_size, const struct sockaddr *to, socklen_t tolen) {
     ssize_t ret;
 
@@ -183,16 +249,37 @@ size_t socket_setsockopt(int fd, int level, int optname, const void *optval, soc
 	return ret;	
 }
 
+bool socket_alive(int fd) {
+	char data;
+
+	/* peek one byte without blocking: 0 means orderly shutdown by the peer */
+	ssize_t ret = recv(fd, &data, sizeof(data), MSG_PEEK | MSG_DONTWAIT);
+	if (ret > 0)
+		return TRUE;
+	if (ret == SOCK_ERROR && (errno == EWOULDBLOCK || errno == EAGAIN))
+		return TRUE;
+
+	return FALSE;
+}
+
 void network_IPv4_to_str(const IPv4Address *IPv4, char *str) {	
 	snprintf(str, 16, "%d.%d.%d.%d", IPv4->bytes[0], IPv4->bytes[1], IPv4->bytes[2], IPv4->bytes[3]);	
 }
 
+void network_IPv4_to_sockaddr(const IPv4Address *IPv4, int port, struct sockaddr_in *sa) {
+    memset(sa, 0, sizeof(struct sockaddr_in));
+    sa->sin_family = AF_INET;
+    memcpy(&sa->sin_addr.s_addr, IPv4->bytes, sizeof(IPv4->bytes));	/* bytes already in network order */
+    sa->sin_port = htons(port);
+    sa->sin_len = sizeof(struct sockaddr_in);
+}
+
 void network_n_to_IPv4(struct sockaddr_in *sa, IPv4Address *IPv4) {
     struct in_addr addr = sa->sin_addr;
     uint32_t value = addr.s_addr;
     uint32_t mod;
     
-	for(int i=0; i<40;i++) {
+	for(int i=0; i<4;i++) {
 		mod = value % 256;
     	IPv4->bytes[i] = (unsigned char) mod;
     	value /= 256;
@@ -11,12 +11,14 @@
 #include <stdbool.h>
 
 #include <netinet/in.h>
+#include <sys/uio.h>
 
 #include "../globals.h"
 
 /* DEFINEs */
 #define 	SOCK_OK			0
 #define 	SOCK_ERROR		-1
+#define 	SOCK_INPROGRESS	1
 
 /* FUNCTIONS helpers */
 /**
@@ -38,8 +40,9 @@ int socket_bind(int fd, char *address, int port);
 /**
  *  enable connects to the socket
  *  @param fd: file descriptor of the socket
+ *  @param backlog: max number of pending connections
  */
-int socket_listen(int fd);
+int socket_listen(int fd, int backlog);
 
 /**
  * connect the socket to a server
@@ -49,6 +52,22 @@ int socket_listen(int fd);
  */
 int socket_connect(int fd, char *bind_address, int port);
 
+/**
+ * start connecting the socket to a server without blocking (the socket is left non-blocking)
+ *  @param fd: file descriptor of a opened socket
+ *  @param address: server address to connect the socket to
+ *  @param port: port to connect the socket to
+ *  @return SOCK_OK if connected, SOCK_INPROGRESS if pending (wait writable), SOCK_ERROR (socket closed)
+ */
+int socket_connect_nonblocking(int fd, char *address, int port);
+
+/**
+ * result of a pending non-blocking connect, once the socket is writable
+ *  @param fd: file descriptor of the socket
+ *  @return SOCK_OK if connected, SOCK_ERROR otherwise
+ */
+int socket_connect_result(int fd);
+
 /**
  *  accept a connection on the socket and return a new socket to manage it
  *  @param fd: file descriptor of the socket
@@ -77,6 +96,15 @@ ssize_t socket_recv(int fd, void *buffer, size_t buffer_size);
  */
 size_t socket_send(int fd, void *buffer, size_t buffer_size);
 
+/**
+ *  send many buffers into the socket with a single write
+ *  @param fd: file descriptor of the socket
+ *  @param iov: buffers to send
+ *  @param iovcnt: number of buffers
+ *  @return bytes sent (can be less than total on non-blocking sockets) or SOCK_ERROR
+ */
+ssize_t socket_sendmsg(int fd, struct iovec *iov, int iovcnt);
+
 /**
  *  send a message into the socket
  *  @param fd: file descriptor of the socket
@@ -97,6 +125,23 @@ size_t socket_sendto(int fd, void *buffer, size_t buffer_size, const struct sock
  */
 size_t socket_recvfrom(int fd, void *buffer, size_t buffer_size, struct sockaddr *from, socklen_t *fromlen);
 
+/**
+ *  set an option on the socket
+ *  @param fd: file descriptor of the socket
+ *  @param level: protocol level of the option
+ *  @param optname: option name
+ *  @param optval: pointer to the option value
+ *  @param optlen: length of the option value
+ */
+size_t socket_setsockopt(int fd, int level, int optname, const void *optval, socklen_t optlen);
+
+/**
+ *  check (without blocking) if a connected socket is still established
+ *  @param fd: file descriptor of the socket
+ *  @return TRUE if the peer hasn't closed or reset the connection
+ */
+bool socket_alive(int fd);
+
 /**
  *  get the name of the first interface excluding loopback
  *  @param ifname: buffer to store interface name
@@ -108,6 +153,14 @@ STATUS network_get_if_params(char *ifname, IPv4Address *IPv4, MACAddress *MAC);
  */
 void network_IPv4_to_str(const IPv4Address *IPv4, char *str);
 
+/**
+ *  build the socket address of a node
+ *  @param IPv4: node address
+ *  @param port: port
+ *  @param sa: socket address to fill
+ */
+void network_IPv4_to_sockaddr(const IPv4Address *IPv4, int port, struct sockaddr_in *sa);
+
 /**
  *  convert IP address from in_addr to uint8_t array
  */
@@ -0,0 +1,178 @@
+/**
+ * timerWheel.c
+ *
+ * Timers on the monotonic tick counter (not affected by the time setting): a hashed timer wheel
+ * served by the Timer task, expirations are sent as IMSGTYPE_TIMEOUTNOTIFY messages to the owner queue
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <semLib.h>
+#include <sysLib.h>
+#include <syslog.h>
+#include <taskLib.h>
+#include <tickLib.h>
+
+#include "../config.h"
+#include "../globals.h"
+#include "msgPool.h"
+#include "timerWheel.h"
+#include "utils.h"
+
+/* defines */
+#define TIMERWHEELMASK			(TIMERWHEELSLOTS - 1)
+#define TIMERWHEELBATCH			16						// Expirations notified at once (the slot is scanned again if more)
+
+/* types */
+// Expired timer, copied to notify it out of the lock
+typedef struct timerExpired {
+	MSG_Q_ID msgQId;
+	uint32_t owner;
+	uint32_t id;
+} timerExpired;
+
+/* variables */
+TASK_ID taskTimerId;
+SEM_ID semTimer;										// Wheel lock
+
+static timerItem *slots[TIMERWHEELSLOTS];				// Timers by expiry tick (modulo slots)
+static _Vx_ticks_t currentTick;							// Next tick to serve (changed only by the Timer task, with the lock)
+static uint32_t lastId = 0;								// Last arm sequence
+static uint32_t armed = 0;								// Timers armed now
+static uint32_t notified = 0;							// Expirations notified
+static uint32_t lost = 0;								// Expirations not notified (pool exhausted or queue full)
+
+/* Implementation functions */
+static void slot_unlink(timerItem *pTimer) {
+	if (pTimer->pPrev == pTimer)
+		// Slot head (pPrev points to itself)
+		slots[pTimer->expiry & TIMERWHEELMASK] = pTimer->pNext;
+	else
+		pTimer->pPrev->pNext = pTimer->pNext;
+	if (pTimer->pNext)
+		pTimer->pNext->pPrev = (pTimer->pPrev == pTimer) ? pTimer->pNext : pTimer->pPrev;
+	pTimer->pNext = NULL;
+	pTimer->pPrev = NULL;
+	armed--;
+}
+
+/* Notify the expired timers of the current tick slot (at most TIMERWHEELBATCH), then go to the next tick */
+static void slot_expire() {
+	timerExpired expired[TIMERWHEELBATCH];
+	int numExpired = 0;
+	
+	// Expired timers of the tick (the others in the slot are later rounds)
+	semTake(semTimer, WAIT_FOREVER);
+	_Vx_ticks_t tick = currentTick;
+	timerItem *pTimer = slots[tick & TIMERWHEELMASK];
+	while (pTimer && numExpired < TIMERWHEELBATCH) {
+		timerItem *pNext = pTimer->pNext;
+		if ((int32_t) (pTimer->expiry - tick) <= 0) {
+			expired[numExpired].msgQId = pTimer->msgQId;
+			expired[numExpired].owner = pTimer->owner;
+			expired[numExpired].id = pTimer->id;
+			numExpired++;
+			slot_unlink(pTimer);
+		}
+		pTimer = pNext;
+	}
+	
+	// Tick served (if more expired the slot is scanned again): timers armed from now on go after it
+	if (numExpired < TIMERWHEELBATCH)
+		currentTick++;
+	semGive(semTimer);
+	
+	// Notify the owners (out of the lock: the queue can block)
+	for (int i = 0; i < numExpired; i++) {
+		message *pMessage = msgPool_Alloc();
+		if (!pMessage) {
+			lost++;
+			continue;
+		}
+		pMessage->iHeader.type = IMSGTYPE_TIMEOUTNOTIFY;
+		pMessage->timeoutNotify.owner = expired[i].owner;
+		pMessage->timeoutNotify.timerId = expired[i].id;
+		if (msgQ_SendRef(expired[i].msgQId, pMessage))
+			notified++;
+		else
+			lost++;
+	}
+}
+
+/* Timer task: serve each tick elapsed since the last round */
+static void dixlTimer() {
+	syslog(LOG_INFO, "Task started Id 0x%jx", taskTimerId);
+	
+	FOREVER {
+		taskDelay(1);
+		
+		_Vx_ticks_t now = tickGet();
+		while ((int32_t) (now - currentTick) >= 0)
+			slot_expire();
+	}
+}
+
+/* FUNCTIONS helpers */
+void timerWheel_Initialize() {
+	memset(slots, 0, sizeof(slots));
+	currentTick = tickGet();
+	semTimer = semMCreate(SEM_Q_FIFO);
+	
+	// Spawning dixlTimer
+	syslog(LOG_INFO, "Spawning %s task...", TASKTIMERDESC);
+	taskTimerId = taskSpawn(TASKTIMERNAME, TASKTIMERPRIO, 0, TASKTIMERSTACKSIZE, (FUNCPTR) dixlTimer, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+}
+
+void timer_Init(timerItem *pTimer, MSG_Q_ID msgQId, uint32_t owner) {
+	memset(pTimer, 0, sizeof(timerItem));
+	pTimer->msgQId = msgQId;
+	pTimer->owner = owner;
+}
+
+void timer_Arm(timerItem *pTimer, int msTimeout) {
+	semTake(semTimer, WAIT_FOREVER);
+	if (pTimer->pPrev)
+		slot_unlink(pTimer);
+	
+	// Expiry tick (at least the next one, not yet served)
+	_Vx_ticks_t expiry = tickGet() + math_ceil(msTimeout * sysClkRateGet(), 1000);
+	if ((int32_t) (expiry - currentTick) < 0)
+		expiry = currentTick;
+	pTimer->expiry = expiry;
+	
+	// New sequence (0 is not armed)
+	if (++lastId == 0)
+		lastId = 1;
+	pTimer->id = lastId;
+	
+	// Slot head
+	timerItem **pSlot = &slots[expiry & TIMERWHEELMASK];
+	pTimer->pNext = *pSlot;
+	pTimer->pPrev = pTimer;
+	if (*pSlot)
+		(*pSlot)->pPrev = pTimer;
+	*pSlot = pTimer;
+	armed++;
+	semGive(semTimer);
+}
+
+void timer_Cancel(timerItem *pTimer) {
+	semTake(semTimer, WAIT_FOREVER);
+	if (pTimer->pPrev)
+		slot_unlink(pTimer);
+	pTimer->id = 0;
+	semGive(semTimer);
+}
+
+bool timer_IsCurrent(const timerItem *pTimer, const message *pMessage) {
+	return pTimer->id && pMessage->timeoutNotify.timerId == pTimer->id;
+}
+
+void timerWheelShow() {
+	syslog(LOG_INFO, "Timer wheel: %u armed, %u notified, %u lost (%d slots, tick %u)", armed, notified, lost, TIMERWHEELSLOTS, (unsigned) currentTick);
+}
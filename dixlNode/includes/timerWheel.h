@@ -0,0 +1,69 @@
+/**
+ * timerWheel.h
+ *
+ * Timers on the monotonic tick counter (not affected by the time setting): a hashed timer wheel
+ * served by the Timer task, expirations are sent as IMSGTYPE_TIMEOUTNOTIFY messages to the owner queue
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#ifndef INCLUDES_TIMERWHEEL_H_
+#define INCLUDES_TIMERWHEEL_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include <msgQLib.h>
+
+#include "../datatypes/messages.h"
+
+/* Timer (owned by the caller, linked in a wheel slot while armed) */
+typedef struct timerItem {
+	struct timerItem *pNext;		// Next in the slot
+	struct timerItem *pPrev;		// Previous in the slot (NULL = not armed)
+	_Vx_ticks_t expiry;				// Expiry tick
+	uint32_t id;					// Arm sequence (0 = not armed): notifies of a previous arm are stale
+	MSG_Q_ID msgQId;				// Owner queue
+	uint32_t owner;					// Owner value copied in the notify
+} timerItem;
+
+/* FUNCTIONS helpers */
+
+/**
+ * Initialize the wheel and spawn the Timer task (before any task uses a timer)
+ */
+void timerWheel_Initialize();
+
+/**
+ * Set the owner of a timer (not armed)
+ * @param pTimer: timer
+ * @param msgQId: queue the notify is sent to
+ * @param owner: value copied in the notify (timeoutNotify.owner)
+ */
+void timer_Init(timerItem *pTimer, MSG_Q_ID msgQId, uint32_t owner);
+
+/**
+ * Arm (or re-arm) a timer: O(1)
+ * @param pTimer: timer
+ * @param msTimeout: timeout (ms)
+ */
+void timer_Arm(timerItem *pTimer, int msTimeout);
+
+/**
+ * Cancel a timer (if armed): O(1), a notify already sent becomes stale
+ * @param pTimer: timer
+ */
+void timer_Cancel(timerItem *pTimer);
+
+/**
+ * Check a notify is of the last arm of the timer (not cancelled or re-armed meanwhile)
+ * @param pTimer: timer
+ * @param pMessage: IMSGTYPE_TIMEOUTNOTIFY message
+ */
+bool timer_IsCurrent(const timerItem *pTimer, const message *pMessage);
+
+/**
+ * Print the wheel statistics
+ */
+void timerWheelShow();
+
+#endif /* INCLUDES_TIMERWHEEL_H_ */
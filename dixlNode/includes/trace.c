@@ -0,0 +1,132 @@
+/**
+ * trace.c
+ *
+ * Route setting latency trace: hops stamped by dixlCommRx, the Ctrl FSM and dixlCommTx
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "../globals.h"
+#include "trace.h"
+
+/* Implementation functions */
+// Realtime clock (us): the hops of different nodes are compared (NTP synchronised clocks)
+static int64_t trace_now() {
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return (int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// Timestamp of a hop: us since the trace origin
+static int32_t trace_offset(const msgTrace *pTrace) {
+	return (int32_t) (trace_now() - pTrace->origin);
+}
+
+// Route messages carrying the trace (they share the layout)
+static bool trace_routeType(uint8_t type) {
+	return type >= MSGTYPE_ROUTEREQ && type <= MSGTYPE_ROUTETRAINNOK;
+}
+
+// Last hop if it's of this node
+static traceHop *trace_ownHop(msgTrace *pTrace) {
+	if (!pTrace->numHops || nodecmp(pTrace->hops[pTrace->numHops - 1].node, IPv4))
+		return NULL;
+	return &pTrace->hops[pTrace->numHops - 1];
+}
+
+// Append a hop of this node (counted as dropped if the trace is full)
+static traceHop *trace_addHop(message *pMessage, msgTrace *pTrace, uint8_t type) {
+	if (pTrace->numHops == MSG_TRACEMAXHOPS) {
+		if (pTrace->droppedHops < UINT8_MAX)
+			pTrace->droppedHops++;
+		return NULL;
+	}
+
+	traceHop *pHop = &pTrace->hops[pTrace->numHops++];
+	memset(pHop, 0, sizeof(traceHop));
+	pHop->node = IPv4;
+	pHop->type = type;
+	pMessage->header.lentgh = sizeof(msgHeader) + offsetof(msgRouteREQ, trace) + trace_Size(pTrace);
+	return pHop;
+}
+
+/* FUNCTIONS helpers */
+msgTrace *trace_Find(message *pMessage) {
+	size_t offset = sizeof(msgHeader) + offsetof(msgRouteREQ, trace);
+	if (!trace_routeType(pMessage->header.type) || pMessage->header.lentgh < offset + offsetof(msgTrace, hops))
+		return NULL;
+
+	msgTrace *pTrace = &pMessage->routeReq.trace;
+	if (!pTrace->traceId || pTrace->numHops > MSG_TRACEMAXHOPS || pMessage->header.lentgh < offset + trace_Size(pTrace))
+		return NULL;
+	return pTrace;
+}
+
+size_t trace_Size(const msgTrace *pTrace) {
+	uint8_t numHops = pTrace->numHops < MSG_TRACEMAXHOPS ? pTrace->numHops : MSG_TRACEMAXHOPS;
+	return offsetof(msgTrace, hops) + numHops * sizeof(traceHop);
+}
+
+void trace_Received(message *pMessage) {
+	msgTrace *pTrace = trace_Find(pMessage);
+	if (!pTrace)
+		return;
+
+	// Request from the host: the trace starts
+	if (!pTrace->origin)
+		pTrace->origin = trace_now();
+
+	traceHop *pHop = trace_addHop(pMessage, pTrace, pMessage->header.type);
+	if (pHop) {
+		pHop->flags = TRACEHOP_RX;
+		pHop->rxAt = trace_offset(pTrace);
+	}
+}
+
+void trace_Processed(message *pMessage, msgTrace *pRouteTrace) {
+	msgTrace *pTrace = trace_Find(pMessage);
+	if (!pTrace)
+		return;
+
+	traceHop *pHop = trace_ownHop(pTrace);
+	if (pHop && pHop->type == pMessage->header.type && (pHop->flags & TRACEHOP_RX) && !(pHop->flags & TRACEHOP_FSM)) {
+		pHop->flags |= TRACEHOP_FSM;
+		pHop->fsmAt = trace_offset(pTrace);
+	}
+
+	// The last traced message received is sent on
+	memcpy(pRouteTrace, pTrace, trace_Size(pTrace));
+}
+
+void trace_Attach(message *pMessage, msgTrace *pRouteTrace) {
+	msgTrace *pTrace = &pMessage->routeIReq.trace;
+	if (!pRouteTrace->traceId) {
+		pTrace->traceId = 0;
+		return;
+	}
+	memcpy(pTrace, pRouteTrace, trace_Size(pRouteTrace));
+
+	// Sent once: the next messages of the route (if any before a new hop) are send-only hops
+	traceHop *pHop = trace_ownHop(pRouteTrace);
+	if (pHop)
+		pHop->flags |= TRACEHOP_ATTACHED;
+}
+
+void trace_Sent(message *pMessage) {
+	msgTrace *pTrace = trace_Find(pMessage);
+	if (!pTrace)
+		return;
+
+	traceHop *pHop = trace_ownHop(pTrace);
+	if (!pHop || (pHop->flags & (TRACEHOP_TX | TRACEHOP_ATTACHED)))
+		pHop = trace_addHop(pMessage, pTrace, pMessage->header.type);
+	if (pHop) {
+		pHop->flags = (pHop->flags & ~TRACEHOP_ATTACHED) | TRACEHOP_TX;
+		pHop->txAt = trace_offset(pTrace);
+	}
+}
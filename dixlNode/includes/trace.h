@@ -0,0 +1,60 @@
+/**
+ * trace.h
+ *
+ * Route setting latency trace: a route request traced by the host carries a hop for each message
+ * received by a node (received, processed by the Ctrl FSM, next message sent), back to the host with TRAINOK/TRAINNOK
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#ifndef INCLUDES_TRACE_H_
+#define INCLUDES_TRACE_H_
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../datatypes/messages.h"
+
+/* FUNCTIONS helpers */
+
+/**
+ * Trace of a received EXT route message
+ * @param pMessage: EXT message
+ * @return the trace or NULL if the message isn't traced (or the trace is malformed)
+ */
+msgTrace *trace_Find(message *pMessage);
+
+/**
+ * Length of a trace on the wire (the hops used only)
+ * @param pTrace: trace
+ */
+size_t trace_Size(const msgTrace *pTrace);
+
+/**
+ * EXT route message received by dixlCommRx: a new hop (a trace requested by the host starts here)
+ * @param pMessage: EXT message (pool message, its length is updated)
+ */
+void trace_Received(message *pMessage);
+
+/**
+ * EXT route message taken by the Ctrl FSM: FSM timestamp of the hop, trace kept by the route
+ * @param pMessage: EXT message
+ * @param pRouteTrace: trace of the route (sent with its next messages)
+ */
+void trace_Processed(message *pMessage, msgTrace *pRouteTrace);
+
+/**
+ * Trace of the route attached to an INT route message to send
+ * @param pMessage: INT route message (REQ..TRAINNOK)
+ * @param pRouteTrace: trace of the route (traceId 0 = not traced)
+ */
+void trace_Attach(message *pMessage, msgTrace *pRouteTrace);
+
+/**
+ * EXT route message handed to the transport by dixlCommTx: send timestamp of the hop,
+ * a send-only hop if the hop was already sent with a previous message (e.g. after a timeout)
+ * @param pMessage: EXT message (its length is updated)
+ */
+void trace_Sent(message *pMessage);
+
+#endif /* INCLUDES_TRACE_H_ */
@@ -19,6 +19,8 @@
 #include <objLibCommon.h>
 
 #include "../globals.h"
+#include "msgPool.h"
+#include "msgQRing.h"
 #include "network.h"
 #include "ntp.h"
 
@@ -27,14 +29,21 @@
 MSG_Q_ID msgQ_Initialize(size_t maxMsgs, size_t maxMsgLength, int options) {
 	MSG_Q_ID msgQId = 0;
 	
-	// Initialize Message Queue
-	if ((msgQId = msgQCreate(maxMsgs, maxMsgLength, options)) == NULL) {
+	// Initialize Message Queue (only the handle if replaced by a ring)
+	if ((msgQId = msgQCreate((options & MSGQ_OPT_RING) ? 1 : maxMsgs, maxMsgLength, options & ~MSGQ_OPT_RING)) == NULL) {
 		int err = errno;
 		/* initialization failed */
 		syslog(LOG_ERR, "Message queue initialization error %d: %s", err, strerror(err));
 		taskExit(rcINQUEUE_INITERR);      
 	}
 	
+	// Lock-free ring in place of the queue
+	if ((options & MSGQ_OPT_RING) && !msgQRing_Create(msgQId, maxMsgs))
+		taskExit(rcINQUEUE_INITERR);
+	
+	// Sending policy and statistics (blocking by default)
+	msgQ_Register(msgQId, maxMsgs);
+	
 	syslog(LOG_INFO, "Message queue initialized");
 	
 	return msgQId;
@@ -51,40 +60,37 @@ bool msgQ_Receive(MSG_Q_ID msgQId, char *buffer, size_t  maxNBytes, int32_t msTi
 
 
 	// Wait for a message ... 
-	ssize_t rc = msgQReceive(msgQId, buffer, maxNBytes, timeout);
-	
-	// Error check
-	if (rc == ERROR) {
-		int err = errno;
-		if (err == S_objLib_OBJ_TIMEOUT && timeout != WAIT_FOREVER) {
-			buffer[0]='\000';
-			return FALSE;
-		} else {
-			syslog(LOG_ERR, "Message queue receive error %d: %s", err, strerror(err));
-			taskExit(rcINQUEUE_RECEIVEERR);
-		}
+	message *pMessage = msgQ_ReceiveRef(msgQId, timeout);
+	if (!pMessage) {
+		buffer[0]='\000';
+		return FALSE;
 	}
 	
+	// Copy it and give it back to the pool
+	memcpy(buffer, pMessage, (maxNBytes < MSG_MAXLENGTH) ? maxNBytes : MSG_MAXLENGTH);
+	msgPool_Free(pMessage);
+	
 	return TRUE;
 }
 
 bool msgQ_Send(MSG_Q_ID msgQId, char *buffer, size_t  nBytes) {
-	// Send the message
-	STATUS rc = msgQSend(msgQId, buffer, nBytes, WAIT_FOREVER, MSG_PRI_NORMAL);
-	
-	// Error check
-	if (rc == ERROR) {
-		int err = errno;
-		syslog(LOG_ERR, "Message queue receive error %d: %s", err, strerror(err));
-		taskExit(rcINQUEUE_SENDERR);
+	// Copy the message in a pool message
+	message *pMessage = msgPool_Alloc();
+	if (!pMessage) {
+		msgQ_PoolDropped(msgQId);
+		return FALSE;
 	}
+	memcpy(pMessage, buffer, (nBytes < MSG_MAXLENGTH) ? nBytes : MSG_MAXLENGTH);
 	
-	return TRUE;	
+	// Send its reference
+	return msgQ_SendRef(msgQId, pMessage);	
 }
 
 
 bool msgQ_Delete(MSG_Q_ID msgQId) {
-	// Delete the queue
+	// Delete the ring (if any) and the queue
+	msgQ_Unregister(msgQId);
+	msgQRing_Delete(msgQId);
 	STATUS rc = msgQDelete(msgQId);
 	
 	if (rc == ERROR) {
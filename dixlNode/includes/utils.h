@@ -13,18 +13,22 @@
 #include <stdbool.h>
 #include <taskLib.h>
 
+#include "msgPool.h"
+#include "msgQRing.h"
+
 /* MACROs */
 
 /* FUNCTIONS helpers */
 
 /**
  * Inizialize the message Queue of the task
+ * @param options: VxWorks queue options, MSGQ_OPT_RING to use a lock-free ring (single receiver) 
  * @return TRUE if queue initialization is OK, else FALSE
  */
 MSG_Q_ID msgQ_Initialize(size_t maxMsgs, size_t maxMsgLength, int options);
 
 /**
- * Receive a message from a Queue
+ * Receive a message from a Queue (copied from the pool message, given back to the pool)
  * 
  * @param msgQId
  * @param buffer
@@ -35,14 +39,23 @@ MSG_Q_ID msgQ_Initialize(size_t maxMsgs, size_t maxMsgLength, int options);
 bool msgQ_Receive(MSG_Q_ID msgQId, char *buffer, size_t  maxNBytes, int32_t msTimeout);
 
 /**
- * Send a message to a Queue
+ * Send a message to a Queue (copied in a pool message, the queue carries its reference)
+ * applying the queue policy (see msgQ_SetPolicy)
  * @param msgQId
  * @param buffer
  * @param nBytes
- * @return
+ * @return TRUE if sent, FALSE if dropped
  */
 bool msgQ_Send(MSG_Q_ID msgQId, char *buffer, size_t  nBytes);
 
+/**
+ * Delete the message Queue of a task (and its ring). The receiver task must be deleted before;
+ * the senders still running get an error (the ring waits the sends in progress)
+ * @param msgQId
+ * @return TRUE if deleted, else FALSE
+ */
+bool msgQ_Delete(MSG_Q_ID msgQId);
+
 /**
  * Wait the task with taskId ID become not ready, each test is made after a delay
  * @param taskId	: ID of the task to wait notReady  statefor
@@ -10,14 +10,39 @@
 #ifndef DXILCOMM_H_
 #define DXILCOMM_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Delivery of a received message to its task */
+typedef enum {
+	COMMDISPATCH_QUEUED			= 0,	// Queued to the task in charge of it (or served)
+	COMMDISPATCH_DROPPED		= 1,	// Not queued: pool exhausted or queue full
+	COMMDISPATCH_UNKNOWN		= 2,	// Unknown message type
+	COMMDISPATCH_FULL			= 3,	// Ctrl queue full, not waited for (the caller keeps the message)
+} eCommDispatch;
+
 /*
  * Comm Rx task function
  */
 void dixlCommRx();
 
+/*
+ * Deliver a complete EXT message to the task in charge of it (by type)
+ * @param frame: pointer to the message
+ * @param frameLen: message length
+ * @param wait: wait for room in the Ctrl queue (FALSE for a sender Ctrl may be waiting on)
+ * @return the delivery result
+ */
+eCommDispatch dixlCommRxDispatch(const char *frame, uint8_t frameLen, bool wait);
+
 /*
  * Comm Tx task function
  */
 void dixlCommTx();
 
+/*
+ * Comm Tx statistics (connection pool usage) to the logger
+ */
+void dixlCommTxShow();
+
 #endif /* DXILCOMM_H_ */
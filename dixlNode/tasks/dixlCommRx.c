@@ -11,104 +11,476 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stddef.h>
 
 #include <vxWorks.h>
 #include <msgQLib.h>
 #include <sockLib.h>
 #include <taskLib.h>
 #include <syslog.h>
+#include <sys/select.h>
 
 #include "dixlComm.h"
 #include "dixlLog.h"
 #include "../config.h"
 #include "../datatypes/messages.h"
 #include "../includes/network.h"
+#include "../includes/trace.h"
 #include "../includes/utils.h"
 
+/* types */
+// Inbound connection
+typedef struct commRxConnection {
+	int fd;								// Connected socket (0 = free slot)
+	char buffer[COMMBUFFERSIZE];		// Received data (reassembly) buffer
+	int head;							// Offset of the first byte not yet processed
+	int tail;							// Offset of the end of the received data
+	struct timespec lastActivity;		// Timestamp (monotonic) of the last data received
+} commRxConnection;
+
+// Datagram peer (duplicates check)
+typedef struct commRxDgramPeer {
+	nodeId node;						// Sending node (0 = free slot)
+	uint32_t session;					// Current session of the sender
+	uint32_t highest;					// Highest sequence received
+	uint64_t window;					// Received sequences bitmap: bit n => highest - n
+	struct timespec lastReceived;		// Timestamp (monotonic) of the last datagram
+} commRxDgramPeer;
+
 /* variables */
 int dixlCommRxSocket = 0;
+int dixlCommRxDgramSocket = 0;
 
 // Input message queue
 TASK_ID     taskCommRxId;
 
-// Received data buffer
-char buffer[COMMBUFFERSIZE] = "\0";
-int bufferLen = 0;
+// Inbound connections served at the same time (each one with its own buffer)
+static commRxConnection connections[COMMRXMAXCONNECTIONS];
+
+// Datagram peers
+static commRxDgramPeer dgramPeers[COMMDGRAMMAXPEERS];
+static ulong_t dgramDuplicates = 0;		// Duplicated datagrams discarded
+static ulong_t dgramUntracked = 0;		// Datagrams discarded (not acknowledged): peers table full
+static ulong_t dgramDropped = 0;		// Datagrams not acknowledged: message not queued
+
+/* Implementation functions */
 /**
- * Process data received from the stream:
- * @param stream: chunk of stream data received
- * @param streamLen: data chunk length
- * 
- * - store data in the buffer updating bufferLen
- * - get message length (msgLen) from first byte
- * - if msgLen <= bufferLen then move (removing from buffer) data in msg struct and process it
+ * Send the tasks queues statistics to the host (one message per queue): replied here and not
+ * by a task, so the request doesn't wait in the queues it measures
+ * @param destination: requesting host
  */
-static bool process_message(char *stream, ssize_t streamLen) {
-	
-	// If chunk is empty, nothing to do
-	if (streamLen <=0) return FALSE;
-
-	// Copy received chunck to the and of the buffer
-	// Overflow isn't possibile because of these lengths:
-	// - streamLen <= MSG_MAXLENGTH
-	// - buffer = 2 * MSG_MAXLENGTH
-	// and when complete a message is removed
-	memcpy(&buffer[bufferLen], stream, streamLen);
-	bufferLen += streamLen;
+static void stats_send(nodeId destination) {
+	MSG_Q_ID msgQIds[MSGQSTATS_NUM] = { msgQInitId, msgQCtrlId, msgQCommTxId, msgQLogId, msgQDiagId, msgQPointId, msgQSensorId };
 	
-	// While the buffer containts a complete message, process it
-	uint8_t messageLen = 0;
-	while ( bufferLen > 0 && ( messageLen = buffer[0] ) <= bufferLen ) {
-	 	
-		// The message is complete: copy data to message struct removing from buffer
+	for (int i = 0; i < MSGQSTATS_NUM; i++) {
 		message message;
-		memcpy(&message, buffer, messageLen);					// Copy data in message struct
-		bufferLen -= messageLen;								// Remaining data in the buffer
-		memcpy(buffer, &buffer[messageLen], bufferLen);			// Move remaining data to the start of the buffer		
-		// Get message data
-		eMsgType messageType = message.header.type;
+		memset(&message, 0, sizeof(message));
 		
-		// Process the message (EXTERNAL TYPES)
-		switch (messageType) {
-			// INIT messages
-			case MSGTYPE_NODECONFIG:
-			case MSGTYPE_NODERESET:
-				// Send to dixlInit task queue
-				msgQ_Send(msgQInitId, (char *) &message, messageLen);	
-				break;
-				
-			// LOG Messages
-			case MSGTYPE_LOGREQ:
-			case MSGTYPE_LOGSEND:			
-			case MSGTYPE_LOGDEL:
-				// Send to dixlLog task queue
-				msgQ_Send(msgQLogId, (char *) &message, messageLen);	
-				break;
+		message.iHeader.type = IMSGTYPE_NODESTATS;
+		message.nodeIStats.destination = destination;
+		msgQ_GetStats(msgQIds[i], &message.nodeIStats.stats);
+		message.nodeIStats.stats.queue = i;
+		message.nodeIStats.stats.totalQueues = MSGQSTATS_NUM;
+		
+		// Send to dilCommTx
+		msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgINodeSTATS));
+	}
+}
+
+eCommDispatch dixlCommRxDispatch(const char *frame, uint8_t frameLen, bool wait) {
+	// Get message data
+	eMsgType messageType = ((const msgHeader *) frame)->type;
+	bool queued = TRUE;
 	
-			// ROUTE Messages
-			case MSGTYPE_ROUTEREQ:
-			case MSGTYPE_ROUTEACK:
-			case MSGTYPE_ROUTENACK:
-			case MSGTYPE_ROUTECOMMIT:
-			case MSGTYPE_ROUTEAGREE:
-			case MSGTYPE_ROUTEDISAGREE:				
-				// Send to dixlCtrl task queue
-				msgQ_Send(msgQCtrlId, (char *) &message, messageLen);					
-				break;
+	// Process the message (EXTERNAL TYPES): the queue copies the frame
+	switch (messageType) {
+		// INIT messages
+		case MSGTYPE_NODECONFIG:
+		case MSGTYPE_NODECONFIGBULK:
+		case MSGTYPE_NODECONFIGMEMBERS:
+		case MSGTYPE_NODERESET:
+			// Send to dixlInit task queue
+			queued = msgQ_Send(msgQInitId, (char *) frame, frameLen);	
+			break;
+			
+		// Queues statistics
+		case MSGTYPE_NODESTATSREQ:
+			stats_send(((const msgHeader *) frame)->source);
+			break;
+			
+		// LOG Messages
+		case MSGTYPE_LOGREQ:
+		case MSGTYPE_LOGSEND:			
+		case MSGTYPE_LOGDEL:
+			// Send to dixlLog task queue
+			queued = msgQ_Send(msgQLogId, (char *) frame, frameLen);	
+			break;
 
-			// LOG Messages
-			case MSGTYPE_POINTMALFUNC:
-				// Send to dixlPoint task queue
-				msgQ_Send(msgQPointId, (char *) &message, messageLen);	
+		// ROUTE Messages
+		case MSGTYPE_ROUTEREQ:
+		case MSGTYPE_ROUTEREQBATCH:
+		case MSGTYPE_ROUTEACK:
+		case MSGTYPE_ROUTENACK:
+		case MSGTYPE_ROUTECOMMIT:
+		case MSGTYPE_ROUTEAGREE:
+		case MSGTYPE_ROUTEDISAGREE:
+		case MSGTYPE_ROUTERELEASE: {
+			// Send to dixlCtrl task queue (a traced message gets its hop)
+			message *pMessage = msgPool_Alloc();
+			if (!pMessage) {
+				msgQ_PoolDropped(msgQCtrlId);
+				queued = FALSE;
 				break;
+			}
+			memcpy(pMessage, frame, frameLen);
+			trace_Received(pMessage);
+			if (wait)
+				queued = msgQ_SendRef(msgQCtrlId, pMessage);
+			else if (!msgQ_TrySendRef(msgQCtrlId, pMessage)) {
+				msgPool_Free(pMessage);
+				return COMMDISPATCH_FULL;
+			}
+			break;
+		}
+
+		// LOG Messages
+		case MSGTYPE_POINTMALFUNC:
+			// Send to dixlPoint task queue
+			queued = msgQ_Send(msgQPointId, (char *) frame, frameLen);	
+			break;
+	
+		// UNKNOWN Messages	
+		default:
+			return COMMDISPATCH_UNKNOWN;
+	}	
+	
+	return queued ? COMMDISPATCH_QUEUED : COMMDISPATCH_DROPPED;
+}
+
+/**
+ * Length of the frame at the start of the data, with legacy or compact header:
+ * - legacy: the first byte is the length (>= header length)
+ * - compact: the first byte is the version, followed by the type and the 16 bit length
+ * @param data: received data
+ * @param dataLen: received data length
+ * @return frame length, 0 if more data is needed to know it, SOCK_ERROR if invalid
+ */
+static int frame_length(const char *data, int dataLen) {
+	if (dataLen < 1)
+		return 0;
+	
+	// Compact header
+	if ((uint8_t) data[0] == MSG_COMPACTVERSION) {
+		uint16_t length;
+		if (dataLen < offsetof(msgCompactHeader, length) + sizeof(length))
+			return 0;
+		memcpy(&length, &data[offsetof(msgCompactHeader, length)], sizeof(length));
+		length = ntohs(length);
+		return (length < sizeof(msgCompactHeader) || length > MSG_BULKMAXLENGTH) ? SOCK_ERROR : length;
+	}
+	
+	// Legacy header
+	return (uint8_t) data[0] < sizeof(msgHeader) ? SOCK_ERROR : (uint8_t) data[0];
+}
+
+/**
+ * Deliver a complete frame, converting a compact header to the EXT message layout used by the tasks
+ * @param frame: pointer to the frame
+ * @param frameLen: frame length
+ * @return the delivery result
+ */
+static eCommDispatch frame_dispatch(const char *frame, int frameLen) {
+	// Legacy header: already in the tasks layout
+	if ((uint8_t) frame[0] != MSG_COMPACTVERSION)
+		return dixlCommRxDispatch(frame, frameLen, TRUE);
+	
+	msgCompactHeader header;
+	memcpy(&header, frame, sizeof(header));
+	int payloadLen = frameLen - sizeof(msgCompactHeader);
+	if (sizeof(msgHeader) + payloadLen > MSG_MAXLENGTH) {
+		syslog(LOG_WARNING, "Message type (%d) of %d bytes too long for the task queues: skipped", header.type, frameLen);
+		return COMMDISPATCH_DROPPED;
+	}
+	
+	// Rebuild the message with the EXT header
+	union {
+		message message;
+		char bytes[MSG_MAXLENGTH];
+	} converted;
+	memset(&converted, 0, sizeof(converted));
+	converted.message.header.lentgh = sizeof(msgHeader) + payloadLen;
+	converted.message.header.type = header.type;
+	converted.message.header.source = header.source;
+	converted.message.header.destination = header.destination;
+	memcpy(&converted.bytes[sizeof(msgHeader)], &frame[sizeof(msgCompactHeader)], payloadLen);
+	
+	return dixlCommRxDispatch(converted.bytes, converted.message.header.lentgh, TRUE);
+}
+
+/**
+ * Process data received in the connection buffer (between head and tail):
+ * @param pConn: connection the data was received from
+ * @return FALSE if the stream is corrupted (frame length invalid)
+ * 
+ * - get frame length from the header at head (legacy or compact)
+ * - if the frame is complete, dispatch it in place and move head after it
+ * - frames of unknown type are skipped by their length (the stream stays in sync)
+ */
+static bool process_message(commRxConnection *pConn) {
+	
+	// While the buffer containts a complete message, process it
+	while ( pConn->tail > pConn->head ) {
+		const char *frame = &pConn->buffer[pConn->head];
+		int frameLen = frame_length(frame, pConn->tail - pConn->head);
 		
-			// UNKNOWN Messages	
-			default:
-				return FALSE;
-		}	
+		// A frame with invalid length can't be framed: the stream is lost
+		if (frameLen == SOCK_ERROR)
+			return FALSE;
+		
+		// Frame not complete yet: wait for more data
+		if (!frameLen || frameLen > pConn->tail - pConn->head)
+			break;
+		
+		// The message is complete: process it, skipping unknown types (type is the second byte with both headers)
+		if (frame_dispatch(frame, frameLen) == COMMDISPATCH_UNKNOWN)
+			syslog(LOG_WARNING, "Unknown message type (%d) received: %d bytes skipped", (uint8_t) frame[1], frameLen);
+		pConn->head += frameLen;
+	}
+	
+	// Buffer empty: restart from the beginning
+	if (pConn->head == pConn->tail)
+		pConn->head = pConn->tail = 0;
+	
+	return TRUE;
+}
+
+/**
+ * Accept a new inbound connection in a free slot
+ * @return FALSE if accept fails
+ */
+static bool connection_accept() {
+	int receiveSocket = 0;			/* The new socket created to receive data for each connection */
+	if (( receiveSocket = socket_accept(dixlCommRxSocket)) == SOCK_ERROR)
+		return FALSE;
+	
+	// Search a free slot
+	for (int i = 0; i < COMMRXMAXCONNECTIONS; i++)
+		if (!connections[i].fd) {
+			connections[i].fd = receiveSocket;
+			connections[i].head = connections[i].tail = 0;
+			clock_gettime(CLOCK_MONOTONIC, &connections[i].lastActivity);
+			return TRUE;
+		}
+	
+	// No free slots: refuse the connection (the peer will reconnect)
+	syslog(LOG_WARNING, "Max inbound connections (%d) reached: connection refused", COMMRXMAXCONNECTIONS);
+	socket_close(receiveSocket);
+	return TRUE;
+}
+
+/**
+ * Close an inbound connection freeing its slot
+ * @param pConn: inbound connection
+ */
+static void connection_close(commRxConnection *pConn) {
+	socket_close(pConn->fd);
+	pConn->fd = 0;
+	pConn->head = pConn->tail = 0;
+}
+
+/**
+ * Receive and process data available on an inbound connection
+ * @param pConn: inbound connection
+ */
+static void connection_receive(commRxConnection *pConn) {
+	// Keep room for at least the longest message after tail: only when short of space,
+	// move the pending partial frame (less than MSG_BULKMAXLENGTH bytes) to the start of the buffer
+	if (COMMBUFFERSIZE - pConn->tail < MSG_BULKMAXLENGTH) {
+		memmove(pConn->buffer, &pConn->buffer[pConn->head], pConn->tail - pConn->head);
+		pConn->tail -= pConn->head;
+		pConn->head = 0;
+	}
+	
+	// Receive data from TCP stream directly into the buffer
+	// Multiple messages can be received and processed at each socket_recv
+	ssize_t streamLen = 0;
+	if (( streamLen = socket_recv(pConn->fd, &pConn->buffer[pConn->tail], COMMBUFFERSIZE - pConn->tail)) == SOCK_ERROR || streamLen == 0) {
+		// if ERROR or NO DATA (connection closed by the peer) don't exit the task:
+		// close the client socket only
+		connection_close(pConn);
+		return;
+	}		
+	clock_gettime(CLOCK_MONOTONIC, &pConn->lastActivity);
+	pConn->tail += streamLen;
+
+	// Process the messages, on a corrupted stream drop data and connection
+	if (!process_message(pConn)) {
+		syslog(LOG_ERR, "Invalid message length received: connection closed");
+		connection_close(pConn);
+	}
+}
+
+/**
+ * Close the inbound connections without data for more than COMMRXIDLETIMEOUT
+ */
+static void connection_closeIdle() {
+	struct timespec current;
+	clock_gettime(CLOCK_MONOTONIC, &current);
+	
+	for (int i = 0; i < COMMRXMAXCONNECTIONS; i++)
+		if (connections[i].fd && time_timespecdiff(&current, &connections[i].lastActivity) >= COMMRXIDLETIMEOUT)
+			connection_close(&connections[i]);
+}
+
+/**
+ * Get the duplicates check state of a datagram sender
+ * @param node: sending node
+ * @return the peer state or NULL if the table is full
+ * 
+ * A slot is reused only if its peer is silent for longer than a sender retransmits a datagram:
+ * a copy of a datagram already delivered can't arrive after its duplicates check is forgotten
+ */
+static commRxDgramPeer *dgram_peer(nodeId node) {
+	struct timespec current;
+	clock_gettime(CLOCK_MONOTONIC, &current);
+	
+	commRxDgramPeer *pPeer = NULL;
+	for (int i = 0; i < COMMDGRAMMAXPEERS; i++) {
+		if (nodecmp(dgramPeers[i].node, node) == 0)
+			return &dgramPeers[i];
+		if (!pPeer && (!dgramPeers[i].session || time_timespecdiff(&current, &dgramPeers[i].lastReceived) * 1000 > COMMDGRAMRETRANSMIT * (COMMDGRAMMAXRETRIES + 1)))
+			pPeer = &dgramPeers[i];
+	}
+	
+	// New peer: a free or silent slot (the peer starts the duplicates check)
+	if (pPeer) {
+		memset(pPeer, 0, sizeof(commRxDgramPeer));
+		pPeer->node = node;
+	}
+	return pPeer;
+}
+
+/**
+ * Check if a datagram was already received
+ * @param pPeer: sender state
+ * @param session: sender session
+ * @param sequence: datagram sequence number
+ * @return TRUE if duplicated
+ */
+static bool dgram_isDuplicate(const commRxDgramPeer *pPeer, uint32_t session, uint32_t sequence) {
+	// New session (sender restarted) or newer than any received
+	if (session != pPeer->session || sequence > pPeer->highest)
+		return FALSE;
+	
+	// Older: check the window (too old ones are considered duplicated)
+	uint32_t offset = pPeer->highest - sequence;
+	return offset >= 64 || (pPeer->window & (1ULL << offset));
+}
+
+/**
+ * Mark a datagram as received
+ * @param pPeer: sender state
+ * @param session: sender session
+ * @param sequence: datagram sequence number
+ */
+static void dgram_received(commRxDgramPeer *pPeer, uint32_t session, uint32_t sequence) {
+	// New session (sender restarted): restart the check
+	if (session != pPeer->session) {
+		pPeer->session = session;
+		pPeer->highest = sequence;
+		pPeer->window = 1;
+	}
+	
+	// Newer than any received: slide the window
+	else if (sequence > pPeer->highest) {
+		uint32_t shift = sequence - pPeer->highest;
+		pPeer->window = shift < 64 ? pPeer->window << shift : 0;
+		pPeer->window |= 1;
+		pPeer->highest = sequence;
 	}
 	
-	return true;
+	// Older (in the window)
+	else
+		pPeer->window |= 1ULL << (pPeer->highest - sequence);
+}
+
+/**
+ * Receive and process a datagram:
+ * - DATA: dispatch it if not duplicated, then acknowledge it if queued (a duplicate always: the previous ack
+ *   could be lost); not queued, the sender sends it again
+ * - ACK: notify the Comm Tx task
+ */
+static void dgram_receive() {
+	char dgram[sizeof(msgDgramHeader) + MSG_MAXLENGTH];
+	struct sockaddr_in from;
+	socklen_t fromLen = sizeof(from);
+	
+	ssize_t dgramLen = socket_recvfrom(dixlCommRxDgramSocket, dgram, sizeof(dgram), (struct sockaddr *) &from, &fromLen);
+	if (dgramLen == SOCK_ERROR || dgramLen < sizeof(msgDgramHeader))
+		return;
+	
+	// Induced loss (tests only)
+	if (COMMDGRAMLOSSPERCENT > 0 && rand() % 100 < COMMDGRAMLOSSPERCENT)
+		return;
+	
+	msgDgramHeader *pHeader = (msgDgramHeader *) dgram;
+	uint32_t session = ntohl(pHeader->session);
+	uint32_t sequence = ntohl(pHeader->sequence);
+	nodeId source;
+	network_n_to_IPv4(&from, &source);
+	
+	switch (pHeader->kind) {
+		case DGRAMKIND_ACK: {
+			message ack;
+			memset(&ack, 0, sizeof(ack));
+			ack.iHeader.type = IMSGTYPE_COMMTXDGRAMACK;
+			ack.commTxIDgramAck.source = source;
+			ack.commTxIDgramAck.session = session;
+			ack.commTxIDgramAck.sequence = sequence;
+			msgQ_Send(msgQCommTxId, (char *) &ack, sizeof(msgIHeader) + sizeof(msgICommTxDGRAMACK));
+			break;
+		}
+			
+		case DGRAMKIND_DATA: {
+			// The datagram must carry exactly one message
+			const char *frame = &dgram[sizeof(msgDgramHeader)];
+			int frameLen = frame_length(frame, dgramLen - sizeof(msgDgramHeader));
+			if (frameLen <= 0 || frameLen != dgramLen - sizeof(msgDgramHeader))
+				return;
+			
+			// Sender not tracked (table full): not acknowledged, its duplicates couldn't be checked
+			commRxDgramPeer *pPeer = dgram_peer(source);
+			if (!pPeer) {
+				if (!dgramUntracked++)
+					syslog(LOG_WARNING, "Datagram peers table full (%d): datagrams of new peers not acknowledged", COMMDGRAMMAXPEERS);
+				return;
+			}
+			clock_gettime(CLOCK_MONOTONIC, &pPeer->lastReceived);
+			
+			// Dispatch only the first copy, marked received once queued (an unknown type is never queued)
+			if (dgram_isDuplicate(pPeer, session, sequence))
+				dgramDuplicates++;
+			else {
+				eCommDispatch result = frame_dispatch(frame, frameLen);
+				if (result == COMMDISPATCH_DROPPED) {
+					dgramDropped++;
+					return;
+				}
+				if (result == COMMDISPATCH_UNKNOWN)
+					syslog(LOG_WARNING, "Unknown message type (%d) received in a datagram", (uint8_t) frame[1]);
+				dgram_received(pPeer, session, sequence);
+			}
+			
+			// Acknowledge to the Comm Rx of the sender
+			msgDgramHeader ack = { .kind = DGRAMKIND_ACK, .session = pHeader->session, .sequence = pHeader->sequence };
+			from.sin_port = htons(COMMSOCKPORT);
+			socket_sendto(dixlCommRxDgramSocket, &ack, sizeof(ack), (struct sockaddr *) &from, fromLen);
+			break;
+		}
+			
+		default:
+			break;
+	}
 }
 
 void dixlCommRx() {
@@ -126,43 +498,58 @@ void dixlCommRx() {
 	syslog(LOG_INFO, "RX socket created");
 	
 	// Listen from the socket
-	if ( socket_listen(dixlCommRxSocket) != SOCK_OK)
+	if ( socket_listen(dixlCommRxSocket, COMMLISTENBACKLOG) != SOCK_OK)
 		exit(rcSOCKET_LISTENERR);	
 	syslog(LOG_INFO, "Listening on %03d.%03d.%03d.%03d:%d ...",IPv4.bytes[0], IPv4.bytes[1], IPv4.bytes[2], IPv4.bytes[3], COMMSOCKPORT);
 
+	// Create the datagram socket (UDP transport) on the same port
+	if ((dixlCommRxDgramSocket = socket_create(COMMSOCKDOMAIN, SOCK_DGRAM, IPPROTO_UDP)) == SOCK_ERROR)
+		exit(rcSOCKET_INITERR);
+	if ( socket_bind(dixlCommRxDgramSocket, IPv4s, COMMSOCKPORT) != SOCK_OK)
+		exit(rcSOCKET_BINDERR);	 
+	syslog(LOG_INFO, "RX datagram socket created");
+
 	FOREVER {		
-		// Waiting for a connection
-		int receiveSocket = 0;			/* The new socket created to receive data for each connection */			
-		if (( receiveSocket = socket_accept(dixlCommRxSocket)) == SOCK_ERROR) {
+		// Sockets to wait on: the listening one and every open connection
+		fd_set readFds;
+		FD_ZERO(&readFds);
+		FD_SET(dixlCommRxSocket, &readFds);
+		FD_SET(dixlCommRxDgramSocket, &readFds);
+		int maxFd = dixlCommRxSocket > dixlCommRxDgramSocket ? dixlCommRxSocket : dixlCommRxDgramSocket;
+		for (int i = 0; i < COMMRXMAXCONNECTIONS; i++)
+			if (connections[i].fd) {
+				FD_SET(connections[i].fd, &readFds);
+				if (connections[i].fd > maxFd) maxFd = connections[i].fd;
+			}
+		
+		// Waiting for a connection or data, waking up periodically to close idle connections
+		struct timeval timeout = { COMMRXCHECKPERIOD / 1000, (COMMRXCHECKPERIOD % 1000) * 1000 };
+		int ready = select(maxFd + 1, &readFds, NULL, NULL, &timeout);
+		if (ready == SOCK_ERROR) {
+			int err = errno;
+			if (err == EINTR) continue;
+			syslog(LOG_ERR, "Select socket error %i: %s", err, strerror(err));
 			socket_close(dixlCommRxSocket);
-			exit(rcSOCKET_ACCEPTERR);		
+			exit(rcSOCKET_SELECTERR);
 		}
-
-		// Initialize buffer length
-		bufferLen = 0;
 		
-		// Receive and process messages until connection close
-		FOREVER {
-			// Receive data from TCP stream: max message length bytes
-			// Max a message longest message at time, data gathered in the buffer area until at lesat a complete message is received
-			// Multiple shorter messages can be received and processed at each socket_recv
-			char stream[MSG_MAXLENGTH];
-			ssize_t streamLen = 0;
-
-			if (( streamLen = socket_recv(receiveSocket, (char *) &stream, sizeof(stream))) == SOCK_ERROR || streamLen == 0) {
-				// if ERROR or NO DATA don't exit the task:
-				// - close the client socket
-				// - wait for a new connection
-				break;
-			}		
+		// New connection
+		if (ready > 0 && FD_ISSET(dixlCommRxSocket, &readFds))
+			if (!connection_accept()) {
+				socket_close(dixlCommRxSocket);
+				exit(rcSOCKET_ACCEPTERR);		
+			}
 
-			// Process the message
-			process_message(stream, streamLen);
-		}
-		
-		// Close the receive socket anyway
-		socket_close(receiveSocket);
+		// Datagram
+		if (ready > 0 && FD_ISSET(dixlCommRxDgramSocket, &readFds))
+			dgram_receive();
 
+		// Data (or close) from the open connections
+		for (int i = 0; ready > 0 && i < COMMRXMAXCONNECTIONS; i++)
+			if (connections[i].fd && FD_ISSET(connections[i].fd, &readFds))
+				connection_receive(&connections[i]);
+		
+		// Close idle connections
+		connection_closeIdle();
 	}
 }
-
@@ -9,19 +9,67 @@
 
 /* includes */
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <string.h>
 
 #include <msgQLib.h>
+#include <sysLib.h>
 #include <taskLib.h>
 #include <syslog.h>
+#include <netinet/tcp.h>
+#include <sys/uio.h>
+#include <sys/select.h>
 
 #include "dixlComm.h"
+#include "dixlLog.h"
 #include "../config.h"
 #include "../datatypes/messages.h"
 #include "../includes/network.h"
+#include "../includes/trace.h"
 #include "../includes/utils.h"
 
+/* types */
+// Outbound destination state
+typedef enum {
+	PEERSTATE_IDLE				= 0,	// Not connected
+	PEERSTATE_CONNECTING		= 1,	// Non-blocking connect in progress
+	PEERSTATE_CONNECTED			= 2,	// Connection established
+	PEERSTATE_BACKOFF			= 3		// Connect failed, waiting to retry
+} ePeerState;
+
+// Outbound destination: own connection and own queue, so a slow or dead node doesn't block the others
+typedef struct commPeer {
+	bool used;							// Slot in use
+	nodeId node;						// Destination node
+	int fd;								// Socket (0 = none)
+	ePeerState state;					// Connection state
+	struct timespec stateSince;			// Timestamp (monotonic) of the last state change
+	struct timespec lastUsed;			// Timestamp (monotonic) of the last send
+	message queue[COMMPEERQUEUEMAX];	// Messages to send (ring)
+	struct timespec queuedAt[COMMPEERQUEUEMAX];	// Timestamp (monotonic) of the enqueue
+	int queueHead;						// First message of the ring
+	int queueLen;						// Messages in the ring
+	size_t headOffset;					// Bytes of the first message already sent
+} commPeer;
+
+// Datagram sequence per destination (UDP transport)
+typedef struct commDgramPeer {
+	nodeId node;						// Destination node (0 = free slot)
+	uint32_t nextSequence;				// Sequence number of the next datagram
+} commDgramPeer;
+
+// Datagram waiting for the ack (UDP transport)
+typedef struct commDgramPending {
+	bool used;							// Slot in use
+	nodeId node;						// Destination node
+	uint32_t sequence;					// Sequence number
+	uint8_t retries;					// Retransmissions done
+	struct timespec sentAt;				// Timestamp (monotonic) of the last transmission
+	size_t length;						// Datagram length
+	char dgram[sizeof(msgDgramHeader) + MSG_MAXLENGTH];	// Datagram (header + message)
+} commDgramPending;
+
 /* variables */
 // Task
 TASK_ID     taskCommTxId;
@@ -32,6 +80,31 @@ MSG_Q_ID 	msgQCommTxId;
 // Host node address for direct communication
 nodeId hostNode = {0, 0, 0, 0};
 
+// Outbound destinations (one connection and one queue each)
+static commPeer peers[COMMPOOLMAXCONNECTIONS];
+static ulong_t peerConnects = 0;		// Connections started
+static ulong_t peerConnectFailures = 0;	// Connections failed or timed out
+static ulong_t peerEvictions = 0;		// Connections closed because idle or destination slot reused
+static ulong_t peerDropsExpired = 0;	// Messages dropped because not sent within COMMPEERMSGTIMEOUT
+static ulong_t peerDropsFull = 0;		// Messages dropped because the destination queue (or table) was full
+static ulong_t writeSizes[COMMTXBATCHMAX];	// Writes done per number of messages (n-1)
+static ulong_t loopbackDelivered = 0;	// Messages to this node delivered without the network
+
+// Datagram transport (route messages between nodes when COMMROUTETRANSPORT is UDP)
+static int dgramSocket = 0;
+static uint32_t dgramSession = 0;		// Session of this run, lets receivers restart the duplicates check
+static commDgramPeer dgramPeers[COMMDGRAMMAXPEERS];
+static commDgramPending dgramPending[COMMDGRAMMAXPENDING];
+static int dgramNumPending = 0;
+static ulong_t dgramSent = 0;			// Datagrams sent (first transmission)
+static ulong_t dgramRetransmits = 0;	// Datagrams retransmitted
+static ulong_t dgramAcked = 0;			// Datagrams acknowledged
+static ulong_t dgramExpired = 0;		// Datagrams dropped after COMMDGRAMMAXRETRIES
+static ulong_t dgramFallbacks = 0;		// Messages sent by TCP because tables were full
+
+/* Forward declarations */
+static void peer_closeAll();
+
 /* Implementation functions */
 /** 
  * Acquire the configuration parameters
@@ -55,11 +128,31 @@ static void reset_config(const message *inMessage) {
 	// Host node address
 	memset(&hostNode, 0, sizeof(hostNode));
 	
+	// Drop connections and queued messages (neighbours and host could change with the next config)
+	peer_closeAll();
+	
 	// Log
 	syslog(LOG_INFO, "Host node address resetted");	
 }
 	
 	
+/**
+ * Route message payload: the trace (if any) follows the route id (the route messages share the layout)
+ * @param inMessage: INT route message
+ * @param outMessage: EXT route message
+ * @param untracedLength: payload length if not traced
+ * @return payload length
+ */
+static uint8_t route_payload(const message *inMessage, message *outMessage, size_t untracedLength) {
+	// Not traced: the fields before the trace only
+	if (!inMessage->routeIReq.trace.traceId)
+		return untracedLength;
+	
+	size_t traceSize = trace_Size(&inMessage->routeIReq.trace);
+	memcpy(&outMessage->routeReq.trace, &inMessage->routeIReq.trace, traceSize);
+	return offsetof(msgRouteREQ, trace) + traceSize;
+}
+
 /**
  * Process received message preparing the message to send
  * @param inMessage: received message
@@ -78,56 +171,65 @@ static bool process_message(const message *inMessage, message *outMessage) {
 			outMessage->header.type = MSGTYPE_ROUTEREQ;
 			outMessage->header.destination = inMessage->routeIReq.destination;
 			outMessage->routeReq.requestRouteId = inMessage->routeIReq.requestRouteId;
-			size += sizeof(msgRouteREQ);
+			outMessage->routeReq.batch = FALSE;
+			size += route_payload(inMessage, outMessage, offsetof(msgRouteREQ, batch));
 			break;
 			
 		case IMSGTYPE_ROUTEACK:
 			outMessage->header.type = MSGTYPE_ROUTEACK;
 			outMessage->header.destination = inMessage->routeIAck.destination;
 			outMessage->routeAck.requestRouteId = inMessage->routeIAck.requestRouteId;
-			size += sizeof(msgRouteACK);
+			outMessage->routeAck.points = inMessage->routeIAck.points;
+			size += route_payload(inMessage, outMessage, offsetof(msgRouteACK, trace));
 			break;
 			
 		case IMSGTYPE_ROUTENACK:
 			outMessage->header.type = MSGTYPE_ROUTENACK;
 			outMessage->header.destination = inMessage->routeINAck.destination;
 			outMessage->routeNAck.requestRouteId = inMessage->routeINAck.requestRouteId;
-			size += sizeof(msgRouteNACK);
+			size += route_payload(inMessage, outMessage, offsetof(msgRouteREQ, batch));
 			break;
 			
 		case IMSGTYPE_ROUTECOMMIT:	
 			outMessage->header.type = MSGTYPE_ROUTECOMMIT;			
 			outMessage->header.destination = inMessage->routeICommit.destination;
 			outMessage->routeCommit.requestRouteId = inMessage->routeICommit.requestRouteId;
-			size += sizeof(msgRouteCOMMIT);
+			size += route_payload(inMessage, outMessage, offsetof(msgRouteREQ, batch));
 			break;
 			
 		case IMSGTYPE_ROUTEAGREE:
 			outMessage->header.type = MSGTYPE_ROUTEAGREE;			
 			outMessage->header.destination = inMessage->routeIAgree.destination;
 			outMessage->routeAgree.requestRouteId = inMessage->routeIAgree.requestRouteId;
-			size += sizeof(msgRouteAGREE);
+			size += route_payload(inMessage, outMessage, offsetof(msgRouteREQ, batch));
 			break;
 			
 		case IMSGTYPE_ROUTEDISAGREE:
 			outMessage->header.type = MSGTYPE_ROUTEDISAGREE;			
 			outMessage->header.destination = inMessage->routeIDisagree.destination;
 			outMessage->routeDisagree.requestRouteId = inMessage->routeIDisagree.requestRouteId;
-			size += sizeof(msgRouteDISAGREE);
+			size += route_payload(inMessage, outMessage, offsetof(msgRouteREQ, batch));
 			break;
 			
 		case IMSGTYPE_ROUTETRAINOK:
 			outMessage->header.type = MSGTYPE_ROUTETRAINOK;			
 			outMessage->header.destination = inMessage->routeITrainOk.destination;
 			outMessage->routeTrainOk.requestRouteId = inMessage->routeITrainOk.requestRouteId;
-			size += sizeof(msgRouteTRAINOK);
+			size += route_payload(inMessage, outMessage, offsetof(msgRouteREQ, batch));
 			break;
 			
 		case IMSGTYPE_ROUTETRAINNOK:
 			outMessage->header.type = MSGTYPE_ROUTETRAINNOK;			
 			outMessage->header.destination = inMessage->routeITrainNOk.destination;
 			outMessage->routeTrainNOk.requestRouteId = inMessage->routeITrainNOk.requestRouteId;
-			size += sizeof(msgRouteTRAINNOK);
+			size += route_payload(inMessage, outMessage, offsetof(msgRouteREQ, batch));
+			break;
+			
+		case IMSGTYPE_ROUTERELEASE:
+			outMessage->header.type = MSGTYPE_ROUTERELEASE;			
+			outMessage->header.destination = inMessage->routeIRelease.destination;
+			outMessage->routeRelease.requestRouteId = inMessage->routeIRelease.requestRouteId;
+			size += sizeof(msgRouteRELEASE);
 			break;
 			
 		case IMSGTYPE_LOGSEND:
@@ -139,6 +241,17 @@ static bool process_message(const message *inMessage, message *outMessage) {
 			size += sizeof(msgLogSEND);
 			break;
 			
+		case IMSGTYPE_LOGSENDBULK:
+			outMessage->header.type = MSGTYPE_LOGSENDBULK;			
+			outMessage->header.destination = inMessage->logISendBulk.destination;
+			outMessage->logSendBulk.firstLine = inMessage->logISendBulk.firstLine;
+			outMessage->logSendBulk.totalLines = inMessage->logISendBulk.totalLines;
+			outMessage->logSendBulk.numLines = inMessage->logISendBulk.numLines;
+			outMessage->logSendBulk.pLines = inMessage->logISendBulk.pLines;
+			outMessage->logSendBulk.last = inMessage->logISendBulk.last;
+			size += offsetof(msgLogSENDBULK, pLines);		// lines appended by frame_encode
+			break;
+			
 		case IMSGTYPE_LOGDELACK:
 			outMessage->header.type = MSGTYPE_LOGDELACK;			
 			outMessage->header.destination = inMessage->logIDelAck.destination;
@@ -157,6 +270,13 @@ static bool process_message(const message *inMessage, message *outMessage) {
 			size += sizeof(msgIDiagErrTask);
 			break;
 
+		case IMSGTYPE_NODESTATS:
+			outMessage->header.type = MSGTYPE_NODESTATS;
+			outMessage->header.destination = inMessage->nodeIStats.destination;
+			outMessage->nodeStats.stats = inMessage->nodeIStats.stats;
+			size += sizeof(msgNodeSTATS);
+			break;
+
 		default:			
 			return FALSE;
 			
@@ -167,96 +287,616 @@ static bool process_message(const message *inMessage, message *outMessage) {
 }
 
 /**
- * Send the message to destination node using socket
+ * Encode the message for the wire: compact header (if COMMWIRECOMPACT) or EXT header as is
+ * @param message: EXT message
+ * @param wire: buffer for the encoded message (at least the message length)
+ * @return encoded length
+ */
+static size_t frame_encode(const message *message, char *wire) {
+	if (!COMMWIRECOMPACT) {
+		memcpy(wire, message, message->header.lentgh);
+		return message->header.lentgh;
+	}
+	
+	// Same payload after a 12 bytes header without padding
+	size_t payloadLen = message->header.lentgh - sizeof(msgHeader);
+	msgCompactHeader header = {
+		.version = MSG_COMPACTVERSION,
+		.type = message->header.type,
+		.length = htons(sizeof(msgCompactHeader) + payloadLen),
+		.source = message->header.source,
+		.destination = message->header.destination
+	};
+	
+	// Log lines (bulk export) read from the Log task export area
+	if (message->header.type == MSGTYPE_LOGSENDBULK) {
+		size_t linesLen = message->logSendBulk.numLines * sizeof(logMessage);
+		header.length = htons(sizeof(msgCompactHeader) + payloadLen + linesLen);
+		memcpy(wire, &header, sizeof(header));
+		memcpy(&wire[sizeof(header)], (const char *) message + sizeof(msgHeader), payloadLen);
+		memcpy(&wire[sizeof(header) + payloadLen], message->logSendBulk.pLines, linesLen);
+		return sizeof(header) + payloadLen + linesLen;
+	}
+	
+	memcpy(wire, &header, sizeof(header));
+	memcpy(&wire[sizeof(header)], (const char *) message + sizeof(msgHeader), payloadLen);
+	return sizeof(header) + payloadLen;
+}
+
+/**
+ * Message done (sent or dropped): release what it refers to
+ * @param message: EXT message
+ */
+static void frame_release(const message *message) {
+	// Last message of a bulk log export: the export area can be reused
+	if (message->header.type == MSGTYPE_LOGSENDBULK && message->logSendBulk.last)
+		logger_exportDone();
+}
+
+/**
+ * Milliseconds elapsed since a timestamp
+ * @param since: timestamp (monotonic)
+ * @param current: current timestamp (monotonic)
+ */
+static double elapsed_ms(const struct timespec *since, const struct timespec *current) {
+	return time_timespecdiff(current, since) * 1000;
+}
+
+/**
+ * Close the connection of a destination moving it to a new state
+ * @param pPeer: destination
+ * @param state: new state
+ */
+static void peer_close(commPeer *pPeer, ePeerState state) {
+	if (pPeer->fd)
+		socket_close(pPeer->fd);
+	pPeer->fd = 0;
+	pPeer->headOffset = 0;				// a partially sent message is sent again on the next connection
+	pPeer->state = state;
+	clock_gettime(CLOCK_MONOTONIC, &pPeer->stateSince);
+}
+
+/**
+ * Close all the connections dropping the queued messages
+ */
+static void peer_closeAll() {
+	for (int i = 0; i < COMMPOOLMAXCONNECTIONS; i++) {
+		if (peers[i].fd)
+			socket_close(peers[i].fd);
+		for (int j = 0; j < peers[i].queueLen; j++)
+			frame_release(&peers[i].queue[(peers[i].queueHead + j) % COMMPEERQUEUEMAX]);
+		memset(&peers[i], 0, sizeof(commPeer));
+	}
+}
+
+/**
+ * Get the destination slot of a node, allocating a free one (or reusing the least recently used one without queued messages)
+ * @param node: destination node
+ * @return the destination or NULL if all slots have queued messages
+ */
+static commPeer *peer_get(nodeId node) {
+	commPeer *pFree = NULL;				// Unused slot
+	commPeer *pOldest = NULL;			// Least recently used slot without queued messages
+	
+	for (int i = 0; i < COMMPOOLMAXCONNECTIONS; i++) {
+		if (!peers[i].used) {
+			if (!pFree) pFree = &peers[i];
+			continue;
+		}
+		if (nodecmp(peers[i].node, node) == 0)
+			return &peers[i];
+		if (!peers[i].queueLen && (!pOldest || time_timespecdiff(&pOldest->lastUsed, &peers[i].lastUsed) > 0))
+			pOldest = &peers[i];
+	}
+	
+	if (!pFree && pOldest) {
+		if (pOldest->fd)
+			peerEvictions++;
+		peer_close(pOldest, PEERSTATE_IDLE);
+		pFree = pOldest;
+	}
+	if (!pFree)
+		return NULL;
+	
+	memset(pFree, 0, sizeof(commPeer));
+	pFree->used = TRUE;
+	pFree->node = node;
+	clock_gettime(CLOCK_MONOTONIC, &pFree->lastUsed);
+	return pFree;
+}
+
+/**
+ * Queue a message to its destination
  * @param message: message to send
- * @return
  */
-static bool send_message(const message *message) {
-	int fd;					// Send socket file descriptor
-	IPv4String destAddr;	// Destination address of the node
+static void peer_enqueue(const message *message) {
+	commPeer *pPeer = peer_get(message->header.destination);
 	
-	// Create the socket
-	if ((fd = socket_create(COMMSOCKDOMAIN, COMMSOCKTYPE, COMMSOCKPROTOCOL)) == 0)
-		exit(rcSOCKET_INITERR);
+	if (!pPeer || pPeer->queueLen == COMMPEERQUEUEMAX) {
+		syslog(LOG_ERR, "Queue to %d.%d.%d.%d full: message type %d dropped", message->header.destination.bytes[0], message->header.destination.bytes[1], message->header.destination.bytes[2], message->header.destination.bytes[3], message->header.type);
+		peerDropsFull++;
+		frame_release(message);
+		return;
+	}
+	
+	int tail = (pPeer->queueHead + pPeer->queueLen) % COMMPEERQUEUEMAX;
+	// Whole message: the bulk log lines and last flag are node internal, past the message length
+	pPeer->queue[tail] = *message;
+	clock_gettime(CLOCK_MONOTONIC, &pPeer->queuedAt[tail]);
+	pPeer->queueLen++;
+}
+
+/**
+ * Remove the first queued message
+ * @param pPeer: destination
+ */
+static void peer_dequeue(commPeer *pPeer) {
+	frame_release(&pPeer->queue[pPeer->queueHead]);
+	pPeer->queueHead = (pPeer->queueHead + 1) % COMMPEERQUEUEMAX;
+	pPeer->queueLen--;
+	pPeer->headOffset = 0;
+}
+
+/**
+ * Drop the queued messages not sent within COMMPEERMSGTIMEOUT (not the one partially sent)
+ * @param pPeer: destination
+ * @param current: current timestamp (monotonic)
+ */
+static void peer_expire(commPeer *pPeer, const struct timespec *current) {
+	while (pPeer->queueLen && !pPeer->headOffset && elapsed_ms(&pPeer->queuedAt[pPeer->queueHead], current) >= COMMPEERMSGTIMEOUT) {
+		message *pMessage = &pPeer->queue[pPeer->queueHead];
+		syslog(LOG_ERR, "Message type %d to %d.%d.%d.%d not sent in time: dropped", pMessage->header.type, pPeer->node.bytes[0], pPeer->node.bytes[1], pPeer->node.bytes[2], pPeer->node.bytes[3]);
+		peer_dequeue(pPeer);
+		peerDropsExpired++;
+	}
+}
+
+/**
+ * Start a non-blocking connection to the destination
+ * @param pPeer: destination
+ */
+static void peer_connect(commPeer *pPeer) {
+	int fd;
+	IPv4String destAddr;
 	
-	// Get node destination address
-	network_IPv4_to_str(&(message->header.destination), destAddr);
+	peerConnects++;
+	if ((fd = socket_create(COMMSOCKDOMAIN, COMMSOCKTYPE, COMMSOCKPROTOCOL)) == SOCK_ERROR) {
+		peerConnectFailures++;
+		peer_close(pPeer, PEERSTATE_BACKOFF);
+		return;
+	}
 	
-	// Connect to the server (destination node)
-	if (socket_connect(fd, destAddr, COMMSOCKPORT) == SOCK_ERROR) {
-		close(fd);
-		// if connection fail, close it, return FALSE but don't exit the task
-		return FALSE;
+	// Connect to the server (destination node), on error the socket is closed by socket_connect_nonblocking
+	network_IPv4_to_str(&pPeer->node, destAddr);
+	switch (socket_connect_nonblocking(fd, destAddr, COMMSOCKPORT)) {
+		case SOCK_OK:
+			pPeer->fd = fd;
+			pPeer->state = PEERSTATE_CONNECTED;
+			break;
+		case SOCK_INPROGRESS:
+			pPeer->fd = fd;
+			pPeer->state = PEERSTATE_CONNECTING;
+			break;
+		default:
+			peerConnectFailures++;
+			peer_close(pPeer, PEERSTATE_BACKOFF);
+			return;
 	}
+	clock_gettime(CLOCK_MONOTONIC, &pPeer->stateSince);
+	
+	// Frames are small and latency bound: disable Nagle on the persistent stream
+	int noDelay = 1;
+	socket_setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+}
+
+/**
+ * Check the pending connections (without waiting): established, failed or timed out
+ * @param current: current timestamp (monotonic)
+ */
+static void peer_checkConnecting(const struct timespec *current) {
+	fd_set writeFds;
+	FD_ZERO(&writeFds);
+	int maxFd = -1;
+	for (int i = 0; i < COMMPOOLMAXCONNECTIONS; i++)
+		if (peers[i].state == PEERSTATE_CONNECTING) {
+			FD_SET(peers[i].fd, &writeFds);
+			if (peers[i].fd > maxFd) maxFd = peers[i].fd;
+		}
+	if (maxFd < 0)
+		return;
+	
+	struct timeval noWait = { 0, 0 };
+	if (select(maxFd + 1, NULL, &writeFds, NULL, &noWait) == SOCK_ERROR)
+		FD_ZERO(&writeFds);
+	
+	for (int i = 0; i < COMMPOOLMAXCONNECTIONS; i++) {
+		commPeer *pPeer = &peers[i];
+		if (pPeer->state != PEERSTATE_CONNECTING)
+			continue;
 		
-	// Connection ok, send data
-	if (socket_send(fd, (void *) message, message->header.lentgh) == SOCK_ERROR) {
-		close(fd);
-		// if send fail, close the socket and return FALSE but don't exit the task
-		return FALSE;
+		// Writable: connection completed (successfully or not)
+		if (FD_ISSET(pPeer->fd, &writeFds)) {
+			if (socket_connect_result(pPeer->fd) == SOCK_OK) {
+				pPeer->state = PEERSTATE_CONNECTED;
+				pPeer->stateSince = *current;
+			} else {
+				peerConnectFailures++;
+				peer_close(pPeer, PEERSTATE_BACKOFF);
+			}
+		
+		// Not completed in time
+		} else if (elapsed_ms(&pPeer->stateSince, current) >= COMMCONNECTTIMEOUT) {
+			syslog(LOG_ERR, "Connect to %d.%d.%d.%d timed out", pPeer->node.bytes[0], pPeer->node.bytes[1], pPeer->node.bytes[2], pPeer->node.bytes[3]);
+			peerConnectFailures++;
+			peer_close(pPeer, PEERSTATE_BACKOFF);
+		}
+	}
+}
+
+/**
+ * Send the queued messages (at most COMMTXBATCHMAX) with a single write, without blocking
+ * @param pPeer: connected destination
+ * @param current: current timestamp (monotonic)
+ */
+static void peer_send(commPeer *pPeer, const struct timespec *current) {
+	// Connection closed by the peer (e.g. restarted): connect again
+	if (!socket_alive(pPeer->fd)) {
+		peer_close(pPeer, PEERSTATE_IDLE);
+		return;
+	}
+	
+	// Gather the queued messages encoded for the wire
+	static char wire[COMMTXBATCHMAX][MSG_BULKMAXLENGTH];
+	size_t wireLen[COMMTXBATCHMAX];
+	struct iovec iov[COMMTXBATCHMAX];
+	int iovcnt = 0;
+	for (; iovcnt < pPeer->queueLen && iovcnt < COMMTXBATCHMAX; iovcnt++) {
+		message *pMessage = &pPeer->queue[(pPeer->queueHead + iovcnt) % COMMPEERQUEUEMAX];
+		size_t offset = iovcnt ? 0 : pPeer->headOffset;
+		wireLen[iovcnt] = frame_encode(pMessage, wire[iovcnt]);
+		iov[iovcnt].iov_base = wire[iovcnt] + offset;
+		iov[iovcnt].iov_len = wireLen[iovcnt] - offset;
+	}
+	
+	ssize_t sent = socket_sendmsg(pPeer->fd, iov, iovcnt);
+	if (sent == SOCK_ERROR) {
+		// Socket buffer full: retry later, otherwise connect again
+		if (errno != EWOULDBLOCK && errno != EAGAIN)
+			peer_close(pPeer, PEERSTATE_IDLE);
+		return;
+	}
+	writeSizes[iovcnt - 1]++;
+	pPeer->lastUsed = *current;
+	
+	// Remove the sent messages (the last one can be sent partially)
+	size_t sentLen = (size_t) sent;
+	for (int i = 0; sentLen > 0; i++) {
+		size_t remaining = wireLen[i] - pPeer->headOffset;
+		if (sentLen < remaining) {
+			pPeer->headOffset += sentLen;
+			break;
+		}
+		sentLen -= remaining;
+		peer_dequeue(pPeer);
+	}
+}
+
+/**
+ * Advance every destination: expire old messages, connect, send, retry after failures, close idle connections
+ */
+static void peer_service() {
+	struct timespec current;
+	clock_gettime(CLOCK_MONOTONIC, &current);
+	
+	peer_checkConnecting(&current);
+	
+	for (int i = 0; i < COMMPOOLMAXCONNECTIONS; i++) {
+		commPeer *pPeer = &peers[i];
+		if (!pPeer->used)
+			continue;
+		
+		peer_expire(pPeer, &current);
+		
+		switch (pPeer->state) {
+			case PEERSTATE_BACKOFF:
+				if (elapsed_ms(&pPeer->stateSince, &current) < COMMCONNECTRETRY)
+					break;
+				pPeer->state = PEERSTATE_IDLE;
+				/* fall through - connect now if needed */
+				
+			case PEERSTATE_IDLE:
+				if (pPeer->queueLen)
+					peer_connect(pPeer);
+				if (pPeer->state != PEERSTATE_CONNECTED)
+					break;
+				/* fall through - connected immediately */
+				
+			case PEERSTATE_CONNECTED:
+				if (pPeer->queueLen)
+					peer_send(pPeer, &current);
+				else if (time_timespecdiff(&current, &pPeer->lastUsed) >= COMMPOOLIDLETIMEOUT) {
+					peer_close(pPeer, PEERSTATE_IDLE);
+					peerEvictions++;
+				}
+				break;
+				
+			default:
+				break;
+		}
 	}
+}
+
+/**
+ * Check if some destination has messages waiting (connect or send in progress)
+ */
+static bool peer_busy() {
+	for (int i = 0; i < COMMPOOLMAXCONNECTIONS; i++)
+		if (peers[i].queueLen)
+			return TRUE;
+	return FALSE;
+}
+
+/**
+ * Transmit (or retransmit) a pending datagram
+ * @param pPending: datagram waiting for the ack
+ */
+static void dgram_transmit(commDgramPending *pPending) {
+	struct sockaddr_in to;
+	network_IPv4_to_sockaddr(&pPending->node, COMMSOCKPORT, &to);
 	
-	// Close the socket
-	socket_close(fd);
+	// On error the datagram stays pending and will be retransmitted
+	socket_sendto(dgramSocket, pPending->dgram, pPending->length, (struct sockaddr *) &to, sizeof(to));
+	clock_gettime(CLOCK_MONOTONIC, &pPending->sentAt);
+}
 
+/**
+ * Send a message as datagram waiting for its ack
+ * @param message: message to send
+ * @return FALSE if the datagram transport can't take it (tables full)
+ */
+static bool dgram_send(const message *message) {
+	nodeId node = message->header.destination;
+	
+	// Destination sequence
+	commDgramPeer *pPeer = NULL;
+	for (int i = 0; i < COMMDGRAMMAXPEERS && !pPeer; i++)
+		if (nodecmp(dgramPeers[i].node, node) == 0)
+			pPeer = &dgramPeers[i];
+	for (int i = 0; i < COMMDGRAMMAXPEERS && !pPeer; i++)
+		if (!dgramPeers[i].nextSequence) {
+			pPeer = &dgramPeers[i];
+			pPeer->node = node;
+			pPeer->nextSequence = 1;
+		}
+	
+	// Free pending slot
+	commDgramPending *pPending = NULL;
+	for (int i = 0; i < COMMDGRAMMAXPENDING && !pPending; i++)
+		if (!dgramPending[i].used)
+			pPending = &dgramPending[i];
+	
+	if (!pPeer || !pPending) {
+		dgramFallbacks++;
+		return FALSE;
+	}
+	
+	// Datagram: header + message
+	msgDgramHeader header = { .kind = DGRAMKIND_DATA, .session = htonl(dgramSession), .sequence = htonl(pPeer->nextSequence) };
+	memcpy(pPending->dgram, &header, sizeof(header));
+	pPending->length = sizeof(header) + frame_encode(message, &pPending->dgram[sizeof(header)]);
+	pPending->node = node;
+	pPending->sequence = pPeer->nextSequence++;
+	pPending->retries = 0;
+	pPending->used = TRUE;
+	dgramNumPending++;
+	
+	dgram_transmit(pPending);
+	dgramSent++;
 	return TRUE;
 }
 
+/**
+ * Datagram acknowledged: stop its retransmission
+ * @param inMessage: internal ack notification from Comm Rx
+ */
+static void dgram_ack(const message *inMessage) {
+	const msgICommTxDGRAMACK *pAck = &inMessage->commTxIDgramAck;
+	
+	// Acks of a previous run are ignored
+	if (pAck->session != dgramSession)
+		return;
+	
+	for (int i = 0; i < COMMDGRAMMAXPENDING; i++)
+		if (dgramPending[i].used && dgramPending[i].sequence == pAck->sequence && nodecmp(dgramPending[i].node, pAck->source) == 0) {
+			dgramPending[i].used = FALSE;
+			dgramNumPending--;
+			dgramAcked++;
+			return;
+		}
+}
+
+/**
+ * Retransmit the datagrams not acknowledged within COMMDGRAMRETRANSMIT, giving up after COMMDGRAMMAXRETRIES
+ */
+static void dgram_retransmit() {
+	if (!dgramNumPending)
+		return;
+	
+	struct timespec current;
+	clock_gettime(CLOCK_MONOTONIC, &current);
+	
+	for (int i = 0; i < COMMDGRAMMAXPENDING; i++) {
+		commDgramPending *pPending = &dgramPending[i];
+		if (!pPending->used || time_timespecdiff(&current, &pPending->sentAt) * 1000 < COMMDGRAMRETRANSMIT)
+			continue;
+		
+		if (pPending->retries >= COMMDGRAMMAXRETRIES) {
+			syslog(LOG_ERR, "Datagram %u to %d.%d.%d.%d not acknowledged: dropped", pPending->sequence, pPending->node.bytes[0], pPending->node.bytes[1], pPending->node.bytes[2], pPending->node.bytes[3]);
+			pPending->used = FALSE;
+			dgramNumPending--;
+			dgramExpired++;
+			continue;
+		}
+		
+		pPending->retries++;
+		dgram_transmit(pPending);
+		dgramRetransmits++;
+	}
+}
+
+/**
+ * Check if the message has to be sent by datagram
+ * (route messages between nodes, if configured: the host is reached by TCP only)
+ * @param message: message to send
+ */
+static bool dgram_eligible(const message *message) {
+	return COMMROUTETRANSPORT == COMMTRANSPORTUDP
+			&& message->header.type >= MSGTYPE_ROUTEREQ && message->header.type <= MSGTYPE_ROUTETRAINNOK
+			&& nodecmp(message->header.destination, hostNode) != 0;
+}
+
+/**
+ * Handle a message received from the queue
+ * - messages to deliver are processed and queued to their destination
+ * - config messages are applied after trying to send the queued messages (to keep the order)
+ * @param inMessage: received message
+ */
+static void handle_message(const message *inMessage) {
+	message extMessage;
+	
+	// Comm Tx Receive only Internal messages to deliver outside the node
+	switch (inMessage->iHeader.type) {
+		// Internal CONFIG message
+		case IMSGTYPE_COMMTXCONFIGSET:
+			peer_service();
+			set_config(inMessage);
+			break;
+			
+		case IMSGTYPE_COMMTXCONFIGRESET:
+			peer_service();
+			reset_config(inMessage);
+			break;
+			
+		// Datagram acknowledged by the destination
+		case IMSGTYPE_COMMTXDGRAMACK:
+			dgram_ack(inMessage);
+			break;
+	
+		// Route messages internal request to send to
+		case IMSGTYPE_ROUTEREQ:
+		case IMSGTYPE_ROUTEACK:
+		case IMSGTYPE_ROUTENACK:
+		case IMSGTYPE_ROUTECOMMIT:	
+		case IMSGTYPE_ROUTEAGREE:
+		case IMSGTYPE_ROUTEDISAGREE:
+		case IMSGTYPE_ROUTETRAINOK:
+		case IMSGTYPE_ROUTETRAINNOK:
+		case IMSGTYPE_ROUTERELEASE:
+		case IMSGTYPE_LOGSEND:
+		case IMSGTYPE_LOGSENDBULK:
+		case IMSGTYPE_LOGDELACK:
+		case IMSGTYPE_DIAGERRCOMM:
+		case IMSGTYPE_DIAGERRTASK:
+		case IMSGTYPE_NODESTATS:
+			// Process the message preparing it for External delivery
+			memset(&extMessage, 0, sizeof(extMessage));
+			if (!process_message(inMessage, &extMessage))
+				break;
+			
+			// Traced route message: send timestamp of the hop
+			trace_Sent(&extMessage);
+			
+			// Destination is this node: deliver it directly to the local task as Comm Rx would. Ctrl can be
+			// waiting for room in this queue: with its queue full the message goes by the network (Comm Rx waits)
+			if (nodecmp(extMessage.header.destination, IPv4) == 0) {
+				eCommDispatch result = dixlCommRxDispatch((const char *) &extMessage, extMessage.header.lentgh, FALSE);
+				if (result != COMMDISPATCH_FULL) {
+					if (result == COMMDISPATCH_QUEUED)
+						loopbackDelivered++;
+					else if (result == COMMDISPATCH_UNKNOWN)
+						syslog(LOG_WARNING, "Message type %d to this node has no local destination: dropped", extMessage.header.type);
+					frame_release(&extMessage);
+					break;
+				}
+			}
+			
+			// Delivery it by datagram or queue it to the destination connection
+			if (!dgram_eligible(&extMessage) || !dgram_send(&extMessage))
+				peer_enqueue(&extMessage);
+			break;
+							
+		// Other messages discarded
+		default:
+			syslog(LOG_ERR, "Unattended message type (%d). Should not be send to Comm TX and will be ignored", inMessage->iHeader.type);
+			break;
+	}
+}
+
+void dixlCommTxShow() {
+	static const char *stateNames[] = { "IDLE", "CONNECTING", "CONNECTED", "BACKOFF" };
+	
+	syslog(LOG_INFO, "Connections: %lu started, %lu failed, %lu evicted; messages dropped: %lu expired, %lu queue full", peerConnects, peerConnectFailures, peerEvictions, peerDropsExpired, peerDropsFull);
+	syslog(LOG_INFO, "Messages delivered locally: %lu", loopbackDelivered);
+	for (int i = 0; i < COMMPOOLMAXCONNECTIONS; i++)
+		if (peers[i].used)
+			syslog(LOG_INFO, "  %d.%d.%d.%d: %s, %d queued", peers[i].node.bytes[0], peers[i].node.bytes[1], peers[i].node.bytes[2], peers[i].node.bytes[3], stateNames[peers[i].state], peers[i].queueLen);
+	if (COMMROUTETRANSPORT == COMMTRANSPORTUDP)
+		syslog(LOG_INFO, "Datagrams: %lu sent, %lu retransmitted, %lu acked, %lu dropped, %d pending, %lu sent by TCP", dgramSent, dgramRetransmits, dgramAcked, dgramExpired, dgramNumPending, dgramFallbacks);
+	for (int i = 0; i < COMMTXBATCHMAX; i++)
+		if (writeSizes[i])
+			syslog(LOG_INFO, "Writes of %d messages: %lu", i + 1, writeSizes[i]);
+}
+
 void dixlCommTx() {
 	
 	// Start
 	syslog(LOG_INFO,"Task started Id 0x%jx", taskCommTxId);	
 
 	// Message queue initialization
-	msgQCommTxId = msgQ_Initialize( MSGQCOMMTXMESSAGESMAX, MSGQCOMMTXMESSAGESLENGTH, MSG_Q_FIFO);
+	msgQCommTxId = msgQ_Initialize( MSGQCOMMTXMESSAGESMAX, MSGQCOMMTXMESSAGESLENGTH, MSGQCOMMTXOPTIONS);
+	msgQ_SetPolicy(msgQCommTxId, MSGQCOMMTXPOLICY, MSGQCOMMTXSENDTIMEOUT);
 
-	// Wait for message, process and send it by socket to the destination
-	FOREVER {
-		message inMessage;
-		message extMessage;
+	// Datagram transport socket and session
+	if (COMMROUTETRANSPORT == COMMTRANSPORTUDP) {
+		struct timespec now;
+		clock_gettime(CLOCK_REALTIME, &now);
+		dgramSession = ((uint32_t) now.tv_sec ^ (uint32_t) now.tv_nsec) | 1;
+		if ((dgramSocket = socket_create(COMMSOCKDOMAIN, SOCK_DGRAM, IPPROTO_UDP)) == SOCK_ERROR)
+			exit(rcSOCKET_INITERR);
 		
-		// Clear memory
-		memset(&inMessage, 0, sizeof(inMessage));
-		memset(&extMessage, 0, sizeof(extMessage));
+		// Bound to the node address: the peer identifies the sender and sends the acks back by the source address
+		if (socket_bind(dgramSocket, IPv4s, 0) != SOCK_OK)
+			exit(rcSOCKET_INITERR);
+	}
+
+	// Wait for message, queue it to the destination and send what each destination is ready for
+	FOREVER {
+		// Wait a message from the Queue, waking up periodically to progress connects and sends,
+		// to retransmit datagrams not acknowledged and to close idle connections
+		int32_t period = peer_busy() ? COMMPEERPOLLPERIOD : (dgramNumPending ? COMMDGRAMRETRANSMIT : COMMPOOLCHECKPERIOD);
+		message *pInMessage = msgQ_ReceiveRef(msgQCommTxId, math_ceil(period * sysClkRateGet(), 1000));
+		if (pInMessage) {
+			
+			// Drain up to COMMTXBATCHMAX queued messages, waiting at most COMMTXBATCHLINGER for more
+			struct timespec lingerStart;
+			clock_gettime(CLOCK_MONOTONIC, &lingerStart);
+			for (int drained = 1; ; drained++) {
+				handle_message(pInMessage);
+				msgPool_Free(pInMessage);
+				if (drained == COMMTXBATCHMAX)
+					break;
 				
-		// Wait a message from the Queue ... FOREVER
-		msgQReceive(msgQCommTxId, (char *) &inMessage, sizeof(inMessage), WAIT_FOREVER);
-		
-		// Comm Tx Receive only Internal messages to deliver outside the node
-		switch (inMessage.iHeader.type) {
-			// Internal CONFIG message
-			case IMSGTYPE_COMMTXCONFIGSET:
-				set_config(&inMessage);
-				break;
+				struct timespec current;
+				clock_gettime(CLOCK_MONOTONIC, &current);
+				int32_t linger = COMMTXBATCHLINGER - (int32_t) elapsed_ms(&lingerStart, &current);
 				
-			case IMSGTYPE_COMMTXCONFIGRESET:
-				reset_config(&inMessage);
-				break;
-		
-			// Route messages internal request to send to
-			case IMSGTYPE_ROUTEREQ:
-			case IMSGTYPE_ROUTEACK:
-			case IMSGTYPE_ROUTENACK:
-			case IMSGTYPE_ROUTECOMMIT:	
-			case IMSGTYPE_ROUTEAGREE:
-			case IMSGTYPE_ROUTEDISAGREE:
-			case IMSGTYPE_ROUTETRAINOK:
-			case IMSGTYPE_ROUTETRAINNOK:
-			case IMSGTYPE_LOGSEND:
-			case IMSGTYPE_LOGDELACK:
-			case IMSGTYPE_DIAGERRCOMM:
-			case IMSGTYPE_DIAGERRTASK:
-				// Process the message preparing it for External delivery
-				if (process_message(&inMessage, &extMessage))				    
-					// Delivery it to the destination through the socket
-					send_message(&extMessage);
-				break;
-								
-			// Other messages discarded
-			default:
-				syslog(LOG_ERR, "Unattended message type (%d). Should not be send to Comm TX and will be ignored", inMessage.iHeader.type);
-				break;
+				if (!(pInMessage = msgQ_ReceiveRef(msgQCommTxId, linger > 0 ? math_ceil(linger * sysClkRateGet(), 1000) : NO_WAIT)))
+					break;
+			}
 		}
+		
+		// Progress every destination and the datagrams
+		peer_service();
+		dgram_retransmit();
 	}
 }
-
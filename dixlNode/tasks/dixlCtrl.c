@@ -28,8 +28,7 @@
 /* types */
 /* FSM generic manage functions  */
 typedef void (*FSMCtrlFunc)(NodeState *pEventData);
-typedef void (*FSMCtrlEventNewMessage)(message *message, struct timespec *deadline);
-typedef void (*FSMCtrlEventTimeout)(struct timespec *deadline);
+typedef void (*FSMCtrlEventNewMessage)(message *message);
 
 /* variables */
 // Task
@@ -41,10 +40,8 @@ MSG_Q_ID 	msgQCtrlId;
 // Node state
 NodeState nodeState;
 
-struct timespec deadline;						// Next deadline for message timeout or zero
 FSMCtrlFunc FSMCtrl = NULL;						// Point to FSM initialization function
-FSMCtrlEventNewMessage FSMNewMessage;			// Pointer to FSM New Message Event function
-FSMCtrlEventTimeout    FSMTimeout = NULL; 		// Pointer to FSM Timeout Event function
+FSMCtrlEventNewMessage FSMNewMessage;			// Pointer to FSM New Message Event function (timeouts too)
 
 void dixlCtrl() {
 	
@@ -52,45 +49,18 @@ void dixlCtrl() {
 	syslog(LOG_INFO, "Task started Id 0x%jx", taskCtrlId);	
 
 	// Message queue initialization
-	msgQCtrlId = msgQ_Initialize(MSGQCTRLMESSAGESMAX, MSGQCTRLMESSAGESLENGTH, MSG_Q_FIFO);
-	
-	// Reset deadline
-	deadline.tv_sec = 0;
-	deadline.tv_nsec = 0;
+	msgQCtrlId = msgQ_Initialize(MSGQCTRLMESSAGESMAX, MSGQCTRLMESSAGESLENGTH, MSGQCTRLOPTIONS);
+	msgQ_SetPolicy(msgQCtrlId, MSGQCTRLPOLICY, MSGQCTRLSENDTIMEOUT);
 
-	// Wait for messages and execute FSM
+	// Wait for messages (timeouts too, sent by the timer wheel) and execute FSM
 	FOREVER {
-		message message, messagePoint;
-		
-		// Get timeout in ticks
-		_Vx_ticks_t timeout = time_ticksToDeadline(deadline);
-		ssize_t ret = 0;
-
-		// Wait a message from the Queue ... FOREVER or till timeout
-		if (timeout > 0)
-			ret = msgQReceive(msgQCtrlId, (char *  ) &message, sizeof(message), timeout);
-		else
-			ret = msgQReceive(msgQCtrlId, (char *  ) &message, sizeof(message), WAIT_FOREVER);
+		message *pMessage, messagePoint;
 		
-		// Check if timedout
-		if (ret == ERROR && errno == S_objLib_OBJ_TIMEOUT) {
-			// Log
-			syslog(LOG_INFO, "Timeout reacted");
-			
-			// If Event handler configured, notify the message
-			if (FSMTimeout)
-				// Notify the new message to the FSM
-				FSMTimeout(&deadline);
-			else
-				// Log and error and ignore the message
-				syslog(LOG_ERR, "Node not configured: timeout discarted");
-			
-			// skip the loop
-			continue;
-		}
+		// Wait a message from the Queue ... FOREVER
+		pMessage = msgQ_ReceiveRef(msgQCtrlId, WAIT_FOREVER);
 		
 		// CONFIGRESET e CONFIGSET messages processed right here (Init can send them at any time), other passed to the current FSM
-		switch (message.header.type) {
+		switch (pMessage->header.type) {
 			// CONFIG RESET message
 			case IMSGTYPE_NODECONFIGRESET:
 				// TODO
@@ -108,12 +78,14 @@ void dixlCtrl() {
 				// Clean FSM function pointers
 				FSMCtrl = NULL;
 				FSMNewMessage = NULL;
-				FSMTimeout = NULL;
 				
 				// Reset Node State
 				nodeState.pCurrentRoute = NULL;
 				nodeState.pRouteList = NULL;
 				nodeState.numRoutes = 0;
+				routeIndexBuild(&nodeState.routeIndex, NULL, 0);
+				nodeState.pMembersList = NULL;
+				nodeState.numMembersList = 0;
 				break;
 				
 			// CONFIG SET message
@@ -123,22 +95,23 @@ void dixlCtrl() {
 				// - put in fail-safe status
 				
 				// Get CONFIG
-				nodeState.pRouteList = message.nodeIConfigSet.pRoute;
-				nodeState.numRoutes = message.nodeIConfigSet.numRoutes;				
-				nodeState.nodeType = message.nodeIConfigSet.nodeType;
+				nodeState.pRouteList = pMessage->nodeIConfigSet.pRoute;
+				nodeState.numRoutes = pMessage->nodeIConfigSet.numRoutes;				
+				routeIndexBuild(&nodeState.routeIndex, nodeState.pRouteList, nodeState.numRoutes);
+				nodeState.pMembersList = pMessage->nodeIConfigSet.pMembers;
+				nodeState.numMembersList = pMessage->nodeIConfigSet.numMembers;
+				nodeState.nodeType = pMessage->nodeIConfigSet.nodeType;
 				
 				// Set FSM function pointers and initialize it
 				if (nodeState.nodeType == NODETYPE_TRACKCIRCUIT) {
 					// Track Circuit Node
 					FSMCtrl = FSMCtrlTRACKCIRCUIT;
 					FSMNewMessage = FSMCtrlTRACKCIRCUITEvent_NewMessage;
-					FSMTimeout = FSMCtrlTRACKCIRCUITEvent_TimerExpired;
 					syslog(LOG_INFO, "Node configured for Track Circuit logic");
 				} else {
 					// Point Node
 					FSMCtrl = FSMCtrlPOINT;
 					FSMNewMessage = FSMCtrlPOINTEvent_NewMessage;
-					FSMTimeout = FSMCtrlPOINTEvent_TimerExpired;
 					syslog(LOG_INFO, "Node configured for Point logic");
 				}
 						
@@ -152,7 +125,7 @@ void dixlCtrl() {
 				// If Event handler configured, notify the message
 				if (FSMNewMessage)
 					// Notify the new message to the FSM
-					FSMNewMessage(&message, &deadline);
+					FSMNewMessage(pMessage);
 				else
 					// Log and error and ignore the message
 					syslog(LOG_ERR, "Node not configured: message discarted");
@@ -160,6 +133,8 @@ void dixlCtrl() {
 				break;
 		}		
 		
+		// Give it back to the pool
+		msgPool_Free(pMessage);
 	}
 }
 
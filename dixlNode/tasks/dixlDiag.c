@@ -81,13 +81,13 @@ static void initialize() {
 }
 
 // Analyze all the routes and extract unique clients ids
-static void config_pack(message message, client *clients) {
+static void config_pack(const message *pMessage, client *clients) {
 	// Clean configuration
 	memset(clients, 0, sizeof(client) * CONFIGMAXROUTES);
 
 	// Loop to extract all unique prev nodes
-	uint32_t numRoutes = message.nodeIConfigSet.numRoutes;
-	route *pRoute = message.nodeIConfigSet.pRoute;
+	uint32_t numRoutes = pMessage->nodeIConfigSet.numRoutes;
+	route *pRoute = pMessage->nodeIConfigSet.pRoute;
 	for(int idxRoute=0; idxRoute < numRoutes; idxRoute++) {
 		
 		// Search if current prev is already in
@@ -108,9 +108,9 @@ static void config_pack(message message, client *clients) {
 }
 
 // Process a single message received
-static void process_message(message message) {
+static void process_message(const message *pMessage) {
 	
-	switch (message.header.type) {
+	switch (pMessage->header.type) {
 		// Configuration RESET
 		case IMSGTYPE_NODECONFIGRESET:
 			// Clean configuration
@@ -127,7 +127,7 @@ static void process_message(message message) {
 		// Configuration SET
 		case IMSGTYPE_NODECONFIGSET:
 			// Pack routes extracting clients to monitor
-			config_pack(message, clients);
+			config_pack(pMessage, clients);
 			currentChecked = 0;
 
 			// Log
@@ -137,7 +137,7 @@ static void process_message(message message) {
 			
 		// Other messages discarded
 		default:
-			syslog(LOG_ERR, "Unattended message type (%d). Should not be send to Sensor task and will be ignored", message.iHeader.type);
+			syslog(LOG_ERR, "Unattended message type (%d). Should not be send to Sensor task and will be ignored", pMessage->iHeader.type);
 			break;
 	}
 }
@@ -349,11 +349,11 @@ static int worker() {
 	// If present receive a message
 	if (msgQNumMsgs(msgQDiagId)) {
 		// Receive the messsage
-		message message;
-		msgQReceive(msgQDiagId, (char *  ) &message, sizeof(message), WAIT_FOREVER);
+		message *pMessage = msgQ_ReceiveRef(msgQDiagId, WAIT_FOREVER);
 		
 		// Process the message
-		process_message(message);
+		process_message(pMessage);
+		msgPool_Free(pMessage);
 	}
 
 	// Checking tasks presence
@@ -386,14 +386,14 @@ void dixlDiag() {
 	FOREVER {
 			
 		// Wait a configuration message ... FOREVER
-		message inMessage;
-		msgQReceive(msgQDiagId, (char *  ) &inMessage, sizeof(inMessage), WAIT_FOREVER);
+		message *pInMessage = msgQ_ReceiveRef(msgQDiagId, WAIT_FOREVER);
 
 		// Take sem
 		semTake(semDiag, WAIT_FOREVER);		
 		
 		// Process the message
-		process_message(inMessage);
+		process_message(pInMessage);
+		msgPool_Free(pInMessage);
 
 		// Log
 		syslog(LOG_INFO,"Starting to monitor");
@@ -113,11 +113,13 @@ void dixlInit() {
 	
 	// Wait for messages and execute FSM
 	FOREVER {
-		// Wait a message ... FOREVER
-		message message;
-		msgQReceive(msgQInitId, (char *  ) &message, sizeof(message), WAIT_FOREVER);
+		// Wait a message ... FOREVER (a pool message: bulk CONFIG routes follow the message struct)
+		message *pMessage = msgQ_ReceiveRef(msgQInitId, WAIT_FOREVER);
 		
 		// Notify the new message to the FSM
-		FSMInitEvent_NewMessage(&message, NULL);
+		FSMInitEvent_NewMessage(pMessage, NULL);
+		
+		// Give it back to the pool
+		msgPool_Free(pMessage);
 	}
 }
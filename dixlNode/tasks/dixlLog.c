@@ -12,6 +12,8 @@
 #include <stdbool.h>
 
 #include <msgQLib.h>
+#include <semLib.h>
+#include <sysLib.h>
 #include <taskLib.h>
 #include <syslog.h>
 #include <string.h>
@@ -38,27 +40,40 @@ static int head;									// Log line head index
 static int numLines = 0;							// Number of lines currently in the storage
 static int newestSent = -1;							// Index of the last line sent in the last request (from the host)
 
+// Log export (bulk): lines copied here are read by dixlCommTx until the last message is sent
+static logMessage exportLines[TASKLOGMAXLINES];		// Export area
+static SEM_ID semExport;							// Export area free (given back by dixlCommTx)
+
 /* Helpers functions */
 /* Log a new line */
 void logger_log(eLogType type, routeId requestedRouteId, nodeId source) {
-	logMessage logMessage; 		// Log line
-	message message;			// Task queue message
+	// Task queue message, built directly in a pool message (never the messages reserved to the route messages)
+	message *pMessage = msgPool_AllocLow();
+	if (!pMessage) {
+		msgQ_PoolDropped(msgQLogId);
+		return;
+	}
 	
 	// Construct the log line
-	clock_gettime(CLOCK_REALTIME, &logMessage.timestamp);
-	logMessage.type = type;
-	logMessage.requestedRouteId = requestedRouteId;
-	logMessage.source = source;
+	logMessage *pLine = &pMessage->logILog.message;
+	clock_gettime(CLOCK_REALTIME, &pLine->timestamp);
+	pLine->type = type;
+	pLine->requestedRouteId = requestedRouteId;
+	pLine->source = source;
 
 	// Incapsulate in queue message
-	message.iHeader.type = IMSGTYPE_LOG;
-	message.logILog.message = logMessage;	
+	pMessage->iHeader.type = IMSGTYPE_LOG;
 	
 	// Enqueue to Log tak queue (logger_log caller it's a different task)
-	msgQ_Send(msgQLogId, (char *) &message, sizeof(msgIHeader) + sizeof(msgILog));
+	msgQ_SendRef(msgQLogId, pMessage);
 }
 
 
+/* Log export area released (by dixlCommTx) */
+void logger_exportDone() {
+	semGive(semExport);
+}
+
 /* Implementation functions */
 /* Store a new line */
 static void logEnqueue(logMessage line) {
@@ -132,6 +147,41 @@ static bool logSendCurrent(nodeId destination) {
 		return FALSE;
 	}
 		
+	// Bulk export: many lines per message (the compact header is needed for the length)
+	if (COMMWIRECOMPACT) {
+		// Wait the previous export to be sent before reusing the area
+		if (semTake(semExport, TASKLOGEXPORTTIMEOUT * sysClkRateGet() / 1000) != OK) {
+			syslog(LOG_ERR, "Previous log export still in progress: request ignored");
+			return FALSE;
+		}
+		
+		// Copy the lines in the export area
+		for (int i=0; i<numLines; i++)
+			exportLines[i] = logLines[ ((head+i) % TASKLOGMAXLINES) ];
+		
+		for (int i=0; i<numLines; i+=MSG_LOGBULKMAXLINES) {
+			// Prepare the message for dixlCommTx
+			message message;
+			memset(&message, 0, sizeof(message));
+			
+			message.iHeader.type = IMSGTYPE_LOGSENDBULK;
+			message.logISendBulk.destination = destination;
+			message.logISendBulk.firstLine = (i+1);
+			message.logISendBulk.totalLines = numLines;
+			message.logISendBulk.numLines = (numLines - i < MSG_LOGBULKMAXLINES) ? numLines - i : MSG_LOGBULKMAXLINES;
+			message.logISendBulk.pLines = &exportLines[i];
+			message.logISendBulk.last = (i + MSG_LOGBULKMAXLINES >= numLines);
+			
+			// Send to dilCommTx
+			msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgILogSENDBULK));
+		}
+		
+		// Store last sent index
+		newestSent = (head + numLines -1) % TASKLOGMAXLINES;
+		
+		return TRUE;
+	}
+	
 	// Current stored lines loop
 	for (int i=0; i<numLines; i++) {
 		// Prepare the message for dixlCommTx
@@ -142,8 +192,12 @@ static bool logSendCurrent(nodeId destination) {
 		message.logISend.destination = destination;
 		message.logISend.currentLine = (i+1);
 		message.logISend.totalLines = numLines;
-		message.logISend.line = logLines[ ((head+i) % TASKLOGMAXLINES) ];	
-		
+		message.logISend.line = logLines[ ((head+i) % TASKLOGMAXLINES) ];
+
+		// Leave room in the dixlCommTx queue for the route messages
+		while (msgQ_NumMsgs(msgQCommTxId) > MSGQCOMMTXLOGLIMIT)
+			taskDelay(1);
+
 		// Send to dilCommTx
 		msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgILogSEND));
 	}
@@ -184,38 +238,40 @@ void dixlLog() {
 
 	// Message queue initialization
 	msgQLogId = msgQ_Initialize(MSGQLOGMESSAGESMAX, MSGQLOGMESSAGESLENGTH, MSG_Q_FIFO);
+	msgQ_SetPolicy(msgQLogId, MSGQLOGPOLICY, NO_WAIT);
+	
+	// Log export area semaphore (free)
+	semExport = semBCreate(SEM_Q_FIFO, SEM_FULL);
 
 	// Wait for messages, log and forward
 	FOREVER {
-		message inMessage;
-		
 		// Wait a message from the Queue ... FOREVER
-		msgQReceive(msgQLogId, (char *  ) &inMessage, sizeof(inMessage), WAIT_FOREVER);
+		message *pInMessage = msgQ_ReceiveRef(msgQLogId, WAIT_FOREVER);
 		
 		// Process request
-		switch (inMessage.header.type) {
+		switch (pInMessage->header.type) {
 			// Internal Log a message
 			case IMSGTYPE_LOG:
-				logEnqueue(inMessage.logILog.message);
+				logEnqueue(pInMessage->logILog.message);
 				break;
 				
 			// External Log lines request
 			case MSGTYPE_LOGREQ:
 				// Log
-				syslog(LOG_INFO, "Log REQ received from host node (%d.%d.%d.%d)", inMessage.header.source.bytes[0], inMessage.header.source.bytes[1], inMessage.header.source.bytes[2], inMessage.header.source.bytes[3]);			
+				syslog(LOG_INFO, "Log REQ received from host node (%d.%d.%d.%d)", pInMessage->header.source.bytes[0], pInMessage->header.source.bytes[1], pInMessage->header.source.bytes[2], pInMessage->header.source.bytes[3]);			
 				
 				// Send current log to the requester
-				logSendCurrent(inMessage.header.source);
+				logSendCurrent(pInMessage->header.source);
 
 				// Log
-				syslog(LOG_INFO, "Log SENT to host node (%d.%d.%d.%d)", inMessage.header.source.bytes[0], inMessage.header.source.bytes[1], inMessage.header.source.bytes[2], inMessage.header.source.bytes[3]);			
+				syslog(LOG_INFO, "Log SENT to host node (%d.%d.%d.%d)", pInMessage->header.source.bytes[0], pInMessage->header.source.bytes[1], pInMessage->header.source.bytes[2], pInMessage->header.source.bytes[3]);			
 				
 				break;
 
 			// External Log del request (after a logREQ)
 			case MSGTYPE_LOGDEL:
 				// Log
-				syslog(LOG_INFO, "Log DEL received from host node (%d.%d.%d.%d)", inMessage.header.source.bytes[0], inMessage.header.source.bytes[1], inMessage.header.source.bytes[2], inMessage.header.source.bytes[3]);			
+				syslog(LOG_INFO, "Log DEL received from host node (%d.%d.%d.%d)", pInMessage->header.source.bytes[0], pInMessage->header.source.bytes[1], pInMessage->header.source.bytes[2], pInMessage->header.source.bytes[3]);			
 				
 				// Prune log lines based on last request
 				logPrune();
@@ -226,16 +282,19 @@ void dixlLog() {
 				// ACK the deletion
 				message outMessage;
 				outMessage.iHeader.type = IMSGTYPE_LOGDELACK;
-				outMessage.logIDelAck.destination = inMessage.header.source;
+				outMessage.logIDelAck.destination = pInMessage->header.source;
 
 				// Send to CommTx task
 				msgQ_Send(msgQCommTxId, (char *) &outMessage, sizeof(msgIHeader) + sizeof(msgILogDELACK));		
 				
 				// Log
-				syslog(LOG_INFO, "Log DEL ACK sent to host node (%d.%d.%d.%d)", inMessage.header.source.bytes[0], inMessage.header.source.bytes[1], inMessage.header.source.bytes[2], inMessage.header.source.bytes[3]);			
+				syslog(LOG_INFO, "Log DEL ACK sent to host node (%d.%d.%d.%d)", pInMessage->header.source.bytes[0], pInMessage->header.source.bytes[1], pInMessage->header.source.bytes[2], pInMessage->header.source.bytes[3]);			
 
 				break;
 		}
+		
+		// Give it back to the pool
+		msgPool_Free(pInMessage);
 	}
 		
 	// Dummy call (to avoid compiler warnings ;)
@@ -51,6 +51,11 @@ typedef struct logMessage {
  */
 void logger_log(eLogType type, routeId requestedRouteId, nodeId source);
 
+/**
+ * Log export area released: called by dixlCommTx when the last message of a bulk export is sent (or dropped)
+ */
+void logger_exportDone();
+
 /*
  * Log task function
  */
@@ -62,14 +62,14 @@ static void initialize() {
 }
 
 // Process a single message received
-static void process_message(message message) {
+static void process_message(const message *pMessage) {
 	
 	// If malfunction state, ignore all messages (physical reset needed)
-	if (position != POINTPOS_UNDEFINED || message.header.type == IMSGTYPE_POINTRESET) {
-		switch (message.header.type) {
+	if (position != POINTPOS_UNDEFINED || pMessage->header.type == IMSGTYPE_POINTRESET) {
+		switch (pMessage->header.type) {
 			// Point RESET
 			case IMSGTYPE_POINTRESET:
-				requestedPosition = message.pointIReset.requestedPosition;
+				requestedPosition = pMessage->pointIReset.requestedPosition;
 				position=requestedPosition;
 				
 				// Disable notify
@@ -83,8 +83,8 @@ static void process_message(message message) {
 			
 			// Positioning request
 			case IMSGTYPE_POINTPOS:
-				requestedPosition =  message.pointIPosition.requestedPosition;
-				requestNonce = message.pointIPosition.requestTimestamp;
+				requestedPosition =  pMessage->pointIPosition.requestedPosition;
+				requestNonce = pMessage->pointIPosition.requestTimestamp;
 				
 				// Log
 				syslog(LOG_INFO, "Request for %s positioning received with nonce %i", pointPosStr(requestedPosition), requestNonce);	
@@ -103,7 +103,7 @@ static void process_message(message message) {
 				
 			// Other messages discarded
 			default:
-				syslog(LOG_ERR, "Unattended message type (%d). Should not be send to Point task and will be ignored", message.iHeader.type);
+				syslog(LOG_ERR, "Unattended message type (%d). Should not be send to Point task and will be ignored", pMessage->iHeader.type);
 				break;
 		}
 	}
@@ -116,11 +116,11 @@ static int worker() {
 	// If present receive a message
 	if (msgQNumMsgs(msgQPointId)) {
 		// Receive the messsage
-		message message;
-		msgQReceive(msgQPointId, (char *  ) &message, sizeof(message), WAIT_FOREVER);
+		message *pMessage = msgQ_ReceiveRef(msgQPointId, WAIT_FOREVER);
 		
 		// Process the message
-		process_message(message);
+		process_message(pMessage);
+		msgPool_Free(pMessage);
 	}
 	
 	// In any case modify the position (if necessary)
@@ -161,8 +161,7 @@ void dixlPoint() {
 	FOREVER {
 		
 		// Wait an activation message ... FOREVER
-		message inMessage;
-		msgQReceive(msgQPointId, (char *  ) &inMessage, sizeof(inMessage), WAIT_FOREVER);
+		message *pInMessage = msgQ_ReceiveRef(msgQPointId, WAIT_FOREVER);
 		
 		// If is VxSim compile LED management is disabled
 #if CPU !=_VX_SIMNT
@@ -177,7 +176,8 @@ void dixlPoint() {
 		semTake(semPosition, WAIT_FOREVER);
 		
 		// Process the message
-		process_message(inMessage);
+		process_message(pInMessage);
+		msgPool_Free(pInMessage);
 		
 		// Need to move ?
 		bool moved = FALSE;
@@ -11,6 +11,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+#include <clockLib.h>
 #include <msgQLib.h>
 #include <taskLib.h>
 #include <sysLib.h>
@@ -38,6 +39,7 @@ SEM_ID semSensor;										// Semaphore to access sensor
 // Sensor State
 static eSensorState currentState = SENSORSTATE_OFF;		// Initial OFF state
 static eSensorState requestedState = SENSORSTATE_OFF;
+static struct timespec changedAt;						// Current state reached (monotonic clock)
 static struct timespec requestNonce;					// Nonce (timestamp) of the request (if 0 notification isn't sent)
 static _Vx_freq_t periodTick;
 
@@ -59,14 +61,21 @@ static void initialize() {
 	syslog(LOG_INFO, "> Real excepted period time: %.0fms (+%0.f%)", realPeriodTime, increment);	
 }
 
+// Sensor read: time of the change kept (the route stays locked from then until the Ctrl task gets the notify)
+static void setState(eSensorState state) {
+	if (state != currentState)
+		clock_gettime(CLOCK_MONOTONIC, &changedAt);
+	currentState = state;
+}
+
 // Process a single message received
-static void process_message(message message) {
+static void process_message(const message *pMessage) {
 	
-	switch (message.header.type) {
+	switch (pMessage->header.type) {
 		// Positioning request
 		case IMSGTYPE_SENSORSTATE:
-			requestedState = message.sensorIPOS.requestedState;
-			requestNonce = message.sensorIPOS.requestTimestamp;
+			requestedState = pMessage->sensorIPOS.requestedState;
+			requestNonce = pMessage->sensorIPOS.requestTimestamp;
 						
 			// Log
 			syslog(LOG_INFO, "Waiting for %s state with nonce %i", sensorStateStr(requestedState), requestNonce);				
@@ -74,7 +83,7 @@ static void process_message(message message) {
 			
 		// Other messages discarded
 		default:
-			syslog(LOG_ERR, "Unattended message type (%d). Should not be send to Sensor task and will be ignored", message.iHeader.type);
+			syslog(LOG_ERR, "Unattended message type (%d). Should not be send to Sensor task and will be ignored", pMessage->iHeader.type);
 			break;
 	}
 }
@@ -86,15 +95,15 @@ static int worker() {
 	// If present receive a message
 	if (msgQNumMsgs(msgQSensorId)) {
 		// Receive the messsage
-		message message;
-		msgQReceive(msgQSensorId, (char *  ) &message, sizeof(message), WAIT_FOREVER);
+		message *pMessage = msgQ_ReceiveRef(msgQSensorId, WAIT_FOREVER);
 		
 		// Process the message
-		process_message(message);
+		process_message(pMessage);
+		msgPool_Free(pMessage);
 	}
 	// If VxSim compile Button emulate mode (only when needed)
 #if CPU ==_VX_SIMNT
-	if (currentState != requestedState) {
+	if (currentState != requestedState && !TASKSENSORSIMMISSED) {
 		syslog(LOG_INFO,"Simulation mode: emulating SENSOR %s in 5 seconds", sensorStateStr(requestedState));
 		taskDelay(sysClkRateGet() * 5);
 		// Log occupied/freed if it wasn't
@@ -102,7 +111,7 @@ static int worker() {
 			logger_log(LOGTYPE_OCCUPIED, NULL, NodeNULL );
 		else
 			logger_log(LOGTYPE_FREED, NULL, NodeNULL );
-		currentState = requestedState;
+		setState(requestedState);
 	}
 #else
 	// Read sensor state from GPIO
@@ -113,14 +122,14 @@ static int worker() {
 			logger_log(LOGTYPE_OCCUPIED, NULL, NodeNULL );
 			syslog(LOG_INFO,"SENSOR is %s: track is occupied", sensorStateStr(SENSORSTATE_ON));
 		}
-		currentState = SENSORSTATE_ON;		
+		setState(SENSORSTATE_ON);
 	} else {
 		// Log freed if it wasn't
 		if (currentState != SENSORSTATE_OFF) {
 			logger_log(LOGTYPE_FREED, NULL, NodeNULL );
 			syslog(LOG_INFO,"SENSOR is %s: track is free", sensorStateStr(SENSORSTATE_OFF));
 		}
-		currentState = SENSORSTATE_OFF;
+		setState(SENSORSTATE_OFF);
 	}		
 #endif
 
@@ -150,6 +159,7 @@ void dixlSensor() {
 	
 	// Message queue initialization
 	msgQSensorId = msgQ_Initialize(MSGQSENSORMESSAGESMAX, MSGQSENSORMESSAGESLENGTH, MSG_Q_FIFO);
+	msgQ_SetPolicy(msgQSensorId, MSGQSENSORPOLICY, NO_WAIT);
 	
 	// Take sem
 	semTake(semSensor, WAIT_FOREVER);			
@@ -176,6 +186,7 @@ void dixlSensor() {
 			outMessage.iHeader.type = IMSGTYPE_SENSORNOTIFY;
 			outMessage.sensorINOTIFY.currentState = currentState;
 			outMessage.sensorINOTIFY.requestTimestamp = requestNonce;
+			outMessage.sensorINOTIFY.changedAt = changedAt;
 	
 			// Notify to task Ctrl
 			msgQ_Send(msgQCtrlId, (char *) &outMessage, sizeof(msgIHeader) + sizeof(msgISensorNOTIFY));					
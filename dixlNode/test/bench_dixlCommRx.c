@@ -0,0 +1,239 @@
+/**
+ * bench_dixlCommRx.c
+ *
+ * dixlCommRx framer benchmark: frames/sec of the in place framer (offset cursor) against the previous
+ * one (a copy of each frame and a shift of the buffer after it), on a stream of mixed frame sizes
+ * received from memory (framing only) and from a local stream socket (recv calls included).
+ * Frames of unknown type in the stream check the resync: the frames after them are still delivered
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../tasks/dixlCommRx.c"
+
+/* defines */
+#define STREAMFRAMES		100000				// Frames in the stream
+#define ROUNDS				20					// Times the stream is processed
+#define UNKNOWNEVERY		10					// A frame of unknown type every UNKNOWNEVERY (resync check)
+
+/* Node stubs: the frames are copied as the queues would, not queued */
+MSG_Q_ID msgQInitId, msgQCtrlId, msgQCommTxId, msgQLogId, msgQDiagId, msgQPointId, msgQSensorId;
+IPv4Address IPv4 = { { 127, 0, 0, 2 } };
+IPv4String IPv4s = "127.0.0.2";
+static union {
+	message message;
+	char buffer[MSG_MAXLENGTH];
+} poolMessage;
+static unsigned long dispatched = 0;
+
+bool msgQ_Send(MSG_Q_ID msgQId, char *buffer, size_t nBytes) {
+	memcpy(&poolMessage, buffer, nBytes < MSG_MAXLENGTH ? nBytes : MSG_MAXLENGTH);
+	dispatched++;
+	return TRUE;
+}
+
+bool msgQ_SendRef(MSG_Q_ID msgQId, message *pMessage) {
+	dispatched++;
+	return TRUE;
+}
+
+bool msgQ_TrySendRef(MSG_Q_ID msgQId, message *pMessage) {
+	return msgQ_SendRef(msgQId, pMessage);
+}
+
+message *msgPool_Alloc() {
+	return &poolMessage.message;
+}
+
+void msgPool_Free(message *pMessage) {
+}
+
+void msgQ_PoolDropped(MSG_Q_ID msgQId) {
+}
+
+bool msgQ_GetStats(MSG_Q_ID msgQId, msgQStats *pStats) {
+	return FALSE;
+}
+
+double time_timespecdiff(const struct timespec *time1, const struct timespec *time0) {
+	return (time1->tv_sec - time0->tv_sec) + (time1->tv_nsec - time0->tv_nsec) / 1e9;
+}
+
+/* Previous framer: buffer of two messages, received chunks up to MSG_MAXLENGTH */
+static char oldBuffer[2 * MSG_MAXLENGTH];
+static int oldBufferLen = 0;
+
+static void old_process(const char *stream, int streamLen) {
+	memcpy(&oldBuffer[oldBufferLen], stream, streamLen);
+	oldBufferLen += streamLen;
+
+	uint8_t messageLen = 0;
+	while (oldBufferLen > 0 && (messageLen = oldBuffer[0]) <= oldBufferLen) {
+		message message;
+		memcpy(&message, oldBuffer, messageLen);
+		oldBufferLen -= messageLen;
+		memmove(oldBuffer, &oldBuffer[messageLen], oldBufferLen);
+
+		// Unknown type: the rest of the buffer is left behind
+		if (dixlCommRxDispatch((const char *) &message, messageLen, TRUE) == COMMDISPATCH_UNKNOWN)
+			return;
+	}
+}
+
+/* Stream of legacy frames: 16 (LOGREQ), 24 (route), 64, 128, 255 bytes (traced route) */
+static char *stream_build(int numFrames, bool unknown, int *pStreamLen, int *pKnown) {
+	static const uint8_t sizes[] = { 16, 24, 24, 24, 64, 128, 255 };
+	char *stream = malloc((size_t) numFrames * MSG_MAXLENGTH);
+	int streamLen = 0;
+
+	*pKnown = 0;
+	srand(1);
+	for (int i = 0; i < numFrames; i++) {
+		uint8_t size = sizes[rand() % sizeof(sizes)];
+		msgHeader *pHeader = (msgHeader *) &stream[streamLen];
+		memset(pHeader, 0, size);
+		pHeader->lentgh = size;
+		pHeader->type = (size == 16) ? MSGTYPE_LOGREQ : MSGTYPE_ROUTEACK;
+		if (unknown && i % UNKNOWNEVERY == UNKNOWNEVERY - 1)
+			pHeader->type = 200;
+		else
+			(*pKnown)++;
+		streamLen += size;
+	}
+	*pStreamLen = streamLen;
+	return stream;
+}
+
+static double now() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* Source of the stream: memory (the recv copy only) or a local stream socket fed by a writer thread */
+typedef struct {
+	const char *stream;
+	int streamLen;
+	int pos;
+	int fd;
+} streamSource;
+
+static int source_read(streamSource *pSource, char *buffer, int maxLen) {
+	int len = pSource->streamLen - pSource->pos;
+	len = (maxLen < len) ? maxLen : len;
+	if (!len)
+		return 0;
+	if (pSource->fd < 0)
+		memcpy(buffer, &pSource->stream[pSource->pos], len);
+	else if ((len = recv(pSource->fd, buffer, len, 0)) <= 0)
+		return 0;
+	pSource->pos += len;
+	return len;
+}
+
+static void *source_writer(void *arg) {
+	streamSource *pSource = arg;
+	for (int pos = 0; pos < pSource->streamLen; ) {
+		ssize_t len = write(pSource->fd, &pSource->stream[pos], pSource->streamLen - pos);
+		if (len <= 0)
+			break;
+		pos += len;
+	}
+	return NULL;
+}
+
+/* Frames dispatched from the stream received in chunks */
+static unsigned long old_run(streamSource *pSource, int chunk) {
+	char received[MSG_MAXLENGTH];
+	dispatched = 0;
+	oldBufferLen = 0;
+	int len;
+	while ((len = source_read(pSource, received, chunk)) > 0)
+		old_process(received, len);
+	return dispatched;
+}
+
+static unsigned long new_run(streamSource *pSource, int chunk) {
+	static commRxConnection conn;
+	dispatched = 0;
+	conn.head = conn.tail = 0;
+	for (;;) {
+		// As connection_receive: room for the longest message, received in place
+		if (COMMBUFFERSIZE - conn.tail < MSG_BULKMAXLENGTH) {
+			memmove(conn.buffer, &conn.buffer[conn.head], conn.tail - conn.head);
+			conn.tail -= conn.head;
+			conn.head = 0;
+		}
+		int len = COMMBUFFERSIZE - conn.tail;
+		if ((len = source_read(pSource, &conn.buffer[conn.tail], (chunk < len) ? chunk : len)) <= 0)
+			break;
+		conn.tail += len;
+		if (!process_message(&conn))
+			return 0;
+	}
+	return dispatched;
+}
+
+static unsigned long run(unsigned long (*framer)(streamSource *, int), const char *stream, int streamLen, int chunk, bool socket) {
+	streamSource source = { stream, streamLen, 0, -1 };
+	streamSource writer = { stream, streamLen, 0, -1 };
+	pthread_t writerThread;
+	int fds[2];
+
+	if (socket) {
+		socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+		source.fd = fds[0];
+		writer.fd = fds[1];
+		pthread_create(&writerThread, NULL, source_writer, &writer);
+	}
+	unsigned long frames = framer(&source, chunk);
+	if (socket) {
+		pthread_join(writerThread, NULL);
+		close(fds[0]);
+		close(fds[1]);
+	}
+	return frames;
+}
+
+static void bench(const char *name, unsigned long (*framer)(streamSource *, int), const char *stream, int streamLen, int chunk, bool socket) {
+	double start = now();
+	for (int i = 0; i < ROUNDS; i++)
+		run(framer, stream, streamLen, chunk, socket);
+	double elapsed = now() - start;
+	printf("  %-8s %-26s %5d bytes/recv  %8.2f Mframes/s\n", socket ? "socket" : "memory", name, chunk, (double) STREAMFRAMES * ROUNDS / elapsed / 1e6);
+}
+
+int main() {
+	int streamLen, known;
+	int failed = 0;
+
+	// Throughput
+	char *stream = stream_build(STREAMFRAMES, FALSE, &streamLen, &known);
+	printf("dixlCommRx framer: %d frames (16..255 bytes, %d bytes), %d rounds\n", STREAMFRAMES, streamLen, ROUNDS);
+	for (int socket = 0; socket <= 1; socket++) {
+		bench("shift after each frame", old_run, stream, streamLen, MSG_MAXLENGTH, socket);
+		bench("in place (offset cursor)", new_run, stream, streamLen, MSG_MAXLENGTH, socket);
+		bench("in place (offset cursor)", new_run, stream, streamLen, 1460, socket);
+		bench("in place (offset cursor)", new_run, stream, streamLen, COMMBUFFERSIZE, socket);
+	}
+	free(stream);
+
+	// Resync: all the known frames are delivered
+	stream = stream_build(STREAMFRAMES / 10, TRUE, &streamLen, &known);
+	unsigned long oldDelivered = run(old_run, stream, streamLen, MSG_MAXLENGTH, FALSE);
+	unsigned long newDelivered = run(new_run, stream, streamLen, COMMBUFFERSIZE, FALSE);
+	printf("Unknown frame every %d: %d known frames, %lu delivered by the shift framer, %lu in place\n", UNKNOWNEVERY, known, oldDelivered, newDelivered);
+	if (newDelivered != (unsigned long) known) {
+		printf("FAIL: frames lost after an unknown frame\n");
+		failed = 1;
+	}
+	free(stream);
+
+	return failed;
+}
@@ -0,0 +1,192 @@
+/**
+ * bench_msgQRing.c
+ *
+ * Lock-free ring (msgQRing) against a mutex/condition variable queue (the shim msgQSend/msgQReceive) carrying
+ * message references from 1 to 8 producers to one consumer: throughput with the producers sending as fast as
+ * they can, latency (send to receive) with the producers paced. Then a ring deleted while its producers are
+ * blocked on it full: the producers must return and every pool message be given back
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vxWorks.h"
+#include <msgQLib.h>
+#include <syslog.h>
+
+#include "../config.h"
+#include "../includes/msgPool.h"
+#include "../includes/msgQRing.h"
+#include "../includes/utils.h"
+
+/* defines */
+#define QUEUEMAX			MSGQCTRLMESSAGESMAX		// Queue length (as the Ctrl queue)
+#define MESSAGES			(1 << 19)				// Messages per throughput run (all the producers)
+#define PACEDMESSAGES		(1 << 14)				// Messages per latency run
+#define PACEDPERIOD			50						// Period of each paced producer (us)
+#define SLOTS				(4 * QUEUEMAX)			// Samples per producer, reused (a producer is at most QUEUEMAX ahead)
+#define DELETEPRODUCERS		4						// Producers blocked on the ring deleted
+
+/* types */
+typedef struct sample {
+	struct timespec sentAt;
+} sample;
+
+typedef struct producer {
+	pthread_t thread;
+	int numMessages;
+	long period;							// ns between sends (0: as fast as possible)
+	sample slots[SLOTS];
+} producer;
+
+/* Start task (dkm.c) */
+TASK_ID	taskStartId;
+char	*taskStartName;
+
+/* variables */
+static bool useRing;
+static MSG_Q_ID msgQId;
+static msgQRing *pRing;
+static producer producers[8];
+static double latency[MESSAGES];
+static MSG_Q_ID deletedId;
+
+static double ns(const struct timespec *time) {
+	return time->tv_sec * 1e9 + time->tv_nsec;
+}
+
+static void *produce(void *arg) {
+	producer *pProducer = arg;
+	struct timespec next;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (int i = 0; i < pProducer->numMessages; i++) {
+		// Paced: sleep to the next period
+		if (pProducer->period) {
+			next.tv_nsec += pProducer->period;
+			if (next.tv_nsec >= 1000000000L) {
+				next.tv_sec++;
+				next.tv_nsec -= 1000000000L;
+			}
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+
+		sample *pSample = &pProducer->slots[i % SLOTS];
+		clock_gettime(CLOCK_MONOTONIC, &pSample->sentAt);
+		if (useRing)
+			msgQRing_Send(pRing, (message *) pSample, WAIT_FOREVER);
+		else
+			msgQSend(msgQId, (char *) &pSample, sizeof(pSample), WAIT_FOREVER, MSG_PRI_NORMAL);
+	}
+	return NULL;
+}
+
+static int compare(const void *a, const void *b) {
+	double d = *(const double *) a - *(const double *) b;
+	return (d > 0) - (d < 0);
+}
+
+// Messages from numProducers producers received: elapsed seconds, latencies in latency[]
+static double run(int numProducers, int numMessages, long period) {
+	for (int p = 0; p < numProducers; p++) {
+		producers[p].numMessages = numMessages / numProducers;
+		producers[p].period = period;
+	}
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int p = 0; p < numProducers; p++)
+		pthread_create(&producers[p].thread, NULL, produce, &producers[p]);
+
+	for (int i = 0; i < numMessages; i++) {
+		sample *pSample;
+		if (useRing)
+			pSample = (sample *) msgQRing_Receive(pRing, WAIT_FOREVER);
+		else
+			msgQReceive(msgQId, (char *) &pSample, sizeof(pSample), WAIT_FOREVER);
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		latency[i] = (ns(&now) - ns(&pSample->sentAt)) / 1000;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	for (int p = 0; p < numProducers; p++)
+		pthread_join(producers[p].thread, NULL);
+	return (ns(&end) - ns(&start)) / 1e9;
+}
+
+// Producer of the ring deleted: more messages than it can hold
+static void *produce_deleted(void *arg) {
+	for (int i = 0; i < 100; i++) {
+		message *pMessage = msgPool_Alloc();
+		if (pMessage)
+			msgQ_SendRef(deletedId, pMessage);
+	}
+	return NULL;
+}
+
+// Producers blocked on a full ring deleted: TRUE if they all return and the pool is whole again
+static bool delete_blocked() {
+	msgPool_Initialize();
+	deletedId = msgQ_Initialize(64, MSGPOOL_REFLENGTH, MSG_Q_FIFO | MSGQ_OPT_RING);
+	msgQ_SetPolicy(deletedId, MSGQPOLICY_BLOCK, WAIT_FOREVER);
+
+	pthread_t threads[DELETEPRODUCERS];
+	for (int p = 0; p < DELETEPRODUCERS; p++)
+		pthread_create(&threads[p], NULL, produce_deleted, NULL);
+	usleep(100000);
+	int queued = msgQ_NumMsgs(deletedId);
+	msgQ_Delete(deletedId);
+
+	// Producers returned (within a second)
+	int numReturned = 0;
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += 1;
+	for (int p = 0; p < DELETEPRODUCERS; p++)
+		numReturned += pthread_timedjoin_np(threads[p], NULL, &deadline) == 0;
+
+	// Every message free
+	static message *pMessages[MSGPOOLSIZE];
+	int numFree = 0;
+	while (numFree < MSGPOOLSIZE && (pMessages[numFree] = msgPool_Alloc()))
+		numFree++;
+	for (int i = 0; i < numFree; i++)
+		msgPool_Free(pMessages[i]);
+
+	printf("ring deleted with %d messages queued and %d producers blocked: %d producers returned, %d/%d pool messages free\n", queued, DELETEPRODUCERS, numReturned, numFree, MSGPOOLSIZE);
+	return numReturned == DELETEPRODUCERS && numFree == MSGPOOLSIZE;
+}
+
+int main() {
+	openlog("bench_msgQRing", LOG_PERROR, LOG_USER);
+	setlogmask(LOG_UPTO(LOG_CRIT));
+
+	// Ring (its handle a queue, as msgQ_Initialize does), mutex/condition variable queue
+	MSG_Q_ID ringId = msgQCreate(1, sizeof(sample *), MSG_Q_FIFO);
+	msgQRing_Create(ringId, QUEUEMAX);
+	pRing = msgQRing_Get(ringId);
+	msgQId = msgQCreate(QUEUEMAX, sizeof(sample *), MSG_Q_FIFO);
+
+	printf("%d message references, queue of %d, %ld CPUs\n", MESSAGES, QUEUEMAX, sysconf(_SC_NPROCESSORS_ONLN));
+	printf("  %-9s %-5s %12s  %-44s\n", "producers", "queue", "throughput", "latency (paced, one message every 50 us each)");
+	for (int numProducers = 1; numProducers <= 8; numProducers *= 2)
+		for (int ring = 0; ring < 2; ring++) {
+			useRing = ring;
+			double elapsed = run(numProducers, MESSAGES, 0);
+			run(numProducers, PACEDMESSAGES, PACEDPERIOD * 1000);
+			qsort(latency, PACEDMESSAGES, sizeof(double), compare);
+			printf("  %-9d %-5s %7.2f M/s    median %6.1f us  p99 %7.1f us  p99.9 %7.1f us\n", numProducers, ring ? "ring" : "mutex", MESSAGES / elapsed / 1e6,
+					latency[PACEDMESSAGES / 2], latency[PACEDMESSAGES * 99 / 100], latency[PACEDMESSAGES * 999 / 1000]);
+		}
+
+	bool passed = delete_blocked();
+	if (!passed)
+		printf("FAIL: ring deleted with producers blocked\n");
+	return passed ? 0 : 1;
+}
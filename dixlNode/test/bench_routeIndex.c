@@ -0,0 +1,85 @@
+/**
+ * bench_routeIndex.c
+ *
+ * Route lookups by id through the route index (routeIndexFind) against the linear search of the route list
+ * it replaced in the Ctrl FSMs, with BENCHROUTES configured routes (CONFIGMAXROUTES overridden, the index
+ * sized on it): lookups/s of configured ids (random order) and of ids not configured
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../config.h"
+
+/* Index sized on the routes of the benchmark */
+#undef CONFIGMAXROUTES
+#define CONFIGMAXROUTES			BENCHROUTES
+
+#include "../datatypes/dataHelper.c"
+
+/* defines */
+#define LOOKUPS				(1 << 22)			// Lookups per measure (fewer for the linear search)
+#define IDS					4096				// Ids looked up (cycled)
+
+/* variables */
+static route routes[BENCHROUTES];
+static routeIndex lookupIndex;
+static routeId hits[IDS], misses[IDS];
+static volatile uintptr_t sink;
+
+static double now() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Linear search of the route list (the lookup before the index)
+static route *linear_find(routeId id) {
+	for (uint32_t i = 0; i < BENCHROUTES; i++)
+		if (routes[i].id == id)
+			return &routes[i];
+	return NULL;
+}
+
+// Lookups/s of the ids, FALSE if a lookup is wrong
+static bool measure(bool indexed, const routeId *ids, bool configured, int lookups, double *pRate) {
+	double start = now();
+	for (int i = 0; i < lookups; i++) {
+		route *pRoute = indexed ? routeIndexFind(&lookupIndex, ids[i % IDS]) : linear_find(ids[i % IDS]);
+		if ((pRoute != NULL) != configured || (pRoute && pRoute->id != ids[i % IDS]))
+			return FALSE;
+		sink += (uintptr_t) pRoute;
+	}
+	*pRate = lookups / (now() - start);
+	return TRUE;
+}
+
+int main() {
+	// Sparse ids (as assigned by the host), the ids not configured in between
+	srand(1);
+	for (uint32_t i = 0; i < BENCHROUTES; i++)
+		routes[i].id = 1 + 3 * i;
+	for (int i = 0; i < IDS; i++) {
+		hits[i] = routes[rand() % BENCHROUTES].id;
+		misses[i] = 2 + 3 * (rand() % BENCHROUTES);
+	}
+	double start = now();
+	routeIndexBuild(&lookupIndex, routes, BENCHROUTES);
+	double build = now() - start;
+
+	// The linear search of many routes is slow: fewer lookups
+	int linearLookups = LOOKUPS / BENCHROUTES * 64;
+	double indexedHit, indexedMiss, linearHit, linearMiss;
+	bool passed = measure(TRUE, hits, TRUE, LOOKUPS, &indexedHit) && measure(TRUE, misses, FALSE, LOOKUPS, &indexedMiss)
+			&& measure(FALSE, hits, TRUE, linearLookups, &linearHit) && measure(FALSE, misses, FALSE, linearLookups, &linearMiss);
+
+	printf("%6d routes (index %d slots, built in %.3f ms): index %7.1f M/s hit %7.1f M/s miss, linear %8.3f M/s hit %8.3f M/s miss\n",
+			BENCHROUTES, ROUTEINDEXSLOTS, build * 1000, indexedHit / 1e6, indexedMiss / 1e6, linearHit / 1e6, linearMiss / 1e6);
+	if (!passed)
+		printf("FAIL: wrong route found\n");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+# Linux harness of the node: tests and benchmarks built against the VxWorks shim (test/vxshim),
+# simulated networks of dixlNodeSim processes on the loopback driven by the dixlHost messages (test/sim.py)
+# Run from dixlNode: sh test/build.sh [target ...] (all the targets by default)
+CC=${CC:-gcc}
+CFLAGS="-std=gnu11 -O2 -g -pthread -include test/vxshim/vxWorks.h -Itest/vxshim"
+OUT=test/out
+SHIM=test/vxshim/vxshim.c
+NODE=$(sed -n 's/.*-dkm dkm.c \(.*\) -o dkm.o.*/\1/p' build.sh)
+
+# Tests and benchmarks: name and sources (the test/benchmark first)
+tests() {
+	echo "bench_dixlCommRx test/bench_dixlCommRx.c includes/network.c includes/trace.c datatypes/dataHelper.c"
+	echo "bench_msgQRing test/bench_msgQRing.c $NODE"
+	echo "bench_routeIndex256 test/bench_routeIndex.c -DBENCHROUTES=256"
+	echo "bench_routeIndex4k test/bench_routeIndex.c -DBENCHROUTES=4096"
+	echo "bench_routeIndex64k test/bench_routeIndex.c -DBENCHROUTES=65536"
+	echo "test_FSMEngine test/test_FSMEngine.c FSM/FSMEngine.c"
+	echo "test_dixlCommTxBlackhole test/test_dixlCommTxBlackhole.c $NODE"
+	echo "test_dixlCommTxLoopback test/test_dixlCommTxLoopback.c $NODE"
+	echo "test_dixlLogExport test/test_dixlLogExport.c $NODE"
+}
+
+# Simulated nodes: name and config.h changes (sed script, none for the default config)
+nodes() {
+	UDP='/^#define COMMROUTETRANSPORT/s/COMMTRANSPORTTCP/COMMTRANSPORTUDP/'
+	printf '%s\n' "dixlNodeSim"
+	printf '%s\n' "dixlNodeSimUdp $UDP"
+	printf '%s\n' "dixlNodeSimUdpLoss10 $UDP;/^#define COMMDGRAMLOSSPERCENT/s/[[:space:]]0[[:space:]]/ 10 /"
+	printf '%s\n' "dixlNodeSimUdpLoss30 $UDP;/^#define COMMDGRAMLOSSPERCENT/s/[[:space:]]0[[:space:]]/ 30 /"
+	NONE='/^#define CTRLROUTECONFLICT/s/CTRLCONFLICTALL/CTRLCONFLICTNONE/'
+	POSITION='/^#define CTRLROUTECONFLICT/s/CTRLCONFLICTALL/CTRLCONFLICTPOSITION/'
+	printf '%s\n' "dixlNodeSimConflictNone $NONE"
+	printf '%s\n' "dixlNodeSimConflictPosition $POSITION"
+	printf '%s\n' "dixlNodeSimSensorMissed /^#define TASKSENSORSIMMISSED/s/FALSE/TRUE/"
+}
+
+# Simulations: name and script
+sims() {
+	echo "sim_dgramLoss test/sim_dgramLoss.py"
+	echo "sim_config test/sim_config.py"
+	echo "sim_concurrent test/sim_concurrent.py"
+	echo "sim_star test/sim_star.py"
+	echo "sim_point test/sim_point.py"
+	echo "sim_release test/sim_release.py"
+}
+
+selected() {
+	[ -z "$SELECTED" ] || echo " $SELECTED " | grep -q " $1 "
+}
+
+SELECTED="$*"
+mkdir -p $OUT
+failed=0
+
+# Nodes (the config variants built from a copy of the sources)
+nodes | while read -r name script; do
+	if [ -z "$script" ]; then
+		$CC $CFLAGS -o $OUT/$name test/dixlNodeSim.c $NODE $SHIM -lm || exit 1
+		continue
+	fi
+	rm -rf $OUT/src-$name && mkdir -p $OUT/src-$name/test
+	cp -r FSM datatypes includes tasks globals.h config.h version.h $OUT/src-$name/
+	cp -r test/vxshim test/dixlNodeSim.c $OUT/src-$name/test/
+	sed -i "$script" $OUT/src-$name/config.h
+	(cd $OUT/src-$name && $CC $CFLAGS -o ../$name test/dixlNodeSim.c $NODE $SHIM -lm) || exit 1
+done || failed=1
+
+# Tests and benchmarks
+[ $failed -eq 0 ] && tests | while read -r name sources; do
+	selected $name || continue
+	echo "== $name"
+	$CC $CFLAGS -o $OUT/$name $sources $SHIM -lm || exit 1
+	$OUT/$name || exit 1
+done || failed=1
+
+# Simulations
+[ $failed -eq 0 ] && sims | while read -r name script; do
+	selected $name || continue
+	echo "== $name"
+	python3 $script || exit 1
+done || failed=1
+
+[ $failed -eq 0 ] && echo "== OK" || echo "== FAILED"
+exit $failed
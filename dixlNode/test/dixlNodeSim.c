@@ -0,0 +1,72 @@
+/**
+ * dixlNodeSim.c
+ *
+ * dixlNode as a Linux process (VxWorks shim): a node of a simulated network on the loopback,
+ * its IP from DIXLSIM_IP (e.g. 127.0.0.3), the log on stderr if DIXLSIM_VERBOSE is set.
+ * Started as start() in dkm.c, without the NTP time setting and the GPIO. Terminated (SIGTERM),
+ * it prints the transport and pool counters on stderr
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+
+#include "vxWorks.h"
+#include <syslog.h>
+#include <taskLib.h>
+
+#include "../globals.h"
+#include "../config.h"
+#include "../includes/msgPool.h"
+#include "../includes/timerWheel.h"
+#include "../tasks/dixlComm.h"
+#include "../tasks/dixlInit.h"
+
+/*
+ * Task infos
+ */
+TASK_ID	taskStartId;
+char	*taskStartName;
+
+int main() {
+	// Killed with the simulation driver
+	prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+	// SIGTERM waited by the main thread only (the tasks inherit the mask)
+	sigset_t stopSignals;
+	sigemptyset(&stopSignals);
+	sigaddset(&stopSignals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &stopSignals, NULL);
+
+	openlog("dixlNodeSim", getenv("DIXLSIM_VERBOSE") ? LOG_PERROR : 0, LOG_USER);
+	if (!getenv("DIXLSIM_VERBOSE"))
+		setlogmask(LOG_UPTO(LOG_ERR));
+
+	// Get task infos
+	taskStartId = taskIdSelf();
+	taskStartName = taskName(0);
+
+	// Messages pool (used by all the tasks queues)
+	msgPool_Initialize();
+
+	// Timer wheel (used by the tasks timeouts)
+	timerWheel_Initialize();
+
+	// Spawning
+	taskInitId = taskSpawn(TASKINITNAME, TASKINITPRIO, 0, TASKINITSTACKSIZE, (FUNCPTR) dixlInit, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+	// The node runs until it's terminated
+	int stopSignal;
+	sigwait(&stopSignals, &stopSignal);
+	openlog("dixlNodeSim", LOG_PERROR, LOG_USER);
+	setlogmask(LOG_UPTO(LOG_INFO));
+	dixlCommTxShow();
+	msgPoolShow();
+	return 0;
+}
@@ -0,0 +1,211 @@
+"""
+Simulated dixl network on the loopback: a dixlNodeSim process (test/out) for each node, each on its own
+127.0.0.x address, configured and driven by the dixlHost messages (host on 127.0.0.1).
+The host config flags are set before dixlHost is imported (configure), the GUI notifications are stubbed.
+
+@author         : "Alessandro Mannini"
+@organization   : "Università degli Studi di Firenze"
+@contact        : "alessandro.mannini@gmail.com"
+@date           : "Jan 10, 2023"
+@version        : "1.0.0"
+"""
+import contextlib
+import io
+import os
+import socket
+import statistics
+import subprocess
+import sys
+import time
+import types
+
+TestDir: str = os.path.dirname(os.path.abspath(__file__))
+HostDir: str = os.path.join(TestDir, '..', '..', 'dixlHost')
+NodeFirstIP: int = 10                   # nodes on 127.<run>.<network>.10, 127.<run>.<network>.11, ... (host on 127.<run>.0.1)
+Run: int = os.getpid() % 250 + 1        # listening ports of a previous run (or network) may be in TIME_WAIT
+Networks: int = 0
+HostIP: bytes = bytes([127, Run, 0, 1])
+
+# dixlHost without the GUI: notifications dropped
+sys.modules['pubsub'] = types.SimpleNamespace(pub=types.SimpleNamespace(sendMessage=lambda *args, **kwargs: None, subscribe=lambda *args, **kwargs: None))
+sys.path.insert(0, HostDir)
+
+def configure(**flags):
+	"""
+	Set the dixlHost config flags (before the first use of the host modules)
+	"""
+	import config
+	for name, value in flags.items():
+		setattr(config, name, value)
+
+def nodeIP(network: int, index: int) -> bytes:
+	return bytes([127, Run, network, NodeFirstIP + index])
+
+class ReusableSocket(socket.socket):
+	"""
+	Host sockets: the reply socket is bound again at each request while the previous connections are in TIME_WAIT
+	"""
+	def bind(self, address):
+		self.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+		super().bind(address)
+
+def hostMessages():
+	"""
+	dixlHost message module (its sockets reusable)
+	"""
+	import message
+	if message.socket is socket:
+		message.socket = types.ModuleType('socket')
+		message.socket.__dict__.update(socket.__dict__)
+		message.socket.socket = ReusableSocket
+	return message
+
+class Network:
+	"""
+	Nodes of the simulated network (track circuits, a line: node i next to node i + 1, points at the given indexes,
+	binaries: node variants at the given indexes instead of binary)
+	"""
+	def __init__(self, numNodes: int, binary: str = 'dixlNodeSim', env: dict = None, points: list[int] = (), binaries: dict[int, str] = None) -> None:
+		from model.point import Point
+		from model.track_circuit import TrackCircuit
+		global Networks
+		Networks += 1
+		IPs: list[bytes] = [nodeIP(Networks, i) for i in range(numNodes)]
+		self.nodes = [(Point(f'P{i + 1}', bytes([2, 0]) + IP, IP) if i in points else TrackCircuit(f'TC{i + 1}', bytes([2, 0]) + IP, IP)) for i, IP in enumerate(IPs)]
+		self.routes = []
+		self.processes = []
+		self.logs = []
+		for i in range(numNodes):
+			nodeBinary: str = (binaries or {}).get(i, binary)
+			processEnv = dict(os.environ, DIXLSIM_IP=socket.inet_ntoa(IPs[i]), **(env or {}))
+			self.logs.append(open(os.path.join(TestDir, 'out', f'{nodeBinary}-{i + 1}.log'), 'w+'))
+			self.processes.append(subprocess.Popen([os.path.join(TestDir, 'out', nodeBinary)], env=processEnv, stderr=self.logs[-1]))
+		for IP in IPs:
+			self.waitListening(IP)
+
+	def waitListening(self, IP: bytes, timeout: float = 10) -> None:
+		deadline: float = time.time() + timeout
+		while True:
+			try:
+				with socket.create_connection((socket.inet_ntoa(IP), 256), timeout=1):
+					return
+			except OSError:
+				if time.time() > deadline:
+					raise
+				time.sleep(0.05)
+
+	def route(self, id: int, nodes: list[int], position: str = 'STRAIGHT'):
+		"""
+		Add a route over the nodes (indexes), the points in the position (PointPosition name)
+		"""
+		from model.point import Point
+		from model.point_ref import PointPosition, PointRef
+		from model.route import Route
+		from model.track_circuit_ref import TrackCircuitRef
+		route = Route(id, f'Route {id}', [(PointRef(self.nodes[i], PointPosition[position]) if isinstance(self.nodes[i], Point) else TrackCircuitRef(self.nodes[i])) for i in nodes])
+		self.routes.append(route)
+		return route
+
+	def configureNodes(self) -> None:
+		message = hostMessages()
+		with contextlib.redirect_stdout(io.StringIO()):
+			for node in self.nodes:
+				message.sendConfig(HostIP, node)
+		time.sleep(0.5)
+
+	def request(self, route) -> tuple[bool, float]:
+		"""
+		Request a route: (TRAINOK received, seconds to the reply)
+		"""
+		message = hostMessages()
+		start: float = time.perf_counter()
+		output = io.StringIO()
+		with contextlib.redirect_stdout(output):
+			ok: bool = message.sendRequest(HostIP, route) and route.state.name == 'OK'
+		if not ok: print(output.getvalue())
+		return ok, time.perf_counter() - start
+
+	def requestBatch(self, routes: list) -> tuple[bool, float]:
+		"""
+		Request routes together (all or none): (all reserved, seconds to the last reply)
+		"""
+		message = hostMessages()
+		start: float = time.perf_counter()
+		output = io.StringIO()
+		with contextlib.redirect_stdout(output):
+			ok: bool = message.sendRequestBatch(HostIP, routes)
+		if not ok: print(output.getvalue())
+		return ok, time.perf_counter() - start
+
+	def release(self, route) -> None:
+		message = hostMessages()
+		with contextlib.redirect_stdout(io.StringIO()):
+			message.sendRelease(HostIP, route)
+
+	def reset(self, index: int) -> None:
+		message = hostMessages()
+		with contextlib.redirect_stdout(io.StringIO()):
+			message.sendReset(HostIP, self.nodes[index])
+
+	def configure(self, index: int) -> None:
+		message = hostMessages()
+		with contextlib.redirect_stdout(io.StringIO()):
+			message.sendConfig(HostIP, self.nodes[index])
+
+	def stats(self, index: int) -> dict:
+		"""
+		Queues statistics of a node (queue name => MsgQStats)
+		"""
+		message = hostMessages()
+		with contextlib.redirect_stdout(io.StringIO()):
+			return message.requestStats(HostIP, self.nodes[index])
+
+	def stop(self) -> list[str]:
+		"""
+		Terminate the nodes: their stderr (log errors, then the counters printed on SIGTERM)
+		"""
+		for process in self.processes:
+			process.terminate()
+		for process in self.processes:
+			try:
+				process.wait(timeout=5)
+			except subprocess.TimeoutExpired:
+				process.kill()
+				process.wait()
+		outputs: list[str] = []
+		for log in self.logs:
+			log.seek(0)
+			outputs.append(log.read())
+			log.close()
+		self.processes = []
+		self.logs = []
+		return outputs
+
+	def __enter__(self):
+		return self
+
+	def __exit__(self, *args):
+		self.stop()
+
+def counters(outputs: list[str], pattern: str) -> list[int]:
+	"""
+	Sum over the nodes of the numbers in the first line matching pattern (regex) of each node output
+	"""
+	import re
+	total: list[int] = []
+	for output in outputs:
+		match = re.search(pattern, output)
+		if match:
+			values = [int(value) for value in match.groups()]
+			total = [a + b for a, b in zip(total, values)] if total else values
+	return total
+
+def percentiles(samples: list[float]) -> str:
+	"""
+	Median, 95th percentile and max of samples (seconds) in ms
+	"""
+	if not samples:
+		return 'no samples'
+	ordered = sorted(samples)
+	p95 = ordered[min(len(ordered) - 1, int(round(0.95 * (len(ordered) - 1))))]
+	return f'median {statistics.median(ordered) * 1000:7.1f} ms  p95 {p95 * 1000:7.1f} ms  max {ordered[-1] * 1000:7.1f} ms'
@@ -0,0 +1,72 @@
+"""
+Concurrent route requests on the same nodes (per-route contexts): Routes routes over the same chain of track
+circuits, with no conflict between routes (CTRLROUTECONFLICT NONE, test only). Throughput (routes reserved
+per second) requesting them one at a time (each released before the next: a single route in progress on the
+nodes), one after the other (held) and all together (ROUTEREQBATCH: interleaved on every node).
+All or none: a batch with a route already reserved is rejected before any node is COMMITted.
+
+@author         : "Alessandro Mannini"
+@organization   : "Università degli Studi di Firenze"
+@contact        : "alessandro.mannini@gmail.com"
+@date           : "Jan 10, 2023"
+@version        : "1.0.0"
+"""
+import re
+import sys
+import time
+
+import sim
+
+Nodes: int = 3
+Routes: int = 4
+Rounds: int = 20
+
+sim.configure(RouteRequestResponseTimeout=5)
+
+def oneAtATime(network: sim.Network, routes: list) -> tuple[bool, float]:
+	ok, seconds = True, 0.0
+	for route in routes:
+		reserved, elapsed = network.request(route)
+		ok, seconds = ok and reserved, seconds + elapsed
+		network.release(route)
+		time.sleep(0.5)
+	return ok, seconds
+
+def held(network: sim.Network, routes: list) -> tuple[bool, float]:
+	results = [network.request(route) for route in routes]
+	return all(ok for ok, _ in results), sum(seconds for _, seconds in results)
+
+def concurrent(network: sim.Network, routes: list) -> tuple[bool, float]:
+	return network.requestBatch(routes)
+
+failed: bool = False
+print(f'{Routes} routes over the same {Nodes} nodes (chain), {Rounds} rounds, CTRLROUTECONTEXTSMAX contexts')
+with sim.Network(Nodes, 'dixlNodeSimConflictNone') as network:
+	routes = [network.route(id, list(range(Nodes))) for id in range(1, Routes + 1)]
+	network.configureNodes()
+
+	for mode, request in (('one at a time', oneAtATime), ('held', held), ('concurrent', concurrent)):
+		elapsed: list[float] = []
+		for i in range(Rounds):
+			ok, seconds = request(network, routes)
+			if ok:
+				elapsed.append(seconds)
+			for route in routes:
+				network.release(route)
+			time.sleep(0.5)
+		throughput: str = f'{Routes * len(elapsed) / sum(elapsed):6.1f} routes/s' if elapsed else ''
+		print(f'  {mode:13}  {len(elapsed):2}/{Rounds} reserved  {throughput}  per round {sim.percentiles(elapsed)}')
+		failed |= len(elapsed) != Rounds
+
+# All or none: the route held is rejected (already in progress), the others released before their COMMIT
+with sim.Network(Nodes, 'dixlNodeSimConflictNone', env={'DIXLSIM_VERBOSE': '1'}) as network:
+	routes = [network.route(id, list(range(Nodes))) for id in range(1, Routes + 1)]
+	network.configureNodes()
+	held, _ = network.request(routes[-1])
+	reserved, _ = network.requestBatch(routes)
+	outputs = network.stop()
+committed: int = sum(len(re.findall(rf'Route request \(({"|".join(str(route.id) for route in routes[:-1])})\) (COMMITed|AGREEed)', output)) for output in outputs)
+print(f'  all or none    batch with route {routes[-1].id} held {"reserved" if reserved else "rejected"}, other routes COMMITted on {committed} nodes')
+failed |= not held or reserved or committed != 0
+
+sys.exit(1 if failed else 0)
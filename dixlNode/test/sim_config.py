@@ -0,0 +1,61 @@
+"""
+Configuration of a node with CONFIGMAXROUTES routes, one route per message (NODECONFIG) against many routes per
+message (NODECONFIGBULK): frames sent and time from the reset to the whole configuration processed by the Init
+task and set in the Ctrl task (their queues statistics polled until every message is received).
+
+@author         : "Alessandro Mannini"
+@organization   : "Università degli Studi di Firenze"
+@contact        : "alessandro.mannini@gmail.com"
+@date           : "Jan 10, 2023"
+@version        : "1.0.0"
+"""
+import sys
+import time
+
+import sim
+
+Routes: int = 256
+Configurations: int = 20
+Timeout: float = 10
+
+def processed(network: sim.Network, init: int, ctrl: int) -> bool:
+	"""
+	Wait for the Init and Ctrl queues to receive the given number of messages
+	"""
+	deadline: float = time.perf_counter() + Timeout
+	while time.perf_counter() < deadline:
+		stats = network.stats(0)
+		if stats and stats['Init'].dequeued >= init and stats['Ctrl'].dequeued >= ctrl and not stats['Init'].depth and not stats['Ctrl'].depth:
+			return True
+	return False
+
+failed: bool = False
+print(f'Configuration of {Routes} routes, {Configurations} times')
+for bulk in (False, True):
+	message = sim.hostMessages()
+	message.NodeConfigBulk = bulk
+	frames: int = 1 + (-(-Routes // message.MsgConfigBulkMaxRoutes) if bulk else Routes)
+	with sim.Network(2, 'dixlNodeSim') as network:
+		for id in range(1, Routes + 1):
+			network.route(id, [0, 1])
+
+		# Stats requests are served by CommRx: the queue counters only
+		stats = network.stats(0)
+		init: int = stats['Init'].dequeued
+		ctrl: int = stats['Ctrl'].dequeued
+		elapsed: list[float] = []
+		for i in range(Configurations):
+			start: float = time.perf_counter()
+			network.reset(0)
+			network.configure(0)
+			# Init: the reset and the configuration frames; Ctrl: CONFIGRESET (once configured) and CONFIGSET
+			init += 1 + frames
+			ctrl += 2 if i else 1
+			if not processed(network, init, ctrl):
+				break
+			elapsed.append(time.perf_counter() - start)
+		outputs = network.stop()
+		print(f'  {"NODECONFIGBULK" if bulk else "NODECONFIG":14} {frames:3} frames  {len(elapsed):2}/{Configurations} configured  {sim.percentiles(elapsed)}')
+		failed |= len(elapsed) != Configurations
+
+sys.exit(1 if failed else 0)
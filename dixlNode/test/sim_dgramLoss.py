@@ -0,0 +1,46 @@
+"""
+Route messages between nodes on the UDP transport with induced loss (COMMDGRAMLOSSPERCENT, datagrams dropped
+on receive): a route over a chain of track circuits requested and released again, against the TCP transport.
+Up to 10% loss all the requests must be reserved: the lost datagrams are retransmitted. At 30% loss the
+retransmissions (COMMDGRAMRETRANSMIT) of many hops add up beyond the 2PC reply timeouts: measured only.
+
+@author         : "Alessandro Mannini"
+@organization   : "Università degli Studi di Firenze"
+@contact        : "alessandro.mannini@gmail.com"
+@date           : "Jan 10, 2023"
+@version        : "1.0.0"
+"""
+import sys
+import time
+
+import sim
+
+Nodes: int = 3
+Requests: int = 50
+Settle: float = 1.0			# Release retransmitted up to twice per hop (COMMDGRAMRETRANSMIT) before the next request
+
+sim.configure(RouteRequestResponseTimeout=5)
+
+failed: bool = False
+print(f'Route over {Nodes} nodes (chain), {Requests} requests')
+for binary, transport, required in (('dixlNodeSim', 'TCP', True), ('dixlNodeSimUdp', 'UDP', True), ('dixlNodeSimUdpLoss10', 'UDP 10% loss', True), ('dixlNodeSimUdpLoss30', 'UDP 30% loss', False)):
+	with sim.Network(Nodes, binary) as network:
+		route = network.route(1, list(range(Nodes)))
+		network.configureNodes()
+
+		latencies: list[float] = []
+		for i in range(Requests):
+			ok, elapsed = network.request(route)
+			if ok:
+				latencies.append(elapsed)
+			# The release reaches the last node before the next request (retransmitted too)
+			network.release(route)
+			time.sleep(Settle)
+
+		outputs = network.stop()
+		datagrams = sim.counters(outputs, r'Datagrams: (\d+) sent, (\d+) retransmitted, (\d+) acked, (\d+) dropped')
+		counted: str = f'  datagrams {datagrams[0]} sent, {datagrams[1]} retransmitted, {datagrams[3]} given up' if datagrams else ''
+		print(f'  {transport:13} {len(latencies):3}/{Requests} reserved  {sim.percentiles(latencies)}{counted}')
+		failed |= required and len(latencies) != Requests
+
+sys.exit(1 if failed else 0)
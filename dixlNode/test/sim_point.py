@@ -0,0 +1,63 @@
+"""
+Two routes through the same point in the same position (TC1 -> P3 and TC2 -> P3), a train on each: the point
+has a single sensor, each route must stay reserved until its own train went through (sensor ON then OFF).
+Default config (CTRLROUTECONFLICT ALL): the second route is reserved after the first train cleared the point.
+CTRLROUTECONFLICT POSITION: both reserved at once, the sensor events go to the oldest route (its train first).
+The sensor is emulated by the node (5 s after each request).
+
+@author         : "Alessandro Mannini"
+@organization   : "Università degli Studi di Firenze"
+@contact        : "alessandro.mannini@gmail.com"
+@date           : "Jan 10, 2023"
+@version        : "1.0.0"
+"""
+import os
+import re
+import sys
+import time
+
+import sim
+
+Timeout: float = 40.0                   # Both trains through the point (4 emulated sensor changes, 5 s each)
+
+sim.configure(RouteRequestResponseTimeout=5)
+
+def pointEvents(binary: str) -> list[tuple[int, str]]:
+	"""
+	Sensor events of the routes on the point (node 3) so far: (route, ON or OFF) in order
+	"""
+	with open(os.path.join(sim.TestDir, 'out', f'{binary}-3.log')) as log:
+		return [(int(route), 'ON' if event == 'TRAIN IS GOING THROUGH' else 'OFF') for route, event in re.findall(r'Route request \((\d+)\) (TRAIN IS GOING THROUGH|SENSOR OFF received)', log.read())]
+
+def waitCleared(binary: str, routeId: int) -> bool:
+	deadline: float = time.time() + Timeout
+	while (routeId, 'OFF') not in pointEvents(binary):
+		if time.time() > deadline:
+			return False
+		time.sleep(0.5)
+	return True
+
+failed: bool = False
+print('Two routes through the same point (same position), a train on each')
+for binary, together in (('dixlNodeSim', False), ('dixlNodeSimConflictPosition', True)):
+	with sim.Network(3, binary, env={'DIXLSIM_VERBOSE': '1'}, points=[2]) as network:
+		first, second = network.route(1, [0, 2]), network.route(2, [1, 2])
+		network.configureNodes()
+
+		# Second route requested while the first is reserved: reserved at once or after the first train
+		okFirst, _ = network.request(first)
+		okSecond, _ = network.request(second)
+		reservedTogether: bool = okSecond
+		if not okSecond and waitCleared(binary, 1):
+			okSecond, _ = network.request(second)
+		cleared: bool = okFirst and okSecond and waitCleared(binary, 2)
+		outputs = network.stop()
+
+	# Each route released by its own train: ON then OFF of a route before the next one, a sensor cycle each
+	events = pointEvents(binary)
+	emulated: int = len(re.findall(r'emulating SENSOR ON', outputs[2]))
+	ok: bool = cleared and reservedTogether == together and events == [(1, 'ON'), (1, 'OFF'), (2, 'ON'), (2, 'OFF')] and emulated == 2
+	print(f'  {binary:28}  reserved {"together" if reservedTogether else "one after the other"}  point sensor events {events}  trains {emulated}  {"OK" if ok else "FAILED"}')
+	failed |= not ok
+
+sys.exit(1 if failed else 0)
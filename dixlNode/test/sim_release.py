@@ -0,0 +1,56 @@
+"""
+A route over three track circuits (TC1 -> TC2 -> TC3) whose middle sensor never sees the train (dixlNodeSimSensorMissed):
+TC2 would stay reserved until the host releases the route, locking every other route through it. TC3 clearing
+releases it (RELEASE sent behind), a second route over TC2 -> TC3 is then reserved without any host release.
+Each track circuit that saw the train logs the time it stayed locked after its own sensor cleared (node clock).
+The sensors are emulated by the nodes (5 s after each request).
+
+@author         : "Alessandro Mannini"
+@organization   : "Università degli Studi di Firenze"
+@contact        : "alessandro.mannini@gmail.com"
+@date           : "Jan 10, 2023"
+@version        : "1.0.0"
+"""
+import os
+import re
+import sys
+import time
+
+import sim
+
+Timeout: float = 20.0                   # Train through TC3 (2 emulated sensor changes, 5 s each)
+Missed: str = 'dixlNodeSimSensorMissed'
+
+sim.configure(RouteRequestResponseTimeout=5)
+
+def nodeLog(binary: str, index: int) -> str:
+	with open(os.path.join(sim.TestDir, 'out', f'{binary}-{index + 1}.log')) as log:
+		return log.read()
+
+def waitLog(binary: str, index: int, pattern: str) -> bool:
+	deadline: float = time.time() + Timeout
+	while not re.search(pattern, nodeLog(binary, index)):
+		if time.time() > deadline:
+			return False
+		time.sleep(0.5)
+	return True
+
+print('A route whose middle track circuit never sees the train, a second route over it')
+with sim.Network(3, env={'DIXLSIM_VERBOSE': '1'}, binaries={1: Missed}) as network:
+	first, second = network.route(1, [0, 1, 2]), network.route(2, [1, 2])
+	network.configureNodes()
+
+	# Second route rejected while the first holds TC2, reserved once TC3 cleared (no host release)
+	okFirst, _ = network.request(first)
+	okLocked, _ = network.request(second)
+	released: bool = waitLog('dixlNodeSim', 2, r'Route request \(1\) SENSOR OFF received') and waitLog(Missed, 1, r'Route request \(1\) RELEASE received: the train went through unseen')
+	okSecond, _ = network.request(second)
+	waitLog('dixlNodeSim', 0, r'Route request \(1\) SENSOR OFF received')
+	network.stop()
+
+locked: list[str] = [' '.join(re.findall(r'Route request \(1\) SENSOR OFF received: locked (\d+) ms', nodeLog('dixlNodeSim', i))) or '-' for i in (0, 2)]
+ok: bool = okFirst and not okLocked and released and okSecond and '-' not in locked
+print(f'  first route {"reserved" if okFirst else "rejected"}  second route {"rejected" if not okLocked else "reserved"} while TC2 held, '
+      f'{"reserved" if okSecond else "rejected"} after TC3 cleared  locked after clear TC1 {locked[0]} ms TC3 {locked[1]} ms  {"OK" if ok else "FAILED"}')
+
+sys.exit(0 if ok else 1)
@@ -0,0 +1,46 @@
+"""
+Route reservation latency over 2, 8 and 32 nodes, node to node (chain) against the first node coordinating
+all the others (star, RouteStarTopology). The host route model reads RouteStarTopology when it's imported:
+each topology is measured by this script run again with its name (one process each).
+
+@author         : "Alessandro Mannini"
+@organization   : "Università degli Studi di Firenze"
+@contact        : "alessandro.mannini@gmail.com"
+@date           : "Jan 10, 2023"
+@version        : "1.0.0"
+"""
+import subprocess
+import sys
+import time
+
+Sizes: list[int] = [2, 8, 32]
+Requests: int = 20
+
+def measure(topology: str) -> bool:
+	import sim
+	sim.configure(RouteStarTopology=(topology == 'star'), RouteRequestResponseTimeout=10)
+	passed: bool = True
+	for numNodes in Sizes:
+		with sim.Network(numNodes) as network:
+			route = network.route(1, list(range(numNodes)))
+			network.configureNodes()
+
+			latencies: list[float] = []
+			for i in range(Requests):
+				ok, elapsed = network.request(route)
+				if ok:
+					latencies.append(elapsed)
+				network.release(route)
+				time.sleep(0.5)
+			print(f'  {topology:5} {numNodes:2} nodes  {len(latencies):2}/{Requests} reserved  {sim.percentiles(latencies)}', flush=True)
+			passed &= len(latencies) == Requests
+	return passed
+
+if len(sys.argv) > 1:
+	sys.exit(0 if measure(sys.argv[1]) else 1)
+
+print(f'Route over 2 to 32 nodes, {Requests} requests', flush=True)
+failed: bool = False
+for topology in ('chain', 'star'):
+	failed |= subprocess.run([sys.executable, __file__, topology]).returncode != 0
+sys.exit(1 if failed else 0)
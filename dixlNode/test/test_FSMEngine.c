@@ -0,0 +1,203 @@
+/**
+ * test_FSMEngine.c
+ *
+ * FSM engine transitions lookup: the first matching row wins (wildcard rows too), a failed guard falls
+ * through only to the next rows with the same state and message type (contiguous), FSMANYSTATE/FSMANYTYPE
+ * rows, entry/exit functions on state changes and internal events. Then the dispatch cost of FSM_Event
+ * against the same machine written as a switch on state and message type
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../FSM/FSMEngine.h"
+
+/* defines */
+#define DISPATCHES			(1 << 24)			// Events per dispatch measure
+
+/* States */
+enum { StateDummy = FSMSTATEDUMMY, StateA, StateB, StateC, StateD, NUMSTATES };
+
+/* Message types */
+enum {
+	TYPE_FIRST = 10,			// Two rows: the first one wins
+	TYPE_EXACT = 11,			// Exact row before a FSMANYTYPE one
+	TYPE_OTHER = 12,			// Only the FSMANYTYPE row
+	TYPE_ANYSTATE = 13,			// FSMANYSTATE row before an exact one
+	TYPE_GUARD = 14,			// Failed guard, then a guard passing (contiguous rows)
+	TYPE_GUARDS = 15,			// Guards all failing
+	TYPE_SPLIT = 16,			// Failed guard, the next row of the same key not contiguous
+	TYPE_SPLITOTHER = 17,		// Row between the split rows
+	TYPE_GUARDANY = 18,			// Failed guard, then a FSMANYTYPE row
+	TYPE_INTERNAL = 19,			// State D generates an internal event to A
+};
+
+/* variables */
+static char calls[256];			// Functions called (one letter each)
+static FiniteStateMachine fsm;
+
+static void call(char c) {
+	size_t len = strlen(calls);
+	if (len < sizeof(calls) - 1)
+		calls[len] = c;
+}
+
+static void StateFuncA(eventData *pEventData) { call('a'); }
+static void StateFuncB(eventData *pEventData) { call('b'); }
+static void StateFuncC(eventData *pEventData) { call('c'); }
+static void StateFuncD(eventData *pEventData) { call('d'); FSM_Internal(&fsm, StateA, pEventData); }
+static void EntryB(eventData *pEventData) { call('E'); }
+static void ExitA(eventData *pEventData) { call('X'); }
+static bool GuardFail(eventData *pEventData) { call('f'); return false; }
+static bool GuardPass(eventData *pEventData) { call('p'); return true; }
+static void Action1(eventData *pEventData) { call('1'); }
+static void Action2(eventData *pEventData) { call('2'); }
+
+static const StateMapItem stateMap[NUMSTATES] = {
+	{ NULL, NULL, NULL },
+	{ StateFuncA, NULL, ExitA },
+	{ StateFuncB, EntryB, NULL },
+	{ StateFuncC, NULL, NULL },
+	{ StateFuncD, NULL, NULL },
+};
+
+static const TransitionItem transitions[] = {
+	{ StateA,		TYPE_FIRST,			NULL,		Action1,	StateB },
+	{ StateA,		TYPE_FIRST,			NULL,		Action2,	StateC },
+	{ StateA,		TYPE_EXACT,			NULL,		NULL,		StateB },
+	{ FSMANYSTATE,	TYPE_ANYSTATE,		NULL,		NULL,		StateC },
+	{ StateB,		TYPE_ANYSTATE,		NULL,		NULL,		StateA },
+	{ StateA,		TYPE_GUARD,			GuardFail,	Action1,	StateB },
+	{ StateA,		TYPE_GUARD,			GuardPass,	Action2,	StateC },
+	{ StateA,		TYPE_GUARDS,		GuardFail,	NULL,		StateB },
+	{ StateA,		TYPE_GUARDS,		GuardFail,	NULL,		StateC },
+	{ StateA,		TYPE_SPLIT,			GuardFail,	NULL,		StateB },
+	{ StateA,		TYPE_SPLITOTHER,	NULL,		NULL,		StateB },
+	{ StateA,		TYPE_SPLIT,			NULL,		NULL,		StateC },
+	{ StateA,		TYPE_GUARDANY,		GuardFail,	NULL,		StateB },
+	{ StateA,		TYPE_INTERNAL,		NULL,		NULL,		StateD },
+	{ StateA,		FSMANYTYPE,			NULL,		Action1,	StateC },
+	{ StateB,		TYPE_EXACT,			NULL,		NULL,		StateB },
+	{ StateB,		FSMANYTYPE,			NULL,		NULL,		StateA },
+	{ StateC,		FSMANYTYPE,			NULL,		NULL,		StateA },
+};
+
+static uint8_t lookup[NUMSTATES][FSMMSGTYPES];
+static FSMTable table = { stateMap, NUMSTATES, transitions, sizeof(transitions) / sizeof(transitions[0]), lookup };
+
+static int numFailed = 0;
+
+// Event in a state: the result, the new state and the functions called must be the expected ones
+static void check(const char *name, uint8_t state, uint8_t msgType, bool served, uint8_t newState, const char *expectedCalls) {
+	FSM_Reset(&fsm, &table, state);
+	memset(calls, 0, sizeof(calls));
+	eventData data = { NULL, NULL };
+	bool result = FSM_Event(&fsm, msgType, &data);
+	bool passed = result == served && fsm.currentState == newState && !strcmp(calls, expectedCalls);
+	printf("  %-4s %-60s (%s -> state %d, calls \"%s\")\n", passed ? "ok" : "FAIL", name, result ? "served" : "discarded", fsm.currentState, calls);
+	numFailed += !passed;
+}
+
+/* Same machine as a switch on state and message type (the dispatch the FSMs used before the engine) */
+static bool switch_event(uint8_t *pState, uint8_t msgType, eventData *pEventData) {
+	uint8_t state = *pState;
+	switch (*pState) {
+		case StateA:
+			switch (msgType) {
+				case TYPE_FIRST: Action1(pEventData); *pState = StateB; break;
+				case TYPE_EXACT: *pState = StateB; break;
+				case TYPE_ANYSTATE: *pState = StateC; break;
+				case TYPE_GUARD:
+					if (GuardFail(pEventData)) { Action1(pEventData); *pState = StateB; }
+					else if (GuardPass(pEventData)) { Action2(pEventData); *pState = StateC; }
+					else return false;
+					break;
+				case TYPE_GUARDS:
+					if (GuardFail(pEventData)) *pState = StateB;
+					else if (GuardFail(pEventData)) *pState = StateC;
+					else return false;
+					break;
+				case TYPE_SPLIT:
+					if (GuardFail(pEventData)) *pState = StateB;
+					else return false;
+					break;
+				case TYPE_SPLITOTHER: *pState = StateB; break;
+				case TYPE_GUARDANY:
+					if (GuardFail(pEventData)) *pState = StateB;
+					else return false;
+					break;
+				case TYPE_INTERNAL: *pState = StateD; break;
+				default: Action1(pEventData); *pState = StateC; break;
+			}
+			break;
+		case StateB:
+			*pState = (msgType == TYPE_ANYSTATE) ? StateC : (msgType == TYPE_EXACT) ? StateB : StateA;
+			break;
+		case StateC:
+			*pState = (msgType == TYPE_ANYSTATE) ? StateC : StateA;
+			break;
+		default:
+			return false;
+	}
+
+	// Exit and entry functions on a state change, then the state function (internal events not served)
+	if (*pState != state && state == StateA)
+		ExitA(pEventData);
+	if (*pState != state && *pState == StateB)
+		EntryB(pEventData);
+	stateMap[*pState].pStateFunc(pEventData);
+	return true;
+}
+
+static double now() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main() {
+	FSM_TableBuild(&table);
+
+	printf("FSM engine transitions\n");
+	check("first matching row wins", StateA, TYPE_FIRST, true, StateB, "1XEb");
+	check("exact row before a FSMANYTYPE row", StateA, TYPE_EXACT, true, StateB, "XEb");
+	check("FSMANYTYPE row for the other types", StateA, TYPE_OTHER, true, StateC, "1Xc");
+	check("FSMANYTYPE row for type 0", StateA, 0, true, StateC, "1Xc");
+	check("FSMANYSTATE row before an exact row (state B)", StateB, TYPE_ANYSTATE, true, StateC, "c");
+	check("FSMANYSTATE row in another state", StateA, TYPE_ANYSTATE, true, StateC, "Xc");
+	check("failed guard falls through to the next row", StateA, TYPE_GUARD, true, StateC, "fp2Xc");
+	check("all guards failed: discarded", StateA, TYPE_GUARDS, false, StateA, "ff");
+	check("failed guard, same key not contiguous: discarded (limit)", StateA, TYPE_SPLIT, false, StateA, "f");
+	check("failed guard, FSMANYTYPE row after: discarded (limit)", StateA, TYPE_GUARDANY, false, StateA, "f");
+	check("no row for the state and type: discarded", StateD, TYPE_FIRST, false, StateD, "");
+	check("internal event from a state function", StateA, TYPE_INTERNAL, true, StateA, "Xda");
+	check("self transition: no exit/entry functions", StateB, TYPE_EXACT, true, StateB, "b");
+
+	// Dispatch cost: a cycle of events served in both ways (the calls record cleared at each event)
+	static const uint8_t cycle[][2] = { { StateA, TYPE_EXACT }, { StateB, TYPE_OTHER }, { StateA, TYPE_GUARD }, { StateC, TYPE_FIRST }, { StateA, TYPE_OTHER } };
+	int numCycle = sizeof(cycle) / sizeof(cycle[0]);
+	eventData data = { NULL, NULL };
+	double start = now();
+	for (int i = 0; i < DISPATCHES; i++) {
+		calls[0] = '\0';
+		FSM_Reset(&fsm, &table, cycle[i % numCycle][0]);
+		FSM_Event(&fsm, cycle[i % numCycle][1], &data);
+	}
+	double engine = (now() - start) / DISPATCHES * 1e9;
+	start = now();
+	for (int i = 0; i < DISPATCHES; i++) {
+		calls[0] = '\0';
+		uint8_t state = cycle[i % numCycle][0];
+		switch_event(&state, cycle[i % numCycle][1], &data);
+	}
+	double switched = (now() - start) / DISPATCHES * 1e9;
+	printf("dispatch: FSM_Event %.1f ns/event, switch %.1f ns/event (lookup table %zu bytes)\n", engine, switched, sizeof(lookup));
+
+	if (numFailed)
+		printf("FAIL: %d transitions\n", numFailed);
+	return numFailed ? 1 : 0;
+}
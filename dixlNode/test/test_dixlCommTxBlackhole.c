@@ -0,0 +1,194 @@
+/**
+ * test_dixlCommTxBlackhole.c
+ *
+ * dixlCommTx with a blackholed destination (SYNs dropped: listening socket with a full backlog):
+ * the route messages to a healthy destination are sent without waiting for the blackholed one,
+ * whose messages are dropped after COMMPEERMSGTIMEOUT. Latency of the healthy destination
+ * measured alone and with a message to the blackholed destination before each of its messages
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "vxWorks.h"
+#include <syslog.h>
+#include <taskLib.h>
+
+#include "../globals.h"
+#include "../config.h"
+#include "../includes/msgPool.h"
+#include "../includes/network.h"
+#include "../includes/utils.h"
+#include "../tasks/dixlComm.h"
+
+/* defines */
+#define MESSAGES			200					// Messages to the healthy destination per phase
+#define MESSAGEPERIOD		5					// Period of the messages (ms)
+#define MAXLATENCY			100					// Max latency of the healthy destination (ms), well below COMMCONNECTTIMEOUT
+
+/* Start task (dkm.c) */
+TASK_ID	taskStartId;
+char	*taskStartName;
+
+/* variables */
+static struct timespec sentAt[2 * MESSAGES];
+static double latency[2 * MESSAGES];
+static volatile int received = 0;
+
+static double now_ms() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+static double ms(const struct timespec *time) {
+	return time->tv_sec * 1000.0 + time->tv_nsec / 1e6;
+}
+
+static void address(const char *str, IPv4Address *pIPv4) {
+	inet_pton(AF_INET, str, pIPv4->bytes);
+}
+
+// Listening socket on a loopback address, the node port
+static int listener(const char *address, int backlog) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	int reuse = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(COMMSOCKPORT) };
+	inet_pton(AF_INET, address, &addr.sin_addr);
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || listen(fd, backlog)) {
+		perror(address);
+		exit(2);
+	}
+	return fd;
+}
+
+// Healthy destination: route ids (the message index) of the compact frames received
+static void *healthy_receive(void *arg) {
+	int fd = accept(*(int *) arg, NULL, NULL);
+	char buffer[COMMBUFFERSIZE];
+	int len = 0;
+	ssize_t n;
+	while ((n = recv(fd, &buffer[len], sizeof(buffer) - len, 0)) > 0) {
+		double at = now_ms();
+		len += n;
+		int head = 0;
+		uint16_t frameLen;
+		while (len - head >= (int) sizeof(msgCompactHeader)) {
+			memcpy(&frameLen, &buffer[head + offsetof(msgCompactHeader, length)], sizeof(frameLen));
+			frameLen = ntohs(frameLen);
+			if (len - head < frameLen)
+				break;
+			routeId id;
+			memcpy(&id, &buffer[head + sizeof(msgCompactHeader)], sizeof(id));
+			if (id < 2 * MESSAGES)
+				latency[id] = at - ms(&sentAt[id]);
+			received++;
+			head += frameLen;
+		}
+		memmove(buffer, &buffer[head], len - head);
+		len -= head;
+	}
+	return NULL;
+}
+
+static void route_send(const char *destination, routeId id) {
+	message message;
+	memset(&message, 0, sizeof(message));
+	message.iHeader.type = IMSGTYPE_ROUTEREQ;
+	address(destination, &message.routeIReq.destination);
+	message.routeIReq.requestRouteId = id;
+	msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteREQ));
+}
+
+static int compare(const void *a, const void *b) {
+	double d = *(const double *) a - *(const double *) b;
+	return (d > 0) - (d < 0);
+}
+
+// Median, 99th percentile and max of the latencies of a phase; FALSE if any is over MAXLATENCY or missing
+static bool report(const char *phase, double *pLatency) {
+	double sorted[MESSAGES];
+	memcpy(sorted, pLatency, sizeof(sorted));
+	qsort(sorted, MESSAGES, sizeof(double), compare);
+	printf("  %-32s median %6.2f ms  p99 %6.2f ms  max %6.2f ms\n", phase, sorted[MESSAGES / 2], sorted[MESSAGES * 99 / 100], sorted[MESSAGES - 1]);
+	return sorted[0] >= 0 && sorted[MESSAGES - 1] <= MAXLATENCY;
+}
+
+int main() {
+	openlog("test_dixlCommTxBlackhole", LOG_PERROR, LOG_USER);
+	setlogmask(LOG_UPTO(LOG_CRIT));
+
+	// Node, healthy and blackholed destinations on the loopback
+	int run = getpid() % 250 + 1;
+	char healthy[INET_ADDRSTRLEN], blackholed[INET_ADDRSTRLEN];
+	snprintf(IPv4s, sizeof(IPv4s), "127.%d.200.10", run);
+	snprintf(healthy, sizeof(healthy), "127.%d.200.20", run);
+	snprintf(blackholed, sizeof(blackholed), "127.%d.200.21", run);
+	address(IPv4s, &IPv4);
+
+	int healthyFd = listener(healthy, 16);
+	int blackholedFd = listener(blackholed, 0);
+	pthread_t healthyThread;
+	pthread_create(&healthyThread, NULL, healthy_receive, &healthyFd);
+
+	// Fill the backlog of the blackholed destination, check that a new connect gets no answer
+	for (int i = 0; i < 4; i++) {
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		socket_connect_nonblocking(fd, blackholed, COMMSOCKPORT);
+	}
+	usleep(100000);
+	int probe = socket(AF_INET, SOCK_STREAM, 0);
+	bool isBlackholed = socket_connect_nonblocking(probe, blackholed, COMMSOCKPORT) == SOCK_INPROGRESS;
+	fd_set writeFds;
+	FD_ZERO(&writeFds);
+	FD_SET(probe, &writeFds);
+	struct timeval wait = { 0, 300000 };
+	isBlackholed = isBlackholed && select(probe + 1, NULL, &writeFds, NULL, &wait) == 0;
+	close(probe);
+	if (!isBlackholed) {
+		printf("FAIL: the destination %s can't be blackholed\n", blackholed);
+		return 1;
+	}
+
+	// CommTx
+	msgPool_Initialize();
+	for (int i = 0; i < MESSAGES; i++)
+		latency[i] = latency[MESSAGES + i] = -1;
+	taskCommTxId = taskSpawn(TASKCOMMTXNAME, TASKCOMMTXPRIO, 0, TASKCOMMTXSTACKSIZE, (FUNCPTR) dixlCommTx, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	while (!msgQCommTxId)
+		usleep(1000);
+
+	// Healthy destination alone, then with the blackholed one (a message before each)
+	for (int phase = 0; phase < 2; phase++)
+		for (routeId i = phase * MESSAGES; i < (phase + 1) * MESSAGES; i++) {
+			if (phase)
+				route_send(blackholed, 0);
+			clock_gettime(CLOCK_MONOTONIC, &sentAt[i]);
+			route_send(healthy, i);
+			usleep(MESSAGEPERIOD * 1000);
+		}
+
+	// Let the blackholed messages expire
+	usleep((COMMPEERMSGTIMEOUT + 500) * 1000);
+
+	printf("dixlCommTx: %d messages to a healthy destination every %d ms\n", MESSAGES, MESSAGEPERIOD);
+	bool passed = report("healthy destination alone", latency);
+	passed = report("with a blackholed destination", &latency[MESSAGES]) && passed;
+	printf("  %d messages received by the healthy destination\n", received);
+	fflush(stdout);
+	setlogmask(LOG_UPTO(LOG_INFO));
+	dixlCommTxShow();
+	if (!passed)
+		printf("FAIL: healthy destination messages delayed or lost\n");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,206 @@
+/**
+ * test_dixlCommTxLoopback.c
+ *
+ * Self-addressed messages delivered locally by dixlCommTx against the same messages received from the
+ * network by dixlCommRx: the route messages (traced and not) sent by CommTx to a peer are captured and
+ * written back to this node CommRx, the bytes reaching the Ctrl queue by both ways must be the same
+ * (the timestamps of this node hops apart). With the Ctrl queue full, a message to this node must go by the
+ * network (CommRx waits for room, CommTx doesn't: it still serves the peer) and reach Ctrl once the queue is drained
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "vxWorks.h"
+#include <syslog.h>
+#include <taskLib.h>
+#include <sysLib.h>
+
+#include "../globals.h"
+#include "../config.h"
+#include "../includes/msgPool.h"
+#include "../includes/trace.h"
+#include "../includes/utils.h"
+#include "../tasks/dixlComm.h"
+
+/* defines */
+#define NUMTYPES			7
+#define NUMMESSAGES			(2 * NUMTYPES)		// Each type traced and not
+
+/* Start task (dkm.c) */
+TASK_ID	taskStartId;
+char	*taskStartName;
+
+/* variables */
+static const eMsgType types[NUMTYPES] = { IMSGTYPE_ROUTEREQ, IMSGTYPE_ROUTEACK, IMSGTYPE_ROUTENACK, IMSGTYPE_ROUTECOMMIT, IMSGTYPE_ROUTEAGREE, IMSGTYPE_ROUTEDISAGREE, IMSGTYPE_ROUTERELEASE };
+static union {
+	message message;
+	char bytes[MSG_MAXLENGTH];
+} looped[NUMMESSAGES], received[NUMMESSAGES];
+
+static void address(const char *str, IPv4Address *pIPv4) {
+	inet_pton(AF_INET, str, pIPv4->bytes);
+}
+
+static struct sockaddr_in sockaddr(const char *str) {
+	struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(COMMSOCKPORT) };
+	inet_pton(AF_INET, str, &addr.sin_addr);
+	return addr;
+}
+
+// INT route message to send (a hop of the previous node if traced)
+static void route_send(eMsgType type, const IPv4Address *pDestination, routeId id, bool traced) {
+	message message;
+	memset(&message, 0, sizeof(message));
+	message.iHeader.type = type;
+	message.routeIReq.destination = *pDestination;
+	message.routeIReq.requestRouteId = id;
+	if (traced) {
+		msgTrace *pTrace = &message.routeIReq.trace;
+		pTrace->traceId = 0xD1C0 + id;
+		pTrace->origin = 1000000;
+		pTrace->numHops = 1;
+		pTrace->hops[0] = (traceHop) { .node = { { 10, 0, 0, 1 } }, .type = MSGTYPE_ROUTEREQ, .flags = TRACEHOP_RX | TRACEHOP_FSM, .rxAt = 10, .fsmAt = 20 };
+	}
+	if (type == IMSGTYPE_ROUTEACK)
+		message.routeIAck.points = 3;
+	msgQ_Send(msgQCommTxId, (char *) &message, sizeof(msgIHeader) + sizeof(msgIRouteACK));
+}
+
+// Messages reaching the Ctrl queue, by route id (the timestamps of this node hops cleared)
+static int ctrl_receive(void *pMessages, size_t size) {
+	int numReceived = 0;
+	message *pMessage;
+	while (numReceived < NUMMESSAGES && (pMessage = msgQ_ReceiveRef(msgQCtrlId, 2 * sysClkRateGet()))) {
+		routeId id = pMessage->routeReq.requestRouteId;
+		if (id < NUMMESSAGES) {
+			msgTrace *pTrace = trace_Find(pMessage);
+			for (int i = 0; pTrace && i < pTrace->numHops; i++)
+				if (!nodecmp(pTrace->hops[i].node, IPv4))
+					pTrace->hops[i].rxAt = pTrace->hops[i].fsmAt = pTrace->hops[i].txAt = 0;
+			memcpy((char *) pMessages + id * size, pMessage, pMessage->header.lentgh);
+			numReceived++;
+		}
+		msgPool_Free(pMessage);
+	}
+	return numReceived;
+}
+
+int main() {
+	openlog("test_dixlCommTxLoopback", LOG_PERROR, LOG_USER);
+	setlogmask(LOG_UPTO(LOG_WARNING));
+
+	// This node and a peer on the loopback
+	int run = getpid() % 250 + 1;
+	char peer[INET_ADDRSTRLEN];
+	IPv4Address peerIPv4;
+	snprintf(IPv4s, sizeof(IPv4s), "127.%d.201.10", run);
+	snprintf(peer, sizeof(peer), "127.%d.201.11", run);
+	address(IPv4s, &IPv4);
+	address(peer, &peerIPv4);
+
+	int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in peerAddr = sockaddr(peer);
+	if (bind(listenFd, (struct sockaddr *) &peerAddr, sizeof(peerAddr)) || listen(listenFd, 1)) {
+		perror(peer);
+		return 2;
+	}
+
+	// Comm Rx and Tx, Ctrl queue (read by the test)
+	msgPool_Initialize();
+	msgQCtrlId = msgQ_Initialize(MSGQCTRLMESSAGESMAX, MSGQCTRLMESSAGESLENGTH, MSGQCTRLOPTIONS);
+	msgQ_SetPolicy(msgQCtrlId, MSGQCTRLPOLICY, MSGQCTRLSENDTIMEOUT);
+	taskCommRxId = taskSpawn(TASKCOMMRXNAME, TASKCOMMRXPRIO, 0, TASKCOMMRXSTACKSIZE, (FUNCPTR) dixlCommRx, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	taskCommTxId = taskSpawn(TASKCOMMTXNAME, TASKCOMMTXPRIO, 0, TASKCOMMTXSTACKSIZE, (FUNCPTR) dixlCommTx, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	while (!msgQCommTxId || !dixlCommRxSocket)
+		usleep(1000);
+
+	// Local delivery: messages to this node
+	for (routeId id = 0; id < NUMMESSAGES; id++)
+		route_send(types[id % NUMTYPES], &IPv4, id, id >= NUMTYPES);
+	int numLooped = ctrl_receive(looped, sizeof(looped[0]));
+
+	// Network: the same messages to the peer, captured and written to this node Comm Rx
+	for (routeId id = 0; id < NUMMESSAGES; id++)
+		route_send(types[id % NUMTYPES], &peerIPv4, id, id >= NUMTYPES);
+	int peerFd = accept(listenFd, NULL, NULL);
+	int rxFd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in rxAddr = sockaddr(IPv4s);
+	if (connect(rxFd, (struct sockaddr *) &rxAddr, sizeof(rxAddr))) {
+		perror(IPv4s);
+		return 2;
+	}
+	char wire[NUMMESSAGES * MSG_MAXLENGTH];
+	int wireLen = 0, numFrames = 0;
+	while (numFrames < NUMMESSAGES) {
+		ssize_t n = recv(peerFd, &wire[wireLen], sizeof(wire) - wireLen, 0);
+		if (n <= 0)
+			break;
+		wireLen += n;
+
+		// Complete frames: destination changed to this node (compact header)
+		int head = 0;
+		uint16_t frameLen;
+		for (numFrames = 0; wireLen - head >= (int) sizeof(msgCompactHeader); numFrames++, head += frameLen) {
+			memcpy(&frameLen, &wire[head + offsetof(msgCompactHeader, length)], sizeof(frameLen));
+			frameLen = ntohs(frameLen);
+			if (wireLen - head < frameLen)
+				break;
+			memcpy(&wire[head + offsetof(msgCompactHeader, destination)], &IPv4, sizeof(IPv4));
+		}
+	}
+	send(rxFd, wire, wireLen, 0);
+	int numReceived = ctrl_receive(received, sizeof(received[0]));
+
+	// Same bytes by both ways
+	int numDifferent = 0;
+	for (int id = 0; id < NUMMESSAGES; id++) {
+		uint8_t length = looped[id].message.header.lentgh;
+		if (!length || length != received[id].message.header.lentgh || memcmp(&looped[id], &received[id], length)) {
+			printf("  route message type %d (%s): %d bytes locally, %d bytes from the network, different\n", types[id % NUMTYPES], id >= NUMTYPES ? "traced" : "not traced", length, received[id].message.header.lentgh);
+			numDifferent++;
+		}
+	}
+	printf("dixlCommTx loopback: %d route messages delivered locally, %d from the network (%d bytes on the wire), %d different\n", numLooped, numReceived, wireLen, numDifferent);
+
+	// Ctrl queue full (one message queued many times): the message to this node waits in Comm Rx
+	message *pFiller = msgPool_Alloc(), *pMessage;
+	int numFiller = 0, numDrained = 0;
+	while (msgQ_TrySendRef(msgQCtrlId, pFiller))
+		numFiller++;
+	route_send(IMSGTYPE_ROUTEREQ, &IPv4, NUMMESSAGES, FALSE);
+	route_send(IMSGTYPE_ROUTEREQ, &peerIPv4, NUMMESSAGES, FALSE);
+	struct timeval wait = { 1, 0 };
+	setsockopt(peerFd, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait));
+	bool served = recv(peerFd, wire, sizeof(wire), 0) > 0;
+	bool delivered = FALSE;
+	while (!delivered && (pMessage = msgQ_ReceiveRef(msgQCtrlId, 2 * sysClkRateGet()))) {
+		if (pMessage == pFiller) {
+			numDrained++;
+			continue;
+		}
+		delivered = pMessage->routeReq.requestRouteId == NUMMESSAGES;
+		msgPool_Free(pMessage);
+	}
+	msgPool_Free(pFiller);
+	printf("  Ctrl queue full (%d messages): peer %s, message to this node %s after %d drained\n", numFiller, served ? "served" : "not served", delivered ? "delivered" : "lost", numDrained);
+	fflush(stdout);
+	setlogmask(LOG_UPTO(LOG_INFO));
+	dixlCommTxShow();
+
+	bool passed = numLooped == NUMMESSAGES && numReceived == NUMMESSAGES && !numDifferent;
+	if (!passed)
+		printf("FAIL: local delivery and network delivery differ\n");
+	if (!served || !delivered || numDrained != numFiller)
+		printf("FAIL: message to this node lost or Comm Tx blocked with the Ctrl queue full\n");
+	passed = passed && served && delivered && numDrained == numFiller;
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+/**
+ * test_dixlLogExport.c
+ *
+ * Bulk log export through the dixlCommTx destination queues: the Log task export area (semExport) must be
+ * given back when the last frame of an export is sent and when it is dropped, so back to back requests are
+ * all served. A full log is exported to a host, to an unreachable host (frames dropped), then to the host
+ * again many times; the lines received are checked and the export time measured
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "vxWorks.h"
+#include <syslog.h>
+#include <taskLib.h>
+
+#include "../globals.h"
+#include "../config.h"
+#include "../includes/msgPool.h"
+#include "../includes/utils.h"
+#include "../tasks/dixlComm.h"
+#include "../tasks/dixlLog.h"
+
+/* defines */
+#define EXPORTS				20					// Back to back exports to the host
+#define RECEIVETIMEOUT		1000				// Max wait (ms) of a frame
+
+/* Start task (dkm.c) */
+TASK_ID	taskStartId;
+char	*taskStartName;
+
+/* variables */
+static int hostFd;
+static char buffer[COMMBUFFERSIZE];
+static int bufferLen = 0;
+
+static double now_ms() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+static void address(const char *str, IPv4Address *pIPv4) {
+	inet_pton(AF_INET, str, pIPv4->bytes);
+}
+
+// Log request from a host (as dixlCommRx delivers it)
+static void log_request(const IPv4Address *pHost) {
+	message *pMessage = msgPool_Alloc();
+	memset(pMessage, 0, sizeof(msgHeader));
+	pMessage->header.type = MSGTYPE_LOGREQ;
+	pMessage->header.source = *pHost;
+	pMessage->header.destination = IPv4;
+	msgQ_SendRef(msgQLogId, pMessage);
+}
+
+// Lines of an export received by the host, FALSE if a frame is missing, late or out of sequence
+static bool export_receive(int *pNumLines, int *pNumFrames, int timeout) {
+	uint32_t expected = 1, totalLines = 0;
+	*pNumLines = *pNumFrames = 0;
+	while (!totalLines || expected <= totalLines) {
+		// Complete frame at the buffer start
+		uint16_t frameLen = 0;
+		if (bufferLen >= (int) sizeof(msgCompactHeader)) {
+			memcpy(&frameLen, &buffer[offsetof(msgCompactHeader, length)], sizeof(frameLen));
+			frameLen = ntohs(frameLen);
+		}
+		if (!frameLen || bufferLen < frameLen) {
+			fd_set readFds;
+			FD_ZERO(&readFds);
+			FD_SET(hostFd, &readFds);
+			struct timeval wait = { timeout / 1000, timeout % 1000 * 1000 };
+			ssize_t n = 0;
+			if (select(hostFd + 1, &readFds, NULL, NULL, &wait) > 0)
+				n = recv(hostFd, &buffer[bufferLen], sizeof(buffer) - bufferLen, 0);
+			if (n <= 0)
+				return FALSE;
+			bufferLen += n;
+			continue;
+		}
+
+		msgLogSENDBULK bulk;
+		memcpy(&bulk, &buffer[sizeof(msgCompactHeader)], offsetof(msgLogSENDBULK, pLines));
+		const char *pLines = &buffer[sizeof(msgCompactHeader) + offsetof(msgLogSENDBULK, pLines)];
+		if (buffer[offsetof(msgCompactHeader, type)] != MSGTYPE_LOGSENDBULK || bulk.firstLine != expected)
+			return FALSE;
+		for (uint32_t i = 0; i < bulk.numLines; i++) {
+			logMessage line;
+			memcpy(&line, &pLines[i * sizeof(logMessage)], sizeof(line));
+			if (line.requestedRouteId != bulk.firstLine + i)
+				return FALSE;
+		}
+		totalLines = bulk.totalLines;
+		expected += bulk.numLines;
+		*pNumLines += bulk.numLines;
+		(*pNumFrames)++;
+		memmove(buffer, &buffer[frameLen], bufferLen - frameLen);
+		bufferLen -= frameLen;
+	}
+	return TRUE;
+}
+
+int main() {
+	openlog("test_dixlLogExport", LOG_PERROR, LOG_USER);
+	setlogmask(LOG_UPTO(LOG_CRIT));
+
+	// Node, host and unreachable host (nothing listening) on the loopback
+	int run = getpid() % 250 + 1;
+	char host[INET_ADDRSTRLEN], unreachable[INET_ADDRSTRLEN];
+	IPv4Address hostIPv4, unreachableIPv4;
+	snprintf(IPv4s, sizeof(IPv4s), "127.%d.202.10", run);
+	snprintf(host, sizeof(host), "127.%d.202.1", run);
+	snprintf(unreachable, sizeof(unreachable), "127.%d.202.2", run);
+	address(IPv4s, &IPv4);
+	address(host, &hostIPv4);
+	address(unreachable, &unreachableIPv4);
+
+	int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in hostAddr = { .sin_family = AF_INET, .sin_port = htons(COMMSOCKPORT) };
+	inet_pton(AF_INET, host, &hostAddr.sin_addr);
+	if (bind(listenFd, (struct sockaddr *) &hostAddr, sizeof(hostAddr)) || listen(listenFd, 1)) {
+		perror(host);
+		return 2;
+	}
+
+	// Log and CommTx
+	msgPool_Initialize();
+	taskLogId = taskSpawn(TASKLOGNAME, TASKLOGPRIO, 0, TASKLOGSTACKSIZE, (FUNCPTR) dixlLog, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	taskCommTxId = taskSpawn(TASKCOMMTXNAME, TASKCOMMTXPRIO, 0, TASKCOMMTXSTACKSIZE, (FUNCPTR) dixlCommTx, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	while (!msgQLogId || !msgQCommTxId)
+		usleep(1000);
+
+	// Full log (the route id is the line number), the Log queue drained on the way
+	for (int i = 1; i <= TASKLOGMAXLINES; i++) {
+		logger_log(LOGTYPE_REQ, i, NodeNULL);
+		while (msgQ_NumMsgs(msgQLogId) >= MSGQLOGMESSAGESMAX / 2)
+			usleep(1000);
+	}
+	while (msgQ_NumMsgs(msgQLogId))
+		usleep(1000);
+
+	// Export to the host, the connection accepted
+	int numLines, numFrames;
+	double start = now_ms();
+	log_request(&hostIPv4);
+	hostFd = accept(listenFd, NULL, NULL);
+	bool passed = export_receive(&numLines, &numFrames, RECEIVETIMEOUT);
+	printf("dixlLog bulk export of %d lines: %d lines in %d frames in %.2f ms\n", TASKLOGMAXLINES, numLines, numFrames, now_ms() - start);
+
+	// Export to the unreachable host (dropped after COMMPEERMSGTIMEOUT), then to the host again
+	start = now_ms();
+	log_request(&unreachableIPv4);
+	log_request(&hostIPv4);
+	bool served = export_receive(&numLines, &numFrames, TASKLOGEXPORTTIMEOUT);
+	printf("  after an export dropped: %d lines in %.2f ms\n", numLines, now_ms() - start);
+	passed = passed && served;
+
+	// Back to back exports
+	int numServed = 0;
+	start = now_ms();
+	for (int i = 0; i < EXPORTS; i++)
+		log_request(&hostIPv4);
+	for (int i = 0; i < EXPORTS && export_receive(&numLines, &numFrames, RECEIVETIMEOUT); i++)
+		numServed += numLines == TASKLOGMAXLINES;
+	printf("  %d back to back exports: %d served in %.2f ms\n", EXPORTS, numServed, now_ms() - start);
+	passed = passed && numServed == EXPORTS;
+
+	fflush(stdout);
+	setlogmask(LOG_UPTO(LOG_INFO));
+	dixlCommTxShow();
+	if (!passed)
+		printf("FAIL: log export not served (export area not given back)\n");
+	return passed ? 0 : 1;
+}
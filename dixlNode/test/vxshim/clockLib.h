@@ -0,0 +1,2 @@
+/* clockLib.h: see vxWorks.h */
+#include "vxWorks.h"
@@ -0,0 +1,10 @@
+/* ifaddrs.h: the simulated node address (DIXLSIM_IP) in place of the host interfaces */
+#ifndef VXSHIM_IFADDRS_H_
+#define VXSHIM_IFADDRS_H_
+#include_next <ifaddrs.h>
+
+int vxshim_getifaddrs(struct ifaddrs **ifap);
+void vxshim_freeifaddrs(struct ifaddrs *ifa);
+#define getifaddrs					vxshim_getifaddrs
+#define freeifaddrs					vxshim_freeifaddrs
+#endif
@@ -0,0 +1,3 @@
+/* inetLib.h: see vxWorks.h */
+#include "vxWorks.h"
+#include <arpa/inet.h>
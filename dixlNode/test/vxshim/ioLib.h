@@ -0,0 +1,4 @@
+/* ioLib.h: see vxWorks.h */
+#include "vxWorks.h"
+#include <sys/ioctl.h>
+#include <unistd.h>
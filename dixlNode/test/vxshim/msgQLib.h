@@ -0,0 +1,2 @@
+/* msgQLib.h: see vxWorks.h */
+#include "vxWorks.h"
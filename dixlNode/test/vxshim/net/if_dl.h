@@ -0,0 +1,9 @@
+/* net/if_dl.h: link level addresses are AF_PACKET ones on Linux */
+#ifndef VXSHIM_NET_IF_DL_H_
+#define VXSHIM_NET_IF_DL_H_
+#include <linux/if_packet.h>
+
+#define AF_LINK						AF_PACKET
+#define sockaddr_dl					sockaddr_ll
+#define LLADDR(s)					((s)->sll_addr)
+#endif
@@ -0,0 +1,2 @@
+/* objLibCommon.h: see vxWorks.h */
+#include "vxWorks.h"
@@ -0,0 +1,2 @@
+/* pingLib.h: see vxWorks.h */
+#include "vxWorks.h"
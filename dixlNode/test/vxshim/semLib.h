@@ -0,0 +1,2 @@
+/* semLib.h: see vxWorks.h */
+#include "vxWorks.h"
@@ -0,0 +1,5 @@
+/* sockLib.h: see vxWorks.h */
+#include "vxWorks.h"
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
@@ -0,0 +1,10 @@
+/* vxbGpioLib.h: GPIO constants (no GPIO on the simulator) */
+#ifndef VXSHIM_VXBGPIOLIB_H_
+#define VXSHIM_VXBGPIOLIB_H_
+#include "../../vxWorks.h"
+
+#define GPIO_DIR_INPUT				0
+#define GPIO_DIR_OUTPUT				1
+#define GPIO_VALUE_LOW				0
+#define GPIO_VALUE_HIGH				1
+#endif
@@ -0,0 +1,2 @@
+/* sysLib.h: see vxWorks.h */
+#include "vxWorks.h"
@@ -0,0 +1,2 @@
+/* taskLib.h: see vxWorks.h */
+#include "vxWorks.h"
@@ -0,0 +1,2 @@
+/* tickLib.h: see vxWorks.h */
+#include "vxWorks.h"
@@ -0,0 +1,107 @@
+/**
+ * vxWorks.h
+ *
+ * VxWorks shim for the Linux test builds: the kernel API used by the node (tasks, semaphores,
+ * message queues, ticks) on POSIX threads. Forced include of every test build (-include)
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#ifndef VXSHIM_VXWORKS_H_
+#define VXSHIM_VXWORKS_H_
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+/* Defines */
+#define VXSHIM_CLKRATE				1000				// System clock rate (ticks/s)
+
+#define OK							0
+#define ERROR						(-1)
+#define TRUE						1
+#define FALSE						0
+#define FOREVER						for (;;)
+#define WAIT_FOREVER				(-1)
+#define NO_WAIT						0
+
+#define S_objLib_OBJ_UNAVAILABLE	0x3d0002
+#define S_objLib_OBJ_TIMEOUT		0x3d0004
+
+#define MSG_Q_FIFO					0x00
+#define MSG_Q_PRIORITY				0x01
+#define MSG_PRI_NORMAL				0
+#define MSG_PRI_URGENT				1
+
+#define SEM_Q_FIFO					0x00
+#define SEM_Q_PRIORITY				0x01
+#define SEM_EMPTY					0
+#define SEM_FULL					1
+
+#define VX_TASK_PRIORITY_MAX		255
+
+// Simulator build: no GPIO
+#define _VX_SIMNT					2
+#define CPU							_VX_SIMNT
+
+// BSD socket address length (not in the Linux sockaddr_in): a padding byte instead
+#define sin_len						sin_zero[0]
+
+/* Types */
+typedef int STATUS;
+typedef int _Vx_freq_t;
+typedef long _Vx_ticks_t;
+typedef unsigned long ulong_t;
+typedef unsigned int uint_t;
+typedef int (*FUNCPTR)();
+typedef struct vxshimTask *TASK_ID;
+typedef struct vxshimSem *SEM_ID;
+typedef struct vxshimMsgQ *MSG_Q_ID;
+
+typedef struct {
+	char td_name[32];
+} TASK_DESC;
+
+/* Tasks */
+TASK_ID taskSpawn(char *name, int priority, int options, size_t stackSize, FUNCPTR entryPt, ...);
+TASK_ID taskIdSelf(void);
+char *taskName(TASK_ID tid);
+STATUS taskDelete(TASK_ID tid);
+void taskExit(int code);
+STATUS taskDelay(_Vx_ticks_t ticks);
+bool taskIsReady(TASK_ID tid);
+STATUS taskSuspend(TASK_ID tid);
+STATUS taskResume(TASK_ID tid);
+STATUS taskInfoGet(TASK_ID tid, TASK_DESC *pTaskDesc);
+
+/* System clock */
+_Vx_freq_t sysClkRateGet(void);
+_Vx_ticks_t tickGet(void);
+char *sysModel(void);
+
+/* Semaphores */
+SEM_ID semBCreate(int options, int initialState);
+SEM_ID semMCreate(int options);
+SEM_ID semCCreate(int options, int initialCount);
+STATUS semTake(SEM_ID semId, _Vx_ticks_t timeout);
+STATUS semGive(SEM_ID semId);
+STATUS semMTake(SEM_ID semId, _Vx_ticks_t timeout);
+STATUS semDelete(SEM_ID semId);
+
+/* Message queues */
+MSG_Q_ID msgQCreate(size_t maxMsgs, size_t maxMsgLength, int options);
+STATUS msgQDelete(MSG_Q_ID msgQId);
+STATUS msgQSend(MSG_Q_ID msgQId, char *buffer, size_t nBytes, _Vx_ticks_t timeout, int priority);
+ssize_t msgQReceive(MSG_Q_ID msgQId, char *buffer, size_t maxNBytes, _Vx_ticks_t timeout);
+ssize_t msgQNumMsgs(MSG_Q_ID msgQId);
+
+/* Network */
+#define PING_OPT_SILENT				0x01
+#define PING_OPT_NOHOST				0x02
+STATUS ping(char *host, int numPackets, unsigned long options);
+
+#endif /* VXSHIM_VXWORKS_H_ */
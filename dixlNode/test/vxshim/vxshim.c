@@ -0,0 +1,394 @@
+/**
+ * vxshim.c
+ *
+ * VxWorks shim for the Linux test builds: tasks on POSIX threads, semaphores and message
+ * queues on mutexes and condition variables, ticks on the monotonic clock
+ *
+ * @author: Alessandro Mannini <alessandro.mannini@gmail.com>
+ * @date: Jan 10, 2023
+ */
+
+#include <ifaddrs.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "vxWorks.h"
+
+/* types */
+struct vxshimTask {
+	pthread_t thread;
+	char name[32];
+	FUNCPTR entryPt;
+	long args[10];
+};
+
+typedef enum { SEMTYPE_BINARY, SEMTYPE_MUTEX, SEMTYPE_COUNTING } eSemType;
+struct vxshimSem {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	eSemType type;
+	int count;								// Binary/counting: count, mutex: 1 if free
+	pthread_t owner;						// Mutex owner (recursive)
+	int depth;								// Mutex recursion depth
+};
+
+struct vxshimMsgQ {
+	pthread_mutex_t lock;
+	pthread_cond_t notEmpty;
+	pthread_cond_t notFull;
+	size_t maxMsgs;
+	size_t maxMsgLength;
+	size_t head;
+	size_t numMsgs;
+	size_t *lengths;
+	char *buffer;
+};
+
+/* variables */
+static struct vxshimTask mainTask = { .name = "tShell" };
+static __thread struct vxshimTask *pSelf = NULL;
+
+/* Implementation functions */
+// Absolute deadline (realtime clock, as used by the condition variables) after a number of ticks
+static void shim_deadline(_Vx_ticks_t ticks, struct timespec *deadline) {
+	clock_gettime(CLOCK_REALTIME, deadline);
+	long long ns = (long long) ticks * (1000000000LL / VXSHIM_CLKRATE);
+	deadline->tv_sec += ns / 1000000000LL;
+	deadline->tv_nsec += ns % 1000000000LL;
+	if (deadline->tv_nsec >= 1000000000L) {
+		deadline->tv_sec += 1;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+// Wait on a condition within the timeout: FALSE (errno set) if it elapsed
+static bool shim_wait(pthread_cond_t *pCond, pthread_mutex_t *pLock, _Vx_ticks_t timeout, const struct timespec *deadline) {
+	if (timeout == NO_WAIT) {
+		errno = S_objLib_OBJ_UNAVAILABLE;
+		return FALSE;
+	}
+	if (timeout == WAIT_FOREVER) {
+		pthread_cond_wait(pCond, pLock);
+		return TRUE;
+	}
+	if (pthread_cond_timedwait(pCond, pLock, deadline) != 0) {
+		errno = S_objLib_OBJ_TIMEOUT;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void *shim_taskEntry(void *arg) {
+	struct vxshimTask *pTask = arg;
+	long *a = pTask->args;
+	pSelf = pTask;
+	pTask->entryPt(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9]);
+	return NULL;
+}
+
+/* Tasks */
+TASK_ID taskSpawn(char *name, int priority, int options, size_t stackSize, FUNCPTR entryPt, ...) {
+	struct vxshimTask *pTask = calloc(1, sizeof(struct vxshimTask));
+	va_list args;
+	va_start(args, entryPt);
+	for (int i = 0; i < 10; i++)
+		pTask->args[i] = va_arg(args, long);
+	va_end(args);
+	snprintf(pTask->name, sizeof(pTask->name), "%s", name ? name : "tTask");
+	pTask->entryPt = entryPt;
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	int rc = pthread_create(&pTask->thread, &attr, shim_taskEntry, pTask);
+	pthread_attr_destroy(&attr);
+	if (rc) {
+		free(pTask);
+		errno = rc;
+		return NULL;
+	}
+	return pTask;
+}
+
+TASK_ID taskIdSelf(void) {
+	return pSelf ? pSelf : &mainTask;
+}
+
+char *taskName(TASK_ID tid) {
+	return (tid ? tid : taskIdSelf())->name;
+}
+
+STATUS taskDelete(TASK_ID tid) {
+	if (!tid || tid == &mainTask)
+		return ERROR;
+	if (tid == pSelf)
+		pthread_exit(NULL);
+	return pthread_cancel(tid->thread) ? ERROR : OK;
+}
+
+void taskExit(int code) {
+	if (!pSelf) {
+		fprintf(stderr, "vxshim: main task exit %d\n", code);
+		exit(code);
+	}
+	fprintf(stderr, "vxshim: task %s exit %d\n", pSelf->name, code);
+	pthread_exit(NULL);
+}
+
+STATUS taskDelay(_Vx_ticks_t ticks) {
+	struct timespec delay = { ticks / VXSHIM_CLKRATE, (ticks % VXSHIM_CLKRATE) * (1000000000L / VXSHIM_CLKRATE) };
+	if (ticks <= 0)
+		sched_yield();
+	else
+		while (nanosleep(&delay, &delay) && errno == EINTR)
+			;
+	return OK;
+}
+
+// Threads can't be suspended: the tasks run (the start task is never ready, it only waits)
+bool taskIsReady(TASK_ID tid) {
+	return FALSE;
+}
+
+STATUS taskSuspend(TASK_ID tid) {
+	return OK;
+}
+
+STATUS taskResume(TASK_ID tid) {
+	return OK;
+}
+
+STATUS taskInfoGet(TASK_ID tid, TASK_DESC *pTaskDesc) {
+	if (!tid)
+		return ERROR;
+	snprintf(pTaskDesc->td_name, sizeof(pTaskDesc->td_name), "%s", tid->name);
+	return OK;
+}
+
+/* System clock */
+_Vx_freq_t sysClkRateGet(void) {
+	return VXSHIM_CLKRATE;
+}
+
+_Vx_ticks_t tickGet(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (_Vx_ticks_t) (now.tv_sec * VXSHIM_CLKRATE + now.tv_nsec / (1000000000L / VXSHIM_CLKRATE));
+}
+
+char *sysModel(void) {
+	return "SIMNT Linux (vxshim)";
+}
+
+/* Semaphores */
+static SEM_ID shim_semCreate(eSemType type, int count) {
+	SEM_ID semId = calloc(1, sizeof(struct vxshimSem));
+	pthread_mutex_init(&semId->lock, NULL);
+	pthread_cond_init(&semId->cond, NULL);
+	semId->type = type;
+	semId->count = count;
+	return semId;
+}
+
+SEM_ID semBCreate(int options, int initialState) {
+	return shim_semCreate(SEMTYPE_BINARY, initialState == SEM_FULL);
+}
+
+SEM_ID semMCreate(int options) {
+	return shim_semCreate(SEMTYPE_MUTEX, 1);
+}
+
+SEM_ID semCCreate(int options, int initialCount) {
+	return shim_semCreate(SEMTYPE_COUNTING, initialCount);
+}
+
+STATUS semTake(SEM_ID semId, _Vx_ticks_t timeout) {
+	struct timespec deadline;
+	if (!semId)
+		return ERROR;
+	if (timeout != NO_WAIT && timeout != WAIT_FOREVER)
+		shim_deadline(timeout, &deadline);
+
+	pthread_mutex_lock(&semId->lock);
+	// Mutex taken again by its owner
+	if (semId->type == SEMTYPE_MUTEX && semId->depth && pthread_equal(semId->owner, pthread_self())) {
+		semId->depth++;
+		pthread_mutex_unlock(&semId->lock);
+		return OK;
+	}
+	while (!semId->count)
+		if (!shim_wait(&semId->cond, &semId->lock, timeout, &deadline)) {
+			pthread_mutex_unlock(&semId->lock);
+			return ERROR;
+		}
+	semId->count--;
+	if (semId->type == SEMTYPE_MUTEX) {
+		semId->owner = pthread_self();
+		semId->depth = 1;
+	}
+	pthread_mutex_unlock(&semId->lock);
+	return OK;
+}
+
+STATUS semMTake(SEM_ID semId, _Vx_ticks_t timeout) {
+	return semTake(semId, timeout);
+}
+
+STATUS semGive(SEM_ID semId) {
+	if (!semId)
+		return ERROR;
+
+	pthread_mutex_lock(&semId->lock);
+	switch (semId->type) {
+		case SEMTYPE_MUTEX:
+			if (--semId->depth > 0) {
+				pthread_mutex_unlock(&semId->lock);
+				return OK;
+			}
+			semId->depth = 0;
+			semId->count = 1;
+			break;
+		case SEMTYPE_BINARY:
+			semId->count = 1;
+			break;
+		case SEMTYPE_COUNTING:
+			semId->count++;
+			break;
+	}
+	pthread_cond_signal(&semId->cond);
+	pthread_mutex_unlock(&semId->lock);
+	return OK;
+}
+
+STATUS semDelete(SEM_ID semId) {
+	// Waiters can't be woken with an error: the semaphore is left allocated
+	return semId ? OK : ERROR;
+}
+
+/* Message queues */
+MSG_Q_ID msgQCreate(size_t maxMsgs, size_t maxMsgLength, int options) {
+	MSG_Q_ID msgQId = calloc(1, sizeof(struct vxshimMsgQ));
+	pthread_mutex_init(&msgQId->lock, NULL);
+	pthread_cond_init(&msgQId->notEmpty, NULL);
+	pthread_cond_init(&msgQId->notFull, NULL);
+	msgQId->maxMsgs = maxMsgs ? maxMsgs : 1;
+	msgQId->maxMsgLength = maxMsgLength;
+	msgQId->lengths = calloc(msgQId->maxMsgs, sizeof(size_t));
+	msgQId->buffer = calloc(msgQId->maxMsgs, maxMsgLength);
+	return msgQId;
+}
+
+STATUS msgQDelete(MSG_Q_ID msgQId) {
+	// Waiters can't be woken with an error: the queue is left allocated
+	return msgQId ? OK : ERROR;
+}
+
+STATUS msgQSend(MSG_Q_ID msgQId, char *buffer, size_t nBytes, _Vx_ticks_t timeout, int priority) {
+	struct timespec deadline;
+	if (!msgQId || nBytes > msgQId->maxMsgLength)
+		return ERROR;
+	if (timeout != NO_WAIT && timeout != WAIT_FOREVER)
+		shim_deadline(timeout, &deadline);
+
+	pthread_mutex_lock(&msgQId->lock);
+	while (msgQId->numMsgs == msgQId->maxMsgs)
+		if (!shim_wait(&msgQId->notFull, &msgQId->lock, timeout, &deadline)) {
+			pthread_mutex_unlock(&msgQId->lock);
+			return ERROR;
+		}
+
+	// Urgent messages go to the head
+	size_t slot;
+	if (priority == MSG_PRI_URGENT) {
+		msgQId->head = (msgQId->head + msgQId->maxMsgs - 1) % msgQId->maxMsgs;
+		slot = msgQId->head;
+	} else
+		slot = (msgQId->head + msgQId->numMsgs) % msgQId->maxMsgs;
+	memcpy(&msgQId->buffer[slot * msgQId->maxMsgLength], buffer, nBytes);
+	msgQId->lengths[slot] = nBytes;
+	msgQId->numMsgs++;
+	pthread_cond_signal(&msgQId->notEmpty);
+	pthread_mutex_unlock(&msgQId->lock);
+	return OK;
+}
+
+ssize_t msgQReceive(MSG_Q_ID msgQId, char *buffer, size_t maxNBytes, _Vx_ticks_t timeout) {
+	struct timespec deadline;
+	if (!msgQId)
+		return ERROR;
+	if (timeout != NO_WAIT && timeout != WAIT_FOREVER)
+		shim_deadline(timeout, &deadline);
+
+	pthread_mutex_lock(&msgQId->lock);
+	while (!msgQId->numMsgs)
+		if (!shim_wait(&msgQId->notEmpty, &msgQId->lock, timeout, &deadline)) {
+			pthread_mutex_unlock(&msgQId->lock);
+			return ERROR;
+		}
+
+	size_t nBytes = msgQId->lengths[msgQId->head] < maxNBytes ? msgQId->lengths[msgQId->head] : maxNBytes;
+	memcpy(buffer, &msgQId->buffer[msgQId->head * msgQId->maxMsgLength], nBytes);
+	msgQId->head = (msgQId->head + 1) % msgQId->maxMsgs;
+	msgQId->numMsgs--;
+	pthread_cond_signal(&msgQId->notFull);
+	pthread_mutex_unlock(&msgQId->lock);
+	return (ssize_t) nBytes;
+}
+
+ssize_t msgQNumMsgs(MSG_Q_ID msgQId) {
+	if (!msgQId)
+		return ERROR;
+	pthread_mutex_lock(&msgQId->lock);
+	ssize_t numMsgs = (ssize_t) msgQId->numMsgs;
+	pthread_mutex_unlock(&msgQId->lock);
+	return numMsgs;
+}
+
+/* Network */
+// Every simulated node answers
+STATUS ping(char *host, int numPackets, unsigned long options) {
+	return OK;
+}
+
+// One interface: the simulated node address (DIXLSIM_IP, default 127.0.0.2) and a MAC derived from it
+int vxshim_getifaddrs(struct ifaddrs **ifap) {
+	static char ifName[] = "sim0";
+	struct {
+		struct ifaddrs inet;
+		struct ifaddrs link;
+		struct sockaddr_in sin;
+		struct sockaddr_ll sll;
+	} *pIf = calloc(1, sizeof(*pIf));
+	const char *address = getenv("DIXLSIM_IP");
+	
+	pIf->sin.sin_family = AF_INET;
+	if (!address || inet_pton(AF_INET, address, &pIf->sin.sin_addr) != 1)
+		inet_pton(AF_INET, "127.0.0.2", &pIf->sin.sin_addr);
+	pIf->sll.sll_family = AF_PACKET;
+	pIf->sll.sll_halen = 6;
+	pIf->sll.sll_addr[0] = 0x02;
+	memcpy(&pIf->sll.sll_addr[2], &pIf->sin.sin_addr, 4);
+
+	pIf->inet.ifa_name = ifName;
+	pIf->inet.ifa_flags = IFF_UP;
+	pIf->inet.ifa_addr = (struct sockaddr *) &pIf->sin;
+	pIf->inet.ifa_next = &pIf->link;
+	pIf->link.ifa_name = ifName;
+	pIf->link.ifa_flags = IFF_UP;
+	pIf->link.ifa_addr = (struct sockaddr *) &pIf->sll;
+	*ifap = &pIf->inet;
+	return 0;
+}
+
+void vxshim_freeifaddrs(struct ifaddrs *ifa) {
+	free(ifa);
+}